@@ -110,6 +110,7 @@ $(CSOUND_SRC_ROOT)/Opcodes/minmax.c  \
 $(CSOUND_SRC_ROOT)/Opcodes/pan2.c  \
 $(CSOUND_SRC_ROOT)/Opcodes/phisem.c \
 $(CSOUND_SRC_ROOT)/Opcodes/arrays.c \
+$(CSOUND_SRC_ROOT)/Opcodes/hrtfdb.c  \
 $(CSOUND_SRC_ROOT)/Opcodes/hrtfopcodes.c  \
 $(CSOUND_SRC_ROOT)/Opcodes/vbap.c  \
 $(CSOUND_SRC_ROOT)/Opcodes/vbap1.c  \
@@ -26,11 +26,165 @@
 static CS_NOINLINE void auxchprint(CSOUND *, INSDS *);
 static CS_NOINLINE void fdchprint(CSOUND *, INSDS *);
 
+/* AUXCH blocks given up by an instance, because an opcode asked for a
+ * different size or because the instance was freed, are kept in a cache
+ * belonging to the instrument, bucketed by size class (four classes per
+ * octave).  Later notes of the same instrument asking for the same or a
+ * similar layout take their blocks from there instead of the allocator.
+ * A block records only its requested size, which is never more than its
+ * real size, so a block is filed under the class at or below its size
+ * and looked up from the class of the request upwards.  The cache is
+ * emptied when the instrument's instances are compacted or freed.     */
+
+#define AUX_CLASSES     240
+#define AUX_CACHE_BYTES ((size_t) 16 * 1024 * 1024)
+
+typedef struct auxfree {
+    struct auxfree *nxt;
+    size_t  size;
+} AUXFREE;
+
+typedef struct auxcache {
+    AUXFREE *blocks[AUX_CLASSES];
+    size_t  bytes;
+    spin_lock_t lock;
+} AUXCACHE;
+
+#if defined(HAVE_ATOMIC_BUILTIN)
+#define AUX_LOAD(p)     __atomic_load_n(&(p), __ATOMIC_ACQUIRE)
+#define AUX_STORE(p, v) __atomic_store_n(&(p), v, __ATOMIC_RELEASE)
+#else
+#define AUX_LOAD(p)     (p)
+#define AUX_STORE(p, v) ((p) = (v))
+#endif
+
+static inline int32_t aux_topbit(size_t n)
+{
+#if defined(__GNUC__)
+    return 63 - __builtin_clzll((unsigned long long) n);
+#else
+    int32_t b = 0;
+    while (n >>= 1)
+      b++;
+    return b;
+#endif
+}
+
+/* largest class not above n; n >= sizeof(AUXFREE) */
+static inline int32_t aux_class(size_t n)
+{
+    int32_t b = aux_topbit(n);
+    return (b - 4) * 4 + (int32_t) ((n >> (b - 2)) & 3);
+}
+
+/* the instrument's cache, created on first use; instances of the same
+   instrument can be deinitialised from different threads, so it is
+   published under a lock */
+static AUXCACHE *aux_cache(CSOUND *csound, INSTRTXT *tp)
+{
+    AUXCACHE *cache;
+
+    if ((cache = (AUXCACHE*) AUX_LOAD(tp->auxcache)) != NULL)
+      return cache;
+    csoundSpinLock(&csound->auxcache_spinlock);
+    if ((cache = (AUXCACHE*) tp->auxcache) == NULL) {
+      cache = (AUXCACHE*) csound->Calloc(csound, sizeof(AUXCACHE));
+      if (cache != NULL) {
+        csoundSpinLockInit(&cache->lock);
+        AUX_STORE(tp->auxcache, (void*) cache);
+      }
+    }
+    csoundSpinUnLock(&csound->auxcache_spinlock);
+    return cache;
+}
+
+/* file a block in the instrument's cache, or free it */
+static void aux_release(CSOUND *csound, INSTRTXT *tp, void *auxp, size_t size)
+{
+    AUXCACHE *cache;
+    AUXFREE  *blk = (AUXFREE*) auxp;
+    int32_t  cls;
+
+    if (tp == NULL || size < sizeof(AUXFREE) || size > AUX_CACHE_BYTES ||
+        (cache = aux_cache(csound, tp)) == NULL) {
+      csound->Free(csound, auxp);
+      return;
+    }
+    cls = aux_class(size);
+    csoundSpinLock(&cache->lock);
+    if (cache->bytes + size > AUX_CACHE_BYTES) {
+      csoundSpinUnLock(&cache->lock);
+      csound->Free(csound, auxp);
+      return;
+    }
+    blk->size = size;
+    blk->nxt = cache->blocks[cls];
+    cache->blocks[cls] = blk;
+    cache->bytes += size;
+    csoundSpinUnLock(&cache->lock);
+}
+
+/* take a block of at least nbytes from the cache, cleared to zero */
+static void *aux_reuse(INSTRTXT *tp, size_t nbytes)
+{
+    AUXCACHE *cache;
+    AUXFREE  *blk = NULL, **prv;
+    int32_t  cls;
+
+    if (tp == NULL ||
+        (cache = (AUXCACHE*) AUX_LOAD(tp->auxcache)) == NULL ||
+        nbytes < sizeof(AUXFREE) || nbytes > AUX_CACHE_BYTES)
+      return NULL;
+    cls = aux_class(nbytes);
+    csoundSpinLock(&cache->lock);
+    /* this class may hold blocks smaller than nbytes ... */
+    for (prv = &cache->blocks[cls]; *prv != NULL; prv = &(*prv)->nxt) {
+      if ((*prv)->size >= nbytes) {
+        blk = *prv;
+        break;
+      }
+    }
+    /* ... the next one never does */
+    if (blk == NULL && cls + 1 < AUX_CLASSES && cache->blocks[cls + 1] != NULL)
+      blk = *(prv = &cache->blocks[cls + 1]);
+    if (blk != NULL) {
+      *prv = blk->nxt;
+      cache->bytes -= blk->size;
+    }
+    csoundSpinUnLock(&cache->lock);
+    if (blk != NULL)
+      memset((void*) blk, 0, nbytes);
+    return (void*) blk;
+}
+
+/* free all blocks cached for an instrument */
+
+void auxcachefree(CSOUND *csound, INSTRTXT *tp)
+{
+    AUXCACHE *cache = (AUXCACHE*) tp->auxcache;
+    int32_t  cls;
+
+    if (cache == NULL)
+      return;
+    for (cls = 0; cls < AUX_CLASSES; cls++) {
+      while (cache->blocks[cls] != NULL) {
+        AUXFREE *nxt = cache->blocks[cls]->nxt;
+        csound->Free(csound, cache->blocks[cls]);
+        cache->blocks[cls] = nxt;
+      }
+    }
+    tp->auxcache = NULL;
+    csound->Free(csound, cache);
+}
+
 /* allocate an auxds, or expand an old one */
 /*    call only from init (xxxset) modules */
 
 void csoundAuxAlloc(CSOUND *csound, size_t nbytes, AUXCH *auxchp)
 {
+    INSTRTXT *tp = csound->curip != NULL ? csound->curip->instr : NULL;
+    void     *auxp;
+
     if (auxchp->auxp != NULL) {
       /* if allocd with same size, just clear to zero */
       if (nbytes == (size_t)auxchp->size) {
@@ -39,9 +193,9 @@ void csoundAuxAlloc(CSOUND *csound, size_t nbytes, AUXCH *auxchp)
       }
       else {
         void  *tmp = auxchp->auxp;
-        /* if size change only, free the old space and re-allocate */
+        /* if size change only, give back the old space and re-allocate */
         auxchp->auxp = NULL;
-        csound->Free(csound, tmp);
+        aux_release(csound, tp, tmp, auxchp->size);
       }
     }
     else {                                  /* else link in new auxch blk */
@@ -49,8 +203,10 @@ void csoundAuxAlloc(CSOUND *csound, size_t nbytes, AUXCH *auxchp)
       csound->curip->auxchp = auxchp;
     }
     /* now alloc the space and update the internal data */
+    if ((auxp = aux_reuse(tp, nbytes)) == NULL)
+      auxp = csound->Calloc(csound, nbytes);
     auxchp->size = nbytes;
-    auxchp->auxp = csound->Calloc(csound, nbytes);
+    auxchp->auxp = auxp;
     auxchp->endp = (char*)auxchp->auxp + nbytes;
     if (UNLIKELY(csound->oparms->odebug))
       auxchprint(csound, csound->curip);
@@ -153,9 +309,11 @@ void auxchfree(CSOUND *csound, INSDS *ip)
       auxchprint(csound, ip);
     while (LIKELY(ip->auxchp != NULL)) {        /* for all auxp's in chain: */
       void  *auxp = (void*) ip->auxchp->auxp;
+      size_t size = ip->auxchp->size;
       AUXCH *nxt = ip->auxchp->nxtchp;
       memset((void*) ip->auxchp, 0, sizeof(AUXCH)); /*  delete the pntr     */
-      csound->Free(csound, auxp);                   /*  & free the space    */
+      if (auxp != NULL)                             /*  & cache the space   */
+        aux_release(csound, ip->instr, auxp, size);
       ip->auxchp = nxt;
     }
     if (UNLIKELY(csound->oparms->odebug))
@@ -946,6 +946,11 @@ void free_instrtxt(CSOUND *csound, INSTRTXT *instrtxt) {
     csound->Free(csound, active);
     active = nxt;
   }
+  auxcachefree(csound, ip);
+  if (ip->vwatch != NULL) {
+    csound->Free(csound, ip->vwatch);
+    ip->vwatch = NULL;
+  }
   OPTXT *t = ip->nxtop;
   while (t) {
     OPTXT *s = t->nxtop;
@@ -1269,6 +1274,14 @@ void insert_instrtxt(CSOUND *csound, INSTRTXT *instrtxt, int32 instrNum,
     /* inherit active & maxalloc flags */
     instrtxt->active = engineState->instrtxtp[instrNum]->active;
     instrtxt->maxalloc = engineState->instrtxtp[instrNum]->maxalloc;
+    instrtxt->vsteal = engineState->instrtxtp[instrNum]->vsteal;
+    instrtxt->vrelease = engineState->instrtxtp[instrNum]->vrelease;
+    instrtxt->vpriority = engineState->instrtxtp[instrNum]->vpriority;
+    instrtxt->vfading = engineState->instrtxtp[instrNum]->vfading;
+    instrtxt->vsleep = engineState->instrtxtp[instrNum]->vsleep;
+    instrtxt->vsleepthr = engineState->instrtxtp[instrNum]->vsleepthr;
+    instrtxt->vwakethr = engineState->instrtxtp[instrNum]->vwakethr;
+    instrtxt->vsleeptime = engineState->instrtxtp[instrNum]->vsleeptime;
 
     /* here we should move the old instrument definition into a deadpool
        which will be checked for active instances and freed when there are no
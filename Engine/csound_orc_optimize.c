@@ -149,7 +149,7 @@ static TREE* remove_excess_assigns(CSOUND *csound, TREE* root)
         /* if (PARSER_DEBUG) printf("test3: %c%c %c\n", */
         /*            nxt->left->value->lexeme[0], nxt->left->value->lexeme[1], */
         /*            nxt->right->value->lexeme[1]); */
-        if (nxt->type == '=' &&
+        if (nxt != NULL && nxt->type == '=' &&
             nxt->left != NULL &&
             !strcmp(current->left->value->lexeme,nxt->right->value->lexeme) &&
             same_type(nxt->left->value->lexeme, nxt->right->value->lexeme[1])) {
@@ -418,6 +418,487 @@ TREE* constant_fold(CSOUND *csound, TREE* root)
 }
 
 
+/* UDO inlining
+ *
+ * A call to a user-defined opcode normally allocates a sub-instance,
+ * copies its arguments in through xin and out through xout, and runs the
+ * body through useropcd.  When the UDO is defined in the same orchestra,
+ * is not recursive, runs at the caller's ksmps and its body only holds
+ * plain statements, the call is replaced here by a copy of the body.
+ * Locals and labels are renamed "name@n" (not a legal identifier, so
+ * they cannot clash with the instrument's own names) and added to the
+ * instrument's variable pool.  The xin names stay locals of the copy and
+ * are assigned the call's inputs, as xin would copy them, so a body that
+ * writes its inputs (directly or through an opcode that updates an input
+ * argument in place) or a global passed to it behaves as before.  Each
+ * xout value is either written straight to the call's output or, where
+ * that could change behaviour, assigned to it.  Anything this does not
+ * understand is left as an ordinary call.  This is only done with
+ * --inline-udos.
+ */
+
+extern int tree_arg_list_count(TREE *);
+extern int pnum(char *);
+extern char *get_arg_string_from_tree(CSOUND *, TREE *, TYPE_TABLE *);
+extern OENTRIES *find_opcode2(CSOUND *, char *);
+extern OENTRY *resolve_opcode(CSOUND *, OENTRIES *, char *, char *);
+extern const char *SYNTHESIZED_ARG;
+
+#define INLINE_MAX_STATEMENTS (256)
+#define INLINE_MAX_DEPTH      (32)
+
+typedef struct {
+    TREE        *body;          /* UDO statement list */
+    CS_VAR_POOL *udoPool;
+    CS_VAR_POOL *pool;          /* caller's local pool */
+    TREE        *xinArgs;       /* names bound by xin */
+    TREE        *xoutArgs;
+    TREE        *callOuts;
+    char        *aliased;       /* per output: written directly */
+    int         id;
+} INLINE_CALL;
+
+/* opcodes that act on the UDO instance itself */
+static const char *inline_excluded[] = {
+    "setksmps", "oversample", "undersample", "reinit", "rigoto", "rireturn",
+    "timout", "xtratim", "turnoff", "pset", "p", "pcount", "passign", NULL
+};
+
+static TREE *inline_find_udo(TREE *root, OENTRY *ep)
+{
+    OPCODINFO *inm;
+
+    if (ep == NULL || ep->useropinfo == NULL) return NULL;
+    inm = (OPCODINFO *) ep->useropinfo;
+    for ( ; root != NULL; root = root->next)
+      if (root->type == UDO_TOKEN &&
+          root->left->left->value->lexeme == inm->outtypes &&
+          root->left->right->value->lexeme == inm->intypes)
+        return root;
+    return NULL;
+}
+
+/* does anything reachable from body call target? */
+static int inline_calls(TREE *root, TREE *body, TREE *target, int depth)
+{
+    TREE *s, *udo;
+
+    if (depth > INLINE_MAX_DEPTH) return 1;
+    for (s = body; s != NULL; s = s->next) {
+      if (s->type != T_OPCODE && s->type != T_OPCODE0) continue;
+      udo = inline_find_udo(root, (OENTRY *) s->markup);
+      if (udo != NULL &&
+          (udo == target || inline_calls(root, udo->right, target, depth + 1)))
+        return 1;
+    }
+    return 0;
+}
+
+static int inline_count_refs(TREE *t, const char *name)
+{
+    int n = 0;
+    for ( ; t != NULL; t = t->next) {
+      if ((t->type == T_IDENT || t->type == T_ARRAY_IDENT) &&
+          t->value != NULL && !strcmp(t->value->lexeme, name))
+        n++;
+      n += inline_count_refs(t->left, name) + inline_count_refs(t->right, name);
+    }
+    return n;
+}
+
+static int inline_has_pfield(TREE *t)
+{
+    for ( ; t != NULL; t = t->next) {
+      if (t->type == T_IDENT && t->value != NULL && pnum(t->value->lexeme) >= 0)
+        return 1;
+      if (inline_has_pfield(t->left) || inline_has_pfield(t->right))
+        return 1;
+    }
+    return 0;
+}
+
+static int inline_is_label(TREE *body, const char *name)
+{
+    for ( ; body != NULL; body = body->next)
+      if (body->type == LABEL_TOKEN && !strcmp(body->value->lexeme, name))
+        return 1;
+    return 0;
+}
+
+static TREE *inline_nth(TREE *list, int n)
+{
+    while (list != NULL && n-- > 0) list = list->next;
+    return list;
+}
+
+/* checks the body holds only statements that can be moved, and finds
+   the xin (first statement) and xout (last statement) */
+static int inline_body_ok(TREE *body, TREE **xin, TREE **xout, int *branches)
+{
+    TREE *s;
+    int i, n = 0;
+
+    for (s = body; s != NULL; s = s->next) {
+      if (++n > INLINE_MAX_STATEMENTS) return 0;
+      switch (s->type) {
+      case LABEL_TOKEN:
+        *branches = 1;
+        continue;
+      case GOTO_TOKEN:
+      case IGOTO_TOKEN:
+      case KGOTO_TOKEN:
+      case '=':
+      case T_OPCODE:
+      case T_OPCODE0:
+        break;
+      default:
+        return 0;
+      }
+      if (s->value == NULL || s->markup == NULL) return 0;
+      if (!strcmp(s->value->lexeme, "xin")) {
+        if (s != body) return 0;
+        *xin = s;
+        continue;
+      }
+      if (!strcmp(s->value->lexeme, "xout")) {
+        if (s->next != NULL) return 0;
+        *xout = s;
+        continue;
+      }
+      for (i = 0; inline_excluded[i] != NULL; i++)
+        if (!strcmp(s->value->lexeme, inline_excluded[i])) return 0;
+      if (inline_has_pfield(s->left) || inline_has_pfield(s->right))
+        return 0;
+    }
+    return 1;
+}
+
+static ORCTOKEN *inline_copy_token(CSOUND *csound, ORCTOKEN *tok)
+{
+    ORCTOKEN *ans;
+
+    if (tok == NULL) return NULL;
+    ans = (ORCTOKEN *) csound->Malloc(csound, sizeof(ORCTOKEN));
+    memcpy(ans, tok, sizeof(ORCTOKEN));
+    ans->lexeme = cs_strdup(csound, tok->lexeme);
+    ans->next = NULL;
+    return ans;
+}
+
+static TREE *inline_copy_tree(CSOUND *csound, TREE *t, int withNext)
+{
+    TREE *ans;
+
+    if (t == NULL) return NULL;
+    ans = (TREE *) csound->Malloc(csound, sizeof(TREE));
+    memcpy(ans, t, sizeof(TREE));
+    ans->value = inline_copy_token(csound, t->value);
+    ans->left = inline_copy_tree(csound, t->left, 1);
+    ans->right = inline_copy_tree(csound, t->right, 1);
+    ans->next = withNext ? inline_copy_tree(csound, t->next, 1) : NULL;
+    return ans;
+}
+
+static CS_VARIABLE *inline_find_var(CSOUND *csound, TYPE_TABLE *typeTable,
+                                    CS_VAR_POOL *pool, char *name)
+{
+    char *t = name;
+    if (*t == '#') t++;
+    return csoundFindVariableWithName(csound, (*t == 'g') ?
+                                      typeTable->globalPool : pool, name);
+}
+
+/* type string of a single argument as seen from pool */
+static char *inline_arg_type(CSOUND *csound, TREE *arg,
+                             TYPE_TABLE *typeTable, CS_VAR_POOL *pool)
+{
+    CS_VAR_POOL *saved = typeTable->localPool;
+    TREE *next = arg->next;
+    char *ans;
+
+    typeTable->localPool = pool;
+    arg->next = NULL;
+    ans = get_arg_string_from_tree(csound, arg, typeTable);
+    arg->next = next;
+    typeTable->localPool = saved;
+    return ans;
+}
+
+static OENTRY *inline_find_assign(CSOUND *csound, char *outType, char *inType)
+{
+    OENTRIES *entries = find_opcode2(csound, "=");
+    OENTRY *ep = NULL;
+    int i;
+
+    if (entries == NULL) return NULL;
+    if (outType != NULL && inType != NULL)
+      ep = resolve_opcode(csound, entries, outType, inType);
+    if (ep != NULL && csound->oparms->sampleAccurate &&
+        !strcmp(ep->opname, "=.a")) {  /* as in verify_opcode */
+      for (i = 0; i < entries->count; i++)
+        if (!strcmp(entries->entries[i]->opname, "=.l")) {
+          ep = entries->entries[i];
+          break;
+        }
+    }
+    csound->Free(csound, entries);
+    return ep;
+}
+
+static void inline_set_lexeme(CSOUND *csound, TREE *t, char *name, int id)
+{
+    size_t len = strlen(name) + 16;
+    char *s = (char *) csound->Malloc(csound, len);
+
+    if (id >= 0) snprintf(s, len, "%s@%d", name, id);
+    else strNcpy(s, name, len);
+    csound->Free(csound, t->value->lexeme);
+    t->value->lexeme = s;
+}
+
+static void inline_add_var(CSOUND *csound, CS_VAR_POOL *pool,
+                           CS_VARIABLE *var, char *name)
+{
+    ARRAY_VAR_INIT varInit;
+    void *typeArg = NULL;
+
+    if (csoundFindVariableWithName(csound, pool, name) != NULL) return;
+    if (var->subType != NULL) {
+      varInit.dimensions = var->dimensions;
+      varInit.type = var->subType;
+      typeArg = &varInit;
+    }
+    csoundAddVariable(csound, pool,
+                      csoundCreateVariable(csound, csound->typePool,
+                                           var->varType, name, typeArg));
+}
+
+/* rewrites names in a copied statement list for the call site */
+static void inline_rename(CSOUND *csound, INLINE_CALL *ic, TREE *t)
+{
+    TREE *a;
+    CS_VARIABLE *var;
+    char *name;
+    int i;
+
+    for ( ; t != NULL; t = t->next) {
+      if ((t->type == T_IDENT || t->type == T_ARRAY_IDENT ||
+           t->type == LABEL_TOKEN) &&
+          t->value != NULL && t->value->lexeme != NULL) {
+        name = t->value->lexeme;
+        for (i = 0, a = ic->xoutArgs; a != NULL; a = a->next, i++)
+          if (ic->aliased[i] && !strcmp(a->value->lexeme, name)) break;
+        if (a != NULL) {
+          inline_set_lexeme(csound, t,
+                            inline_nth(ic->callOuts, i)->value->lexeme, -1);
+        }
+        else if (t->type == LABEL_TOKEN || inline_is_label(ic->body, name)) {
+          inline_set_lexeme(csound, t, name, ic->id);
+        }
+        else if ((var = csoundFindVariableWithName(csound, ic->udoPool,
+                                                   name)) != NULL) {
+          inline_set_lexeme(csound, t, name, ic->id);
+          inline_add_var(csound, ic->pool, var, t->value->lexeme);
+        }
+      }
+      inline_rename(csound, ic, t->left);
+      inline_rename(csound, ic, t->right);
+    }
+}
+
+/* builds the statements replacing call; returns 0 to keep the call */
+static int inline_expand(CSOUND *csound, TREE *root, TREE *udo, TREE *call,
+                         CS_VAR_POOL *pool, TYPE_TABLE *typeTable, int id,
+                         TREE **first, TREE **last)
+{
+    INLINE_CALL ic;
+    TREE *xin = NULL, *xout = NULL, *s, *a, *c, *w = NULL, *head = NULL, *tail;
+    OENTRY **assign = NULL, **inAssign = NULL;
+    char *intypes = udo->left->right->value->lexeme;
+    char *outtypes = udo->left->left->value->lexeme;
+    int branches = 0, nin, nout, i, ok = 0;
+
+    if (udo->markup == NULL || udo->right == NULL ||
+        strchr(intypes, '[') != NULL || strchr(outtypes, '[') != NULL)
+      return 0;
+    if (!inline_body_ok(udo->right, &xin, &xout, &branches) ||
+        inline_calls(root, udo->right, udo, 0))
+      return 0;
+
+    nin = (xin != NULL) ? tree_arg_list_count(xin->left) : 0;
+    nout = (xout != NULL) ? tree_arg_list_count(xout->right) : 0;
+    if (tree_arg_list_count(call->right) != nin + 1 ||
+        tree_arg_list_count(call->left) != nout)
+      return 0;
+    /* the trailing argument is the local ksmps; 0 means the caller's */
+    a = inline_nth(call->right, nin);
+    if (a->markup != &SYNTHESIZED_ARG &&
+        !(a->type == INTEGER_TOKEN && a->value->value == 0))
+      return 0;
+    for (i = 0, a = call->right, c = (xin ? xin->left : NULL); i < nin;
+         i++, a = a->next, c = c->next) {
+      if (a->type != T_IDENT && a->type != INTEGER_TOKEN &&
+          a->type != NUMBER_TOKEN && a->type != STRING_TOKEN)
+        return 0;
+      if (c->type != T_IDENT) return 0;
+    }
+    for (a = call->left; a != NULL; a = a->next)
+      if (a->type != T_IDENT) return 0;
+
+    for (s = udo->right; s != NULL && s->next != xout; s = s->next) ;
+    if (xout != NULL && s != NULL && s != xin) w = s;
+
+    memset(&ic, 0, sizeof(INLINE_CALL));
+    ic.body = udo->right;
+    ic.udoPool = (CS_VAR_POOL *) udo->markup;
+    ic.pool = pool;
+    ic.xinArgs = (xin != NULL) ? xin->left : NULL;
+    ic.xoutArgs = (xout != NULL) ? xout->right : NULL;
+    ic.callOuts = call->left;
+    ic.id = id;
+    if (nout > 0) {
+      ic.aliased = (char *) csound->Calloc(csound, nout);
+      assign = (OENTRY **) csound->Calloc(csound, nout * sizeof(OENTRY *));
+    }
+    if (nin > 0)
+      inAssign = (OENTRY **) csound->Calloc(csound, nin * sizeof(OENTRY *));
+
+    /* xin copies each input into the instance; so does the inlined code */
+    for (i = 0, a = call->right, c = ic.xinArgs; i < nin;
+         i++, a = a->next, c = c->next) {
+      char *outType = inline_arg_type(csound, c, typeTable, ic.udoPool);
+      char *inType = inline_arg_type(csound, a, typeTable, pool);
+      inAssign[i] = inline_find_assign(csound, outType, inType);
+      if (outType != NULL) csound->Free(csound, outType);
+      if (inType != NULL) csound->Free(csound, inType);
+      if (inAssign[i] == NULL) goto done;
+    }
+
+    /* an output value produced by the last statement and used nowhere
+       else can be written straight into the caller's variable, unless
+       that is a global the body might read */
+    for (i = 0, a = ic.xoutArgs, c = call->left; i < nout;
+         i++, a = a->next, c = c->next) {
+      char *name = a->value->lexeme;
+      CS_VARIABLE *v1, *v2;
+      int refs = 0;
+
+      if (!branches && w != NULL && a->type == T_IDENT &&
+          inline_count_refs(ic.xoutArgs, name) == 1 &&
+          inline_count_refs(ic.xinArgs, name) == 0 &&
+          inline_count_refs(w->left, name) == 1 &&
+          inline_count_refs(call->right, c->value->lexeme) == 0 &&
+          c->value->lexeme[c->value->lexeme[0] == '#'] != 'g' &&
+          (v1 = csoundFindVariableWithName(csound, ic.udoPool, name)) != NULL &&
+          (v2 = inline_find_var(csound, typeTable, pool,
+                                c->value->lexeme)) != NULL &&
+          v1->varType == v2->varType && v1->subType == v2->subType) {
+        for (s = udo->right; s != xout; s = s->next)
+          refs += inline_count_refs(s->left, name) +
+                  inline_count_refs(s->right, name);
+        if (refs == 1) {
+          ic.aliased[i] = 1;
+          continue;
+        }
+      }
+      {
+        char *outType = inline_arg_type(csound, c, typeTable, pool);
+        char *inType = inline_arg_type(csound, a, typeTable, ic.udoPool);
+        assign[i] = inline_find_assign(csound, outType, inType);
+        if (outType != NULL) csound->Free(csound, outType);
+        if (inType != NULL) csound->Free(csound, inType);
+        if (assign[i] == NULL) goto done;
+      }
+    }
+
+    /* assign the inputs, copy and rename the body, then assign the
+       outputs not aliased */
+    tail = NULL;
+    for (i = 0, a = call->right, c = ic.xinArgs; i < nin;
+         i++, a = a->next, c = c->next) {
+      TREE *t = make_leaf(csound, c->line, c->locn, '=',
+                          make_token(csound, "="));
+      t->value->type = '=';
+      t->left = inline_copy_tree(csound, c, 0);
+      inline_rename(csound, &ic, t->left);
+      t->right = inline_copy_tree(csound, a, 0);
+      t->markup = inAssign[i];
+      if (tail == NULL) head = t;
+      else tail->next = t;
+      tail = t;
+    }
+    for (s = udo->right; s != NULL; s = s->next) {
+      TREE *t;
+      if (s == xin || s == xout) continue;
+      t = inline_copy_tree(csound, s, 0);
+      inline_rename(csound, &ic, t);
+      if (tail == NULL) head = t;
+      else tail->next = t;
+      tail = t;
+    }
+    for (i = 0, a = ic.xoutArgs, c = call->left; i < nout;
+         i++, a = a->next, c = c->next) {
+      TREE *t;
+      if (ic.aliased[i]) continue;
+      t = make_leaf(csound, a->line, a->locn, '=', make_token(csound, "="));
+      t->value->type = '=';
+      t->left = inline_copy_tree(csound, c, 0);
+      t->right = inline_copy_tree(csound, a, 0);
+      inline_rename(csound, &ic, t->right);
+      t->markup = assign[i];
+      if (tail == NULL) head = t;
+      else tail->next = t;
+      tail = t;
+    }
+    *first = head;
+    *last = tail;
+    ok = 1;
+
+ done:
+    if (ic.aliased != NULL) csound->Free(csound, ic.aliased);
+    if (assign != NULL) csound->Free(csound, assign);
+    if (inAssign != NULL) csound->Free(csound, inAssign);
+    return ok;
+}
+
+/* Replaces calls to suitable UDOs in instrument bodies by their code */
+TREE *csound_orc_inline_udos(CSOUND *csound, TREE *root, TYPE_TABLE *typeTable)
+{
+    TREE *current, *s, *prev, *udo, *first, *last;
+    int count = 0;
+
+    for (current = root; current != NULL; current = current->next) {
+      if (current->type != INSTR_TOKEN || current->markup == NULL) continue;
+      prev = NULL;
+      s = current->right;
+      while (s != NULL) {
+        if ((s->type == T_OPCODE || s->type == T_OPCODE0) &&
+            (udo = inline_find_udo(root, (OENTRY *) s->markup)) != NULL &&
+            inline_expand(csound, root, udo, s,
+                          (CS_VAR_POOL *) current->markup, typeTable,
+                          count, &first, &last)) {
+          TREE *next = s->next;
+          count++;
+          if (first == NULL) first = next;
+          else last->next = next;
+          if (prev != NULL) prev->next = first;
+          else current->right = first;
+          s->next = NULL;
+          delete_tree(csound, s);
+          /* rescan, so calls inside the copied body are inlined too */
+          s = first;
+          continue;
+        }
+        prev = s;
+        s = s->next;
+      }
+    }
+    if (count > 0 && UNLIKELY(csound->oparms->odebug))
+      csound->Message(csound, Str("inlined %d UDO calls\n"), count);
+    return root;
+}
+
+
 /* Optimizes tree (expressions, etc.) */
 TREE * csound_orc_optimize(CSOUND *csound, TREE *root)
 {
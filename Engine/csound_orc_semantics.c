@@ -34,6 +34,7 @@
 #include "csound_standard_types.h"
 #include "csound_orc_expressions.h"
 #include "csound_orc_semantics.h"
+#include "csmodule.h"
 
 extern char *csound_orcget_text ( void *scanner );
 static int is_label(char* ident, CONS_CELL* labelList);
@@ -617,6 +618,7 @@ OENTRY* find_opcode(CSOUND *csound, char *opname)
       return 0;
 
     shortName = get_opcode_short_name(csound, opname);
+    csoundLoadLazyPlugins(csound, shortName, 0);
 
     head = cs_hash_table_get(csound, csound->opcodes, shortName);
 
@@ -648,6 +650,8 @@ OENTRIES* find_opcode2(CSOUND* csound, char* opname)
     }
 
     shortName = get_opcode_short_name(csound, opname);
+    /* plugins may add overloads to names that are already defined */
+    csoundLoadLazyPlugins(csound, shortName, 0);
     head = cs_hash_table_get(csound, csound->opcodes, shortName);
     retVal = get_entries(csound, cs_cons_length(head));
     while (head != NULL) {
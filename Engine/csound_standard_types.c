@@ -25,6 +25,7 @@
 #include "csound_standard_types.h"
 #include "pstream.h"
 #include <stdlib.h>
+#include <string.h>
 
 
 /* MEMORY COPYING FUNCTIONS */
@@ -109,6 +110,34 @@ static size_t array_get_num_members(ARRAYDAT* aSrc) {
     return (size_t)retVal;
 }
 
+/* Make sure an array's data block holds at least 'bytes' bytes, keeping
+   the existing contents and zeroing any new space.  Storage only ever
+   grows, so a shrinking copy or resize reuses the block it already has.
+   Allocations made outside an init pass are counted and reported, as
+   they are not real-time safe. */
+MYFLT *csoundArrayReserve(CSOUND *csound, ARRAYDAT *p, size_t bytes)
+{
+    if (p->data != NULL && bytes <= p->allocated)
+      return p->data;
+    if (csound->ids == NULL && csound->engineStatus & CS_STATE_COMP) {
+      long n = ++csound->perf_array_allocs;
+      if ((n & (n - 1)) == 0)       /* 1, 2, 4, 8... */
+        csound->Warning(csound,
+                        Str("array storage allocated at performance time "
+                            "(%ld so far); size it at init or use "
+                            "reservearray"), n);
+    }
+    if (p->data == NULL)
+      p->data = (MYFLT*) csound->Calloc(csound, bytes);
+    else {
+      p->data = (MYFLT*) csound->ReAlloc(csound, p->data, bytes);
+      if (p->allocated)         /* 0 if some opcode sized it by hand */
+        memset((char*) p->data + p->allocated, 0, bytes - p->allocated);
+    }
+    p->allocated = bytes;
+    return p->data;
+}
+
 void array_copy_value(void* csound, void* dest, void* src) {
     ARRAYDAT* aDest = (ARRAYDAT*)dest;
     ARRAYDAT* aSrc = (ARRAYDAT*)src;
@@ -125,20 +154,29 @@ void array_copy_value(void* csound, void* dest, void* src) {
        aSrc->dimensions != aDest->dimensions ||
        aSrc->arrayType != aDest->arrayType ||
        arrayNumMembers != array_get_num_members(aDest)) {
+        size_t bytes = aSrc->arrayMemberSize * arrayNumMembers;
+        /* members of another type cannot be copied over stale data */
+        int retyped = aDest->data != NULL &&
+          (aSrc->arrayMemberSize != aDest->arrayMemberSize ||
+           aSrc->arrayType != aDest->arrayType);
 
         aDest->arrayMemberSize = aSrc->arrayMemberSize;
-        aDest->dimensions = aSrc->dimensions;
-        if(aDest->sizes != NULL) {
-            cs->Free(cs, aDest->sizes);
+        if(aDest->sizes == NULL || aSrc->dimensions != aDest->dimensions) {
+            if(aDest->sizes != NULL) {
+                cs->Free(cs, aDest->sizes);
+            }
+            aDest->sizes = cs->Malloc(cs, sizeof(int) * aSrc->dimensions);
         }
-        aDest->sizes = cs->Malloc(cs, sizeof(int) * aSrc->dimensions);
+        aDest->dimensions = aSrc->dimensions;
         memcpy(aDest->sizes, aSrc->sizes, sizeof(int) * aSrc->dimensions);
         aDest->arrayType = aSrc->arrayType;
 
-        if(aDest->data != NULL) {
+        if(retyped) {
             cs->Free(cs, aDest->data);
+            aDest->data = NULL;
+            aDest->allocated = 0;
         }
-        aDest->data = cs->Calloc(cs, aSrc->arrayMemberSize * arrayNumMembers);
+        csoundArrayReserve(cs, aDest, bytes);
     }
 
     for (j = 0; j < arrayNumMembers; j++) {
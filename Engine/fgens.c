@@ -32,6 +32,7 @@
 #include "fgens.h"
 #include "pstream.h"
 #include "pvfileio.h"
+#include "csmodule.h"
 #include <stdlib.h>
 /* #undef ISSTRCOD */
 
@@ -210,6 +211,9 @@ int hfgens(CSOUND *csound, FUNC **ftpp, const EVTBLK *evtblkp, int mode)
           break;
         }
         n = n->next;                            /*  and round again         */
+        /* not found: it may be in a plugin deferred by the manifest */
+        if (n == NULL && csoundLoadLazyPlugins(csound, ff.e.strarg, 1) > 0)
+          n = (NAMEDGEN*) csound->namedgen;
       }
       if (UNLIKELY(n == NULL)) {
         return fterror(&ff, Str("Named gen \"%s\" not defined"), ff.e.strarg);
@@ -3342,6 +3346,7 @@ int allocgen(CSOUND *csound, char *s, GEN fn)
       n = n->next;
     }
     /* Need to allocate */
+    csoundPluginManifestRecord(csound, s, 1);
     n = (NAMEDGEN*) csound->Malloc(csound, sizeof(NAMEDGEN));
     n->genum = csound->genmax++;
     n->next = (NAMEDGEN*) csound->namedgen;
@@ -33,6 +33,7 @@
 #include "interlocks.h"
 #include "csound_type_system.h"
 #include "csound_standard_types.h"
+#include "voices.h"
 #include <inttypes.h>
 
 static  void    showallocs(CSOUND *);
@@ -91,6 +92,7 @@ static void message_string_enqueue(CSOUND *csound, int attr,
     //csound->message_string_queue[wp].str[MAX_MESSAGE_STR-1] = '\0';
     csound->message_string_queue_wp = wp + 1 < QUEUESIZ ? wp + 1 : 0;
     ATOMIC_INCR(csound->message_string_queue_items);
+    event_insert_wake(csound);
 }
 
 static void no_op(CSOUND *csound, int attr,
@@ -145,13 +147,69 @@ static int reinit_pass(CSOUND *csound, INSDS *ip, OPDS *ids) {
 }
 
 
+/*
+ * Realtime mode allocation queue.  Requests can come from more than one
+ * thread (reinit is requested from whichever thread runs the opcode), so
+ * a slot is claimed by moving the write index with a compare and swap,
+ * filled in, and then published through its ready flag.  The insertion
+ * thread takes slots strictly in order, so notes for an instrument start
+ * in the order they were queued.
+ */
+ALLOC_DATA *alloc_queue_claim(CSOUND *csound)
+{
+  long wp, nwp;
+  do {
+    wp = (long) ATOMIC_GET(csound->alloc_queue_wp);
+    nwp = wp + 1 < MAX_ALLOC_QUEUE ? wp + 1 : 0;
+  } while (ATOMIC_CMP_XCH((long *) &csound->alloc_queue_wp, nwp, wp));
+  return &csound->alloc_queue[wp];
+}
+
+void alloc_queue_publish(CSOUND *csound, ALLOC_DATA *item)
+{
+  item->qtime = csoundGetRealTime(csound->csRtClock);
+  ATOMIC_SET(item->ready, 1);
+  ATOMIC_INCR(csound->alloc_queue_items);
+  event_insert_wake(csound);
+}
+
+/* wake the insertion thread if it is waiting for work; it flags that
+   under alloc_queue_mutex before it last looks at the queues, so either
+   it sees the new item or it is already waiting for this signal */
+void event_insert_wake(CSOUND *csound)
+{
+  if (ATOMIC_GET(csound->alloc_queue_sleeping)) {
+    csoundLockMutex(csound->alloc_queue_mutex);
+    csoundCondSignal(csound->alloc_queue_cond);
+    csoundUnlockMutex(csound->alloc_queue_mutex);
+  }
+}
+
+static inline int event_insert_idle(CSOUND *csound, ALLOC_DATA *next)
+{
+  return (ATOMIC_GET(csound->event_insert_loop) &&
+          !ATOMIC_GET(next->ready) &&
+          ATOMIC_GET(csound->message_string_queue_items) == 0);
+}
+
+static void init_latency(CSOUND *csound, ALLOC_DATA *item)
+{
+  double t = csoundGetRealTime(csound->csRtClock) - item->qtime;
+  csound->init_latency_count++;
+  csound->init_latency_total += t;
+  if (t > csound->init_latency_max)
+    csound->init_latency_max = t;
+  if (UNLIKELY(csound->oparms->odebug))
+    csound->Message(csound, Str("instr %d started %.3f ms after queueing\n"),
+                    item->insno, t * 1000.0);
+}
+
 /*
  * creates a thread to process instance allocations
  */
 uintptr_t event_insert_thread(void *p) {
   CSOUND *csound = (CSOUND *) p;
   ALLOC_DATA *inst = csound->alloc_queue;
-  float wakeup = (1000*csound->ksmps/csound->esr);
   unsigned long rp = 0, items, rpm = 0;
   message_string_queue_t *mess = NULL;
   void (*csoundMessageStringCallback)(CSOUND *csound,
@@ -175,12 +233,16 @@ uintptr_t event_insert_thread(void *p) {
   csoundSetMessageCallback(csound, no_op);
  }
 
-  while(csound->event_insert_loop) {
-    // get the value of items_to_alloc
-    items = ATOMIC_GET(csound->alloc_queue_items);
-    if(items == 0)
-       csoundSleep((int) ((int) wakeup > 0 ? wakeup : 1));
-    else while(items) {
+  while(ATOMIC_GET(csound->event_insert_loop)) {
+    if (event_insert_idle(csound, &inst[rp])) {
+      csoundLockMutex(csound->alloc_queue_mutex);
+      ATOMIC_SET(csound->alloc_queue_sleeping, 1);
+      while (event_insert_idle(csound, &inst[rp]))
+        csoundCondWait(csound->alloc_queue_cond, csound->alloc_queue_mutex);
+      ATOMIC_SET(csound->alloc_queue_sleeping, 0);
+      csoundUnlockMutex(csound->alloc_queue_mutex);
+    }
+    while (ATOMIC_GET(inst[rp].ready)) {
         if (inst[rp].type == 3)  {
           INSDS *ip = inst[rp].ip;
           OPDS *ids = inst[rp].ids;
@@ -201,15 +263,17 @@ uintptr_t event_insert_thread(void *p) {
           csoundSpinLock(&csound->alloc_spinlock);
           insert_midi(csound, inst[rp].insno, inst[rp].chn, &inst[rp].mep);
           csoundSpinUnLock(&csound->alloc_spinlock);
+          init_latency(csound, &inst[rp]);
         }
        if(inst[rp].type == 0)  {
           csoundSpinLock(&csound->alloc_spinlock);
           insert_event(csound, inst[rp].insno, &inst[rp].blk);
           csoundSpinUnLock(&csound->alloc_spinlock);
+          init_latency(csound, &inst[rp]);
         }
-        // decrement the value of items_to_alloc
+        // release the slot and decrement the value of items_to_alloc
+        ATOMIC_SET(inst[rp].ready, 0);
         ATOMIC_DECR(csound->alloc_queue_items);
-        items--;
         rp = rp + 1 < MAX_ALLOC_QUEUE ? rp + 1 : 0;
       }
      items = ATOMIC_GET(csound->message_string_queue_items);
@@ -280,6 +344,10 @@ static void set_xtratim(CSOUND *csound, INSDS *ip)
   ip->offbet = csound->curBeat + (csound->curBeat_inc * (double) ip->xtratim);
   ip->relesing = 1;
   csound->engineState.instrtxtp[ip->insno]->pending_release++;
+  if (UNLIKELY(ip->vsleep == VOICE_SLEEP)) {
+    ip->vsleep = VOICE_AWAKE;           /* let the release stage run */
+    ip->vsilent = 0;
+  }
 }
 
 /* insert an instr copy into active list */
@@ -287,12 +355,11 @@ static void set_xtratim(CSOUND *csound, INSDS *ip)
 int insert(CSOUND *csound, int insno, EVTBLK *newevtp) {
 
   if(csound->oparms->realtime) {
-    unsigned long wp = csound->alloc_queue_wp;
-    csound->alloc_queue[wp].insno = insno;
-    csound->alloc_queue[wp].blk =  *newevtp;
-    csound->alloc_queue[wp].type = 0;
-    csound->alloc_queue_wp = wp + 1 < MAX_ALLOC_QUEUE ? wp + 1 : 0;
-    ATOMIC_INCR(csound->alloc_queue_items);
+    ALLOC_DATA *item = alloc_queue_claim(csound);
+    item->insno = insno;
+    item->blk =  *newevtp;
+    item->type = 0;
+    alloc_queue_publish(csound, item);
     return 0;
   }
   else return insert_event(csound, insno, newevtp);
@@ -331,6 +398,8 @@ int insert_event(CSOUND *csound, int insno, EVTBLK *newevtp)
       csound->Warning(csound, Str("Instrument %d muted\n"), insno);
     return 0;
   }
+  if (UNLIKELY(csound->voices != NULL && csoundVoiceShed(csound, tp)))
+    return 0;
   if (tp->cpuload > FL(0.0)) {
     csound->cpu_power_busy += tp->cpuload;
     /* if there is no more cpu processing time*/
@@ -341,7 +410,8 @@ int insert_event(CSOUND *csound, int insno, EVTBLK *newevtp)
       return(0);
     }
   }
-  if (UNLIKELY(tp->maxalloc > 0 && tp->active >= tp->maxalloc)) {
+  if (UNLIKELY(tp->maxalloc > 0 && tp->active - tp->vfading >= tp->maxalloc &&
+               !csoundVoiceSteal(csound, tp))) {
     csoundWarning(csound, Str("cannot allocate last note because it exceeds "
                               "instr maxalloc"));
     return(0);
@@ -385,6 +455,11 @@ int insert_event(CSOUND *csound, int insno, EVTBLK *newevtp)
     ip->onedkr = csound->onedkr;
     ip->kicvt = csound->kicvt;
     ip->pds = NULL;
+    ip->vflags = 0;
+    ip->vsleep = VOICE_AWAKE;
+    ip->vstart = csound->icurTime;
+    if (UNLIKELY(tp->vsteal || tp->vsleep))
+      csoundVoiceStart(csound, tp, ip);
     /* Add an active instrument */
     tp->active++;
     tp->instcnt++;
@@ -403,6 +478,10 @@ int insert_event(CSOUND *csound, int insno, EVTBLK *newevtp)
     ip->tieflag = 0;
     ip->actflg++;                   /*    and mark the instr active */
   }
+  else if (UNLIKELY(ip->vsleep == VOICE_SLEEP)) {
+    ip->vsleep = VOICE_AWAKE;       /* a tied note wakes it */
+    ip->vsilent = 0;
+  }
 
 
   /* init: */
@@ -558,13 +637,12 @@ int insert_event(CSOUND *csound, int insno, EVTBLK *newevtp)
 int MIDIinsert(CSOUND *csound, int insno, MCHNBLK *chn, MEVENT *mep) {
 
   if(csound->oparms->realtime) {
-    unsigned long wp = csound->alloc_queue_wp;
-    csound->alloc_queue[wp].insno = insno;
-    csound->alloc_queue[wp].chn = chn;
-    csound->alloc_queue[wp].mep = *mep;
-    csound->alloc_queue[wp].type = 1;
-    csound->alloc_queue_wp = wp + 1 < MAX_ALLOC_QUEUE ? wp + 1 : 0;
-    ATOMIC_INCR(csound->alloc_queue_items);
+    ALLOC_DATA *item = alloc_queue_claim(csound);
+    item->insno = insno;
+    item->chn = chn;
+    item->mep = *mep;
+    item->type = 1;
+    alloc_queue_publish(csound, item);
     return 0;
   }
   else return insert_midi(csound, insno, chn, mep);
@@ -586,6 +664,8 @@ int insert_midi(CSOUND *csound, int insno, MCHNBLK *chn, MEVENT *mep)
     return 0;     /* muted */
 
   tp = csound->engineState.instrtxtp[insno];
+  if (UNLIKELY(csound->voices != NULL && csoundVoiceShed(csound, tp)))
+    return 0;
   if (tp->cpuload > FL(0.0)) {
     csound->cpu_power_busy += tp->cpuload;
     if (UNLIKELY(csound->cpu_power_busy > FL(100.0))) {
@@ -596,7 +676,8 @@ int insert_midi(CSOUND *csound, int insno, MCHNBLK *chn, MEVENT *mep)
       return(0);
     }
   }
-  if (UNLIKELY(tp->maxalloc > 0 && tp->active >= tp->maxalloc)) {
+  if (UNLIKELY(tp->maxalloc > 0 && tp->active - tp->vfading >= tp->maxalloc &&
+               !csoundVoiceSteal(csound, tp))) {
     csoundWarning(csound, Str("cannot allocate last note because it exceeds "
                               "instr maxalloc"));
     return(0);
@@ -677,6 +758,11 @@ int insert_midi(CSOUND *csound, int insno, MCHNBLK *chn, MEVENT *mep)
   ip->onedkr       = csound->onedkr;
   ip->kicvt        = csound->kicvt;
   ip->pds          = NULL;
+  ip->vflags       = 0;
+  ip->vsleep       = VOICE_AWAKE;
+  ip->vstart       = csound->icurTime;
+  if (UNLIKELY(tp->vsteal || tp->vsleep))
+    csoundVoiceStart(csound, tp, ip);
   pfields          = (CS_VAR_MEM*)&ip->p0;
 
   if (tp->psetdata != NULL) {
@@ -893,6 +979,8 @@ static void deact(CSOUND *csound, INSDS *ip)
   csound->engineState.instrtxtp[ip->insno]->active--;
   if (ip->xtratim > 0)
     csound->engineState.instrtxtp[ip->insno]->pending_release--;
+  if (UNLIKELY(ip->vflags & VOICE_FADE))
+    csound->engineState.instrtxtp[ip->insno]->vfading--;
   csound->cpu_power_busy -= csound->engineState.instrtxtp[ip->insno]->cpuload;
   /* IV - Sep 8 2002: free subinstr instances */
   /* that would otherwise result in a memory leak */
@@ -1004,6 +1092,30 @@ void xturnoff_now(CSOUND *csound, INSDS *ip)
   xturnoff(csound, ip);
 }
 
+/* Turn off an instance after 'kcycles' of its own k-cycles, even if */
+/* it is already releasing. Used for stolen voices (voices.c).       */
+void xturnoff_fast(CSOUND *csound, INSDS *ip, int kcycles)
+{
+  if (ip->relesing) {
+    /* take it off the turnoff list so it can be rescheduled sooner */
+    INSDS *prvip = csound->frstoff;
+    if (prvip == ip)
+      csound->frstoff = ip->nxtoff;
+    else {
+      while (prvip != NULL && prvip->nxtoff != ip)
+        prvip = prvip->nxtoff;
+      if (prvip != NULL)
+        prvip->nxtoff = ip->nxtoff;
+    }
+    if (ip->xtratim > 0)
+      csound->engineState.instrtxtp[ip->insno]->pending_release--;
+    ip->relesing = 0;
+    ip->offtim = -1.0;
+  }
+  ip->xtratim = kcycles;
+  xturnoff(csound, ip);
+}
+
 extern void free_instrtxt(CSOUND *csound, INSTRTXT *instrtxt);
 
 
@@ -1020,6 +1132,10 @@ void free_instr_var_memory(CSOUND* csound, INSDS* ip) {
     }
     current = current->next;
   }
+  if (ip->vwatch != NULL) {
+    csound->Free(csound, ip->vwatch);
+    ip->vwatch = NULL;
+  }
 }
 
 void orcompact(CSOUND *csound)          /* free all inactive instr spaces */
@@ -1066,6 +1182,7 @@ void orcompact(CSOUND *csound)          /* free all inactive instr spaces */
     }
 
     txtp->act_instance = NULL;                /* no free instances */
+    auxcachefree(csound, txtp);               /* & no cached aux space */
   }
   /* check current items in deadpool to see if they need deleting */
   {
@@ -1364,6 +1481,96 @@ int subinstrset(CSOUND *csound, SUBINST *p){
 */
 int useropcd1(CSOUND *, UOPCODE*), useropcd2(CSOUND *, UOPCODE*);
 
+/* Perf-time argument copies of a UDO call are planned once per init from
+   the argument types, so useropcd1/useropcd2 only loop over the arguments
+   that change during performance.  At the caller's ksmps, adjacent a-rate
+   arguments whose buffers are contiguous on both sides (and whose type
+   headers in between agree) are merged into a single memcpy range. */
+
+static void udo_plan_add(CSOUND *csound, UDO_ARGCOPY *plan, int *n,
+                         CS_VARIABLE *var, MYFLT *src, MYFLT *dst,
+                         int local, uint32_t ksmps)
+{
+    UDO_ARGCOPY *c;
+    int kind, size = 1;
+
+    if (var->varType == &CS_VAR_TYPE_I || var->varType == &CS_VAR_TYPE_b ||
+        var->subType == &CS_VAR_TYPE_I || src == NULL || dst == NULL)
+      return;                                   /* init time only */
+    if (var->varType == &CS_VAR_TYPE_A) {
+      kind = UDOARG_ASIG;
+      size = (ksmps == 1) ? 1 : (int) csound->ksmps;
+    }
+    else if (var->varType == &CS_VAR_TYPE_K)
+      kind = UDOARG_SCALAR;
+    else if (local && var->varType == &CS_VAR_TYPE_ARRAY &&
+             var->subType == &CS_VAR_TYPE_A)
+      kind = UDOARG_ASIG_ARRAY;
+    else
+      kind = UDOARG_VALUE;
+
+    if (kind == UDOARG_ASIG && !local && *n > 0) {
+      size_t gap = CS_FLOAT_ALIGN(CS_VAR_TYPE_OFFSET);
+      c = &plan[*n - 1];
+      if (c->kind == UDOARG_ASIG &&
+          (char*) (c->src + c->size) + gap == (char*) src &&
+          (char*) (c->dst + c->size) + gap == (char*) dst &&
+          memcmp(c->src + c->size, c->dst + c->size, gap) == 0) {
+        c->size += (int) (gap / sizeof(MYFLT)) + size;
+        return;
+      }
+    }
+    c = &plan[(*n)++];
+    c->src = src;
+    c->dst = dst;
+    c->size = size;
+    c->kind = kind;
+    c->type = var->varType;
+}
+
+static void udo_copy_plan(CSOUND *csound, UOPCODE *p, int local)
+{
+    OPCOD_IOBUFS *buf = p->buf;
+    OPCODINFO    *inm = buf->opcode_info;
+    MYFLT        **internal_ptrs = buf->iobufp_ptrs;
+    MYFLT        **external_ptrs = p->ar;
+    CS_VARIABLE  *current;
+    int          i;
+
+    buf->ninplan = 0;
+    current = inm->in_arg_pool->head;
+    for (i = 0; i < inm->inchns; i++, current = current->next)
+      udo_plan_add(csound, buf->inplan, &buf->ninplan, current,
+                   external_ptrs[i + inm->outchns],
+                   internal_ptrs[i + inm->outchns], local, CS_KSMPS);
+    buf->noutplan = 0;
+    current = inm->out_arg_pool->head;
+    for (i = 0; i < inm->outchns; i++, current = current->next)
+      udo_plan_add(csound, buf->outplan, &buf->noutplan, current,
+                   internal_ptrs[i], external_ptrs[i], local, CS_KSMPS);
+}
+
+static inline int udo_array_members(ARRAYDAT *a)
+{
+    int j, count = a->sizes[0];
+    for (j = 1; j < a->dimensions; j++)
+      count *= a->sizes[j];
+    return count;
+}
+
+/* copy 'nsmps' samples of every a-rate array member, src from 'sofs' and
+   dst from 'dofs' */
+static void udo_copy_asig_array(ARRAYDAT *src, ARRAYDAT *dst,
+                                int sofs, int dofs, int nsmps)
+{
+    int j, count = udo_array_members(src);
+    int stride = src->arrayMemberSize / sizeof(MYFLT);
+    for (j = 0; j < count; j++)
+      memcpy(dst->data + j * stride + dofs, src->data + j * stride + sofs,
+             nsmps * sizeof(MYFLT));
+}
+
+
 int useropcdset(CSOUND *csound, UOPCODE *p)
 {
     OPDS         *saved_ids = csound->ids;
@@ -1537,6 +1744,7 @@ int useropcdset(CSOUND *csound, UOPCODE *p)
       parent_ip->xtratim = lcurip->xtratim;
       p->h.opadr = (SUBR) useropcd2;
     }
+    udo_copy_plan(csound, p, local_ksmps != CS_KSMPS);
     if (UNLIKELY(csound->oparms->odebug))
       csound->Message(csound, "EXTRATIM=> cur(%p): %d, parent(%p): %d\n",
                       lcurip, lcurip->xtratim, parent_ip, parent_ip->xtratim);
@@ -1888,12 +2096,10 @@ int subinstr(CSOUND *csound, SUBINST *p)
 int useropcd1(CSOUND *csound, UOPCODE *p)
 {
   OPDS    *saved_pds = CS_PDS;
-  int    g_ksmps, ofs, early, offset, i;
-  OPCODINFO   *inm;
-  CS_VARIABLE* current;
+  int    g_ksmps, ofs, early, offset, i, nsmps;
   INSDS    *this_instr = p->ip;
-  MYFLT** internal_ptrs = p->buf->iobufp_ptrs;
-  MYFLT** external_ptrs = p->ar;
+  OPCOD_IOBUFS *buf = p->buf;
+  UDO_ARGCOPY *c;
   int done;
 
   done = ATOMIC_GET(p->ip->init_done);
@@ -1905,7 +2111,6 @@ int useropcd1(CSOUND *csound, UOPCODE *p)
   offset = p->h.insdshead->ksmps_offset;
   p->ip->spin = p->parent_ip->spin;
   p->ip->spout = p->parent_ip->spout;
-  inm = p->buf->opcode_info;
 
   /* global ksmps is the caller instr ksmps minus sample-accurate end */
   g_ksmps = CS_KSMPS - early;
@@ -1920,268 +2125,105 @@ int useropcd1(CSOUND *csound, UOPCODE *p)
   this_instr->ksmps_offset = 0;
   this_instr->ksmps_no_end = 0;
 
-  if (this_instr->ksmps == 1) {           /* special case for local kr == sr */
-    do {
-      /* copy inputs */
-      current = inm->in_arg_pool->head;
-      for (i = 0; i < inm->inchns; i++) {
-        // this hardcoded type check for non-perf time vars needs to change
-        //to use generic code...
-        // skip a-vars for now, handle uniquely within performance loop
-        if (current->varType != &CS_VAR_TYPE_I &&
-            current->varType != &CS_VAR_TYPE_b &&
-            current->varType != &CS_VAR_TYPE_A &&
-            current->subType != &CS_VAR_TYPE_I &&
-            current->subType != &CS_VAR_TYPE_A) {
-          // This one checks if an array has a subtype of 'i'
-          void* in = (void*)external_ptrs[i + inm->outchns];
-          void* out = (void*)internal_ptrs[i + inm->outchns];
-          current->varType->copyValue(csound, out, in);
-        } else if (current->varType == &CS_VAR_TYPE_A) {
-          MYFLT* in = (void*)external_ptrs[i + inm->outchns];
-          MYFLT* out = (void*)internal_ptrs[i + inm->outchns];
-          *out = *(in + ofs);
-        } else if (current->varType == &CS_VAR_TYPE_ARRAY &&
-                   current->subType == &CS_VAR_TYPE_A) {
-          ARRAYDAT* src = (ARRAYDAT*)external_ptrs[i + inm->outchns];
-          ARRAYDAT* target = (ARRAYDAT*)internal_ptrs[i + inm->outchns];
-          int count = src->sizes[0];
-          int j;
-          if (src->dimensions > 1) {
-            for (j = 0; j < src->dimensions; j++) {
-              count *= src->sizes[j];
-            }
-          }
-
-          for (j = 0; j < count; j++) {
-            int memberOffset = j * (src->arrayMemberSize / sizeof(MYFLT));
-            MYFLT* in = src->data + memberOffset;
-            MYFLT* out = target->data + memberOffset;
-            *out = *(in + ofs);
-          }
-        }
-        current = current->next;
-      }
-
-      if ((CS_PDS = (OPDS *) (this_instr->nxtp)) != NULL) {
-        int error = 0;
-        CS_PDS->insdshead->pds = NULL;
-        do {
-          if(UNLIKELY(!ATOMIC_GET8(p->ip->actflg))) goto endop;
-          error = (*CS_PDS->opadr)(csound, CS_PDS);
-          if (CS_PDS->insdshead->pds != NULL &&
-              CS_PDS->insdshead->pds->insdshead) {
-            CS_PDS = CS_PDS->insdshead->pds;
-            CS_PDS->insdshead->pds = NULL;
-          }
-        } while (error == 0 && p->ip != NULL
-                 && (CS_PDS = CS_PDS->nxtp));
-      }
-
-      /* copy a-sig outputs, accounting for offset */
-      current = inm->out_arg_pool->head;
-      for (i = 0; i < inm->outchns; i++) {
-        if (current->varType == &CS_VAR_TYPE_A) {
-          MYFLT* in = (void*)internal_ptrs[i];
-          MYFLT* out = (void*)external_ptrs[i];
-          *(out + ofs) = *in;
-        } else if (current->varType == &CS_VAR_TYPE_ARRAY &&
-                   current->subType == &CS_VAR_TYPE_A) {
-          ARRAYDAT* src = (ARRAYDAT*)internal_ptrs[i];
-          ARRAYDAT* target = (ARRAYDAT*)external_ptrs[i];
-          int count = src->sizes[0];
-          int j;
-          if (src->dimensions > 1) {
-            for (j = 0; j < src->dimensions; j++) {
-              count *= src->sizes[j];
-            }
-          }
-
-          for (j = 0; j < count; j++) {
-            int memberOffset = j * (src->arrayMemberSize / sizeof(MYFLT));
-            MYFLT* in = src->data + memberOffset;
-            MYFLT* out = target->data + memberOffset;
-            *(out + ofs) = *in;
-          }
-        }
-
-        current = current->next;
-      }
-
-
-      this_instr->kcounter++;
-      this_instr->spout += csound->nchnls;
-      this_instr->spin  += csound->nchnls;
-    } while (++ofs < g_ksmps);
-  }
-  else {
+  nsmps = this_instr->ksmps;
+  if (nsmps != 1) {
     /* generic case for local kr != sr */
     /* we have to deal with sample-accurate code
        whole CS_KSMPS blocks are offset here, the
        remainder is left to each opcode to deal with.
     */
     int start = 0;
-    int lksmps = this_instr->ksmps;
-    while (ofs >= lksmps) {
-      ofs -= lksmps;
+    while (ofs >= nsmps) {
+      ofs -= nsmps;
       start++;
     }
     this_instr->ksmps_offset = ofs;
     ofs = start;
-    if (UNLIKELY(early)) this_instr->ksmps_no_end = early % lksmps;
-
-    do {
-      /* copy a-sig inputs, accounting for offset */
-      size_t asigSize = (this_instr->ksmps * sizeof(MYFLT));
-      current = inm->in_arg_pool->head;
-      for (i = 0; i < inm->inchns; i++) {
-        // this hardcoded type check for non-perf time vars needs to change
-        // to use generic code...
-        // skip a-vars for now, handle uniquely within performance loop
-        if (current->varType != &CS_VAR_TYPE_I &&
-            current->varType != &CS_VAR_TYPE_b &&
-            current->varType != &CS_VAR_TYPE_A &&
-            current->subType != &CS_VAR_TYPE_I &&
-            current->subType != &CS_VAR_TYPE_A) {
-          // This one checks if an array has a subtype of 'i'
-          void* in = (void*)external_ptrs[i + inm->outchns];
-          void* out = (void*)internal_ptrs[i + inm->outchns];
-          current->varType->copyValue(csound, out, in);
-        } else if (current->varType == &CS_VAR_TYPE_A) {
-          MYFLT* in = (void*)external_ptrs[i + inm->outchns];
-          MYFLT* out = (void*)internal_ptrs[i + inm->outchns];
-          memcpy(out, in + ofs, asigSize);
-        } else if (current->varType == &CS_VAR_TYPE_ARRAY &&
-                   current->subType == &CS_VAR_TYPE_A) {
-          ARRAYDAT* src = (ARRAYDAT*)external_ptrs[i + inm->outchns];
-          ARRAYDAT* target = (ARRAYDAT*)internal_ptrs[i + inm->outchns];
-          int count = src->sizes[0];
-          int j;
-          if (src->dimensions > 1) {
-            for (j = 0; j < src->dimensions; j++) {
-              count *= src->sizes[j];
-            }
-          }
-
-          for (j = 0; j < count; j++) {
-            int memberOffset = j * (src->arrayMemberSize / sizeof(MYFLT));
-            MYFLT* in = src->data + memberOffset;
-            MYFLT* out = target->data + memberOffset;
-            memcpy(out, in + ofs, asigSize);
-          }
-        }
-        current = current->next;
-      }
+    if (UNLIKELY(early)) this_instr->ksmps_no_end = early % nsmps;
+  }
+  /* with local kr == sr each pass handles one sample of the caller's */
 
-      /*  run each opcode  */
-      if ((CS_PDS = (OPDS *) (this_instr->nxtp)) != NULL) {
-        int error = 0;
-        CS_PDS->insdshead->pds = NULL;
-        do {
-          if(UNLIKELY(!ATOMIC_GET8(p->ip->actflg))) goto endop;
-          error = (*CS_PDS->opadr)(csound, CS_PDS);
-          if (CS_PDS->insdshead->pds != NULL &&
-              CS_PDS->insdshead->pds->insdshead) {
-            CS_PDS = CS_PDS->insdshead->pds;
-            CS_PDS->insdshead->pds = NULL;
-          }
-        } while (error == 0 && p->ip != NULL
-                 && (CS_PDS = CS_PDS->nxtp));
+  do {
+    /* copy inputs, a-sigs accounting for offset */
+    for (i = 0, c = buf->inplan; i < buf->ninplan; i++, c++) {
+      switch (c->kind) {
+      case UDOARG_SCALAR:
+        *c->dst = *c->src;
+        break;
+      case UDOARG_ASIG:
+        memcpy(c->dst, c->src + ofs, nsmps * sizeof(MYFLT));
+        break;
+      case UDOARG_ASIG_ARRAY:
+        udo_copy_asig_array((ARRAYDAT*) c->src, (ARRAYDAT*) c->dst,
+                            ofs, 0, nsmps);
+        break;
+      default:
+        c->type->copyValue(csound, c->dst, c->src);
       }
+    }
 
-      /* copy a-sig outputs, accounting for offset */
-      current = inm->out_arg_pool->head;
-      for (i = 0; i < inm->outchns; i++) {
-        if (current->varType == &CS_VAR_TYPE_A) {
-          MYFLT* in = (void*)internal_ptrs[i];
-          MYFLT* out = (void*)external_ptrs[i];
-          memcpy(out + ofs, in, asigSize);
-        } else if (current->varType == &CS_VAR_TYPE_ARRAY &&
-                   current->subType == &CS_VAR_TYPE_A) {
-          ARRAYDAT* src = (ARRAYDAT*)internal_ptrs[i];
-          ARRAYDAT* target = (ARRAYDAT*)external_ptrs[i];
-          int count = src->sizes[0];
-          int j;
-          if (src->dimensions > 1) {
-            for (j = 0; j < src->dimensions; j++) {
-              count *= src->sizes[j];
-            }
-          }
-
-          for (j = 0; j < count; j++) {
-            int memberOffset = j * (src->arrayMemberSize / sizeof(MYFLT));
-            MYFLT* in = src->data + memberOffset;
-            MYFLT* out = target->data + memberOffset;
-            memcpy(out + ofs, in, asigSize);
-          }
-
+    /*  run each opcode  */
+    if ((CS_PDS = (OPDS *) (this_instr->nxtp)) != NULL) {
+      int error = 0;
+      CS_PDS->insdshead->pds = NULL;
+      do {
+        if(UNLIKELY(!ATOMIC_GET8(p->ip->actflg))) goto endop;
+        error = (*CS_PDS->opadr)(csound, CS_PDS);
+        if (CS_PDS->insdshead->pds != NULL &&
+            CS_PDS->insdshead->pds->insdshead) {
+          CS_PDS = CS_PDS->insdshead->pds;
+          CS_PDS->insdshead->pds = NULL;
         }
+      } while (error == 0 && p->ip != NULL
+               && (CS_PDS = CS_PDS->nxtp));
+    }
 
-        current = current->next;
-      }
+    /* copy a-sig outputs, accounting for offset */
+    for (i = 0, c = buf->outplan; i < buf->noutplan; i++, c++) {
+      if (c->kind == UDOARG_ASIG)
+        memcpy(c->dst + ofs, c->src, nsmps * sizeof(MYFLT));
+      else if (c->kind == UDOARG_ASIG_ARRAY)
+        udo_copy_asig_array((ARRAYDAT*) c->src, (ARRAYDAT*) c->dst,
+                            0, ofs, nsmps);
+    }
 
-      this_instr->spout += csound->nchnls*lksmps;
-      this_instr->spin  += csound->nchnls*lksmps;
-      this_instr->kcounter++;
-    } while ((ofs += this_instr->ksmps) < g_ksmps);
-  }
+    this_instr->spout += csound->nchnls*nsmps;
+    this_instr->spin  += csound->nchnls*nsmps;
+    this_instr->kcounter++;
+  } while ((ofs += nsmps) < g_ksmps);
 
 
   /* copy outputs */
-  current = inm->out_arg_pool->head;
-  for (i = 0; i < inm->outchns; i++) {
-    // this hardcoded type check for non-perf time vars needs to change
-    // to use generic code...
-    if (current->varType != &CS_VAR_TYPE_I &&
-        current->varType != &CS_VAR_TYPE_b &&
-        current->subType != &CS_VAR_TYPE_I) {
-      void* in = (void*)internal_ptrs[i];
-      void* out = (void*)external_ptrs[i];
-
-      if (current->varType == &CS_VAR_TYPE_A) {
-        /* clear the beginning portion of outputs for sample accurate end */
-        if (offset) {
-          memset(out, '\0', sizeof(MYFLT) * offset);
-        }
-
-        /* clear the end portion of outputs for sample accurate end */
-        if (early) {
-          memset((char*)out + g_ksmps, '\0', sizeof(MYFLT) * early);
-        }
-      } else if (current->varType == &CS_VAR_TYPE_ARRAY &&
-                 current->subType == &CS_VAR_TYPE_A) {
-        if (offset || early) {
-          ARRAYDAT* outDat = (ARRAYDAT*)out;
-          int count = outDat->sizes[0];
-          int j;
-          if (outDat->dimensions > 1) {
-            for (j = 0; j < outDat->dimensions; j++) {
-              count *= outDat->sizes[j];
-            }
-          }
-
-          if (offset) {
-            for (j = 0; j < count; j++) {
-              int memberOffset = j * (outDat->arrayMemberSize / sizeof(MYFLT));
-              MYFLT* outMem = outDat->data + memberOffset;
-              memset(outMem, '\0', sizeof(MYFLT) * offset);
-            }
-          }
-
-          if (early) {
-            for (j = 0; j < count; j++) {
-              int memberOffset = j * (outDat->arrayMemberSize / sizeof(MYFLT));
-              MYFLT* outMem = outDat->data + memberOffset;
-              memset(outMem + g_ksmps, '\0', sizeof(MYFLT) * early);
-            }
-          }
+  for (i = 0, c = buf->outplan; i < buf->noutplan; i++, c++) {
+    switch (c->kind) {
+    case UDOARG_SCALAR:
+      *c->dst = *c->src;
+      break;
+    case UDOARG_ASIG:
+      /* clear the beginning portion of outputs for sample accurate end */
+      if (offset)
+        memset(c->dst, '\0', sizeof(MYFLT) * offset);
+      /* clear the end portion of outputs for sample accurate end */
+      if (early)
+        memset(c->dst + g_ksmps, '\0', sizeof(MYFLT) * early);
+      break;
+    case UDOARG_ASIG_ARRAY:
+      if (offset || early) {
+        ARRAYDAT* outDat = (ARRAYDAT*) c->dst;
+        int j, count = udo_array_members(outDat);
+        int stride = outDat->arrayMemberSize / sizeof(MYFLT);
+        for (j = 0; j < count; j++) {
+          MYFLT* outMem = outDat->data + j * stride;
+          if (offset)
+            memset(outMem, '\0', sizeof(MYFLT) * offset);
+          if (early)
+            memset(outMem + g_ksmps, '\0', sizeof(MYFLT) * early);
         }
-
-      } else {
-        current->varType->copyValue(csound, out, in);
       }
+      break;
+    default:
+      c->type->copyValue(csound, c->dst, c->src);
     }
-    current = current->next;
   }
  endop:
   CS_PDS = saved_pds;
@@ -2196,13 +2238,11 @@ int useropcd1(CSOUND *csound, UOPCODE *p)
 int useropcd2(CSOUND *csound, UOPCODE *p)
 {
   OPDS    *saved_pds = CS_PDS;
-  MYFLT   **tmp;
+  OPCOD_IOBUFS *buf = p->buf;
   INSDS    *this_instr = p->ip;
-  OPCODINFO   *inm;
-  CS_VARIABLE* current;
+  UDO_ARGCOPY *c;
   int i, done;
 
-  inm = (OPCODINFO*) p->h.optext->t.oentry->useropinfo;
   done = ATOMIC_GET(p->ip->init_done);
 
   if (UNLIKELY(!done)) /* init not done, exit */
@@ -2217,30 +2257,13 @@ int useropcd2(CSOUND *csound, UOPCODE *p)
 
   /* IV - Nov 16 2002: update release flag */
   p->ip->relesing = p->parent_ip->relesing;
-  tmp = p->buf->iobufp_ptrs;
-  inm = p->buf->opcode_info;
-
-  MYFLT** internal_ptrs = tmp;
-  MYFLT** external_ptrs = p->ar;
 
   /* copy inputs */
-  current = inm->in_arg_pool->head;
-  for (i = 0; i < inm->inchns; i++) {
-    // this hardcoded type check for non-perf time vars needs to
-    //change to use generic code...
-    if (current->varType != &CS_VAR_TYPE_I &&
-        current->varType != &CS_VAR_TYPE_b &&
-        current->subType != &CS_VAR_TYPE_I) {
-      if (current->varType == &CS_VAR_TYPE_A && CS_KSMPS == 1) {
-        *internal_ptrs[i + inm->outchns] = *external_ptrs[i + inm->outchns];
-      } else {
-        void* in = (void*)external_ptrs[i + inm->outchns];
-        void* out = (void*)internal_ptrs[i + inm->outchns];
-        current->varType->copyValue(csound, out, in);
-        //                memcpy(out, in, p->buf->in_arg_sizes[i]);
-      }
-    }
-    current = current->next;
+  for (i = 0, c = buf->inplan; i < buf->ninplan; i++, c++) {
+    if (c->kind == UDOARG_SCALAR) *c->dst = *c->src;
+    else if (c->kind == UDOARG_ASIG)
+      memcpy(c->dst, c->src, c->size * sizeof(MYFLT));
+    else c->type->copyValue(csound, c->dst, c->src);
   }
 
   /*  run each opcode  */
@@ -2261,23 +2284,11 @@ int useropcd2(CSOUND *csound, UOPCODE *p)
   this_instr->kcounter++;
 
   /* copy outputs */
-  current = inm->out_arg_pool->head;
-  for (i = 0; i < inm->outchns; i++) {
-    // this hardcoded type check for non-perf time vars needs to change to
-    // use generic code...
-    if (current->varType != &CS_VAR_TYPE_I &&
-        current->varType != &CS_VAR_TYPE_b &&
-        current->subType != &CS_VAR_TYPE_I) {
-      if (current->varType == &CS_VAR_TYPE_A && CS_KSMPS == 1) {
-        *external_ptrs[i] = *internal_ptrs[i];
-      } else {
-        void* in = (void*)internal_ptrs[i];
-        void* out = (void*)external_ptrs[i];
-        //            memcpy(out, in, p->buf->out_arg_sizes[i]);
-        current->varType->copyValue(csound, out, in);
-      }
-    }
-    current = current->next;
+  for (i = 0, c = buf->outplan; i < buf->noutplan; i++, c++) {
+    if (c->kind == UDOARG_SCALAR) *c->dst = *c->src;
+    else if (c->kind == UDOARG_ASIG)
+      memcpy(c->dst, c->src, c->size * sizeof(MYFLT));
+    else c->type->copyValue(csound, c->dst, c->src);
   }
 
  endop:
@@ -2377,9 +2388,16 @@ static void instance(CSOUND *csound, int insno)
     //      size_t pcnt = (size_t) tp->opcode_info->perf_incnt;
     //      pcnt += (size_t) tp->opcode_info->perf_outcnt;
     OPCODINFO* info = tp->opcode_info;
+    OPCOD_IOBUFS *buf;
     size_t pcnt = sizeof(OPCOD_IOBUFS) +
-      sizeof(MYFLT*) * (info->inchns + info->outchns);
+      sizeof(MYFLT*) * (info->inchns + info->outchns) +
+      sizeof(UDO_ARGCOPY) * (info->inchns + info->outchns);
     ip->opcod_iobufs = (void*) csound->Malloc(csound, pcnt);
+    buf = (OPCOD_IOBUFS*) ip->opcod_iobufs;
+    buf->inplan =
+      (UDO_ARGCOPY*) (buf->iobufp_ptrs + 12 + info->inchns + info->outchns);
+    buf->outplan = buf->inplan + info->inchns;
+    buf->ninplan = buf->noutplan = 0;
   }
 
   /* gbloffbas = csound->globalVarPool; */
@@ -2620,6 +2638,11 @@ int delete_instr(CSOUND *csound, DELETEIN *p)
     csound->Free(csound, active);
     active = nxt;
   }
+  auxcachefree(csound, ip);
+  if (ip->vwatch != NULL) {
+    csound->Free(csound, ip->vwatch);
+    ip->vwatch = NULL;
+  }
   csound->engineState.instrtxtp[n] = NULL;
   /* Now patch it out */
   for (txtp = &(csound->engineState.instxtanchor);
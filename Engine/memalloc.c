@@ -60,6 +60,348 @@ static void memdie(CSOUND *csound, size_t nbytes)
     csound->LongJmp(csound, CSOUND_MEMORY);
 }
 
+#if defined(MEMALLOC_REGIONS) && defined(MEMDEBUG)
+#undef MEMALLOC_REGIONS
+#endif
+
+#ifdef MEMALLOC_REGIONS
+
+/* Region mode (cmake -DUSE_MEMALLOC_REGIONS=ON).  Blocks of up to 4k are
+   carved from large chunks and recycled through free lists kept per
+   thread, bucketed by size class, so that allocating and freeing them
+   takes no lock.  A thread whose free list for a class grows too long
+   hands it to a shared depot, where other threads pick it up.  Larger
+   blocks are linked into a chain as before.  memRESET frees the chunks
+   and the chain, which releases everything in one sweep.  The region is
+   reached through csound->memalloc_db.
+*/
+
+#if defined(_MSC_VER)
+#define MEM_TLS __declspec(thread)
+#else
+#define MEM_TLS __thread
+#endif
+
+#define MEM_CLASSES     32
+#define MEM_SMALL_MAX   4096
+#define MEM_CHUNK_SIZE  ((size_t) 256 * 1024)
+#define MEM_CACHE_MAX   256
+#define MEM_LARGE       ((size_t) -1)
+
+/* the word just before the data holds the size class, or MEM_LARGE */
+typedef struct memSmall_s {
+    struct memSmall_s       *nxt;       /* next free block in list      */
+    size_t                  cls;
+} memSmall_t;
+
+typedef struct memLarge_s {
+    struct memLarge_s       *prv;       /* previous large block         */
+    struct memLarge_s       *nxt;       /* next large block             */
+    size_t                  pad;
+    size_t                  cls;        /* MEM_LARGE                    */
+} memLarge_t;
+
+typedef struct memList_s {
+    memSmall_t              *head, *tail;
+    size_t                  count;
+} memList_t;
+
+typedef struct memCache_s {
+    struct memCache_s       *nxt;
+    void                    *owner;     /* identifies the thread        */
+    memList_t               free[MEM_CLASSES];
+    char                    *bump, *bumpend;
+} memCache_t;
+
+typedef struct memRegion_s {
+    uint64_t                id;
+    void                    *chunks;    /* chain through first word     */
+    memLarge_t              *large;
+    memCache_t              *caches;
+    memList_t               depot[MEM_CLASSES];
+} memRegion_t;
+
+#define SMALL_HDR   ((int) sizeof(memSmall_t))
+#define LARGE_HDR   ((int) sizeof(memLarge_t))
+#define BLOCK_CLS(p) (((size_t*) (p))[-1])
+#define SMALL_PTR(p) ((memSmall_t*) ((unsigned char*) (p) - SMALL_HDR))
+#define LARGE_PTR(p) ((memLarge_t*) ((unsigned char*) (p) - LARGE_HDR))
+#define DATA_PTR_SMALL(p) ((void*) ((unsigned char*) (p) + SMALL_HDR))
+#define DATA_PTR_LARGE(p) ((void*) ((unsigned char*) (p) + LARGE_HDR))
+
+static uint64_t mem_region_count = 0;
+static MEM_TLS memCache_t   *mem_tls_cache = NULL;
+static MEM_TLS memRegion_t  *mem_tls_region = NULL;
+static MEM_TLS uint64_t     mem_tls_id = 0;
+
+/* 16 to 256 in steps of 16, then four classes per octave up to 4096 */
+static inline size_t mem_class_size(size_t cls)
+{
+    if (cls < 16)
+      return (cls + 1) << 4;
+    return (size_t) (4 + ((cls - 16) & 3) + 1) << (((cls - 16) >> 2) + 6);
+}
+
+static inline size_t mem_class(size_t size)
+{
+    size_t cls;
+    if (size <= 256)
+      return size == 0 ? 0 : (size - 1) >> 4;
+    for (cls = 16; mem_class_size(cls) < size; cls++)
+      ;
+    return cls;
+}
+
+static memRegion_t *mem_region(CSOUND *csound)
+{
+    memRegion_t *r = (memRegion_t*) MEMALLOC_DB;
+    if (LIKELY(r != NULL))
+      return r;
+    CSOUND_MEM_SPINLOCK
+    if ((r = (memRegion_t*) MEMALLOC_DB) == NULL) {
+      if (UNLIKELY((r = (memRegion_t*) calloc(1, sizeof(memRegion_t))) == NULL)) {
+        CSOUND_MEM_SPINUNLOCK
+        memdie(csound, sizeof(memRegion_t));
+      }
+#if defined(HAVE_ATOMIC_BUILTIN)
+      r->id = __atomic_add_fetch(&mem_region_count, 1, __ATOMIC_SEQ_CST);
+#else
+      r->id = ++mem_region_count;
+#endif
+      MEMALLOC_DB = (void*) r;
+    }
+    CSOUND_MEM_SPINUNLOCK
+    return r;
+}
+
+/* this thread's cache in the region of csound */
+static memCache_t *mem_cache(CSOUND *csound)
+{
+    memRegion_t *r = mem_region(csound);
+    memCache_t  *c;
+
+    if (LIKELY(mem_tls_region == r && mem_tls_id == r->id))
+      return mem_tls_cache;
+    CSOUND_MEM_SPINLOCK
+    for (c = r->caches; c != NULL; c = c->nxt)
+      if (c->owner == (void*) &mem_tls_cache)
+        break;
+    if (c == NULL) {
+      if (UNLIKELY((c = (memCache_t*) calloc(1, sizeof(memCache_t))) == NULL)) {
+        CSOUND_MEM_SPINUNLOCK
+        memdie(csound, sizeof(memCache_t));
+      }
+      c->owner = (void*) &mem_tls_cache;
+      c->nxt = r->caches;
+      r->caches = c;
+    }
+    CSOUND_MEM_SPINUNLOCK
+    mem_tls_cache = c;
+    mem_tls_region = r;
+    mem_tls_id = r->id;
+    return c;
+}
+
+static void *mem_small_alloc(CSOUND *csound, size_t size)
+{
+    memCache_t  *c = mem_cache(csound);
+    size_t      cls = mem_class(size);
+    memList_t   *l = &c->free[cls];
+    memSmall_t  *p;
+
+    if (UNLIKELY(l->head == NULL)) {
+      memRegion_t *r = (memRegion_t*) MEMALLOC_DB;
+      if (r->depot[cls].head != NULL) {       /* take the shared list */
+        CSOUND_MEM_SPINLOCK
+        *l = r->depot[cls];
+        memset(&r->depot[cls], 0, sizeof(memList_t));
+        CSOUND_MEM_SPINUNLOCK
+      }
+      if (l->head == NULL) {                  /* carve a new block */
+        size_t n = SMALL_HDR + mem_class_size(cls);
+        if (UNLIKELY(c->bump + n > c->bumpend)) {
+          void **chunk = (void**) malloc(MEM_CHUNK_SIZE);
+          if (UNLIKELY(chunk == NULL))
+            memdie(csound, size);
+          CSOUND_MEM_SPINLOCK
+          chunk[0] = r->chunks;
+          r->chunks = (void*) chunk;
+          CSOUND_MEM_SPINUNLOCK
+          c->bump = (char*) chunk + 2 * sizeof(void*);
+          c->bumpend = (char*) chunk + MEM_CHUNK_SIZE;
+        }
+        p = (memSmall_t*) c->bump;
+        c->bump += n;
+        p->cls = cls;
+        return DATA_PTR_SMALL(p);
+      }
+    }
+    p = l->head;
+    if ((l->head = p->nxt) == NULL)
+      l->tail = NULL;
+    l->count--;
+    return DATA_PTR_SMALL(p);
+}
+
+static void mem_small_free(CSOUND *csound, void *ptr)
+{
+    memCache_t  *c = mem_cache(csound);
+    memSmall_t  *p = SMALL_PTR(ptr);
+    memList_t   *l = &c->free[p->cls];
+
+    p->nxt = l->head;
+    if (l->head == NULL)
+      l->tail = p;
+    l->head = p;
+    if (UNLIKELY(++l->count > MEM_CACHE_MAX)) {   /* hand to the depot */
+      memRegion_t *r = (memRegion_t*) MEMALLOC_DB;
+      memList_t   *d = &r->depot[p->cls];
+      CSOUND_MEM_SPINLOCK
+      l->tail->nxt = d->head;
+      if (d->head == NULL)
+        d->tail = l->tail;
+      d->head = l->head;
+      d->count += l->count;
+      CSOUND_MEM_SPINUNLOCK
+      memset(l, 0, sizeof(memList_t));
+    }
+}
+
+static void *mem_large_alloc(CSOUND *csound, size_t size, int clear)
+{
+    memRegion_t *r = mem_region(csound);
+    memLarge_t  *p;
+
+    p = (memLarge_t*) (clear ? calloc(LARGE_HDR + size, (size_t) 1)
+                             : malloc(LARGE_HDR + size));
+    if (UNLIKELY(p == NULL))
+      memdie(csound, size);     /* does a long jump */
+    p->cls = MEM_LARGE;
+    CSOUND_MEM_SPINLOCK
+    p->prv = NULL;
+    p->nxt = r->large;
+    if (r->large != NULL)
+      r->large->prv = p;
+    r->large = p;
+    CSOUND_MEM_SPINUNLOCK
+    return DATA_PTR_LARGE(p);
+}
+
+static void mem_large_unlink(memRegion_t *r, memLarge_t *p)
+{
+    if (p->nxt != NULL)
+      p->nxt->prv = p->prv;
+    if (p->prv != NULL)
+      p->prv->nxt = p->nxt;
+    else
+      r->large = p->nxt;
+}
+
+void *mmalloc(CSOUND *csound, size_t size)
+{
+    if (size <= MEM_SMALL_MAX)
+      return mem_small_alloc(csound, size);
+    return mem_large_alloc(csound, size, 0);
+}
+
+void *mcalloc(CSOUND *csound, size_t size)
+{
+    if (size <= MEM_SMALL_MAX) {
+      void *p = mem_small_alloc(csound, size);
+      memset(p, 0, size);
+      return p;
+    }
+    return mem_large_alloc(csound, size, 1);
+}
+
+void mfree(CSOUND *csound, void *p)
+{
+    memRegion_t *r;
+
+    if (UNLIKELY(p == NULL))
+      return;
+    if (BLOCK_CLS(p) != MEM_LARGE) {
+      mem_small_free(csound, p);
+      return;
+    }
+    r = (memRegion_t*) MEMALLOC_DB;
+    CSOUND_MEM_SPINLOCK
+    mem_large_unlink(r, LARGE_PTR(p));
+    CSOUND_MEM_SPINUNLOCK
+    free((void*) LARGE_PTR(p));
+}
+
+void *mrealloc(CSOUND *csound, void *oldp, size_t size)
+{
+    memRegion_t *r;
+    memLarge_t  *pp, *p;
+    size_t      cls;
+    int         failed;
+
+    if (UNLIKELY(oldp == NULL))
+      return mmalloc(csound, size);
+    if (UNLIKELY(size == (size_t) 0)) {
+      mfree(csound, oldp);
+      return NULL;
+    }
+    if ((cls = BLOCK_CLS(oldp)) != MEM_LARGE) {
+      size_t  oldsize = mem_class_size(cls);
+      void    *newp;
+      if (size <= oldsize && mem_class(size) == cls)
+        return oldp;
+      newp = mmalloc(csound, size);
+      memcpy(newp, oldp, size < oldsize ? size : oldsize);
+      mem_small_free(csound, oldp);
+      return newp;
+    }
+    /* large blocks stay large; unlink while moving */
+    r = (memRegion_t*) MEMALLOC_DB;
+    pp = LARGE_PTR(oldp);
+    CSOUND_MEM_SPINLOCK
+    mem_large_unlink(r, pp);
+    CSOUND_MEM_SPINUNLOCK
+    p = (memLarge_t*) realloc((void*) pp, LARGE_HDR + size);
+    if ((failed = (p == NULL)))
+      p = pp;                   /* relink the old block, then die */
+    CSOUND_MEM_SPINLOCK
+    p->prv = NULL;
+    p->nxt = r->large;
+    if (r->large != NULL)
+      r->large->prv = p;
+    r->large = p;
+    CSOUND_MEM_SPINUNLOCK
+    if (UNLIKELY(failed))
+      memdie(csound, size);     /* does a long jump */
+    return DATA_PTR_LARGE(p);
+}
+
+void memRESET(CSOUND *csound)
+{
+    memRegion_t *r = (memRegion_t*) MEMALLOC_DB;
+
+    if (r == NULL)
+      return;
+    MEMALLOC_DB = NULL;
+    while (r->chunks != NULL) {
+      void **chunk = (void**) r->chunks;
+      r->chunks = chunk[0];
+      free((void*) chunk);
+    }
+    while (r->large != NULL) {
+      memLarge_t *nxt = r->large->nxt;
+      free((void*) r->large);
+      r->large = nxt;
+    }
+    while (r->caches != NULL) {
+      memCache_t *nxt = r->caches->nxt;
+      free((void*) r->caches);
+      r->caches = nxt;
+    }
+    free((void*) r);
+}
+
+#else   /* MEMALLOC_REGIONS */
+
 void *mmalloc(CSOUND *csound, size_t size)
 {
     void  *p;
@@ -91,6 +433,8 @@ void *mmalloc(CSOUND *csound, size_t size)
     return DATA_PTR(p);
 }
 
+#endif  /* MEMALLOC_REGIONS */
+
 void *mmallocDebug(CSOUND *csound, size_t size, char *file, int line)
 {
     void *ans = mmalloc(csound,size);
@@ -98,6 +442,7 @@ void *mmallocDebug(CSOUND *csound, size_t size, char *file, int line)
     return ans;
 }
 
+#ifndef MEMALLOC_REGIONS
 void *mcalloc(CSOUND *csound, size_t size)
 {
     void  *p;
@@ -129,6 +474,8 @@ void *mcalloc(CSOUND *csound, size_t size)
     return DATA_PTR(p);
 }
 
+#endif  /* MEMALLOC_REGIONS */
+
 void *mcallocDebug(CSOUND *csound, size_t size, char *file, int line)
 {
     void *ans = mcalloc(csound,size);
@@ -137,6 +484,7 @@ void *mcallocDebug(CSOUND *csound, size_t size, char *file, int line)
 }
 
 
+#ifndef MEMALLOC_REGIONS
 void mfree(CSOUND *csound, void *p)
 {
     memAllocBlock_t *pp;
@@ -174,12 +522,15 @@ void mfree(CSOUND *csound, void *p)
     CSOUND_MEM_SPINUNLOCK
 }
 
+#endif  /* MEMALLOC_REGIONS */
+
 void mfreeDebug(CSOUND *csound, void *ans, char *file, int line)
 {
     printf("Free %p %s:%d\n", ans, file, line);
     mfree(csound,ans);
 }
 
+#ifndef MEMALLOC_REGIONS
 void *mrealloc(CSOUND *csound, void *oldp, size_t size)
 {
     memAllocBlock_t *pp;
@@ -238,6 +589,8 @@ void *mrealloc(CSOUND *csound, void *oldp, size_t size)
     return DATA_PTR(pp);
 }
 
+#endif  /* MEMALLOC_REGIONS */
+
 void *mreallocDebug(CSOUND *csound, void *oldp, size_t size, char *file, int line)
 {
     void *p = mrealloc(csound, oldp, size);
@@ -245,6 +598,7 @@ void *mreallocDebug(CSOUND *csound, void *oldp, size_t size, char *file, int lin
     return p;
 }
 
+#ifndef MEMALLOC_REGIONS
 void memRESET(CSOUND *csound)
 {
     memAllocBlock_t *pp, *nxtp;
@@ -260,3 +614,4 @@ void memRESET(CSOUND *csound)
       pp = nxtp;
     }
 }
+#endif  /* MEMALLOC_REGIONS */
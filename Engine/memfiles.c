@@ -432,6 +432,145 @@ int delete_memfile(CSOUND *csound, const char *filnam)
 
 /* RWD NB PVOCEX format always 32bit, so no MYFLTs here! */
 
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_UNISTD_H) && !defined(WIN32)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define PVX_MMAP 1
+
+#if (defined(linux) || defined(__HAIKU__) || defined(__EMSCRIPTEN__) || \
+     defined(__CYGWIN__)) && !defined(PTHREAD_SPINLOCK_INITIALIZER)
+#define PTHREAD_SPINLOCK_INITIALIZER 0
+#endif
+
+/* Files mapped read-only with csoundMapFile() are shared by every Csound
+   instance in the process that maps the same file (matched on device,
+   inode, size and modification time), and pages are only read in when
+   they are touched.  Native-endian PVOC-EX data that needs no rescaling
+   is used straight from such a mapping, as are SoundFont banks. */
+
+typedef struct mapped_file_ {
+    struct mapped_file_ *nxt;
+    dev_t       dev;
+    ino_t       ino;
+    off_t       size;
+    time_t      mtime;
+    void        *base;
+    size_t      len;
+    int         refcnt;
+} MAPPED_FILE;
+
+static MAPPED_FILE  *mapped_files = NULL;
+static spin_lock_t  mapped_lock = SPINLOCK_INIT;
+
+static inline int pvx_big_endian(void)
+{
+    const int32_t one = 1;
+    return (!*((char*) &one));
+}
+
+void *csoundMapFile(const char *path, size_t *len)
+{
+    MAPPED_FILE *m;
+    struct stat st;
+    void        *base;
+    int         fd;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+      return NULL;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+      close(fd);
+      return NULL;
+    }
+    csoundSpinLock(&mapped_lock);
+    for (m = mapped_files; m != NULL; m = m->nxt) {
+      if (m->dev == st.st_dev && m->ino == st.st_ino &&
+          m->size == st.st_size && m->mtime == st.st_mtime)
+        break;
+    }
+    if (m == NULL) {
+      base = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+      if (base == MAP_FAILED ||
+          (m = (MAPPED_FILE*) calloc(1, sizeof(MAPPED_FILE))) == NULL) {
+        if (base != MAP_FAILED)
+          munmap(base, (size_t) st.st_size);
+        csoundSpinUnLock(&mapped_lock);
+        close(fd);
+        return NULL;
+      }
+      m->dev = st.st_dev;
+      m->ino = st.st_ino;
+      m->size = st.st_size;
+      m->mtime = st.st_mtime;
+      m->base = base;
+      m->len = (size_t) st.st_size;
+      m->nxt = mapped_files;
+      mapped_files = m;
+    }
+    m->refcnt++;
+    csoundSpinUnLock(&mapped_lock);
+    close(fd);                  /* the mapping stays valid */
+    *len = m->len;
+    return m->base;
+}
+
+void csoundUnmapFile(const void *addr)
+{
+    MAPPED_FILE *m, *prv = NULL;
+
+    csoundSpinLock(&mapped_lock);
+    for (m = mapped_files; m != NULL; prv = m, m = m->nxt) {
+      if ((const char*) addr >= (const char*) m->base &&
+          (const char*) addr < (const char*) m->base + m->len)
+        break;
+    }
+    if (m != NULL && --m->refcnt <= 0) {
+      if (prv == NULL)
+        mapped_files = m->nxt;
+      else
+        prv->nxt = m->nxt;
+      munmap(m->base, m->len);
+      free(m);
+    }
+    csoundSpinUnLock(&mapped_lock);
+}
+
+static float *pvx_map_data(const char *path, int32 offset, size_t nbytes)
+{
+    char        *base;
+    size_t      len;
+
+    if (offset < 0 || (offset & (int32) (sizeof(float) - 1)) != 0)
+      return NULL;              /* frames must be float-aligned in the file */
+    base = (char*) csoundMapFile(path, &len);
+    if (base == NULL)
+      return NULL;
+    if (len < (size_t) offset + nbytes) {
+      csoundUnmapFile(base);
+      return NULL;
+    }
+    return (float*) (base + offset);
+}
+
+static void pvx_unmap_data(const float *data)
+{
+    csoundUnmapFile(data);
+}
+#else
+void *csoundMapFile(const char *path, size_t *len)
+{
+    (void) path; (void) len;
+    return NULL;
+}
+
+void csoundUnmapFile(const void *addr)
+{
+    (void) addr;
+}
+#endif  /* HAVE_SYS_MMAN_H */
+
 static int pvx_err_msg(CSOUND *csound, const char *fmt, ...)
 {
     va_list args;
@@ -449,7 +588,7 @@ int PVOCEX_LoadFile(CSOUND *csound, const char *fname, PVOCEX_MEMFILE *p)
     int           i, j, rc = 0, pvx_id, hdr_size, name_size;
     int32          mem_wanted;
     int32          totalframes, framelen;
-    float         *pFrame;
+    float         *pFrame, *mapped = NULL;
 
     if (UNLIKELY(fname == NULL || fname[0] == '\0')) {
       memset(p, 0, sizeof(PVOCEX_MEMFILE));
@@ -492,9 +631,19 @@ int PVOCEX_LoadFile(CSOUND *csound, const char *fname, PVOCEX_MEMFILE *p)
       return pvx_err_msg(csound, Str("pvoc-ex file %s is empty!"), fname);
     }
     mem_wanted = totalframes * 2 * pvdata.nAnalysisBins * sizeof(float);
+#ifdef PVX_MMAP
+    /* amplitudes are scaled in place below, so the file data can only be
+       used directly if it is already in Csound's range */
+    if (!pvx_big_endian() && csound->e0dbfs == FL(1.0)) {
+      const char  *path = NULL;
+      int32       offset = pvoc_datachunk(csound, pvx_id, &path);
+      if (offset >= 0 && path != NULL)
+        mapped = pvx_map_data(path, offset, (size_t) mem_wanted);
+    }
+#endif
     /* try for the big block first! */
     pp = (PVOCEX_MEMFILE*) csound->Malloc(csound, (size_t) (hdr_size + name_size)
-                                           + (size_t) mem_wanted);
+                                   + (mapped != NULL ? 0 : (size_t) mem_wanted));
     memset((void*) pp, 0, (size_t) (hdr_size + name_size));
     pp->filename = (char*) ((uintptr_t) pp + (uintptr_t) hdr_size);
     pp->nxt = csound->pvx_memfiles;
@@ -506,15 +655,21 @@ int PVOCEX_LoadFile(CSOUND *csound, const char *fname, PVOCEX_MEMFILE *p)
        It seems preferable to do this here, rather than force the user
        to do so. Csound might change one day...
      */
-    for (pFrame = pp->data, i = 0; i < totalframes; i++) {
-      rc = csound->PVOC_GetFrames(csound, pvx_id, pFrame, 1);
-      if (UNLIKELY(rc != 1))
-        break;          /* read error, but may still have something to use */
-      /* scale amps to Csound range, to fit fsig */
-      for (j = 0; j < framelen; j += 2) {
-        pFrame[j] *= (float) csound->e0dbfs;
+    if (mapped != NULL) {
+      pp->data = mapped;
+      i = totalframes;
+    }
+    else {
+      for (pFrame = pp->data, i = 0; i < totalframes; i++) {
+        rc = csound->PVOC_GetFrames(csound, pvx_id, pFrame, 1);
+        if (UNLIKELY(rc != 1))
+          break;        /* read error, but may still have something to use */
+        /* scale amps to Csound range, to fit fsig */
+        for (j = 0; j < framelen; j += 2) {
+          pFrame[j] *= (float) csound->e0dbfs;
+        }
+        pFrame += framelen;
       }
-      pFrame += framelen;
     }
     csound->PVOC_CloseFile(csound, pvx_id);
     if (UNLIKELY(rc < 0)) {
@@ -555,13 +710,34 @@ int PVOCEX_LoadFile(CSOUND *csound, const char *fname, PVOCEX_MEMFILE *p)
 
     /* link into PVOC-EX memfile chain */
     csound->pvx_memfiles = pp;
-    csound->Message(csound, Str("file %s (%"PRIi32" bytes) loaded into memory\n"),
-                            fname, mem_wanted);
+    if (mapped != NULL)
+      csound->Message(csound, Str("file %s (%"PRIi32" bytes) mapped into memory\n"),
+                              fname, mem_wanted);
+    else
+      csound->Message(csound, Str("file %s (%"PRIi32" bytes) loaded into memory\n"),
+                              fname, mem_wanted);
 
     memcpy(p, pp, sizeof(PVOCEX_MEMFILE));
     return 0;
 }
 
+/* release the PVOC-EX memfile chain, dropping any shared file mappings */
+
+void rlspvxmemfiles(CSOUND *csound)
+{
+    PVOCEX_MEMFILE  *pp = csound->pvx_memfiles, *nxt;
+
+    while (pp != NULL) {
+      nxt = pp->nxt;
+#ifdef PVX_MMAP
+      pvx_unmap_data(pp->data);
+#endif
+      csound->Free(csound, pp);
+      pp = nxt;
+    }
+    csound->pvx_memfiles = NULL;
+}
+
  /* ------------------------------------------------------------------------ */
 
 /**
@@ -386,11 +386,15 @@ int musmon(CSOUND *csound)
     if (csound->oparms->realtime && csound->event_insert_loop == 0){
       extern void *event_insert_thread(void *);
       csound->init_pass_threadlock = csoundCreateMutex(0);
+      csound->alloc_queue_mutex = csoundCreateMutex(0);
+      csound->alloc_queue_cond = csoundCreateCondVar();
       csound->Message(csound, "Initialising spinlock...\n");
       csoundSpinLockInit(&csound->alloc_spinlock);
       csound->event_insert_loop = 1;
       csound->alloc_queue = (ALLOC_DATA *)
         csound->Calloc(csound, sizeof(ALLOC_DATA)*MAX_ALLOC_QUEUE);
+      csound->alloc_queue_wp = 0;
+      csound->alloc_queue_items = 0;
       csound->event_insert_thread =
         csound->CreateThread((uintptr_t (*)(void*)) event_insert_thread,
                              (void*)csound);
@@ -475,9 +479,13 @@ PUBLIC int csoundCleanup(CSOUND *csound)
 
 #ifndef __EMSCRIPTEN__
     if (csound->event_insert_loop == 1) {
-      csound->event_insert_loop = 0;
+      ATOMIC_SET(csound->event_insert_loop, 0);
+      event_insert_wake(csound);
       csound->JoinThread(csound->event_insert_thread);
       csoundDestroyMutex(csound->init_pass_threadlock);
+      csoundDestroyMutex(csound->alloc_queue_mutex);
+      csoundDestroyCondVar(csound->alloc_queue_cond);
+      csound->alloc_queue_mutex = csound->alloc_queue_cond = NULL;
       csound->event_insert_thread = 0;
     }
 #endif
@@ -514,6 +522,11 @@ PUBLIC int csoundCleanup(CSOUND *csound)
       csound->Message(csound, Str("\n%d errors in performance\n"),
                       csound->perferrcnt);
       print_benchmark_info(csound, Str("end of performance"));
+      if (csound->profiler != NULL) {
+        csoundWriteProfile(csound, NULL);
+        if (csound->profile_json != NULL)
+          csoundWriteProfile(csound, csound->profile_json);
+      }
     }
     /* close line input (-L) */
     RTclose(csound);
@@ -713,7 +726,9 @@ static int process_score_event(CSOUND *csound, EVTBLK *evt, int rtEvt)
   csound->currevent = evt;
   switch (evt->opcod) {                       /* scorevt or Linevt:     */
   case 'e':           /* quit realtime */
-    csound->event_insert_loop = 0;
+    ATOMIC_SET(csound->event_insert_loop, 0);
+    if (csound->alloc_queue_mutex != NULL)
+      event_insert_wake(csound);
     /* fall through */
   case 'l':
   case 's':
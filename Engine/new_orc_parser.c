@@ -65,6 +65,7 @@ extern void print_tree(CSOUND *, char *, TREE *);
 extern TREE* verify_tree(CSOUND *, TREE *, TYPE_TABLE*);
 extern TREE *csound_orc_expand_expressions(CSOUND *, TREE *);
 extern TREE* csound_orc_optimize(CSOUND *, TREE *);
+extern TREE* csound_orc_inline_udos(CSOUND *, TREE *, TYPE_TABLE *);
 //extern void csp_orc_analyze_tree(CSOUND* csound, TREE* root);
 extern void csp_orc_sa_print_list(CSOUND*);
 
@@ -314,6 +315,8 @@ TREE *csoundParseOrc(CSOUND *csound, const char *str)
         return NULL;
       }
 
+      if (csound->oparms->inlineUdos)
+        astTree = csound_orc_inline_udos(csound, astTree, typeTable);
       astTree = csound_orc_optimize(csound, astTree);
       //print_tree(csound, "AST after optmize", astTree);
       // small hack: use an extra node as head of tree list to hold the
@@ -0,0 +1,553 @@
+/*
+    profile.c:
+
+    Copyright (C) 2026 The Csound Core Developers
+
+    This file is part of Csound.
+
+    The Csound Library is free software; you can redistribute it
+    and/or modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    Csound is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with Csound; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+    02110-1301 USA
+*/
+
+/* Opcode and instrument profiler.
+
+   While csound->profiling is set, kperf runs every perf function through
+   csoundProfileOpcode(), which reads the cycle counter either side of the
+   call, and times each instrument's whole perf chain. Times are charged to
+   the TEXT of the opcode or instrument: the first time a TEXT is seen it
+   is given a slot, remembered in TEXT.profslot, and every performance
+   thread keeps its own array of counters indexed by slot so no locking or
+   atomics are needed on the hot path. The arrays are only summed when a
+   report is made. UDOs are timed as a whole at the call site.
+
+   Ticks are converted to seconds by comparing the cycle counter with the
+   real time clock over the profiled period.
+
+   The k-cycle timer is separate and much coarser: while csound->timing
+   is set the perform functions and kperf call csoundTimingMark() at the
+   boundaries between stages of a k-cycle, and at the end of the cycle
+   its total is checked against ksmps/sr. Only the performance thread
+   writes the totals, so hosts read them without taking a lock; the
+   ring of late k-cycles has a write count that readers check again
+   after copying, to drop entries overwritten meanwhile. */
+
+#include "csoundCore.h"
+#include "profile.h"
+#include <stdio.h>
+#if defined(WIN32)
+#include <windows.h>
+#else
+#include <time.h>
+#include <sys/time.h>
+#endif
+
+#define PROF_MAXSLOTS   4096    /* slot 0 collects anything beyond this */
+
+typedef struct {
+    uint64_t    ticks;
+    uint64_t    calls;
+} PROF_COUNT;
+
+/* What a report says about a slot is copied in when the slot is handed
+   out: the instrument may be redefined and its text freed before the
+   report is written. */
+typedef struct {
+    TEXT        *text;          /* only compared, never dereferenced */
+    int         insno;
+    int         isinstr;        /* times a whole perf chain */
+    int         line;
+    char        opname[32];
+    char        insname[32];    /* empty if the instrument is numbered */
+} PROF_SLOT;
+
+typedef struct {
+    spin_lock_t lock;           /* taken only to hand out slots */
+    int         nslots;
+    int         nthreads;
+    PROF_COUNT  *counts;        /* nthreads * PROF_MAXSLOTS */
+    uint64_t    kcycles;
+    uint64_t    start_ticks;
+    RTCLOCK     clock;
+    PROF_SLOT   slots[PROF_MAXSLOTS];
+} PROFILER;
+
+/* summed counters for one line of a report */
+typedef struct {
+    const char  *name;
+    int         insno, line;
+    uint64_t    ticks, calls;
+} PROF_ROW;
+
+static int profile_slot(CSOUND *csound, PROFILER *p, TEXT *t,
+                        INSDS *ip, int isinstr)
+{
+    int slot = t->profslot;
+
+    if (LIKELY(slot > 0 && slot < p->nslots && p->slots[slot].text == t))
+      return slot;
+    csoundSpinLock(&p->lock);
+    slot = t->profslot;
+    if (slot <= 0 || slot >= p->nslots || p->slots[slot].text != t) {
+      if (p->nslots < PROF_MAXSLOTS) {
+        PROF_SLOT *s;
+        slot = p->nslots;
+        s = &p->slots[slot];
+        s->text = t;
+        s->insno = ip->insno;
+        s->isinstr = isinstr;
+        s->line = (int) t->linenum;
+        strNcpy(s->opname, t->oentry != NULL ? t->oentry->opname :
+                (t->opcod != NULL ? t->opcod : "?"), sizeof(s->opname));
+        s->insname[0] = '\0';
+        if (ip->instr != NULL && ip->instr->insname != NULL)
+          strNcpy(s->insname, ip->instr->insname, sizeof(s->insname));
+        p->nslots++;
+        t->profslot = slot;
+      }
+      else slot = 0;
+    }
+    csoundSpinUnLock(&p->lock);
+    IGN(csound);
+    return slot;
+}
+
+void csoundProfileKcycle(CSOUND *csound)
+{
+    PROFILER *p = (PROFILER*) csound->profiler;
+
+    if (UNLIKELY(p->counts == NULL)) {
+      /* sized here rather than when profiling is switched on, as -j
+         may come later on the command line */
+      p->nthreads = csound->oparms->numThreads > 1 ?
+        csound->oparms->numThreads : 1;
+      p->counts = (PROF_COUNT*)
+        csound->Calloc(csound, sizeof(PROF_COUNT) *
+                       p->nthreads * PROF_MAXSLOTS);
+      csoundInitTimerStruct(&p->clock);
+      p->start_ticks = csoundProfileTicks();
+    }
+    p->kcycles++;
+}
+
+int csoundProfileOpcode(CSOUND *csound, OPDS *op, int thread)
+{
+    PROFILER *p = (PROFILER*) csound->profiler;
+    PROF_COUNT *c;
+    uint64_t t0;
+    int slot, ret;
+
+    if (UNLIKELY(p->counts == NULL || thread >= p->nthreads))
+      return (*op->opadr)(csound, op);
+    slot = profile_slot(csound, p, &op->optext->t, op->insdshead, 0);
+    t0 = csoundProfileTicks();
+    ret = (*op->opadr)(csound, op);
+    c = &p->counts[thread * PROF_MAXSLOTS + slot];
+    c->ticks += csoundProfileTicks() - t0;
+    c->calls++;
+    return ret;
+}
+
+void csoundProfileInstr(CSOUND *csound, INSDS *ip, int thread,
+                        uint64_t start)
+{
+    PROFILER *p = (PROFILER*) csound->profiler;
+    PROF_COUNT *c;
+    int slot;
+
+    if (UNLIKELY(p == NULL || p->counts == NULL || thread >= p->nthreads ||
+                 ip->instr == NULL))
+      return;
+    slot = profile_slot(csound, p, &ip->instr->t, ip, 1);
+    c = &p->counts[thread * PROF_MAXSLOTS + slot];
+    c->ticks += csoundProfileTicks() - start;
+    c->calls++;
+}
+
+PUBLIC void csoundSetProfiling(CSOUND *csound, int enable)
+{
+    if (enable && csound->profiler == NULL) {
+      PROFILER *p = (PROFILER*) csound->Calloc(csound, sizeof(PROFILER));
+      csoundSpinLockInit(&p->lock);
+      p->nslots = 1;            /* slot 0 is the overflow slot */
+      strcpy(p->slots[0].opname, "(other)");
+      csound->profiler = (void*) p;
+    }
+    csound->profiling = enable ? 1 : 0;
+}
+
+static int profile_cmp(const void *a, const void *b)
+{
+    const PROF_ROW *x = (const PROF_ROW*) a, *y = (const PROF_ROW*) b;
+    return x->ticks < y->ticks ? 1 : (x->ticks > y->ticks ? -1 : 0);
+}
+
+/* add a row to 'rows' unless one with the same key is there already */
+static PROF_ROW *profile_row(PROF_ROW *rows, int *n, const char *name,
+                             int insno, int line)
+{
+    int i;
+    for (i = 0; i < *n; i++)
+      if (rows[i].insno == insno && rows[i].line == line &&
+          (rows[i].name == name ||
+           (name != NULL && rows[i].name != NULL &&
+            strcmp(rows[i].name, name) == 0)))
+        return &rows[i];
+    rows[*n].name = name;
+    rows[*n].insno = insno;
+    rows[*n].line = line;
+    rows[*n].ticks = rows[*n].calls = 0;
+    return &rows[(*n)++];
+}
+
+static void profile_json_string(FILE *f, const char *s)
+{
+    putc('"', f);
+    for ( ; s != NULL && *s != '\0'; s++) {
+      if (*s == '"' || *s == '\\')
+        fprintf(f, "\\%c", *s);
+      else if ((unsigned char) *s < 0x20)
+        fprintf(f, "\\u%04x", (unsigned char) *s);
+      else
+        putc(*s, f);
+    }
+    putc('"', f);
+}
+
+PUBLIC int csoundWriteProfile(CSOUND *csound, const char *path)
+{
+    PROFILER *p = (PROFILER*) csound->profiler;
+    PROF_ROW *instrs, *ops, *lines;
+    int ni = 0, no = 0, nl = 0, i, j, nslots;
+    double elapsed, tps, total;
+    uint64_t now, itotal = 0;
+    FILE *f = NULL;
+
+    if (UNLIKELY(p == NULL || p->counts == NULL))
+      return CSOUND_ERROR;
+    nslots = p->nslots;
+    now = csoundProfileTicks();
+    elapsed = csoundGetRealTime(&p->clock);
+    tps = elapsed > 0.0 && now > p->start_ticks ?
+      (double) (now - p->start_ticks) / elapsed : 1.0e9;
+    instrs = (PROF_ROW*) csound->Calloc(csound, sizeof(PROF_ROW) * nslots * 3);
+    ops = instrs + nslots;
+    lines = ops + nslots;
+
+    for (i = 0; i < nslots; i++) {
+      PROF_SLOT *s = &p->slots[i];
+      uint64_t ticks = 0, calls = 0;
+      PROF_ROW *r;
+      for (j = 0; j < p->nthreads; j++) {
+        ticks += p->counts[j * PROF_MAXSLOTS + i].ticks;
+        calls += p->counts[j * PROF_MAXSLOTS + i].calls;
+      }
+      if (calls == 0)
+        continue;
+      if (s->isinstr) {
+        r = profile_row(instrs, &ni,
+                        s->insname[0] != '\0' ? s->insname : NULL,
+                        s->insno, 0);
+        itotal += ticks;
+      }
+      else {
+        r = profile_row(ops, &no, s->opname, 0, 0);
+        r->ticks += ticks;
+        r->calls += calls;
+        r = profile_row(lines, &nl, s->opname, s->insno, s->line);
+      }
+      r->ticks += ticks;
+      r->calls += calls;
+    }
+    qsort(instrs, ni, sizeof(PROF_ROW), profile_cmp);
+    qsort(ops, no, sizeof(PROF_ROW), profile_cmp);
+    qsort(lines, nl, sizeof(PROF_ROW), profile_cmp);
+    total = itotal > 0 ? (double) itotal : 1.0;
+
+    if (path == NULL) {
+      csound->Message(csound,
+                      Str("profile: %.3f s in instruments over %llu "
+                          "k-cycles (%.1f%% of %.3f s elapsed)\n"),
+                      itotal / tps, (unsigned long long) p->kcycles,
+                      elapsed > 0.0 ? 100.0 * itotal / tps / elapsed : 0.0,
+                      elapsed);
+      csound->Message(csound, Str("profile: per instrument\n"
+                                  "    instr        calls     time (s)"
+                                  "      %%    us/call\n"));
+      for (i = 0; i < ni; i++) {
+        PROF_ROW *r = &instrs[i];
+        if (r->name != NULL)
+          csound->Message(csound, "    %-10s", r->name);
+        else
+          csound->Message(csound, "    %-10d", r->insno);
+        csound->Message(csound, " %10llu %12.6f %6.2f %10.3f\n",
+                        (unsigned long long) r->calls, r->ticks / tps,
+                        100.0 * r->ticks / total,
+                        1.0e6 * r->ticks / tps / r->calls);
+      }
+      csound->Message(csound, Str("profile: per opcode\n"
+                                  "    opcode             calls     time (s)"
+                                  "      %%    ns/call\n"));
+      for (i = 0; i < no; i++) {
+        PROF_ROW *r = &ops[i];
+        csound->Message(csound, "    %-16s %10llu %12.6f %6.2f %10.1f\n",
+                        r->name, (unsigned long long) r->calls,
+                        r->ticks / tps, 100.0 * r->ticks / total,
+                        1.0e9 * r->ticks / tps / r->calls);
+      }
+      csound->Message(csound, Str("profile: per source line\n"
+                                  "     line  instr  opcode             calls"
+                                  "     time (s)      %%\n"));
+      for (i = 0; i < nl; i++) {
+        PROF_ROW *r = &lines[i];
+        csound->Message(csound, "    %5d %6d  %-16s %10llu %12.6f %6.2f\n",
+                        r->line, r->insno, r->name,
+                        (unsigned long long) r->calls, r->ticks / tps,
+                        100.0 * r->ticks / total);
+      }
+    }
+    else {
+      f = fopen(path, "w");
+      if (UNLIKELY(f == NULL)) {
+        csound->Warning(csound, Str("profile: cannot write %s"), path);
+        csound->Free(csound, instrs);
+        return CSOUND_ERROR;
+      }
+      fprintf(f, "{\n  \"elapsed\": %.9f,\n  \"seconds\": %.9f,\n"
+              "  \"kcycles\": %llu,\n  \"instruments\": [",
+              elapsed, itotal / tps, (unsigned long long) p->kcycles);
+      for (i = 0; i < ni; i++) {
+        fprintf(f, "%s\n    {\"insno\": %d, \"name\": ", i ? "," : "",
+                instrs[i].insno);
+        if (instrs[i].name != NULL)
+          profile_json_string(f, instrs[i].name);
+        else
+          fputs("null", f);
+        fprintf(f, ", \"calls\": %llu, \"seconds\": %.9f}",
+                (unsigned long long) instrs[i].calls, instrs[i].ticks / tps);
+      }
+      fputs("\n  ],\n  \"opcodes\": [", f);
+      for (i = 0; i < no; i++) {
+        fprintf(f, "%s\n    {\"name\": ", i ? "," : "");
+        profile_json_string(f, ops[i].name);
+        fprintf(f, ", \"calls\": %llu, \"seconds\": %.9f}",
+                (unsigned long long) ops[i].calls, ops[i].ticks / tps);
+      }
+      fputs("\n  ],\n  \"lines\": [", f);
+      for (i = 0; i < nl; i++) {
+        fprintf(f, "%s\n    {\"line\": %d, \"insno\": %d, \"opcode\": ",
+                i ? "," : "", lines[i].line, lines[i].insno);
+        profile_json_string(f, lines[i].name);
+        fprintf(f, ", \"calls\": %llu, \"seconds\": %.9f}",
+                (unsigned long long) lines[i].calls, lines[i].ticks / tps);
+      }
+      fputs("\n  ]\n}\n", f);
+      fclose(f);
+    }
+    csound->Free(csound, instrs);
+    return CSOUND_SUCCESS;
+}
+
+typedef struct {
+    double      warn, period;
+    int         started;            /* a k-cycle is being timed */
+    double      cycle_start, last_mark;
+    double      stage[CS_MARK_COUNT];
+    /* totals */
+    uint64_t    kcycles, overruns, buffers, buffer_overruns;
+    double      sum, last, max, buffer_last, buffer_max;
+    double      sums[CS_MARK_COUNT];
+    uint64_t    histogram[CS_TIMING_BINS];
+    /* for the periodic summary */
+    uint64_t    p_kcycles, p_overruns;
+    double      p_sum, p_max, p_time;
+    /* late k-cycles */
+    CS_TIMING_EVENT ring[CS_TIMING_RING];
+    volatile long ring_count;
+} TIMING;
+
+double csoundTimingNow(void)
+{
+#if defined(WIN32)
+    LARGE_INTEGER t, f;
+    QueryPerformanceCounter(&t);
+    QueryPerformanceFrequency(&f);
+    return (double) t.QuadPart / (double) f.QuadPart;
+#elif defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + 1.0e-9 * (double) ts.tv_nsec;
+#else
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (double) tv.tv_sec + 1.0e-6 * (double) tv.tv_usec;
+#endif
+}
+
+static void timing_report(CSOUND *csound, TIMING *t, double deadline)
+{
+    double n = t->p_kcycles > 0 ? (double) t->p_kcycles : 1.0;
+    csound->Message(csound,
+                    Str("timing: %llu k-cycles, load mean %.1f%% "
+                        "max %.1f%%, %llu overruns\n"),
+                    (unsigned long long) t->p_kcycles,
+                    100.0 * t->p_sum / n / deadline,
+                    100.0 * t->p_max / deadline,
+                    (unsigned long long) t->p_overruns);
+    t->p_kcycles = t->p_overruns = 0;
+    t->p_sum = t->p_max = t->p_time = 0.0;
+}
+
+/* a k-cycle has ended after 'total' seconds */
+static void timing_cycle(CSOUND *csound, TIMING *t, double total)
+{
+    double deadline = (double) csound->ksmps / (double) csound->esr;
+    double load = total / deadline;
+    int i, bin = (int) (load * 20.0);
+
+    if (bin >= CS_TIMING_BINS) bin = CS_TIMING_BINS - 1;
+    else if (bin < 0) bin = 0;
+    t->histogram[bin]++;
+    for (i = 0; i < CS_MARK_COUNT; i++)
+      t->sums[i] += t->stage[i];
+    t->sum += total;
+    t->last = total;
+    if (total > t->max) t->max = total;
+    if (load > 1.0) {
+      t->overruns++;
+      t->p_overruns++;
+    }
+    if (load > t->warn) {
+      long n = t->ring_count;
+      CS_TIMING_EVENT *ev = &t->ring[n % CS_TIMING_RING];
+      ev->kcycle = csound->global_kcounter;
+      ev->total = total;
+      ev->sensevents = t->stage[CS_MARK_SENSEVENTS];
+      ev->messages = t->stage[CS_MARK_MESSAGES];
+      ev->dag = t->stage[CS_MARK_DAG];
+      ev->perf = t->stage[CS_MARK_PERF];
+      ev->spoutran = t->stage[CS_MARK_SPOUTRAN];
+      ATOMIC_SET(t->ring_count, n + 1);
+    }
+    t->kcycles++;
+    if (t->period > 0.0) {
+      t->p_kcycles++;
+      t->p_sum += total;
+      if (total > t->p_max) t->p_max = total;
+      t->p_time += deadline;
+      if (t->p_time >= t->period)
+        timing_report(csound, t, deadline);
+    }
+}
+
+void csoundTimingMark(CSOUND *csound, int mark)
+{
+    TIMING *t = (TIMING*) csound->timer;
+    double now = csoundTimingNow();
+
+    if (mark == CS_MARK_START) {
+      memset(t->stage, 0, sizeof(t->stage));
+      t->cycle_start = t->last_mark = now;
+      t->started = 1;
+      return;
+    }
+    if (UNLIKELY(!t->started))
+      return;
+    t->stage[mark] += now - t->last_mark;
+    t->last_mark = now;
+    if (mark == CS_MARK_SPOUTRAN) {
+      t->started = 0;
+      timing_cycle(csound, t, now - t->cycle_start);
+    }
+}
+
+void csoundTimingBuffer(CSOUND *csound, double start)
+{
+    TIMING *t = (TIMING*) csound->timer;
+    double total = csoundTimingNow() - start;
+    double deadline = (double) csound->oparms_.outbufsamps /
+      ((double) csound->nchnls * (double) csound->esr);
+
+    t->buffers++;
+    t->buffer_last = total;
+    if (total > t->buffer_max) t->buffer_max = total;
+    if (total > deadline) t->buffer_overruns++;
+}
+
+PUBLIC void csoundSetTiming(CSOUND *csound, int enable,
+                            double warn, double period)
+{
+    TIMING *t = (TIMING*) csound->timer;
+
+    csound->timing = 0;
+    if (!enable)
+      return;
+    if (t == NULL) {
+      t = (TIMING*) csound->Calloc(csound, sizeof(TIMING));
+      csound->timer = (void*) t;
+    }
+    else memset(t, 0, sizeof(TIMING));
+    t->warn = warn > 0.0 ? warn : 0.8;
+    t->period = period > 0.0 ? period : 0.0;
+    csound->timing = 1;
+}
+
+PUBLIC int csoundGetTiming(CSOUND *csound, CS_TIMING_INFO *info)
+{
+    TIMING *t = (TIMING*) csound->timer;
+    double n;
+    int i;
+
+    if (UNLIKELY(t == NULL || info == NULL))
+      return CSOUND_ERROR;
+    info->kcycles = t->kcycles;
+    n = info->kcycles > 0 ? (double) info->kcycles : 1.0;
+    info->overruns = t->overruns;
+    info->deadline = csound->esr > 0 ?
+      (double) csound->ksmps / (double) csound->esr : 0.0;
+    info->last = t->last;
+    info->mean = t->sum / n;
+    info->max = t->max;
+    info->sensevents = t->sums[CS_MARK_SENSEVENTS] / n;
+    info->messages = t->sums[CS_MARK_MESSAGES] / n;
+    info->dag = t->sums[CS_MARK_DAG] / n;
+    info->perf = t->sums[CS_MARK_PERF] / n;
+    info->spoutran = t->sums[CS_MARK_SPOUTRAN] / n;
+    info->buffers = t->buffers;
+    info->buffer_overruns = t->buffer_overruns;
+    info->buffer_last = t->buffer_last;
+    info->buffer_max = t->buffer_max;
+    for (i = 0; i < CS_TIMING_BINS; i++)
+      info->histogram[i] = t->histogram[i];
+    return CSOUND_SUCCESS;
+}
+
+PUBLIC int csoundGetTimingEvents(CSOUND *csound, CS_TIMING_EVENT *events,
+                                 int max)
+{
+    TIMING *t = (TIMING*) csound->timer;
+    long n, after, i;
+    int got = 0;
+
+    if (UNLIKELY(t == NULL || events == NULL))
+      return 0;
+    n = ATOMIC_GET(t->ring_count);
+    for (i = n - 1; i >= 0 && i >= n - CS_TIMING_RING && got < max; i--)
+      events[got++] = t->ring[i % CS_TIMING_RING];
+    /* entries the writer has come round to again may be torn */
+    after = ATOMIC_GET(t->ring_count);
+    while (got > 0 && n - got <= after - CS_TIMING_RING)
+      got--;
+    return got;
+}
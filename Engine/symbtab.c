@@ -32,6 +32,7 @@
 #include "namedins.h"
 #include "interlocks.h"
 #include "csound_orc_semantics.h"
+#include "csmodule.h"
 #include "csound_standard_types.h"
 
 #ifndef PARSER_DEBUG
@@ -66,27 +67,18 @@ int get_opcode_type(OENTRY *ep)
     return retVal;
 }
 
-void init_symbtab(CSOUND *csound)
+/* Add token types for opcodes to symbtab.  If a polymorphic opcode
+ * definition is found (dsblksiz >= 0xfffb), look for implementations
+ * of that opcode to correctly mark the type of opcode it is (T_OPCODE,
+ * T_OPCODE0, or T_OPCODE00)
+ */
+static void add_opcode_tokens(CSOUND *csound)
 {
     OENTRY *ep;
     CONS_CELL *top, *head, *items;
 
     char *shortName;
 
-
-    if (csound->symbtab == NULL) {
-      /* VL 27 02 2015 -- if symbtab exists, do not create it again
-        to avoid memory consumption.
-       */
-      //printf("init symbtab\n");
-      csound->symbtab = cs_hash_table_create(csound);
-    /* Now we need to populate with basic words */
-    /* Add token types for opcodes to symbtab.  If a polymorphic opcode
-     * definition is found (dsblksiz >= 0xfffb), look for implementations
-     * of that opcode to correctly mark the type of opcode it is (T_OPCODE,
-     * T_OPCODE0, or T_OPCODE00)
-     */
-
     top = head = cs_hash_table_values(csound, csound->opcodes);
 
     while (head != NULL) {
@@ -108,6 +100,18 @@ void init_symbtab(CSOUND *csound)
       head = head->next;
     }
     csound->Free(csound, top);
+}
+
+void init_symbtab(CSOUND *csound)
+{
+    if (csound->symbtab == NULL) {
+      /* VL 27 02 2015 -- if symbtab exists, do not create it again
+        to avoid memory consumption.
+       */
+      //printf("init symbtab\n");
+      csound->symbtab = cs_hash_table_create(csound);
+      /* Now we need to populate with basic words */
+      add_opcode_tokens(csound);
     }
 }
 
@@ -202,6 +206,12 @@ ORCTOKEN *lookup_token(CSOUND *csound, char *s, void *yyscanner)
 
     a = cs_hash_table_get(csound, csound->symbtab, s);
 
+    if (a == NULL && csoundLoadLazyPlugins(csound, s, 0) > 0) {
+      /* opcode from a plugin deferred by the manifest, now loaded */
+      add_opcode_tokens(csound);
+      a = cs_hash_table_get(csound, csound->symbtab, s);
+    }
+
     if (a != NULL) {
       ans = (ORCTOKEN*)csound->Malloc(csound, sizeof(ORCTOKEN));
       memcpy(ans, a, sizeof(ORCTOKEN));
@@ -0,0 +1,434 @@
+/*
+    voices.c:
+
+    Copyright (C) 2026 The Csound Core Developers
+
+    This file is part of Csound.
+
+    The Csound Library is free software; you can redistribute it
+    and/or modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    Csound is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with Csound; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+    02110-1301 USA
+*/
+
+/* Voice stealing, load shedding and sleeping silent voices.
+
+   With voicesteal an instrument that reaches its maxalloc limit makes
+   room for a new note by releasing its oldest or quietest voice instead
+   of dropping the note. Voices already in their release stage go first.
+   The released voice is turned off after a few k-cycles, and while they
+   run its output is faded to nothing: an instance with INSDS.vflags set
+   performs into a scratch buffer belonging to the performance thread,
+   which is scaled and mixed into spout when its perf chain is done. The
+   same buffer gives the peak output level used to find the quietest
+   voice. Only what the instance sends to the output opcodes is seen;
+   signals routed through global variables or channels are not faded.
+
+   With loadshed kperf reports how long each perf pass took. When that
+   goes over a share of the k-period new notes of instruments below a
+   given priority are dropped, and one of their voices is released in
+   every k-cycle that is still over, lowest priority and oldest first.
+   Shedding stops when the load falls back below 80% of the threshold.
+   It only happens in real time; offline loadshed does nothing.
+
+   With autosleep the same peak level is used to find voices that have
+   gone quiet: once an instance has been heard (gone over its wake level)
+   and then stays under its silence level for long enough, it is either
+   turned off or put to sleep. kperf skips the perf chain of a sleeping
+   instance. It wakes when it is tied to a new note, enters its release
+   stage, or when one of the global variables its opcodes read changes:
+   a k-rate global taking a new value, or an a-rate global going over the
+   wake level. Inputs read any other way (channels, zak, p-fields changed
+   by the host) do not wake it. Turnoffs are queued by the performance
+   threads and done by kperf once the perf pass is over. */
+
+#include "csoundCore.h"
+#include "csound_standard_types.h"
+#include "voices.h"
+#include "profile.h"
+#include "aops.h"
+#include <math.h>
+
+#define VOICE_RELEASE_KCYCLES   (4)     /* default fast release */
+#define VOICE_MAXDONE           (64)    /* silent voices to turn off */
+
+typedef struct {
+    spin_lock_t lock;           /* on done[] */
+    INSDS       *done[VOICE_MAXDONE];
+    int         ndone;
+    MYFLT       *buf;           /* nspout samples per performance thread */
+    int         nbufs;
+    MYFLT       threshold;      /* share of the k-period, 0 if off */
+    int         priority;       /* shed instruments below this */
+    MYFLT       release;
+    double      load;           /* peak held, decaying */
+    int         overloaded;
+    long        stolen, shed, refused, slept, silenced;
+} VOICES;
+
+/* global variables read by an instrument, k-rate ones first */
+typedef struct {
+    int         n, nk;
+    MYFLT       *ptr[1];
+} VOICE_WATCH;
+
+static int voices_reset(CSOUND *csound, void *p)
+{
+    VOICES *v = (VOICES*) p;
+
+    if (v->stolen || v->shed || v->refused)
+      csound->Message(csound,
+                      Str("voices: %ld stolen, %ld shed, "
+                          "%ld notes dropped under load\n"),
+                      v->stolen, v->shed, v->refused);
+    if (v->slept || v->silenced)
+      csound->Message(csound,
+                      Str("voices: %ld put to sleep, %ld turned off "
+                          "when silent\n"), v->slept, v->silenced);
+    return OK;
+}
+
+static VOICES *voices_get(CSOUND *csound)
+{
+    VOICES *v = (VOICES*) csound->voices;
+
+    if (v == NULL) {
+      v = (VOICES*) csound->Calloc(csound, sizeof(VOICES));
+      csoundSpinLockInit(&v->lock);
+      csound->RegisterResetCallback(csound, (void*) v, voices_reset);
+      csound->voices = (void*) v;
+    }
+    return v;
+}
+
+/* the scratch buffers are made by the first voice that needs them, by
+   which time nspout is known */
+static int voices_buffers(CSOUND *csound, VOICES *v)
+{
+    if (v->buf == NULL && csound->nspout > 0) {
+      int n = csound->oparms->numThreads > 1 ?
+        csound->oparms->numThreads : 1;
+      v->buf = (MYFLT*) csound->Calloc(csound,
+                                       (size_t) n * csound->nspout *
+                                       sizeof(MYFLT));
+      v->nbufs = n;
+    }
+    return v->buf != NULL;
+}
+
+static int voice_watched(ARG *arg, const CS_TYPE *type)
+{
+    CS_VARIABLE *var = (CS_VARIABLE*) arg->argPtr;
+
+    if (arg->type != ARG_GLOBAL || var->memBlock == NULL)
+      return 0;
+    if (type != NULL)
+      return var->varType == type;
+    return (var->varType == &CS_VAR_TYPE_K ||
+            var->varType == &CS_VAR_TYPE_A);
+}
+
+static VOICE_WATCH *voice_watch(CSOUND *csound, INSTRTXT *tp)
+{
+    VOICE_WATCH *w;
+    OPTXT *optxt;
+    ARG *arg;
+    int i, k, n = 0;
+
+    for (optxt = tp->nxtop; optxt != NULL; optxt = optxt->nxtop)
+      for (arg = optxt->t.inArgs; arg != NULL; arg = arg->next)
+        n += voice_watched(arg, NULL);
+    w = (VOICE_WATCH*) csound->Calloc(csound, sizeof(VOICE_WATCH) +
+                                      n * sizeof(MYFLT*));
+    for (k = 0; k < 2; k++) {
+      for (optxt = tp->nxtop; optxt != NULL; optxt = optxt->nxtop)
+        for (arg = optxt->t.inArgs; arg != NULL; arg = arg->next) {
+          MYFLT *p;
+          if (!voice_watched(arg, k ? &CS_VAR_TYPE_A : &CS_VAR_TYPE_K))
+            continue;
+          p = &((CS_VARIABLE*) arg->argPtr)->memBlock->value;
+          for (i = 0; i < w->n && w->ptr[i] != p; i++);
+          if (i == w->n)
+            w->ptr[w->n++] = p;
+        }
+      if (k == 0)
+        w->nk = w->n;
+    }
+    tp->vwatch = (void*) w;
+    return w;
+}
+
+void csoundVoiceStart(CSOUND *csound, INSTRTXT *tp, INSDS *ip)
+{
+    VOICES *v = voices_get(csound);
+
+    ip->vlevel = FL(0.0);
+    ip->vsilent = -1;
+    if ((tp->vsteal == VOICE_QUIETEST || tp->vsleep != VOICE_AWAKE) &&
+        voices_buffers(csound, v))
+      ip->vflags = VOICE_LEVEL;
+    if (tp->vsleep == VOICE_SLEEP) {
+      VOICE_WATCH *w = tp->vwatch != NULL ?
+        (VOICE_WATCH*) tp->vwatch : voice_watch(csound, tp);
+      if (w->nk > 0 && ip->vwatch == NULL)
+        ip->vwatch = (MYFLT*) csound->Calloc(csound, w->nk * sizeof(MYFLT));
+    }
+}
+
+/* called from the perf pass with the voice's output peak */
+static void voice_silence(CSOUND *csound, VOICES *v, INSDS *ip, MYFLT peak)
+{
+    INSTRTXT *tp = ip->instr;
+
+    if (peak >= tp->vwakethr) {
+      ip->vsilent = 0;
+      return;
+    }
+    if (ip->vsilent < 0)
+      return;                   /* never heard yet */
+    if (peak >= tp->vsleepthr) {
+      ip->vsilent = 0;
+      return;
+    }
+    if ((double) ++ip->vsilent * csound->ksmps <
+        tp->vsleeptime * csound->esr || ip->vsleep != VOICE_AWAKE)
+      return;
+    if (tp->vsleep == VOICE_SLEEP) {
+      VOICE_WATCH *w = (VOICE_WATCH*) tp->vwatch;
+      int i;
+      if (w == NULL || (w->nk > 0 && ip->vwatch == NULL))
+        return;                 /* started before autosleep was set */
+      for (i = 0; i < w->nk; i++)
+        ip->vwatch[i] = *w->ptr[i];
+      ip->vsleep = VOICE_SLEEP;
+      ATOMIC_INCR(v->slept);
+    }
+    else {
+      csoundSpinLock(&v->lock);
+      if (v->ndone < VOICE_MAXDONE) {   /* else try again next k-cycle */
+        v->done[v->ndone++] = ip;
+        ip->vsleep = VOICE_TURNOFF;
+      }
+      csoundSpinUnLock(&v->lock);
+    }
+}
+
+int csoundVoiceAsleep(CSOUND *csound, INSDS *ip)
+{
+    INSTRTXT *tp = ip->instr;
+    VOICE_WATCH *w = (VOICE_WATCH*) tp->vwatch;
+    uint32_t j, nsmps = csound->ksmps;
+    int i;
+
+    if (w != NULL) {
+      for (i = 0; i < w->nk; i++)
+        if (*w->ptr[i] != ip->vwatch[i])
+          goto wake;
+      for (; i < w->n; i++) {
+        MYFLT *a = w->ptr[i];
+        for (j = 0; j < nsmps; j++)
+          if (FABS(a[j]) >= tp->vwakethr)
+            goto wake;
+      }
+    }
+    return 1;
+ wake:
+    ip->vsleep = VOICE_AWAKE;
+    ip->vsilent = 0;
+    return 0;
+}
+
+void csoundVoiceRelease(CSOUND *csound, INSDS *ip, MYFLT secs)
+{
+    VOICES *v = voices_get(csound);
+    int kcycles;
+
+    if (ip->vflags & VOICE_FADE)
+      return;
+    if (secs > FL(0.0))
+      kcycles = (int) ceil(secs * csound->esr / ip->ksmps);
+    else
+      kcycles = VOICE_RELEASE_KCYCLES * csound->ksmps / ip->ksmps;
+    if (kcycles < 1) kcycles = 1;
+    if (voices_buffers(csound, v)) {
+      ip->vgain = FL(1.0);
+      ip->vstep = FL(1.0) / ((MYFLT) kcycles * ip->ksmps);
+      ip->vflags |= VOICE_FADE;
+      csound->engineState.instrtxtp[ip->insno]->vfading++;
+    }
+    xturnoff_fast(csound, ip, kcycles);
+}
+
+/* releasing voices go before held ones, then oldest or quietest */
+static int voice_better(INSTRTXT *tp, INSDS *a, INSDS *b)
+{
+    if (b == NULL)
+      return 1;
+    if (a->relesing != b->relesing)
+      return a->relesing;
+    if (tp->vsteal == VOICE_QUIETEST && a->vlevel != b->vlevel)
+      return a->vlevel < b->vlevel;
+    return a->vstart < b->vstart;
+}
+
+int csoundVoiceSteal(CSOUND *csound, INSTRTXT *tp)
+{
+    INSDS *ip, *victim = NULL;
+
+    if (tp->vsteal == VOICE_REFUSE)
+      return 0;
+    for (ip = tp->instance; ip != NULL; ip = ip->nxtinstance) {
+      if (ip->actflg && !(ip->vflags & VOICE_FADE) &&
+          voice_better(tp, ip, victim))
+        victim = ip;
+    }
+    if (victim == NULL)
+      return 0;
+    if (UNLIKELY(csound->oparms->odebug))
+      csound->Message(csound, Str("stealing a voice of instr %d\n"),
+                      (int) victim->insno);
+    csoundVoiceRelease(csound, victim, tp->vrelease);
+    ((VOICES*) csound->voices)->stolen++;
+    return 1;
+}
+
+int csoundVoiceShed(CSOUND *csound, INSTRTXT *tp)
+{
+    VOICES *v = (VOICES*) csound->voices;
+
+    if (v->overloaded && tp->vpriority < v->priority) {
+      v->refused++;
+      return 1;
+    }
+    return 0;
+}
+
+static void voice_shed(CSOUND *csound, VOICES *v)
+{
+    INSDS *ip, *victim = NULL;
+    int prio = 0;
+
+    for (ip = csound->actanchor.nxtact; ip != NULL; ip = ip->nxtact) {
+      INSTRTXT *tp = csound->engineState.instrtxtp[ip->insno];
+      if ((ip->vflags & VOICE_FADE) || tp->vpriority >= v->priority)
+        continue;
+      if (victim == NULL || tp->vpriority < prio ||
+          (tp->vpriority == prio && ip->vstart < victim->vstart)) {
+        prio = tp->vpriority;
+        victim = ip;
+      }
+    }
+    if (victim != NULL) {
+      csoundVoiceRelease(csound, victim, v->release);
+      v->shed++;
+    }
+}
+
+void csoundVoiceKcycle(CSOUND *csound, double secs)
+{
+    VOICES *v = (VOICES*) csound->voices;
+    double load = secs * csound->ekr;
+    int shed = 0, i;
+
+    if (v->threshold > FL(0.0)) {
+      if (load > v->load)
+        v->load = load;
+      else
+        v->load += 0.05 * (load - v->load);
+      if (v->load > v->threshold)
+        v->overloaded = 1;
+      else if (v->load < 0.8 * v->threshold)
+        v->overloaded = 0;
+      shed = v->overloaded && load > v->threshold;
+    }
+    if (!shed && v->ndone == 0)
+      return;
+    /* the performance threads are done with the instances by now */
+    if (csound->oparms->realtime)
+      csoundSpinLock(&csound->alloc_spinlock);
+    for (i = 0; i < v->ndone; i++) {
+      INSDS *ip = v->done[i];
+      if (ip->actflg && ip->vsleep == VOICE_TURNOFF) {
+        xturnoff_now(csound, ip);
+        v->silenced++;
+      }
+    }
+    v->ndone = 0;
+    if (shed)
+      voice_shed(csound, v);
+    if (csound->oparms->realtime)
+      csoundSpinUnLock(&csound->alloc_spinlock);
+}
+
+void csoundVoiceSetShedding(CSOUND *csound, MYFLT threshold,
+                            int priority, MYFLT release)
+{
+    VOICES *v = voices_get(csound);
+
+    v->threshold = threshold > FL(0.0) ? threshold : FL(0.0);
+    v->priority = priority;
+    v->release = release;
+    v->load = 0.0;
+    v->overloaded = 0;
+}
+
+MYFLT *csoundVoiceSpout(CSOUND *csound, INSDS *ip, int thread)
+{
+    VOICES *v = (VOICES*) csound->voices;
+    MYFLT *buf = v->buf + (size_t) thread * csound->nspout;
+    IGN(ip);
+
+    memset(buf, 0, csound->nspout * sizeof(MYFLT));
+    return buf;
+}
+
+void csoundVoiceMix(CSOUND *csound, INSDS *ip, int thread)
+{
+    VOICES *v = (VOICES*) csound->voices;
+    MYFLT *buf = v->buf + (size_t) thread * csound->nspout;
+    MYFLT *spout = csound->spraw, peak = FL(0.0);
+    uint32_t i, j, ch, nsmps = csound->ksmps, n = csound->nspout;
+
+    if (ip->vflags & VOICE_FADE) {
+      MYFLT g = ip->vgain, step = ip->vstep;
+      if (ip->ksmps == csound->ksmps) {
+        for (j = 0; j < nsmps; j++, g -= step) {
+          MYFLT gj = g > FL(0.0) ? g : FL(0.0);
+          for (ch = 0; ch < csound->nchnls; ch++)
+            buf[ch * nsmps + j] *= gj;
+        }
+      }
+      else {
+        /* local ksmps lays the buffer out differently: one gain per
+           k-cycle is close enough */
+        MYFLT gm = g - FL(0.5) * step * nsmps;
+        if (gm < FL(0.0)) gm = FL(0.0);
+        for (i = 0; i < n; i++)
+          buf[i] *= gm;
+        g -= step * nsmps;
+      }
+      ip->vgain = g > FL(0.0) ? g : FL(0.0);
+    }
+    for (i = 0; i < n; i++) {
+      MYFLT a = FABS(buf[i]);
+      if (a > peak) peak = a;
+    }
+    ip->vlevel = peak;
+    if (UNLIKELY(ip->instr->vsleep != VOICE_AWAKE))
+      voice_silence(csound, v, ip, peak);
+    CSOUND_SPOUT_SPINLOCK
+    for (i = 0; i < n; i++)
+      spout[i] += buf[i];
+    csound->spoutactive = 1;
+    CSOUND_SPOUT_SPINUNLOCK
+}
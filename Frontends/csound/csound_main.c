@@ -23,11 +23,14 @@
 
 /* Console Csound using the Csound API. */
 #include "csound.h"
+#include <sndfile.h>
 #include <stdio.h>
 #include <signal.h>
 #include <stdarg.h>
+#include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <math.h>
 #if defined(HAVE_UNISTD_H) || defined(MACOSX)
 #include <unistd.h>
 #endif
@@ -255,11 +258,714 @@ static void install_signal_handler(void)
     }
 }
 
+/* Batch rendering: --batch=<manifest> renders every job listed in the
+   manifest on a pool of --batch-jobs=<n> Csound instances in this process.
+   Each manifest line is
+       <csd> <output> [override flags ...]
+   with '#' starting a comment. Flags given on the command line itself are
+   applied to every job before its own overrides. Each worker keeps one
+   instance for all its jobs and resets it in between, so plugin libraries
+   are only opened from disk once. */
+
+#define BATCH_MAXARGS   64
+
+typedef struct {
+    char    *line;              /* tokenised manifest line */
+    char    *argv[BATCH_MAXARGS];
+    int     argc;
+    int     lineno;
+    int     result;
+    double  elapsed;
+} BATCH_JOB;
+
+typedef struct {
+    BATCH_JOB   *jobs;
+    int         njobs, next;
+    int         nbad;           /* manifest lines that were rejected */
+    const char  **common;       /* flags shared by all jobs */
+    int         ncommon;
+    void        *lock;
+} BATCH;
+
+typedef struct {
+    BATCH       *batch;
+    CSOUND      *csound;
+} BATCH_WORKER;
+
+static int batch_tokenise(BATCH_JOB *job)
+{
+    char    *s = job->line;
+
+    job->argc = 0;
+    while (*s != '\0') {
+      while (*s == ' ' || *s == '\t' || *s == '\r' || *s == '\n')
+        s++;
+      if (*s == '\0' || *s == '#')
+        break;
+      if (job->argc >= BATCH_MAXARGS)
+        return -1;
+      if (*s == '"') {
+        job->argv[job->argc++] = ++s;
+        while (*s != '\0' && *s != '"')
+          s++;
+      }
+      else {
+        job->argv[job->argc++] = s;
+        while (*s != '\0' && *s != ' ' && *s != '\t' &&
+               *s != '\r' && *s != '\n')
+          s++;
+      }
+      if (*s != '\0')
+        *(s++) = '\0';
+    }
+    return 0;
+}
+
+static int batch_read_manifest(BATCH *batch, const char *name)
+{
+    FILE    *f;
+    char    buf[4096];
+    int     lineno = 0, size = 0;
+
+    if ((f = fopen(name, "r")) == NULL) {
+      fprintf(stderr, "Error opening batch manifest '%s': %s\n",
+                      name, strerror(errno));
+      return -1;
+    }
+    while (fgets(buf, (int) sizeof(buf), f) != NULL) {
+      BATCH_JOB *job;
+      size_t    len = strlen(buf);
+      lineno++;
+      if (len > 0 && buf[len - 1] != '\n' && !feof(f)) {
+        int c;                          /* skip the rest of the line */
+        while ((c = getc(f)) != EOF && c != '\n')
+          ;
+        fprintf(stderr, "%s:%d: line too long\n", name, lineno);
+        batch->nbad++;
+        continue;
+      }
+      if (batch->njobs >= size) {
+        BATCH_JOB *jobs;
+        size = (size ? size * 2 : 64);
+        jobs = (BATCH_JOB*) realloc(batch->jobs,
+                                    (size_t) size * sizeof(BATCH_JOB));
+        if (jobs == NULL) {
+          fprintf(stderr, "batch: not enough memory\n");
+          fclose(f);
+          return -1;
+        }
+        batch->jobs = jobs;
+      }
+      job = &(batch->jobs[batch->njobs]);
+      memset(job, 0, sizeof(BATCH_JOB));
+      if ((job->line = strdup(buf)) == NULL) {
+        fprintf(stderr, "batch: not enough memory\n");
+        fclose(f);
+        return -1;
+      }
+      job->lineno = lineno;
+      if (batch_tokenise(job) != 0) {
+        fprintf(stderr, "%s:%d: too many arguments\n", name, lineno);
+        free(job->line);
+        batch->nbad++;
+        continue;
+      }
+      if (job->argc == 0) {               /* blank or comment */
+        free(job->line);
+        continue;
+      }
+      if (job->argc < 2) {
+        fprintf(stderr, "%s:%d: expected <csd> <output> [flags]\n",
+                        name, lineno);
+        free(job->line);
+        batch->nbad++;
+        continue;
+      }
+      batch->njobs++;
+    }
+    fclose(f);
+    return 0;
+}
+
+static void batch_render(BATCH_WORKER *w, BATCH_JOB *job)
+{
+    BATCH       *batch = w->batch;
+    const char  *argv[BATCH_MAXARGS * 2 + 4];
+    RTCLOCK     clk;
+    int         argc = 0, i;
+
+    argv[argc++] = "csound";
+    for (i = 0; i < batch->ncommon && i < BATCH_MAXARGS; i++)
+      argv[argc++] = batch->common[i];
+    for (i = 2; i < job->argc; i++)
+      argv[argc++] = job->argv[i];
+    argv[argc++] = "-o";
+    argv[argc++] = job->argv[1];
+    argv[argc++] = job->argv[0];
+
+    csoundInitTimerStruct(&clk);
+    job->result = csoundCompile(w->csound, argc, argv);
+    if (job->result == 0) {
+      job->result = csoundPerform(w->csound);
+      if (job->result > 0)              /* end of score is not an error */
+        job->result = 0;
+    }
+    csoundReset(w->csound);
+    job->elapsed = csoundGetRealTime(&clk);
+}
+
+static uintptr_t batch_worker(void *userData)
+{
+    BATCH_WORKER    *w = (BATCH_WORKER*) userData;
+    BATCH           *batch = w->batch;
+    BATCH_JOB       *job;
+
+    for (;;) {
+      csoundLockMutex(batch->lock);
+      job = (batch->next < batch->njobs ? &(batch->jobs[batch->next++]) : NULL);
+      csoundUnlockMutex(batch->lock);
+      if (job == NULL)
+        break;
+      batch_render(w, job);
+      fprintf(stderr, "batch: [%d] %s -> %s: %s (%.3f s)\n",
+              job->lineno, job->argv[0], job->argv[1],
+              (job->result == 0 ? "ok" : "FAILED"), job->elapsed);
+    }
+    return 0;
+}
+
+static int batch_main(const char *manifest, int nworkers,
+                      int argc, char **argv)
+{
+    BATCH           batch;
+    BATCH_WORKER    *workers;
+    void            **threads;
+    RTCLOCK         clk;
+    double          total, cpu = 0.0;
+    int             i, nfailed = 0;
+
+    memset(&batch, 0, sizeof(BATCH));
+    if (batch_read_manifest(&batch, manifest) != 0) {
+      for (i = 0; i < batch.njobs; i++)
+        free(batch.jobs[i].line);
+      free(batch.jobs);
+      return -1;
+    }
+    if (batch.njobs == 0) {
+      fprintf(stderr, "batch: no jobs in '%s'\n", manifest);
+      free(batch.jobs);
+      return -1;
+    }
+    /* everything on the command line except the batch options themselves
+       and the log file option is passed on to each job */
+    batch.common = (const char**) calloc((size_t) argc, sizeof(char*));
+    for (i = 1; i < argc; i++) {
+      if (strncmp(argv[i], "--batch", 7) == 0 ||
+          strncmp(argv[i], "--logfile=", 10) == 0 ||
+          (strncmp(argv[i], "-O", 2) == 0 && argv[i][2] != '\0'))
+        continue;
+      if (strcmp(argv[i], "-O") == 0) {
+        i++;
+        continue;
+      }
+      batch.common[batch.ncommon++] = argv[i];
+    }
+    if (nworkers < 1)
+      nworkers = 1;
+    if (nworkers > batch.njobs)
+      nworkers = batch.njobs;
+    batch.lock = csoundCreateMutex(0);
+    workers = (BATCH_WORKER*) calloc((size_t) nworkers, sizeof(BATCH_WORKER));
+    threads = (void**) calloc((size_t) nworkers, sizeof(void*));
+
+    csoundInitTimerStruct(&clk);
+    /* instances are created here rather than on the worker threads */
+    for (i = 0; i < nworkers; i++) {
+      workers[i].batch = &batch;
+      workers[i].csound = csoundCreate(NULL);
+    }
+    for (i = 1; i < nworkers; i++)
+      threads[i] = csoundCreateThread(batch_worker, &workers[i]);
+    batch_worker(&workers[0]);
+    for (i = 1; i < nworkers; i++) {
+      if (threads[i] != NULL)
+        csoundJoinThread(threads[i]);
+      else
+        batch_worker(&workers[i]);      /* could not start: drain inline */
+    }
+    total = csoundGetRealTime(&clk);
+    for (i = 0; i < nworkers; i++)
+      csoundDestroy(workers[i].csound);
+
+    for (i = 0; i < batch.njobs; i++) {
+      cpu += batch.jobs[i].elapsed;
+      if (batch.jobs[i].result != 0)
+        nfailed++;
+      free(batch.jobs[i].line);
+    }
+    fprintf(stderr, "batch: %d jobs (%d failed) on %d workers in %.3f s "
+                    "(%.3f s rendering, x%.2f)\n",
+            batch.njobs, nfailed, nworkers, total, cpu,
+            (total > 0.0 ? cpu / total : 0.0));
+    if (batch.nbad)
+      fprintf(stderr, "batch: %d manifest lines rejected\n", batch.nbad);
+    nfailed += batch.nbad;
+
+    csoundDestroyMutex(batch.lock);
+    free(threads);
+    free(workers);
+    free(batch.common);
+    free(batch.jobs);
+    return (nfailed ? -1 : 0);
+}
+
+/* Segmented rendering: --segments=<t1,t2,...> splits an offline render at
+   the given score times and renders the segments concurrently on
+   --segment-jobs=<n> instances. A segment plays the notes starting inside
+   it, then mutes further score notes and keeps running for
+   --segment-tail=<secs> so that decays and reverb tails are kept. The
+   outputs are summed at their start times and written in score order, as
+   soon as every segment that reaches a stretch of the output is done, to
+   the file given with -o (or --segment-output=<file>) in the format asked
+   for with the usual file type and sample format options. This is only
+   valid for scores whose notes do not share state across the boundaries,
+   which --segment-verify checks by also rendering the score in one pass
+   and comparing the two. */
+
+#define SEG_MAXBOUNDS   256
+#define SEG_BLOCK       4096    /* frames mixed and written at a time */
+
+typedef struct {
+    double  start, end;         /* score time; end < 0 means end of score */
+    float   *buf;               /* interleaved, normalised to 0dBFS */
+    int64_t offset, nframes;    /* first frame, frames in buf */
+    int     result, done;
+    double  elapsed;
+} SEG_JOB;
+
+typedef struct {
+    SEG_JOB     *jobs;
+    int         njobs, next;
+    double      tail;
+    const char  **argv;
+    int         argc;
+    void        *lock;
+    double      sr;             /* set before the workers start */
+    int         nchnls;
+    /* output, only touched with wlock held */
+    void        *wlock;
+    SNDFILE     *out;
+    char        *outname;
+    float       *mix;           /* SEG_BLOCK frames */
+    float       scale;          /* applied when writing */
+    int64_t     written;        /* frames written so far */
+    int         failed;
+    SEG_JOB     *whole;         /* single-pass render for --segment-verify */
+    double      maxdiff;
+    int64_t     firstdiff;
+} SEGMENTS;
+
+static void seg_append(SEG_JOB *job, int64_t *size, int64_t frame,
+                       const MYFLT *spout, int nframes, int nchnls,
+                       MYFLT scale)
+{
+    int64_t n = frame - job->offset + nframes;
+    int64_t i;
+
+    if (n > *size) {
+      int64_t newsize = (*size ? *size * 2 : 65536);
+      while (newsize < n)
+        newsize *= 2;
+      job->buf = (float*) realloc(job->buf,
+                                  (size_t) (newsize * nchnls) * sizeof(float));
+      memset(job->buf + *size * nchnls, 0,
+             (size_t) ((newsize - *size) * nchnls) * sizeof(float));
+      *size = newsize;
+    }
+    for (i = 0; i < (int64_t) nframes * nchnls; i++)
+      job->buf[(frame - job->offset) * nchnls + i] += (float) (spout[i] * scale);
+    if (n > job->nframes)
+      job->nframes = n;
+}
+
+static void seg_render(SEGMENTS *seg, SEG_JOB *job)
+{
+    CSOUND      *csound = csoundCreate(NULL);
+    RTCLOCK     clk;
+    MYFLT       scale;
+    int64_t     size = 0, frame;
+    int         ksmps, muted = 0;
+    double      t, stop = (job->end < 0.0 ? -1.0 : job->end + seg->tail);
+
+    csoundInitTimerStruct(&clk);
+    if (job->start > 0.0)
+      csoundSetScoreOffsetSeconds(csound, (MYFLT) job->start);
+    job->result = csoundCompile(csound, seg->argc, seg->argv);
+    if (job->result == 0) {
+      ksmps = (int) csoundGetKsmps(csound);
+      scale = (MYFLT) 1.0 / csoundGet0dBFS(csound);
+      for (;;) {
+        t = csoundGetScoreTime(csound);
+        if (stop >= 0.0 && t >= stop)
+          break;
+        if (!muted && job->end >= 0.0 && t >= job->end) {
+          csoundSetScorePending(csound, 0);   /* later notes are not ours */
+          muted = 1;
+        }
+        if (csoundPerformKsmps(csound) != 0)
+          break;
+        /* the first k-cycle of a segment also skips to its start, so
+           the frame is only known once it has been performed */
+        frame = (int64_t) (csoundGetScoreTime(csound) * seg->sr + 0.5)
+                - ksmps;
+        if (frame >= job->offset)     /* skipping is silent */
+          seg_append(job, &size, frame, csoundGetSpout(csound),
+                     ksmps, seg->nchnls, scale);
+      }
+    }
+    job->result = (job->result < 0 ? job->result : 0);
+    csoundDestroy(csound);
+    job->elapsed = csoundGetRealTime(&clk);
+}
+
+/* write out every frame that no unfinished segment can still add to:
+   everything before the start of the first segment that is not done */
+
+static void seg_flush(SEGMENTS *seg)
+{
+    SEG_JOB *whole = seg->whole;
+    int64_t upto = 0, f, i, n;
+    int     k, j, nchnls = seg->nchnls;
+
+    csoundLockMutex(seg->wlock);
+    csoundLockMutex(seg->lock);
+    for (k = 0; k < seg->njobs && seg->jobs[k].done; k++)
+      if (seg->jobs[k].result != 0)
+        seg->failed = 1;
+    csoundUnlockMutex(seg->lock);
+    if (seg->failed) {
+      csoundUnlockMutex(seg->wlock);
+      return;
+    }
+    if (k < seg->njobs)
+      upto = seg->jobs[k].offset;
+    else {
+      for (j = 0; j < seg->njobs; j++)
+        if (seg->jobs[j].offset + seg->jobs[j].nframes > upto)
+          upto = seg->jobs[j].offset + seg->jobs[j].nframes;
+    }
+    for (f = seg->written; f < upto; f += n) {
+      n = (upto - f < SEG_BLOCK ? upto - f : SEG_BLOCK);
+      memset(seg->mix, 0, (size_t) (n * nchnls) * sizeof(float));
+      for (j = 0; j < k; j++) {
+        SEG_JOB *job = &(seg->jobs[j]);
+        int64_t a = (job->offset > f ? job->offset : f);
+        int64_t b = job->offset + job->nframes;
+        if (b > f + n)
+          b = f + n;
+        for (i = a * nchnls; i < b * nchnls; i++)
+          seg->mix[i - f * nchnls] += job->buf[i - job->offset * nchnls];
+      }
+      if (whole != NULL) {
+        for (i = 0; i < n * nchnls; i++) {
+          int64_t x = f * nchnls + i;
+          double  d = fabs((double) seg->mix[i] -
+                           (x < whole->nframes * nchnls ? whole->buf[x] : 0.0));
+          if (d > seg->maxdiff)
+            seg->maxdiff = d;
+          if (d > 1.0e-5 && seg->firstdiff < 0)
+            seg->firstdiff = x / nchnls;
+        }
+      }
+      if (seg->scale != 1.0f)
+        for (i = 0; i < n * nchnls; i++)
+          seg->mix[i] *= seg->scale;
+      if (sf_writef_float(seg->out, seg->mix, (sf_count_t) n) != n) {
+        fprintf(stderr, "segments: error writing output: %s\n",
+                        sf_strerror(seg->out));
+        seg->failed = 1;
+        break;
+      }
+    }
+    seg->written = f;
+    /* segments that have been written out completely are not needed */
+    for (j = 0; j < k; j++) {
+      SEG_JOB *job = &(seg->jobs[j]);
+      if (job->buf != NULL && job->offset + job->nframes <= seg->written) {
+        free(job->buf);
+        job->buf = NULL;
+      }
+    }
+    csoundUnlockMutex(seg->wlock);
+}
+
+static uintptr_t seg_worker(void *userData)
+{
+    SEGMENTS    *seg = (SEGMENTS*) userData;
+    SEG_JOB     *job;
+
+    for (;;) {
+      csoundLockMutex(seg->lock);
+      job = (seg->next < seg->njobs ? &(seg->jobs[seg->next++]) : NULL);
+      csoundUnlockMutex(seg->lock);
+      if (job == NULL)
+        break;
+      seg_render(seg, job);
+      csoundLockMutex(seg->lock);
+      job->done = 1;
+      csoundUnlockMutex(seg->lock);
+      if (job->end < 0.0)
+        fprintf(stderr, "segments: %.3f - end: %s (%.3f s)\n", job->start,
+                (job->result == 0 ? "ok" : "FAILED"), job->elapsed);
+      else
+        fprintf(stderr, "segments: %.3f - %.3f: %s (%.3f s)\n", job->start,
+                job->end, (job->result == 0 ? "ok" : "FAILED"), job->elapsed);
+      seg_flush(seg);
+    }
+    return 0;
+}
+
+/* the names csoundGetOutputFormat() returns, as libsndfile formats */
+
+static const struct {
+    const char  *name;
+    int         format;
+} seg_types[] = {
+    { "wav",   SF_FORMAT_WAV   },  { "aiff",  SF_FORMAT_AIFF  },
+    { "au",    SF_FORMAT_AU    },  { "raw",   SF_FORMAT_RAW   },
+    { "paf",   SF_FORMAT_PAF   },  { "svx",   SF_FORMAT_SVX   },
+    { "nist",  SF_FORMAT_NIST  },  { "voc",   SF_FORMAT_VOC   },
+    { "ircam", SF_FORMAT_IRCAM },  { "w64",   SF_FORMAT_W64   },
+    { "mat4",  SF_FORMAT_MAT4  },  { "mat5",  SF_FORMAT_MAT5  },
+    { "pvf",   SF_FORMAT_PVF   },  { "xi",    SF_FORMAT_XI    },
+    { "htk",   SF_FORMAT_HTK   },  { "sds",   SF_FORMAT_SDS   },
+    { "avr",   SF_FORMAT_AVR   },  { "wavex", SF_FORMAT_WAVEX },
+    { "sd2",   SF_FORMAT_SD2   },  { "flac",  SF_FORMAT_FLAC  },
+    { "caf",   SF_FORMAT_CAF   },  { "wve",   SF_FORMAT_WVE   },
+    { "ogg",   SF_FORMAT_OGG   },  { "mpc2k", SF_FORMAT_MPC2K },
+    { "rf64",  SF_FORMAT_RF64  },  { NULL,    0               }
+}, seg_encodings[] = {
+    { "alaw",  SF_FORMAT_ALAW   }, { "schar",  SF_FORMAT_PCM_S8 },
+    { "uchar", SF_FORMAT_PCM_U8 }, { "float",  SF_FORMAT_FLOAT  },
+    { "double", SF_FORMAT_DOUBLE }, { "long",  SF_FORMAT_PCM_32 },
+    { "short", SF_FORMAT_PCM_16 }, { "ulaw",   SF_FORMAT_ULAW   },
+    { "24bit", SF_FORMAT_PCM_24 }, { "vorbis", SF_FORMAT_VORBIS },
+    { NULL,    0                }
+};
+
+/* compile the orchestra once to find sr, nchnls and the output file and
+   format the options ask for, then open that file */
+
+static int seg_open_output(SEGMENTS *seg, const char *outfile)
+{
+    CSOUND      *csound = csoundCreate(NULL);
+    SF_INFO     sfinfo;
+    char        type[16], encoding[16], *name = NULL;
+    int         i, major = SF_FORMAT_WAV, minor = SF_FORMAT_PCM_16;
+    double      dbfs;
+
+    /* without the trailing -n */
+    if (csoundCompileArgs(csound, seg->argc - 1, seg->argv) != 0) {
+      csoundDestroy(csound);
+      return -1;
+    }
+    seg->sr = (double) csoundGetSr(csound);
+    seg->nchnls = (int) csoundGetNchnls(csound);
+    dbfs = (double) csoundGet0dBFS(csound);
+    csoundGetOutputFormat(csound, type, encoding);
+    if (outfile == NULL)
+      outfile = csoundGetOutputName(csound);
+    if (outfile != NULL)
+      name = strdup(outfile);
+    csoundDestroy(csound);
+
+    if (name == NULL || strncmp(name, "dac", 3) == 0 ||
+        strcmp(name, "stdout") == 0 || strcmp(name, "null") == 0 ||
+        name[0] == '|') {
+      fprintf(stderr, "segments: a sound file is needed for the output, "
+                      "use -o FNAME\n");
+      free(name);
+      return -1;
+    }
+    for (i = 0; seg_types[i].name != NULL; i++)
+      if (strcmp(type, seg_types[i].name) == 0)
+        major = seg_types[i].format;
+    for (i = 0; seg_encodings[i].name != NULL; i++)
+      if (strcmp(encoding, seg_encodings[i].name) == 0)
+        minor = seg_encodings[i].format;
+    /* as sfopenout(): float samples are normalised to 0dBFS in WAV, AIFF
+       and W64 files, and written as they are in anything else */
+    seg->scale = 1.0f;
+    if ((minor == SF_FORMAT_FLOAT || minor == SF_FORMAT_DOUBLE) &&
+        major != SF_FORMAT_WAV && major != SF_FORMAT_AIFF &&
+        major != SF_FORMAT_W64)
+      seg->scale = (float) dbfs;
+
+    memset(&sfinfo, 0, sizeof(SF_INFO));
+    sfinfo.samplerate = (int) (seg->sr + 0.5);
+    sfinfo.channels = seg->nchnls;
+    sfinfo.format = major | minor;
+    if ((seg->out = sf_open(name, SFM_WRITE, &sfinfo)) == NULL) {
+      fprintf(stderr, "Error opening output file '%s': %s\n",
+                      name, sf_strerror(NULL));
+      free(name);
+      return -1;
+    }
+    if (minor != SF_FORMAT_FLOAT && minor != SF_FORMAT_DOUBLE)
+      sf_command(seg->out, SFC_SET_CLIPPING, NULL, SF_TRUE);
+    fprintf(stderr, "segments: writing %s (%s, %s)\n", name,
+            (type[0] != '\0' ? type : "wav"),
+            (encoding[0] != '\0' ? encoding : "short"));
+    seg->outname = name;
+    return 0;
+}
+
+static int segments_main(const char *bounds, double tail, int nworkers,
+                         const char *outfile, int verify,
+                         int argc, char **argv)
+{
+    SEGMENTS    seg;
+    SEG_JOB     whole;
+    void        **threads;
+    RTCLOCK     clk;
+    double      t[SEG_MAXBOUNDS], total, cpu = 0.0;
+    const char  *s = bounds;
+    char        *end;
+    int64_t     i;
+    int         nbounds = 0, nfailed = 0;
+
+    while (*s != '\0' && nbounds < SEG_MAXBOUNDS) {
+      t[nbounds] = strtod(s, &end);
+      if (end == s || t[nbounds] <= (nbounds ? t[nbounds - 1] : 0.0)) {
+        fprintf(stderr, "segments: bad segment times '%s'\n", bounds);
+        return -1;
+      }
+      nbounds++;
+      s = (*end == ',' ? end + 1 : end);
+      if (*end != ',' && *end != '\0') {
+        fprintf(stderr, "segments: bad segment times '%s'\n", bounds);
+        return -1;
+      }
+    }
+    memset(&seg, 0, sizeof(SEGMENTS));
+    seg.tail = (tail > 0.0 ? tail : 0.0);
+    seg.firstdiff = -1;
+    /* pass everything but our own options on, and render to memory only */
+    seg.argv = (const char**) calloc((size_t) argc + 2, sizeof(char*));
+    seg.argv[seg.argc++] = argv[0];
+    for (i = 1; i < argc; i++) {
+      if (strncmp(argv[i], "--segment", 9) == 0 ||
+          strncmp(argv[i], "--logfile=", 10) == 0 ||
+          (strncmp(argv[i], "-O", 2) == 0 && argv[i][2] != '\0'))
+        continue;
+      if (strcmp(argv[i], "-O") == 0) {
+        i++;
+        continue;
+      }
+      seg.argv[seg.argc++] = argv[i];
+    }
+    seg.argv[seg.argc++] = "-n";
+    if (seg_open_output(&seg, outfile) != 0) {
+      free(seg.argv);
+      return -1;
+    }
+    seg.njobs = nbounds + 1;
+    seg.jobs = (SEG_JOB*) calloc((size_t) seg.njobs, sizeof(SEG_JOB));
+    for (i = 0; i < seg.njobs; i++) {
+      seg.jobs[i].start = (i ? t[i - 1] : 0.0);
+      seg.jobs[i].end = (i < nbounds ? t[i] : -1.0);
+      seg.jobs[i].offset = (int64_t) (seg.jobs[i].start * seg.sr + 0.5);
+    }
+    seg.mix = (float*) malloc((size_t) (SEG_BLOCK * seg.nchnls)
+                              * sizeof(float));
+    if (verify) {
+      /* the reference is compared with the output as it is written */
+      memset(&whole, 0, sizeof(SEG_JOB));
+      whole.end = -1.0;
+      seg_render(&seg, &whole);
+      fprintf(stderr, "segments: sequential render took %.3f s\n",
+              whole.elapsed);
+      if (whole.result != 0)
+        seg.failed = 1;
+      seg.whole = &whole;
+    }
+    if (nworkers < 1)
+      nworkers = 1;
+    if (nworkers > seg.njobs)
+      nworkers = seg.njobs;
+    seg.lock = csoundCreateMutex(0);
+    seg.wlock = csoundCreateMutex(0);
+    threads = (void**) calloc((size_t) nworkers, sizeof(void*));
+
+    csoundInitTimerStruct(&clk);
+    if (!seg.failed) {
+      for (i = 1; i < nworkers; i++)
+        threads[i] = csoundCreateThread(seg_worker, &seg);
+      seg_worker(&seg);
+      for (i = 1; i < nworkers; i++)
+        if (threads[i] != NULL)
+          csoundJoinThread(threads[i]);
+      seg_worker(&seg);                 /* in case a thread failed to start */
+    }
+    total = csoundGetRealTime(&clk);
+
+    for (i = 0; i < seg.njobs; i++) {
+      SEG_JOB *job = &(seg.jobs[i]);
+      cpu += job->elapsed;
+      if (job->result != 0)
+        nfailed++;
+      free(job->buf);
+    }
+    fprintf(stderr, "segments: %d segments (%d failed) on %d workers in "
+                    "%.3f s (%.3f s rendering, x%.2f)\n",
+            seg.njobs, nfailed, nworkers, total, cpu,
+            (total > 0.0 ? cpu / total : 0.0));
+    if (seg.failed && !nfailed)
+      nfailed++;
+
+    if (verify && !nfailed) {
+      /* anything the single pass render has beyond the end of ours */
+      for (i = seg.written * seg.nchnls;
+           i < whole.nframes * seg.nchnls; i++) {
+        double d = fabs((double) whole.buf[i]);
+        if (d > seg.maxdiff)
+          seg.maxdiff = d;
+        if (d > 1.0e-5 && seg.firstdiff < 0)
+          seg.firstdiff = i / seg.nchnls;
+      }
+      if (seg.firstdiff >= 0) {
+        fprintf(stderr, "segments: verify FAILED: output differs from "
+                        "%.6f s (max difference %g)\n",
+                (double) seg.firstdiff / seg.sr, seg.maxdiff);
+        nfailed++;
+      }
+      else
+        fprintf(stderr, "segments: verify ok (max difference %g)\n",
+                seg.maxdiff);
+    }
+    if (verify)
+      free(whole.buf);
+    if (sf_close(seg.out) != 0)
+      nfailed++;
+    if (nfailed)                        /* do not leave a partial render */
+      remove(seg.outname);
+    free(seg.outname);
+
+    csoundDestroyMutex(seg.wlock);
+    csoundDestroyMutex(seg.lock);
+    free(seg.mix);
+    free(threads);
+    free(seg.argv);
+    free(seg.jobs);
+    return (nfailed ? -1 : 0);
+}
+
 int main(int argc, char **argv)
 {
     CSOUND  *csound;
-    char    *fname = NULL;
-    int     i, result, nomessages=0;
+    char    *fname = NULL, *batchfile = NULL, *segments = NULL, *segout = NULL;
+    int     i, result, nomessages=0, batchjobs = 1, segverify = 0;
+    double  segtail = 0.0;
 #ifdef GNU_GETTEXT
     const char* lang;
 #endif
@@ -300,6 +1006,21 @@ int main(int argc, char **argv)
         fname = argv[i] + 10;
       else if (i < (argc - 1) && strcmp(argv[i], "-O") == 0)
         fname = argv[i + 1];
+      else if (strncmp(argv[i], "--batch=", 8) == 0 &&
+               (int) strlen(argv[i]) > 8)
+        batchfile = argv[i] + 8;
+      else if (strncmp(argv[i], "--batch-jobs=", 13) == 0)
+        batchjobs = atoi(argv[i] + 13);
+      else if (strncmp(argv[i], "--segments=", 11) == 0)
+        segments = argv[i] + 11;
+      else if (strncmp(argv[i], "--segment-tail=", 15) == 0)
+        segtail = atof(argv[i] + 15);
+      else if (strncmp(argv[i], "--segment-jobs=", 15) == 0)
+        batchjobs = atoi(argv[i] + 15);
+      else if (strncmp(argv[i], "--segment-output=", 17) == 0)
+        segout = argv[i] + 17;
+      else if (strcmp(argv[i], "--segment-verify") == 0)
+        segverify = 1;
     }
     if (fname != NULL) {
       if (!strcmp(fname, "NULL") || !strcmp(fname, "null"))
@@ -313,9 +1034,20 @@ int main(int argc, char **argv)
     /* if logging to file, set message callback */
     if (logFile != NULL)
       csoundSetDefaultMessageCallback(msg_callback);
-    else if (nomessages)
+    else if (nomessages || batchfile != NULL || segments != NULL)
       csoundSetDefaultMessageCallback(nomsg_callback);
 
+    if (batchfile != NULL || segments != NULL) {
+      if (batchfile != NULL)
+        result = batch_main(batchfile, batchjobs, argc, argv);
+      else
+        result = segments_main(segments, segtail, batchjobs, segout,
+                               segverify, argc, argv);
+      if (logFile != NULL)
+        fclose(logFile);
+      return result;
+    }
+
     /*  Create Csound. */
     csound = csoundCreate(NULL);
     _csound = csound;
@@ -323,7 +1055,8 @@ int main(int argc, char **argv)
     /*  One complete performance cycle. */
     result = csoundCompile(csound, argc, (const char **)argv);
 
-     if(!result) csoundPerform(csound);
+    /*  A performance ended by exitnow with a negative value fails. */
+     if(!result) result = csoundPerform(csound);
 
     /* delete Csound instance */
      csoundDestroy(csound);
@@ -33,6 +33,10 @@
  * variable OPCODE6DIR (or the current directory if OPCODE6DIR is unset) by   *
  * csoundPreCompile() while initialising a Csound instance, and are unloaded  *
  * at the end of performance by csoundReset().                                *
+ * If OPCODE6MANIFEST names a file, it is used as a cache of the opcode and   *
+ * GEN names each library registers, and libraries are only loaded when one  *
+ * of their names is first used. The file is rebuilt by loading all plugins  *
+ * whenever the plugin directories have changed.                              *
  * A library may export any of the following five interface functions,        *
  * however, the presence of csoundModuleCreate() is required for identifying  *
  * the file as a Csound plugin module.                                        *
@@ -103,6 +107,21 @@ extern "C" {
    */
   int csoundDestroyModules(CSOUND *csound);
 
+  /**
+   * Load and initialise the plugin libraries deferred by the plugin
+   * manifest (see OPCODE6MANIFEST) that register the opcode (gen == 0)
+   * or named GEN (gen != 0) 'name', or all deferred libraries if 'name'
+   * is NULL. Returns the number of libraries loaded, which is always zero
+   * when no manifest is in use.
+   */
+  int csoundLoadLazyPlugins(CSOUND *csound, const char *name, int gen);
+
+  /**
+   * Called when an opcode or named GEN is registered, so that the plugin
+   * manifest can record which library provides it while it is rebuilt.
+   */
+  void csoundPluginManifestRecord(CSOUND *csound, const char *name, int gen);
+
   /**
    * Initialise opcodes not in entry1.c
    */
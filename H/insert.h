@@ -57,10 +57,28 @@ typedef struct {
 /* the number of optional outputs defined in entry.c */
 #define SUBINSTNUMOUTS  8
 
+/* kinds of perf-time UDO argument copies */
+enum {
+    UDOARG_SCALAR = 0,          /* one MYFLT (k-rate) */
+    UDOARG_ASIG,                /* a-rate buffer, or a merged range of them */
+    UDOARG_ASIG_ARRAY,          /* a-rate array at a local ksmps */
+    UDOARG_VALUE                /* anything else, through its copyValue */
+};
+
+/* one step of a UDO call's perf-time argument copy; built by useropcdset */
+typedef struct {
+    MYFLT   *src, *dst;
+    int     size;               /* MYFLTs copied for UDOARG_ASIG */
+    int     kind;
+    const CS_TYPE *type;
+} UDO_ARGCOPY;
+
 typedef struct {
     OPCODINFO *opcode_info;
     void    *uopcode_struct;
     INSDS   *parent_ip;
+    UDO_ARGCOPY *inplan, *outplan; /* stored after iobufp_ptrs */
+    int     ninplan, noutplan;
     MYFLT   *iobufp_ptrs[12];  /* expandable IV - Oct 26 2002 */ /* was 8 */
 } OPCOD_IOBUFS;
 
@@ -0,0 +1,107 @@
+/*
+    profile.h:
+
+    Copyright (C) 2026 The Csound Core Developers
+
+    This file is part of Csound.
+
+    The Csound Library is free software; you can redistribute it
+    and/or modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    Csound is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with Csound; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+    02110-1301 USA
+*/
+
+#ifndef CSOUND_PROFILE_H
+#define CSOUND_PROFILE_H
+
+#if !defined(__BUILDING_LIBCSOUND)
+#  error "Csound plugins and host applications should not include profile.h"
+#endif
+
+#if defined(_MSC_VER)
+#  include <intrin.h>
+#elif !defined(__i386__) && !defined(__x86_64__) && !defined(__aarch64__)
+#  include <time.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+  /* Free running tick counter used to time opcodes. The unit is
+     whatever the cycle counter runs at; it is calibrated against the
+     real time clock when a report is made. */
+  static inline uint64_t csoundProfileTicks(void)
+  {
+#if defined(_MSC_VER)
+    return (uint64_t) __rdtsc();
+#elif defined(__i386__) || defined(__x86_64__)
+    uint32_t  l, h;
+    __asm__ volatile ("rdtsc" : "=a" (l), "=d" (h));
+    return ((uint64_t) l | ((uint64_t) h << 32));
+#elif defined(__aarch64__)
+    uint64_t  t;
+    __asm__ volatile ("mrs %0, cntvct_el0" : "=r" (t));
+    return t;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec * 1000000000U + (uint64_t) ts.tv_nsec);
+#endif
+  }
+
+  /* Count a control cycle; called by kperf before any instrument runs. */
+  void csoundProfileKcycle(CSOUND *csound);
+
+  /* Run the perf function of 'op' on behalf of performance thread
+     'thread' (0 is the main thread) and charge the time to its source
+     line. Returns what the perf function returned. */
+  int csoundProfileOpcode(CSOUND *csound, OPDS *op, int thread);
+
+  /* Charge the time since 'start' to the perf chain of instance 'ip'. */
+  void csoundProfileInstr(CSOUND *csound, INSDS *ip, int thread,
+                          uint64_t start);
+
+  /* Points in a k-cycle at which csoundTimingMark() is called. The time
+     since the previous point is charged to the stage that just ended. */
+  enum {
+    CS_MARK_START,          /* about to call sensevents() */
+    CS_MARK_SENSEVENTS,
+    CS_MARK_MESSAGES,
+    CS_MARK_DAG,
+    CS_MARK_PERF,
+    CS_MARK_SPOUTRAN,       /* end of the k-cycle */
+    CS_MARK_COUNT
+  };
+
+  void csoundTimingMark(CSOUND *csound, int mark);
+  /* Monotonic clock in seconds, for csoundTimingBuffer(). */
+  double csoundTimingNow(void);
+  /* Record a csoundPerformBuffer() call that started at 'start'. */
+  void csoundTimingBuffer(CSOUND *csound, double start);
+
+#define CS_TIMING_MARK(csound, mark)                                    \
+  do {                                                                  \
+    if (UNLIKELY((csound)->timing)) csoundTimingMark(csound, mark);     \
+  } while (0)
+
+  /* Run an opcode's perf function, timing it when profiling is on. */
+#define CS_PERF_OPCODE(csound, op, thread)                              \
+  (UNLIKELY((csound)->profiling) ?                                      \
+   csoundProfileOpcode(csound, op, thread) : (*(op)->opadr)(csound, op))
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* CSOUND_PROFILE_H */
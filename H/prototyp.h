@@ -41,6 +41,8 @@ void    mfreeDebug(CSOUND *, void *, char*, int);
 char    *cs_strdup(CSOUND*, char*);
 char    *cs_strndup(CSOUND*, char*, size_t);
 void    csoundAuxAlloc(CSOUND *, size_t, AUXCH *), auxchfree(CSOUND *, INSDS *);
+void    auxcachefree(CSOUND *, INSTRTXT *);
+MYFLT   *csoundArrayReserve(CSOUND *, ARRAYDAT *, size_t);
 int     csoundAuxAllocAsync(CSOUND *, size_t , AUXCH *,
                             AUXASYNC *, aux_cb , void *);
 void    fdrecord(CSOUND *, FDCH *), fd_close(CSOUND *, FDCH *);
@@ -85,12 +87,17 @@ void    remove_tmpfiles(CSOUND *);
 void    add_tmpfile(CSOUND *, char *);
 void    xturnoff(CSOUND *, INSDS *);
 void    xturnoff_now(CSOUND *, INSDS *);
+void    xturnoff_fast(CSOUND *, INSDS *, int);
 int     insert_score_event(CSOUND *, EVTBLK *, double);
+struct _alloc_data_ *alloc_queue_claim(CSOUND *);
+void    alloc_queue_publish(CSOUND *, struct _alloc_data_ *);
+void    event_insert_wake(CSOUND *);
 //MEMFIL  *ldmemfile(CSOUND *, const char *);
 //MEMFIL  *ldmemfile2(CSOUND *, const char *, int);
 MEMFIL  *ldmemfile2withCB(CSOUND *csound, const char *filnam, int csFileType,
                           int (*callback)(CSOUND*, MEMFIL*));
 void    rlsmemfiles(CSOUND *);
+void    rlspvxmemfiles(CSOUND *);
 int     delete_memfile(CSOUND *, const char *);
 char    *csoundTmpFileName(CSOUND *, const char *);
 void    *SAsndgetset(CSOUND *, char *, void *, MYFLT *, MYFLT *, MYFLT *, int);
@@ -100,6 +107,8 @@ void    dbfs_init(CSOUND *, MYFLT dbfs);
 int     csoundLoadExternals(CSOUND *);
 SNDMEMFILE  *csoundLoadSoundFile(CSOUND *, const char *name, void *sfinfo);
 int     PVOCEX_LoadFile(CSOUND *, const char *fname, PVOCEX_MEMFILE *p);
+void    *csoundMapFile(const char *path, size_t *len);
+void    csoundUnmapFile(const void *addr);
 void    print_opcodedir_warning(CSOUND *);
 int     check_rtaudio_name(char *fName, char **devName, int isOutput);
 int     csoundLoadOpcodeDB(CSOUND *, const char *);
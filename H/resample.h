@@ -0,0 +1,65 @@
+/*
+    resample.h:
+
+    Copyright (C) 2026 The Csound Core Developers
+
+    This file is part of Csound.
+
+    The Csound Library is free software; you can redistribute it
+    and/or modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    Csound is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with Csound; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+    02110-1301 USA
+*/
+
+#ifndef CSOUND_RESAMPLE_H
+#define CSOUND_RESAMPLE_H
+
+#if !defined(__BUILDING_LIBCSOUND)
+#  error "Csound plugins and host applications should not include resample.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+  /**
+   * Create a polyphase sample rate converter from 'inrate' to 'outrate'
+   * for 'chans' interleaved channels. 'quality' ranges from 1 to 8
+   * (default 2) and sets the filter length and stopband attenuation.
+   * The filter bank is computed once here; rates in a small integer
+   * ratio use exact phases, others interpolate between 1024 phases.
+   * Returns NULL on bad arguments.
+   */
+  void *csoundResampleSetup(CSOUND *csound, MYFLT inrate, MYFLT outrate,
+                            int32_t chans, int32_t quality);
+
+  /**
+   * Push 'inframes' interleaved frames from 'in' into the converter and
+   * write at most 'maxout' converted frames to 'out', returning the number
+   * written. Input that cannot be converted yet is kept, so calling again
+   * with inframes = 0 drains it. Passing in = NULL marks the end of the
+   * input and flushes the filter delay.
+   */
+  int32_t csoundResample(CSOUND *csound, void *p, const MYFLT *in,
+                         int32_t inframes, MYFLT *out, int32_t maxout);
+
+  /**
+   * Free a converter created by csoundResampleSetup().
+   */
+  void csoundResampleDestroy(CSOUND *csound, void *p);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* CSOUND_RESAMPLE_H */
@@ -0,0 +1,97 @@
+/*
+    voices.h:
+
+    Copyright (C) 2026 The Csound Core Developers
+
+    This file is part of Csound.
+
+    The Csound Library is free software; you can redistribute it
+    and/or modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    Csound is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with Csound; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+    02110-1301 USA
+*/
+
+#ifndef CSOUND_VOICES_H
+#define CSOUND_VOICES_H
+
+#if !defined(__BUILDING_LIBCSOUND)
+#  error "Csound plugins and host applications should not include voices.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+  /* INSTRTXT.vsteal: what to do with a note that would exceed maxalloc */
+  enum {
+    VOICE_REFUSE,           /* drop the new note (the default) */
+    VOICE_OLDEST,           /* fast release the oldest voice */
+    VOICE_QUIETEST          /* fast release the quietest voice */
+  };
+
+  /* INSTRTXT.vsleep: what to do with a voice that has gone silent, and
+     INSDS.vsleep: what has been done with it */
+  enum {
+    VOICE_AWAKE,            /* nothing (the default) */
+    VOICE_SLEEP,            /* skip its perf chain until woken */
+    VOICE_TURNOFF           /* turn it off */
+  };
+
+  /* INSDS.vflags */
+#define VOICE_LEVEL     (1)     /* measure the output level each k-cycle */
+#define VOICE_FADE      (2)     /* fading out after being stolen or shed */
+
+  /* Called by insert for every new note of an instrument that has voice
+     stealing or sleeping set up. */
+  void csoundVoiceStart(CSOUND *csound, INSTRTXT *tp, INSDS *ip);
+  /* Free a voice of 'tp' for a new note, if its policy allows it.
+     Returns non-zero if one was released. */
+  int csoundVoiceSteal(CSOUND *csound, INSTRTXT *tp);
+  /* Non-zero if new notes of 'tp' are to be dropped because the engine
+     is overloaded. */
+  int csoundVoiceShed(CSOUND *csound, INSTRTXT *tp);
+  /* Fade 'ip' out over 'secs' seconds (a few k-cycles if not positive)
+     and turn it off. */
+  void csoundVoiceRelease(CSOUND *csound, INSDS *ip, MYFLT secs);
+  /* Called by kperf after the perf pass, with the time it took. Turns
+     off silent voices and sheds load. */
+  void csoundVoiceKcycle(CSOUND *csound, double secs);
+  /* Non-zero if sleeping instance 'ip' is to stay asleep this k-cycle. */
+  int csoundVoiceAsleep(CSOUND *csound, INSDS *ip);
+  /* Set from the orchestra by loadshed. */
+  void csoundVoiceSetShedding(CSOUND *csound, MYFLT threshold,
+                              int priority, MYFLT release);
+
+  /* An instance with vflags set performs into a scratch buffer of the
+     performance thread, which is mixed into spout when its perf chain
+     is done. */
+  MYFLT *csoundVoiceSpout(CSOUND *csound, INSDS *ip, int thread);
+  void csoundVoiceMix(CSOUND *csound, INSDS *ip, int thread);
+
+#define CS_VOICE_SPOUT(csound, ip, thread)                              \
+  (UNLIKELY((ip)->vflags) ?                                             \
+   csoundVoiceSpout(csound, ip, thread) : (csound)->spraw)
+
+#define CS_VOICE_ASLEEP(csound, ip)                                     \
+  (UNLIKELY((ip)->vsleep == VOICE_SLEEP) && csoundVoiceAsleep(csound, ip))
+
+#define CS_VOICE_MIX(csound, ip, thread)                                \
+  do {                                                                  \
+    if (UNLIKELY((ip)->vflags)) csoundVoiceMix(csound, ip, thread);     \
+  } while (0)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* CSOUND_VOICES_H */
@@ -2232,7 +2232,7 @@ int32_t outRange(CSOUND *csound, OUTRANGE *p)
     //int32_t nchnls = csound->GetNchnls(csound);
     MYFLT *ara[VARGMAX];
     int32_t startChan = (int32_t) *p->kstartChan -1;
-    MYFLT *sp = csound->spraw + startChan*nsmps;
+    MYFLT *sp = CS_SPOUT + startChan*nsmps;
     int32_t narg = p->narg;
 
     if (UNLIKELY(startChan < 0))
@@ -2244,7 +2244,7 @@ int32_t outRange(CSOUND *csound, OUTRANGE *p)
       ara[j] = p->argums[j];
 
     if (!csound->spoutactive) {
-      memset(csound->spraw, '\0', csound->nspout * sizeof(MYFLT));
+      memset(CS_SPOUT, '\0', csound->nspout * sizeof(MYFLT));
       /* no need to offset ?? why ?? */
       int32_t i;
       for (i=0; i < narg; i++) {
@@ -129,14 +129,13 @@ int32_t reinit(CSOUND *csound, GOTO *p)
       csound->reinitflag = p->h.insdshead->reinitflag = 0;
     }
     else {
-      uint64_t wp = csound->alloc_queue_wp;
+      ALLOC_DATA *item = alloc_queue_claim(csound);
       ATOMIC_SET(p->h.insdshead->init_done, 0);
       ATOMIC_SET8(p->h.insdshead->actflg, 0);
-      csound->alloc_queue[wp].ip = p->h.insdshead;
-      csound->alloc_queue[wp].ids = p->lblblk->prvi;
-      csound->alloc_queue[wp].type = 3;
-      csound->alloc_queue_wp = wp + 1 < MAX_ALLOC_QUEUE ? wp + 1 : 0;
-      ATOMIC_INCR(csound->alloc_queue_items);
+      item->ip = p->h.insdshead;
+      item->ids = p->lblblk->prvi;
+      item->type = 3;
+      alloc_queue_publish(csound, item);
       return NOTOK;
     }
     return OK;
@@ -1022,3 +1022,18 @@ int32_t pvoc_framecount(CSOUND *csound, int32_t ifd)
     }
     return p->nFrames;
 }
+
+/* return byte offset of the data chunk, and the resolved file name,
+   so that callers may map native-endian frames directly */
+
+int32_t pvoc_datachunk(CSOUND *csound, int32_t ifd, const char **path)
+{
+    PVOCFILE  *p = pvsys_getFileHandle(csound, ifd);
+    if (UNLIKELY(p == NULL || p->fd == NULL)) {
+      csound->pvErrorCode = -38;
+      return -1;
+    }
+    if (path != NULL)
+      *path = csound->GetFileName(p->fd);
+    return p->datachunkoffset;
+}
@@ -0,0 +1,317 @@
+/*
+    resample.c:
+
+    Copyright (C) 2026 The Csound Core Developers
+
+    This file is part of Csound.
+
+    The Csound Library is free software; you can redistribute it
+    and/or modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    Csound is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with Csound; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+    02110-1301 USA
+*/
+
+/* Polyphase sample rate conversion.
+
+   The prototype lowpass is a Kaiser-windowed sinc with its cutoff at the
+   lower of the two Nyquist frequencies. It is sampled into a bank of
+   'nphases' sub-filters of 'taps' coefficients each, so every output
+   sample is a single inner product against the input history of one
+   channel. For rates in a small integer ratio L/M the bank holds exactly
+   L phases and the position is stepped in integers; otherwise the bank
+   holds RESAMPLE_PHASES phases and adjacent phases are interpolated.
+   Channels are kept de-interleaved so the inner products run over
+   contiguous memory, using AVX or SSE2 when the compiler targets them. */
+
+#include "csoundCore.h"
+#include "resample.h"
+#include <math.h>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define RESAMPLE_PHASES   1024      /* bank size for non-rational ratios */
+#define RESAMPLE_MAXL     1024      /* largest exact L in L/M */
+#define RESAMPLE_ALIGN    8         /* taps are padded to a multiple of this */
+#define RESAMPLE_BLOCK    4096      /* initial history size per channel */
+
+typedef struct {
+    MYFLT       *bank;          /* (nphases + 1) * taps coefficients */
+    MYFLT       *hist;          /* chans * cap de-interleaved input */
+    int32_t     chans, taps, half, nphases;
+    int32_t     L, M;           /* exact ratio, or L = 0 if interpolating */
+    double      step;           /* inrate / outrate */
+    int64_t     n;              /* integer input position of next output */
+    int32_t     phase;          /* exact mode: phase of next output, < L */
+    double      frac;           /* interpolating mode: fraction of n */
+    int64_t     first;          /* input index of hist[0] */
+    int32_t     nbuf, cap;      /* frames held and allocated */
+    int32_t     flushed;
+} RESAMPLER;
+
+static double resample_i0(double x)
+{
+    double  y = x * 0.5, e = 1.0, de = 1.0, sde;
+    int32_t i;
+
+    for (i = 1; i <= 32; i++) {
+      de = de * y / (double) i;
+      sde = de * de;
+      e += sde;
+      if (e * 1.0e-10 > sde)
+        break;
+    }
+    return e;
+}
+
+static int64_t resample_gcd(int64_t a, int64_t b)
+{
+    while (b != 0) {
+      int64_t t = a % b;
+      a = b;
+      b = t;
+    }
+    return a;
+}
+
+static inline MYFLT resample_dot(const MYFLT *x, const MYFLT *h, int32_t n)
+{
+    int32_t i = 0;
+#if defined(__AVX__) && defined(USE_DOUBLE)
+    __m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+    double  t[4];
+    for (; i < n; i += 8) {
+      acc0 = _mm256_add_pd(acc0, _mm256_mul_pd(_mm256_loadu_pd(x + i),
+                                               _mm256_loadu_pd(h + i)));
+      acc1 = _mm256_add_pd(acc1, _mm256_mul_pd(_mm256_loadu_pd(x + i + 4),
+                                               _mm256_loadu_pd(h + i + 4)));
+    }
+    _mm256_storeu_pd(t, _mm256_add_pd(acc0, acc1));
+    return (t[0] + t[1]) + (t[2] + t[3]);
+#elif defined(__AVX__)
+    __m256  acc = _mm256_setzero_ps();
+    float   t[8];
+    for (; i < n; i += 8)
+      acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(x + i),
+                                             _mm256_loadu_ps(h + i)));
+    _mm256_storeu_ps(t, acc);
+    return ((t[0] + t[1]) + (t[2] + t[3])) + ((t[4] + t[5]) + (t[6] + t[7]));
+#elif defined(__SSE2__) && defined(USE_DOUBLE)
+    __m128d acc0 = _mm_setzero_pd(), acc1 = _mm_setzero_pd();
+    __m128d acc2 = _mm_setzero_pd(), acc3 = _mm_setzero_pd();
+    double  t[2];
+    for (; i < n; i += 8) {
+      acc0 = _mm_add_pd(acc0, _mm_mul_pd(_mm_loadu_pd(x + i),
+                                         _mm_loadu_pd(h + i)));
+      acc1 = _mm_add_pd(acc1, _mm_mul_pd(_mm_loadu_pd(x + i + 2),
+                                         _mm_loadu_pd(h + i + 2)));
+      acc2 = _mm_add_pd(acc2, _mm_mul_pd(_mm_loadu_pd(x + i + 4),
+                                         _mm_loadu_pd(h + i + 4)));
+      acc3 = _mm_add_pd(acc3, _mm_mul_pd(_mm_loadu_pd(x + i + 6),
+                                         _mm_loadu_pd(h + i + 6)));
+    }
+    _mm_storeu_pd(t, _mm_add_pd(_mm_add_pd(acc0, acc1), _mm_add_pd(acc2, acc3)));
+    return t[0] + t[1];
+#elif defined(__SSE2__)
+    __m128  acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+    float   t[4];
+    for (; i < n; i += 8) {
+      acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(x + i),
+                                         _mm_loadu_ps(h + i)));
+      acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(x + i + 4),
+                                         _mm_loadu_ps(h + i + 4)));
+    }
+    _mm_storeu_ps(t, _mm_add_ps(acc0, acc1));
+    return (t[0] + t[1]) + (t[2] + t[3]);
+#else
+    MYFLT   a0 = FL(0.0), a1 = FL(0.0), a2 = FL(0.0), a3 = FL(0.0);
+    for (; i < n; i += 4) {
+      a0 += x[i] * h[i];
+      a1 += x[i + 1] * h[i + 1];
+      a2 += x[i + 2] * h[i + 2];
+      a3 += x[i + 3] * h[i + 3];
+    }
+    return (a0 + a1) + (a2 + a3);
+#endif
+}
+
+void *csoundResampleSetup(CSOUND *csound, MYFLT inrate, MYFLT outrate,
+                          int32_t chans, int32_t quality)
+{
+    RESAMPLER   *p;
+    double      cutoff, beta, halfwidth, i0beta;
+    int32_t     ph, j, zc;
+
+    if (UNLIKELY(inrate <= FL(0.0) || outrate <= FL(0.0) || chans < 1))
+      return NULL;
+    if (quality < 1 || quality > 8)
+      quality = 2;
+    p = (RESAMPLER*) csound->Calloc(csound, sizeof(RESAMPLER));
+    p->chans = chans;
+    p->step = (double) inrate / (double) outrate;
+    /* exact phases when both rates are integers in a manageable ratio */
+    if ((double) inrate == floor((double) inrate) &&
+        (double) outrate == floor((double) outrate)) {
+      int64_t g = resample_gcd((int64_t) inrate, (int64_t) outrate);
+      if ((int64_t) outrate / g <= RESAMPLE_MAXL) {
+        p->L = (int32_t) ((int64_t) outrate / g);
+        p->M = (int32_t) ((int64_t) inrate / g);
+      }
+    }
+    p->nphases = (p->L ? p->L : RESAMPLE_PHASES);
+
+    /* cutoff in input-sample units, with a little room for the transition */
+    cutoff = (p->step > 1.0 ? 1.0 / p->step : 1.0) * (0.92 + 0.005 * quality);
+    zc = 8 * quality;                   /* zero crossings each side */
+    p->taps = (int32_t) ceil(2.0 * zc / cutoff);
+    p->taps = (p->taps + RESAMPLE_ALIGN - 1) & ~(RESAMPLE_ALIGN - 1);
+    p->half = p->taps / 2;
+    halfwidth = (double) p->half;
+    beta = 4.0 + 1.4 * quality;
+    i0beta = resample_i0(beta);
+
+    p->bank = (MYFLT*) csound->Malloc(csound, (size_t) (p->nphases + 1)
+                                      * p->taps * sizeof(MYFLT));
+    for (ph = 0; ph <= p->nphases; ph++) {
+      MYFLT *h = p->bank + (size_t) ph * p->taps;
+      for (j = 0; j < p->taps; j++) {
+        /* distance from output position to input n - half + 1 + j */
+        double t = (double) ph / p->nphases + (double) (p->half - 1 - j);
+        double r = t / halfwidth, w, s;
+        if (r <= -1.0 || r >= 1.0) {
+          h[j] = FL(0.0);
+          continue;
+        }
+        w = resample_i0(beta * sqrt(1.0 - r * r)) / i0beta;
+        s = (t == 0.0 ? cutoff : sin(PI * cutoff * t) / (PI * t));
+        h[j] = (MYFLT) (s * w);
+      }
+    }
+
+    p->cap = RESAMPLE_BLOCK + p->taps;
+    p->hist = (MYFLT*) csound->Calloc(csound, (size_t) p->cap * chans
+                                      * sizeof(MYFLT));
+    /* prime with silence so the first output is centred on input 0 */
+    p->nbuf = p->half - 1;
+    p->first = -(int64_t) (p->half - 1);
+    return (void*) p;
+}
+
+static void resample_append(CSOUND *csound, RESAMPLER *p,
+                            const MYFLT *in, int32_t nframes)
+{
+    int32_t c, i;
+
+    if (p->nbuf + nframes > p->cap) {
+      int32_t newcap = p->cap;
+      MYFLT   *hist;
+      while (p->nbuf + nframes > newcap)
+        newcap *= 2;
+      hist = (MYFLT*) csound->Calloc(csound, (size_t) newcap * p->chans
+                                     * sizeof(MYFLT));
+      for (c = 0; c < p->chans; c++)
+        memcpy(hist + (size_t) c * newcap, p->hist + (size_t) c * p->cap,
+               (size_t) p->nbuf * sizeof(MYFLT));
+      csound->Free(csound, p->hist);
+      p->hist = hist;
+      p->cap = newcap;
+    }
+    for (c = 0; c < p->chans; c++) {
+      MYFLT *dst = p->hist + (size_t) c * p->cap + p->nbuf;
+      if (in == NULL)
+        memset(dst, 0, (size_t) nframes * sizeof(MYFLT));
+      else if (p->chans == 1)
+        memcpy(dst, in, (size_t) nframes * sizeof(MYFLT));
+      else
+        for (i = 0; i < nframes; i++)
+          dst[i] = in[(size_t) i * p->chans + c];
+    }
+    p->nbuf += nframes;
+}
+
+int32_t csoundResample(CSOUND *csound, void *p_, const MYFLT *in,
+                       int32_t inframes, MYFLT *out, int32_t maxout)
+{
+    RESAMPLER   *p = (RESAMPLER*) p_;
+    int32_t     nout = 0, c, keep;
+    int64_t     base;
+
+    if (in == NULL) {
+      if (!p->flushed)
+        resample_append(csound, p, NULL, p->half);  /* trailing lookahead */
+      p->flushed = 1;
+    }
+    else if (inframes > 0)
+      resample_append(csound, p, in, inframes);
+
+    while (nout < maxout) {
+      /* input range n - half + 1 ... n + half must be present */
+      base = p->n - p->half + 1 - p->first;
+      if (base + p->taps > p->nbuf)
+        break;
+      if (p->L) {
+        const MYFLT *h = p->bank + (size_t) p->phase * p->taps;
+        for (c = 0; c < p->chans; c++)
+          out[c] = resample_dot(p->hist + (size_t) c * p->cap + base,
+                                h, p->taps);
+        p->phase += p->M;
+        p->n += p->phase / p->L;
+        p->phase %= p->L;
+      }
+      else {
+        double      fph = p->frac * p->nphases;
+        int32_t     ph = (int32_t) fph;
+        MYFLT       w = (MYFLT) (fph - ph);
+        const MYFLT *h0 = p->bank + (size_t) ph * p->taps;
+        const MYFLT *h1 = h0 + p->taps;
+        for (c = 0; c < p->chans; c++) {
+          const MYFLT *x = p->hist + (size_t) c * p->cap + base;
+          MYFLT y0 = resample_dot(x, h0, p->taps);
+          out[c] = y0 + w * (resample_dot(x, h1, p->taps) - y0);
+        }
+        p->frac += p->step;
+        p->n += (int64_t) p->frac;
+        p->frac -= floor(p->frac);
+      }
+      out += p->chans;
+      nout++;
+    }
+
+    /* discard history that no later output can reach */
+    keep = (int32_t) (p->n - p->half + 1 - p->first);
+    if (keep > p->nbuf)
+      keep = p->nbuf;
+    if (keep > 0) {
+      for (c = 0; c < p->chans; c++) {
+        MYFLT *h = p->hist + (size_t) c * p->cap;
+        memmove(h, h + keep, (size_t) (p->nbuf - keep) * sizeof(MYFLT));
+      }
+      p->nbuf -= keep;
+      p->first += keep;
+    }
+    return nout;
+}
+
+void csoundResampleDestroy(CSOUND *csound, void *p_)
+{
+    RESAMPLER   *p = (RESAMPLER*) p_;
+
+    if (p == NULL)
+      return;
+    csound->Free(csound, p->bank);
+    csound->Free(csound, p->hist);
+    csound->Free(csound, p);
+}
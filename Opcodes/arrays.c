@@ -2553,6 +2553,29 @@ static int32_t trim(CSOUND *csound, TRIM *p)
     return OK;
 }
 
+/* Set aside room for isize members at init time without changing the
+   array's length, so that later growth by trim, slicing or assignment
+   at k-rate does not allocate during performance. */
+static int32_t tabreserve(CSOUND *csound, TRIM *p)
+{
+    ARRAYDAT *tab = p->tab;
+    int32_t size = MYFLT2LRND(*p->size);
+
+    if (UNLIKELY(size < 0))
+      return csound->InitError(csound, "%s",
+                               Str("reservearray: size must be >= 0"));
+    if (tab->data == NULL) {
+      CS_VARIABLE* var = tab->arrayType->createVariable(csound, NULL);
+      tab->arrayMemberSize = var->memBlockSize;
+    }
+    csound->ArrayReserve(csound, tab, tab->arrayMemberSize*(size ? size : 1));
+    if (tab->dimensions == 0) {
+      tab->dimensions = 1;
+      tab->sizes = (int32_t*)csound->Calloc(csound, sizeof(int32_t));
+    }
+    return OK;
+}
+
 
 typedef struct {
   OPDS h;
@@ -2729,7 +2752,7 @@ static int32_t outa(CSOUND *csound, OUTA *p)
     uint32_t offset = p->h.insdshead->ksmps_offset;
     uint32_t early  = nsmps - p->h.insdshead->ksmps_no_end;
     MYFLT       *data = p->tabin->data;
-    MYFLT       *sp= csound->spraw;
+    MYFLT       *sp= CS_SPOUT;
     if (!csound->spoutactive) {
       memset(sp, '\0', nsmps*nchns*sizeof(MYFLT));
       for (l=0; l<pl; l++) {
@@ -4081,6 +4104,7 @@ static OENTRY arrayvars_localops[] =
     { "trim.i", sizeof(TRIM), WI, 1, "", "i[]i", (SUBR)trim, NULL },
     { "trim.k", sizeof(TRIM), WI, 2, "", ".[]k", NULL, (SUBR)trim },
     { "trim_i", sizeof(TRIM), WI, 1, "", ".[]i", (SUBR)trim, NULL },
+    { "reservearray", sizeof(TRIM), WI, 1, "", ".[]i", (SUBR)tabreserve, NULL },
     { "copy2ftab", sizeof(TABCOPY), TW|_QQ, 2, "", "k[]k", NULL, (SUBR) tab2ftab },
     { "copy2ttab", sizeof(TABCOPY), TR|_QQ, 2, "", "k[]k", NULL, (SUBR) ftab2tab },
     { "copya2ftab.k", sizeof(TABCOPY), TW, 3, "", "k[]k",
@@ -25,8 +25,21 @@
 #include <unistd.h>
 #endif
 
+static void HDF5IO_releaseLock(CSOUND *csound);
+
+// Stop csound from code that holds the hdf5 library lock, letting go of
+// the lock first so the I/O thread can finish
+#define HDF5DIE(...) \
+    {HDF5IO_releaseLock(csound); csound->Die(csound, __VA_ARGS__);}
+
 #define HDF5ERROR(x) if (UNLIKELY((x) == -1)) \
-    {csound->Die(csound, #x" error\nExiting\n");}
+    {HDF5DIE("%s", #x" error\nExiting\n");}
+
+// Number of control cycles buffered per block and number of blocks in the
+// ring of each buffered dataset unless set with hdf5buffer
+#define HDF5IO_DEFAULT_BLOCK_KCYCLES 256
+#define HDF5IO_DEFAULT_RING_BLOCKS 4
+#define HDF5IO_MAX_RING_BLOCKS 64
 
 // Type strings to match the enum types
 static const char typeStrings[8][12] = {
@@ -162,7 +175,7 @@ HDF5File *HDF5IO_newHDF5File(CSOUND *csound, AUXCH *hdf5FileMemory,
       }
       else {
 
-        csound->Die(csound, "hdf5read: Error, file does not exist");
+        HDF5DIE("%s", "hdf5read: Error, file does not exist");
       }
     }
     else {
@@ -256,6 +269,523 @@ bool HDF5IO_getSampleAccurate(CSOUND *csound)
     return parameters.sampleAccurate;
 }
 
+// Move one block of rows between memory and its dataset, this runs on the
+// I/O thread with the hdf5 library lock held
+//
+// When writing, grow the dataset so it ends with the block
+// Select the rows of the block in the file space
+// Create a memory space the size of the block
+// Read or write the data and close the spaces again
+// Return -1 if any of the calls failed
+
+static int32_t HDF5IO_runJob(HDF5IOJob *job)
+{
+    hsize_t extent[H5S_MAX_RANK];
+    herr_t status = -1;
+    int32_t i;
+
+    if (job->type == HDF5IO_WRITE) {
+
+      for (i = 0; i < job->rank; ++i) {
+
+        extent[i] = job->offset[i] + job->count[i];
+      }
+
+      if (H5Dset_extent(job->datasetID, extent) < 0) {
+
+        return -1;
+      }
+    }
+
+    hid_t filespace = H5Dget_space(job->datasetID);
+
+    if (filespace < 0) {
+
+      return -1;
+    }
+
+    hid_t memspace = H5Screate_simple(job->rank, job->count, NULL);
+
+    if (memspace >= 0) {
+
+      if (H5Sselect_hyperslab(filespace, H5S_SELECT_SET, job->offset,
+                              NULL, job->count, NULL) >= 0) {
+
+        status = job->type == HDF5IO_READ ?
+          H5Dread(job->datasetID, job->floatSize, memspace, filespace,
+                  H5P_DEFAULT, job->data) :
+          H5Dwrite(job->datasetID, job->floatSize, memspace, filespace,
+                   H5P_DEFAULT, job->data);
+      }
+
+      H5Sclose(memspace);
+    }
+
+    H5Sclose(filespace);
+
+    return status < 0 ? -1 : 0;
+}
+
+// Close a file once all the blocks queued before have been moved, this
+// runs on the I/O thread with the hdf5 library lock held
+//
+// Set the final size of the datasets that grew during performance, close
+// them and free their rings of blocks
+// Close the file
+// Return -1 if any of the calls failed
+
+static int32_t HDF5IO_closeFile(CSOUND *csound, HDF5IOClose *closeJob)
+{
+    int32_t status = 0;
+    int32_t i;
+
+    for (i = 0; i < closeJob->datasetCount; ++i) {
+
+      HDF5IOCloseDataset *dataset = &closeJob->datasets[i];
+
+      if (dataset->resize == true
+          &&
+          H5Dset_extent(dataset->datasetID, dataset->size) < 0) {
+
+        status = -1;
+      }
+
+      if (H5Dclose(dataset->datasetID) < 0) {
+
+        status = -1;
+      }
+
+      if (dataset->ring != NULL) {
+
+        csound->Free(csound, dataset->ring);
+      }
+    }
+
+    if (H5Fclose(closeJob->fileHandle) < 0) {
+
+      status = -1;
+    }
+
+    return status;
+}
+
+// The I/O thread
+//
+// Take the first job off the queue, if there is none either stop when asked
+// to or sleep until a job is queued
+// Run the job with the hdf5 library lock held, warn if it failed, there is
+// no way to stop csound from here
+// Mark a block as done, the opcode picks it up on its next control cycle,
+// or free a close job, and wake an offline render waiting for it
+
+static uintptr_t HDF5IO_threadRoutine(void *userData)
+{
+    HDF5IOThread *io = userData;
+    CSOUND *csound = io->csound;
+    static const char *jobNames[3] = { "read", "write", "close" };
+
+    while (true) {
+
+      csound->LockMutex(io->queueMutex);
+      HDF5IOJob *job = io->first;
+
+      if (job != NULL) {
+
+        io->first = job->next;
+
+        if (io->first == NULL) {
+
+          io->last = NULL;
+        }
+      }
+
+      csound->UnlockMutex(io->queueMutex);
+
+      if (job == NULL) {
+
+        if (ATOMIC_GET(io->running) == 0) {
+
+          break;
+        }
+
+        csound->WaitThreadLockNoTimeout(io->workLock);
+        continue;
+      }
+
+      HDF5IOJobType type = job->type;
+      csound->LockMutex(io->hdf5Mutex);
+      int32_t status = type == HDF5IO_CLOSE ?
+        HDF5IO_closeFile(csound, (HDF5IOClose *)job) : HDF5IO_runJob(job);
+      csound->UnlockMutex(io->hdf5Mutex);
+
+      if (UNLIKELY(status != 0)) {
+
+        csound->Warning(csound, Str("hdf5: background %s of a dataset failed"),
+                        jobNames[type]);
+      }
+
+      if (type == HDF5IO_CLOSE) {
+
+        csound->Free(csound, job);
+      }
+      else {
+
+        ATOMIC_SET(job->busy, 0);
+      }
+
+      ATOMIC_DECR(io->pending);
+      csound->NotifyThreadLock(io->doneLock);
+    }
+
+    return 0;
+}
+
+// Stop the I/O thread and free its locks when csound is reset
+
+static int32_t HDF5IO_reset(CSOUND *csound, void *userData)
+{
+    HDF5IOThread *io = userData;
+
+    if (io->thread != NULL) {
+
+      ATOMIC_SET(io->running, 0);
+      csound->NotifyThreadLock(io->workLock);
+      csound->JoinThread(io->thread);
+      io->thread = NULL;
+    }
+
+    csound->DestroyThreadLock(io->workLock);
+    csound->DestroyThreadLock(io->doneLock);
+    csound->DestroyMutex(io->hdf5Mutex);
+    csound->DestroyMutex(io->queueMutex);
+
+    return OK;
+}
+
+// Get the I/O state shared by the hdf5 opcodes, creating it the first time
+//
+// Only a real time performance drops control cycles when the I/O thread
+// falls behind, an offline render waits for it so the files it writes and
+// the signals it reads are the same on every run
+
+static HDF5IOThread *HDF5IO_getGlobals(CSOUND *csound)
+{
+    HDF5IOThread *io = csound->QueryGlobalVariable(csound, "::HDF5IO");
+
+    if (io == NULL) {
+
+      if (UNLIKELY(csound->CreateGlobalVariable(csound, "::HDF5IO",
+                                                sizeof(HDF5IOThread)) != 0)) {
+
+        csound->Die(csound, "%s", Str("hdf5: Error, unable to allocate "
+                                      "globals, exiting"));
+      }
+
+      OPARMS oparms;
+      csound->GetOParms(csound, &oparms);
+      io = csound->QueryGlobalVariable(csound, "::HDF5IO");
+      io->csound = csound;
+      io->realtime = oparms.realtime != 0;
+      io->queueMutex = csound->Create_Mutex(0);
+      io->hdf5Mutex = csound->Create_Mutex(0);
+      io->workLock = csound->CreateThreadLock();
+      io->doneLock = csound->CreateThreadLock();
+      io->blockKcycles = HDF5IO_DEFAULT_BLOCK_KCYCLES;
+      io->ringBlocks = HDF5IO_DEFAULT_RING_BLOCKS;
+      csound->RegisterResetCallback(csound, io, HDF5IO_reset);
+    }
+
+    return io;
+}
+
+// Get the I/O state and start the I/O thread if it is not running yet,
+// it then runs until csound is reset
+
+static HDF5IOThread *HDF5IO_start(CSOUND *csound)
+{
+    HDF5IOThread *io = HDF5IO_getGlobals(csound);
+
+    if (io->thread == NULL) {
+
+      io->running = 1;
+      io->thread = csound->CreateThread(HDF5IO_threadRoutine, io);
+
+      if (UNLIKELY(io->thread == NULL)) {
+
+        csound->Die(csound, "%s", Str("hdf5: Error, unable to start "
+                                      "the I/O thread, exiting"));
+      }
+    }
+
+    return io;
+}
+
+// Take and give back the hdf5 library lock, every call into the library
+// made outside the I/O thread must hold it
+//
+// Initialisation and offline renders wait for the lock, in real time the
+// performance pass only tries to take it because the I/O thread holds it
+// while it moves a whole block
+
+static void HDF5IO_lock(CSOUND *csound, HDF5IOThread *io)
+{
+    csound->LockMutex(io->hdf5Mutex);
+    io->locked = true;
+}
+
+static bool HDF5IO_tryLock(CSOUND *csound, HDF5IOThread *io)
+{
+    if (csound->LockMutexNoWait(io->hdf5Mutex) != 0) {
+
+      return false;
+    }
+
+    io->locked = true;
+
+    return true;
+}
+
+static bool HDF5IO_perfLock(CSOUND *csound, HDF5IOThread *io)
+{
+    if (io->realtime == true) {
+
+      return HDF5IO_tryLock(csound, io);
+    }
+
+    HDF5IO_lock(csound, io);
+
+    return true;
+}
+
+static void HDF5IO_unlock(CSOUND *csound, HDF5IOThread *io)
+{
+    io->locked = false;
+    csound->UnlockMutex(io->hdf5Mutex);
+}
+
+static void HDF5IO_releaseLock(CSOUND *csound)
+{
+    HDF5IOThread *io = csound->QueryGlobalVariable(csound, "::HDF5IO");
+
+    if (io != NULL && io->locked == true) {
+
+      HDF5IO_unlock(csound, io);
+    }
+}
+
+// Queue a job for the I/O thread and wake it
+
+static void HDF5IO_submit(CSOUND *csound, HDF5IOThread *io, HDF5IOJob *job)
+{
+    job->next = NULL;
+    ATOMIC_SET(job->busy, 1);
+    ATOMIC_INCR(io->pending);
+    csound->LockMutex(io->queueMutex);
+
+    if (io->last != NULL) {
+
+      io->last->next = job;
+    }
+    else {
+
+      io->first = job;
+    }
+
+    io->last = job;
+    csound->UnlockMutex(io->queueMutex);
+    csound->NotifyThreadLock(io->workLock);
+}
+
+// Wait until the I/O thread has finished with a block, return false
+// straight away instead in real time
+
+static bool HDF5IO_wait(CSOUND *csound, HDF5IOThread *io, HDF5IOJob *job)
+{
+    if (LIKELY(ATOMIC_GET(job->busy) == 0)) {
+
+      return true;
+    }
+
+    if (io->realtime == true) {
+
+      return false;
+    }
+
+    while (ATOMIC_GET(job->busy) != 0) {
+
+      csound->WaitThreadLock(io->doneLock, 1);
+    }
+
+    return true;
+}
+
+// Wait until the I/O thread has run every job queued so far, so that a file
+// written earlier in the performance is complete and closed
+
+static void HDF5IO_drain(CSOUND *csound, HDF5IOThread *io)
+{
+    while (ATOMIC_GET(io->pending) != 0) {
+
+      csound->WaitThreadLock(io->doneLock, 1);
+    }
+}
+
+// Hand a file and its datasets over to the I/O thread to be closed once
+// it has finished the blocks already queued
+//
+// Copy what is needed to close each dataset, the opcode may be freed before
+// the job runs
+// Written a-rate and k-rate datasets are left as long as their offset
+// Take over the rings of blocks so the job can free them
+
+static void HDF5IO_closeLater(CSOUND *csound, HDF5IOThread *io,
+                              HDF5File *file, HDF5Dataset *datasets,
+                              int32_t count, bool resize)
+{
+    HDF5IOClose *closeJob =
+      csound->Calloc(csound, sizeof(HDF5IOClose) +
+                     count * sizeof(HDF5IOCloseDataset));
+    int32_t i;
+
+    closeJob->job.type = HDF5IO_CLOSE;
+    closeJob->fileHandle = file->fileHandle;
+    closeJob->datasetCount = count;
+    closeJob->datasets = (HDF5IOCloseDataset *)&closeJob[1];
+
+    for (i = 0; i < count; ++i) {
+
+      HDF5Dataset *dataset = &datasets[i];
+      HDF5IOCloseDataset *closeDataset = &closeJob->datasets[i];
+
+      closeDataset->datasetID = dataset->datasetID;
+      closeDataset->rank = dataset->rank;
+
+      if (resize == true
+          &&
+          dataset->writeType != IRATE_VAR
+          &&
+          dataset->writeType != IRATE_ARRAY
+          &&
+          dataset->rank <= H5S_MAX_RANK) {
+
+        closeDataset->resize = true;
+        memcpy(closeDataset->size, dataset->datasetSize,
+               dataset->rank * sizeof(hsize_t));
+        closeDataset->size[0] = dataset->offset[0];
+      }
+
+      closeDataset->ring = dataset->blocks;
+      dataset->blocks = NULL;
+      dataset->blockRows = 0;
+    }
+
+    HDF5IO_submit(csound, io, &closeJob->job);
+}
+
+// Count a control cycle a real time performance could not move because
+// the I/O thread had fallen behind, warn the first time it happens
+
+static void HDF5IO_overrun(CSOUND *csound, HDF5Dataset *dataset,
+                           const char *opname)
+{
+    if (dataset->overruns++ == 0) {
+
+      csound->Warning(csound, Str("%s: the I/O thread fell behind on dataset "
+                                  "%s, control cycles are being dropped, "
+                                  "hdf5buffer can make the ring larger"),
+                      opname, dataset->datasetName);
+    }
+}
+
+// Report the control cycles dropped from a dataset when the opcode finishes
+
+static void HDF5IO_reportOverruns(CSOUND *csound, HDF5Dataset *dataset,
+                                  const char *opname)
+{
+    if (dataset->overruns > 0) {
+
+      csound->Warning(csound, Str("%s: %u control cycles of dataset %s "
+                                  "were dropped"),
+                      opname, dataset->overruns, dataset->datasetName);
+    }
+}
+
+// Set up the ring of blocks of a dataset that is buffered
+//
+// Work out how many rows a block holds, a-rate datasets have ksmps rows per
+// control cycle, k-rate datasets one
+// Allocate the blocks and their memory in one go, outside the instrument
+// instance because the I/O thread may still use them after the opcode has
+// finished, they are freed by the job that closes the file
+// Set the parts of the hyperslab that don't change, all dimensions after
+// the first are moved whole
+
+static void HDF5IO_initialiseBlocks(CSOUND *csound, HDF5IOThread *io,
+                                    HDF5Dataset *dataset, hid_t datasetID,
+                                    hid_t floatSize, HDF5IOJobType type,
+                                    hsize_t blockRows, hsize_t *dimensions)
+{
+    int32_t count = io->ringBlocks;
+    size_t blockSize = blockRows * dataset->frameSize;
+    int32_t i, j;
+
+    dataset->blockRows = blockRows;
+    dataset->blockCount = count;
+    dataset->currentBlock = 0;
+    dataset->blockFill = 0;
+    dataset->nextRow = 0;
+    dataset->blocks =
+      csound->Malloc(csound, count * (sizeof(HDF5IOJob) +
+                                      blockSize * sizeof(MYFLT)));
+
+    MYFLT *data = (MYFLT *)&dataset->blocks[count];
+
+    for (i = 0; i < count; ++i) {
+
+      HDF5IOJob *block = &dataset->blocks[i];
+      block->type = type;
+      block->datasetID = datasetID;
+      block->floatSize = floatSize;
+      block->rank = dataset->rank;
+      block->data = &data[i * blockSize];
+      block->busy = 0;
+
+      for (j = 1; j < dataset->rank; ++j) {
+
+        block->offset[j] = 0;
+        block->count[j] = dimensions[j];
+      }
+
+      block->offset[0] = 0;
+      block->count[0] = 0;
+    }
+}
+
+// Set the hdf5 buffer size
+//
+// Store the amount of control cycles to buffer per block for hdf5 opcodes
+// initialised after this one, 0 writes and reads every control cycle
+// directly, waiting for the hdf5 library lock unless in real time
+// Store the amount of blocks in the ring of each dataset if it is given,
+// the I/O thread can fall behind by all but one of them
+
+int32_t HDF5Buffer_initialise(CSOUND *csound, HDF5Buffer *self)
+{
+    HDF5IOThread *io = HDF5IO_getGlobals(csound);
+    int32_t kcycles = (int32_t)*self->kcycles;
+    int32_t blocks = (int32_t)*self->blocks;
+
+    io->blockKcycles = kcycles > 0 ? kcycles : 0;
+
+    if (blocks > 0) {
+
+      io->ringBlocks = blocks < 2 ? 2 :
+        blocks > HDF5IO_MAX_RING_BLOCKS ? HDF5IO_MAX_RING_BLOCKS : blocks;
+    }
+
+    return OK;
+}
+
 
 // Set everything up so datasets can be written from the opcodes input variables,
 // i-rate datasets are written at initialisation all others are written on the
@@ -266,6 +796,7 @@ bool HDF5IO_getSampleAccurate(CSOUND *csound)
 // argument which is for the filename.
 // Check that the first argument is a string for the filename, check others
 // are not strings
+// Start the I/O thread if it isn't running
 // Register the callback to close the hdf5 file when performance finishes
 // Get the path argument and open a hdf5 file, if it doesn't exist create it
 // Create the datasets in the file so they can be written
@@ -275,11 +806,14 @@ int32_t HDF5Write_initialise(CSOUND *csound, HDF5Write *self)
     self->ksmps = csound->GetKsmps(csound);
     self->inputArgumentCount = self->INOCOUNT - 1;
     HDF5Write_checkArgumentSanity(csound, self);
+    self->io = HDF5IO_start(csound);
     csound->RegisterDeinitCallback(csound, self, HDF5Write_finish);
 
     STRINGDAT *path = (STRINGDAT *)self->arguments[0];
+    HDF5IO_lock(csound, self->io);
     self->hdf5File = HDF5IO_newHDF5File(csound, &self->hdf5FileMemory, path, true);
     HDF5Write_createDatasets(csound, self);
+    HDF5IO_unlock(csound, self->io);
 
     return OK;
 }
@@ -306,6 +840,63 @@ void HDF5Write_writeData(CSOUND *csound, HDF5Write *self,
     HDF5ERROR(H5Dwrite(dataset->datasetID, self->hdf5File->floatSize, memspace,
                        filespace, H5P_DEFAULT, data));
     HDF5ERROR(H5Sclose(filespace));
+    HDF5ERROR(H5Sclose(memspace));
+}
+
+// Copy rows of data into the ring of blocks of a buffered dataset
+//
+// If the current block is empty but the I/O thread is still writing it, it
+// has fallen behind by the whole ring, wait for it, or in real time drop
+// the rows and count an overrun, the dataset offset still moves on so the
+// rows read back as zeros
+// Copy as many rows as fit into the current block, a new block starts at
+// the current dataset offset
+// When the block is full hand it to the I/O thread and move to the next
+// block in the ring
+// Repeat until all the rows are copied
+
+void HDF5Write_bufferData(CSOUND *csound, HDF5Write *self,
+                          HDF5Dataset *dataset, MYFLT *data, hsize_t rows)
+{
+    while (rows > 0) {
+
+      HDF5IOJob *block = &dataset->blocks[dataset->currentBlock];
+
+      if (dataset->blockFill == 0) {
+
+        if (UNLIKELY(HDF5IO_wait(csound, self->io, block) == false)) {
+
+          HDF5IO_overrun(csound, dataset, "hdf5write");
+          dataset->offset[0] += rows;
+          return;
+        }
+
+        block->offset[0] = dataset->offset[0];
+      }
+
+      hsize_t count = dataset->blockRows - dataset->blockFill;
+
+      if (count > rows) {
+
+        count = rows;
+      }
+
+      memcpy(&block->data[dataset->blockFill * dataset->frameSize], data,
+             count * dataset->frameSize * sizeof(MYFLT));
+      dataset->blockFill += count;
+      dataset->offset[0] += count;
+      data += count * dataset->frameSize;
+      rows -= count;
+
+      if (dataset->blockFill == dataset->blockRows) {
+
+        block->count[0] = dataset->blockFill;
+        HDF5IO_submit(csound, self->io, block);
+        dataset->blockFill = 0;
+        dataset->currentBlock =
+          (dataset->currentBlock + 1) % dataset->blockCount;
+      }
+    }
 }
 
 // Write a-rate variables and arrays to the specified data set
@@ -313,9 +904,11 @@ void HDF5Write_writeData(CSOUND *csound, HDF5Write *self,
 // For sample accurate mode, get the offset and early variables
 // Calculate the size of the incoming vector
 // If the vector is 0 return, no more data to write
+// If the dataset is buffered copy the vector to its blocks and return
 // Expand the dataset size by ksmps, because data is written in chunks
 // For sample accurate mode the exact dataset size is set when writing is finished
-// Write the data to the dataset
+// Write the data to the dataset, unless in real time the I/O thread holds
+// the hdf5 library, then the vector is dropped and counted as an overrun
 // Increment the offset by the size of the vector that was just written
 
 void HDF5Write_writeAudioData(CSOUND *csound, HDF5Write *self,
@@ -330,25 +923,56 @@ void HDF5Write_writeAudioData(CSOUND *csound, HDF5Write *self,
       return;
     }
 
+    if (dataset->blockRows > 0) {
+
+      HDF5Write_bufferData(csound, self, dataset, &dataPointer[offset],
+                           vectorSize);
+      return;
+    }
+
     dataset->datasetSize[0] += self->ksmps;
 
-    HDF5Write_writeData(csound, self, dataset, &dataPointer[offset]);
+    if (LIKELY(HDF5IO_perfLock(csound, self->io) == true)) {
+
+      HDF5Write_writeData(csound, self, dataset, &dataPointer[offset]);
+      HDF5IO_unlock(csound, self->io);
+    }
+    else {
+
+      HDF5IO_overrun(csound, dataset, "hdf5write");
+    }
 
     dataset->offset[0] += vectorSize;
 }
 
 // Write k-rate variables and arrays to the specified data set
 //
+// If the dataset is buffered copy one row to its blocks and return
 // Increment the data set size by 1
-// Write the data to the dataset
+// Write the data to the dataset, unless in real time the I/O thread holds
+// the hdf5 library, then the row is dropped and counted as an overrun
 // Increment the offset by 1
 
 void HDF5Write_writeControlData(CSOUND *csound, HDF5Write *self,
                                 HDF5Dataset *dataset, MYFLT *dataPointer)
 {
+    if (dataset->blockRows > 0) {
+
+      HDF5Write_bufferData(csound, self, dataset, dataPointer, 1);
+      return;
+    }
+
     dataset->datasetSize[0]++;
 
-    HDF5Write_writeData(csound, self, dataset, dataPointer);
+    if (LIKELY(HDF5IO_perfLock(csound, self->io) == true)) {
+
+      HDF5Write_writeData(csound, self, dataset, dataPointer);
+      HDF5IO_unlock(csound, self->io);
+    }
+    else {
+
+      HDF5IO_overrun(csound, dataset, "hdf5write");
+    }
 
     dataset->offset[0]++;
 }
@@ -402,49 +1026,41 @@ int32_t HDF5Write_process(CSOUND *csound, HDF5Write *self)
 
 // Close the hdf5 file and set the a-rate dataset extents for sample accurate mode
 //
-// Check that the datasets exist
-// Iterate through the datasets, if a-rate, set the size to be the same as
-// current offset
-// Set the set extent of the dataset to the size
-// Close the datasets, then close the file
+// Hand any partly filled blocks to the I/O thread and report the control
+// cycles that were dropped
+// Queue the job that closes the file behind them, it sets the size of the
+// a-rate and k-rate datasets to their current offset, closes the datasets
+// and then the file, nothing here waits for the I/O thread
 
 int32_t HDF5Write_finish(CSOUND *csound, void *inReference)
 {
     HDF5Write *self = inReference;
+    int32_t count = self->datasets != NULL ? self->inputArgumentCount : 0;
+    int32_t i;
 
-    if (LIKELY(self->datasets != NULL)) {
-      int32_t i;
-      for (i = 0; i < self->inputArgumentCount; ++i) {
-
-        HDF5Dataset *dataset = &self->datasets[i];
+    if (UNLIKELY(self->hdf5File == NULL)) {
 
-        switch (dataset->writeType) {
+      return OK;
+    }
 
-        case ARATE_ARRAY: {
+    for (i = 0; i < count; ++i) {
 
-          dataset->datasetSize[0] =
-            dataset->offset[0];
-          HDF5ERROR(H5Dset_extent(dataset->datasetID, dataset->datasetSize));
-          break;
-        }
-        case ARATE_VAR: {
-
-          dataset->datasetSize[0] =
-            dataset->offset[0];
-          HDF5ERROR(H5Dset_extent(dataset->datasetID, dataset->datasetSize));
-          break;
-        }
-        default: {
+      HDF5Dataset *dataset = &self->datasets[i];
 
-          break;
-        }
-        }
+      if (dataset->blockRows > 0 && dataset->blockFill > 0) {
 
-        HDF5ERROR(H5Dclose(dataset->datasetID));
+        HDF5IOJob *block = &dataset->blocks[dataset->currentBlock];
+        block->count[0] = dataset->blockFill;
+        HDF5IO_submit(csound, self->io, block);
+        dataset->blockFill = 0;
       }
+
+      HDF5IO_reportOverruns(csound, dataset, "hdf5write");
     }
 
-    HDF5ERROR(H5Fclose(self->hdf5File->fileHandle));
+    HDF5IO_closeLater(csound, self->io, self->hdf5File, self->datasets,
+                      count, true);
+    self->hdf5File = NULL;
 
     return OK;
 }
@@ -534,6 +1150,7 @@ void HDF5Write_initialiseHDF5Dataset(CSOUND *csound, HDF5Write *self,
 // dimension to unlimited and dataset size to 0
 // If it's a k-rate array set the last chunk dimension to 1 and last max
 // dimension to unlimited
+// When buffering, a-rate and k-rate chunks are one block long
 // If it's an i-rate array just return
 
 void HDF5Write_newArrayDataset(CSOUND *csound, HDF5Write *self,
@@ -566,11 +1183,14 @@ void HDF5Write_newArrayDataset(CSOUND *csound, HDF5Write *self,
                      &dataset->offsetMemory);
     dataset->offset = dataset->offsetMemory.auxp;
 
+    dataset->frameSize = 1;
+
     for (i = 0; i < array->dimensions; ++i) {
 
       dataset->chunkDimensions[i + 1] = array->sizes[i];
       dataset->maxDimensions[i + 1] = array->sizes[i];
       dataset->datasetSize[i + 1] = array->sizes[i];
+      dataset->frameSize *= array->sizes[i];
     }
 
     switch (dataset->writeType) {
@@ -581,12 +1201,21 @@ void HDF5Write_newArrayDataset(CSOUND *csound, HDF5Write *self,
       dataset->maxDimensions[0] = H5S_UNLIMITED;
       dataset->datasetSize[0] = 0;
 
+      if (self->io->blockKcycles > 0) {
+
+        dataset->chunkDimensions[0] *= self->io->blockKcycles;
+      }
       break;
     }
     case KRATE_ARRAY: {
 
       dataset->chunkDimensions[0] = 1;
       dataset->maxDimensions[0] = H5S_UNLIMITED;
+
+      if (self->io->blockKcycles > 0) {
+
+        dataset->chunkDimensions[0] *= self->io->blockKcycles;
+      }
       break;
     }
     case IRATE_ARRAY: {
@@ -595,7 +1224,7 @@ void HDF5Write_newArrayDataset(CSOUND *csound, HDF5Write *self,
     }
     default: {
 
-      csound->Die(csound, "%s", Str("This should not happen, exiting"));
+      HDF5DIE("%s", Str("This should not happen, exiting"));
       break;
     }
     }
@@ -606,7 +1235,8 @@ void HDF5Write_newArrayDataset(CSOUND *csound, HDF5Write *self,
 // Set the rank to 1
 // Allocate memory for chunk sizes, maximum sizes, dataset sizes and offsets
 // If the argument is not an i-rate variable:
-//  Set the chunk dimensions to ksmps if a-rate, 1 if k-rate
+//  Set the chunk dimensions to ksmps if a-rate, 1 if k-rate, when buffering
+//  chunks are one block long
 //  Set maximum dimensions to unlimited
 //  Set the data size to 0
 // If it is an i-rate variable:
@@ -630,6 +1260,7 @@ void HDF5Write_newScalarDataset(CSOUND *csound, HDF5Write *self,
 
     csound->AuxAlloc(csound, sizeof(hsize_t), &dataset->offsetMemory);
     dataset->offset = dataset->offsetMemory.auxp;
+    dataset->frameSize = 1;
 
     if (dataset->writeType != IRATE_VAR) {
 
@@ -637,6 +1268,11 @@ void HDF5Write_newScalarDataset(CSOUND *csound, HDF5Write *self,
         dataset->writeType == ARATE_VAR ? self->ksmps : 1;
       dataset->maxDimensions[0] = H5S_UNLIMITED;
       dataset->datasetSize[0] = 0;
+
+      if (self->io->blockKcycles > 0) {
+
+        dataset->chunkDimensions[0] *= self->io->blockKcycles;
+      }
     }
     else {
       dataset->datasetSize[0] = 1;
@@ -647,6 +1283,27 @@ void HDF5Write_newScalarDataset(CSOUND *csound, HDF5Write *self,
     dataset->offset[0] = 0;
 }
 
+// Set up the blocks of an a-rate or k-rate dataset for buffered writing
+//
+// Leave the dataset unbuffered if buffering is off
+// The dataset chunks are one block long, so each block written by the
+// I/O thread fills whole chunks
+
+void HDF5Write_initialiseBlocks(CSOUND *csound, HDF5Write *self,
+                                HDF5Dataset *dataset)
+{
+    if (self->io->blockKcycles == 0 || dataset->rank > H5S_MAX_RANK) {
+
+      dataset->blockRows = 0;
+      return;
+    }
+
+    HDF5IO_initialiseBlocks(csound, self->io, dataset, dataset->datasetID,
+                            self->hdf5File->floatSize, HDF5IO_WRITE,
+                            dataset->chunkDimensions[0],
+                            dataset->chunkDimensions);
+}
+
 // Create the datasets for each argument to be written
 //
 // Allocate the memory for the datasets array
@@ -657,6 +1314,7 @@ void HDF5Write_newScalarDataset(CSOUND *csound, HDF5Write *self,
 // Get the enum write type from the argument pointer
 // Depending on the write type set up the variables in the correct way for
 // writing during performance
+// If the variables are a-rate or k-rate and buffering is on set up the blocks
 // If the variables are i-rate set up the variables and write them
 
 void HDF5Write_createDatasets(CSOUND *csound, HDF5Write *self)
@@ -680,12 +1338,14 @@ void HDF5Write_createDatasets(CSOUND *csound, HDF5Write *self)
 
         HDF5Write_newArrayDataset(csound, self, currentDataset);
         HDF5Write_initialiseHDF5Dataset(csound, self, currentDataset);
+        HDF5Write_initialiseBlocks(csound, self, currentDataset);
         break;
       }
       case KRATE_ARRAY: {
 
         HDF5Write_newArrayDataset(csound, self, currentDataset);
         HDF5Write_initialiseHDF5Dataset(csound, self, currentDataset);
+        HDF5Write_initialiseBlocks(csound, self, currentDataset);
         break;
       }
       case IRATE_ARRAY: {
@@ -700,12 +1360,14 @@ void HDF5Write_createDatasets(CSOUND *csound, HDF5Write *self)
 
         HDF5Write_newScalarDataset(csound, self, currentDataset);
         HDF5Write_initialiseHDF5Dataset(csound, self, currentDataset);
+        HDF5Write_initialiseBlocks(csound, self, currentDataset);
         break;
       }
       case KRATE_VAR: {
 
         HDF5Write_newScalarDataset(csound, self, currentDataset);
         HDF5Write_initialiseHDF5Dataset(csound, self, currentDataset);
+        HDF5Write_initialiseBlocks(csound, self, currentDataset);
         break;
       }
       case IRATE_VAR: {
@@ -731,11 +1393,15 @@ void HDF5Write_createDatasets(CSOUND *csound, HDF5Write *self)
 // Get the amount of output arguments
 // Check that input == output arguments and input arguments are strings,
 // output not strings
+// Start the I/O thread if it isn't running
 // Register the finish callback to close the hdf5 file when performance
 // is finished
 // Check csound is running in sample accurate mode
 // Get the path string from the first argument
-// Open the hdf5 file then open the hdf5 datasets
+// Wait for the files written so far to be closed, then open the hdf5
+// file and the hdf5 datasets
+// Start reading ahead the datasets that are buffered, this reads their
+// first blocks so it needs the hdf5 library lock as well
 
 int32_t HDF5Read_initialise(CSOUND *csound, HDF5Read *self)
 {
@@ -743,11 +1409,16 @@ int32_t HDF5Read_initialise(CSOUND *csound, HDF5Read *self)
     self->inputArgumentCount = self->INOCOUNT - 1;
     self->outputArgumentCount = self->OUTOCOUNT;
     HDF5Read_checkArgumentSanity(csound, self);
+    self->io = HDF5IO_start(csound);
     csound->RegisterDeinitCallback(csound, self, HDF5Read_finish);
     self->isSampleAccurate = HDF5IO_getSampleAccurate(csound);
     STRINGDAT *path = (STRINGDAT *)self->arguments[self->outputArgumentCount];
+    HDF5IO_drain(csound, self->io);
+    HDF5IO_lock(csound, self->io);
     self->hdf5File = HDF5IO_newHDF5File(csound, &self->hdf5FileMemory, path, false);
     HDF5Read_openDatasets(csound, self);
+    HDF5Read_initialiseBlocks(csound, self);
+    HDF5IO_unlock(csound, self->io);
 
     return OK;
 }
@@ -805,6 +1476,103 @@ void HDF5Read_readData(CSOUND *csound, HDF5Read *self, HDF5Dataset *dataset,
 
 }
 
+// Fill a block of a buffered dataset with the next rows to be read ahead
+//
+// The block starts at the next row and holds as many rows as are left in
+// the dataset, up to the block size
+// If there are no rows left the block stays empty and isn't queued
+// Otherwise ask the I/O thread to fill it, or when starting up, with the
+// hdf5 library lock held, read it straight away
+
+void HDF5Read_fetchBlock(CSOUND *csound, HDF5Read *self, HDF5Dataset *dataset,
+                         HDF5IOJob *block, bool now)
+{
+    hsize_t start = dataset->nextRow;
+
+    block->offset[0] = start;
+    block->count[0] = 0;
+
+    if (start < dataset->datasetSize[0]) {
+
+      block->count[0] = dataset->datasetSize[0] - start;
+
+      if (block->count[0] > dataset->blockRows) {
+
+        block->count[0] = dataset->blockRows;
+      }
+
+      dataset->nextRow += block->count[0];
+
+      if (now == true) {
+
+        HDF5ERROR(HDF5IO_runJob(block));
+      }
+      else {
+
+        HDF5IO_submit(csound, self->io, block);
+      }
+    }
+}
+
+// Copy rows from the ring of blocks of a buffered dataset
+//
+// If the I/O thread has not filled the current block yet it has fallen
+// behind, wait for it, or in real time fill the rows with zeros, count an
+// overrun and move the dataset offset on so the rows that follow stay in
+// time
+// If the current block is empty there are no rows left
+// If the current block is used up ask for it to be filled with the rows
+// after the last block in the ring, then move to the next block
+// Otherwise copy as many rows as the current block holds
+// Repeat until all the rows are copied
+
+void HDF5Read_readBlocks(CSOUND *csound, HDF5Read *self, HDF5Dataset *dataset,
+                         MYFLT *dataPointer, hsize_t rows)
+{
+    while (rows > 0) {
+
+      HDF5IOJob *block = &dataset->blocks[dataset->currentBlock];
+
+      if (UNLIKELY(HDF5IO_wait(csound, self->io, block) == false)) {
+
+        HDF5IO_overrun(csound, dataset, "hdf5read");
+        memset(dataPointer, 0, rows * dataset->frameSize * sizeof(MYFLT));
+        dataset->offset[0] += rows;
+        return;
+      }
+
+      if (UNLIKELY(block->count[0] == 0)) {
+
+        return;
+      }
+
+      hsize_t end = block->offset[0] + block->count[0];
+
+      if (dataset->offset[0] >= end) {
+
+        HDF5Read_fetchBlock(csound, self, dataset, block, false);
+        dataset->currentBlock =
+          (dataset->currentBlock + 1) % dataset->blockCount;
+        continue;
+      }
+
+      hsize_t count = end - dataset->offset[0];
+
+      if (count > rows) {
+
+        count = rows;
+      }
+
+      memcpy(dataPointer,
+             &block->data[(dataset->offset[0] - block->offset[0]) *
+                          dataset->frameSize],
+             count * dataset->frameSize * sizeof(MYFLT));
+      dataPointer += count * dataset->frameSize;
+      dataset->offset[0] += count;
+      rows -= count;
+    }
+}
+
 // Read data at audio rate from a hdf5 file dataset
 //
 // If the offset is larger than the size of the dataset there is no more
@@ -812,6 +1580,9 @@ void HDF5Read_readData(CSOUND *csound, HDF5Read *self, HDF5Dataset *dataset,
 // Get the offset and early variables and work out the size of data to read
 // If the read vector size plus the offset is larger than the dataset size
 // reduce the vector size accordingly
+// If the dataset is buffered copy the vector from its blocks and return
+// If in real time the I/O thread holds the hdf5 library fill the vector
+// with zeros, count an overrun, increment the offset and return
 // If the vector size is less than the ksmps value, use the sample
 // buffer to store read data so the stride can be corrected before
 // writing it to the array data, if not just point directly to array
@@ -842,6 +1613,31 @@ void HDF5Read_readAudioData(CSOUND *csound, HDF5Read *self,
                          dataset->offset[0]);
     }
 
+    if (dataset->blockRows > 0) {
+
+      HDF5Read_readBlocks(csound, self, dataset, &inputDataPointer[offset],
+                          vectorSize);
+      return;
+    }
+
+    if (UNLIKELY(HDF5IO_perfLock(csound, self->io) == false)) {
+
+      size_t channelCount =
+        dataset->readType == ARATE_ARRAY ? dataset->elementCount : 1;
+      size_t channel;
+
+      HDF5IO_overrun(csound, dataset, "hdf5read");
+
+      for (channel = 0; channel < channelCount; ++channel) {
+
+        memset(&inputDataPointer[self->ksmps * channel + offset], 0,
+               sizeof(MYFLT) * vectorSize);
+      }
+
+      dataset->offset[0] += vectorSize;
+      return;
+    }
+
     MYFLT *dataPointer =
       vectorSize != self->ksmps ? dataset->sampleBuffer : inputDataPointer;
 
@@ -862,6 +1658,7 @@ void HDF5Read_readAudioData(CSOUND *csound, HDF5Read *self,
 
     HDF5Read_readData (csound, self, dataset, dataset->offset,
                        chunkDimensions, dataPointer);
+    HDF5IO_unlock(csound, self->io);
 
     if (vectorSize != self->ksmps) {
 
@@ -881,6 +1678,9 @@ void HDF5Read_readAudioData(CSOUND *csound, HDF5Read *self,
 //
 // If the offset of the dataset is larger than the data set size, no
 // more data to read to return
+// If the dataset is buffered copy one row from its blocks and return
+// If in real time the I/O thread holds the hdf5 library fill the row with
+// zeros, count an overrun, increment the offset and return
 // Create chunk dimension variable and set the appropriate size
 // Read the data from the dataset
 // Increment the offset variable
@@ -894,6 +1694,23 @@ void HDF5Read_readControlData(CSOUND *csound, HDF5Read *self,
       return;
     }
 
+    if (dataset->blockRows > 0) {
+
+      HDF5Read_readBlocks(csound, self, dataset, dataPointer, 1);
+      return;
+    }
+
+    if (UNLIKELY(HDF5IO_perfLock(csound, self->io) == false)) {
+
+      size_t frameSize =
+        dataset->readType == KRATE_ARRAY ? dataset->elementCount : 1;
+
+      HDF5IO_overrun(csound, dataset, "hdf5read");
+      memset(dataPointer, 0, sizeof(MYFLT) * frameSize);
+      dataset->offset[0]++;
+      return;
+    }
+
         // FIXME if this is called frequently or on the audio thread then this won't
         // work and will need a different solution
 #ifndef _MSC_VER
@@ -907,6 +1724,7 @@ void HDF5Read_readControlData(CSOUND *csound, HDF5Read *self,
 
     HDF5Read_readData(csound, self, dataset, dataset->offset,
                       chunkDimensions, dataPointer);
+    HDF5IO_unlock(csound, self->io);
     dataset->offset[0]++;
 #ifdef _MSC_VER
     free (chunkDimensions);
@@ -968,21 +1786,29 @@ int32_t HDF5Read_process(CSOUND *csound, HDF5Read *self)
 
 // Close the necessary variables when reading has finished
 //
-// Iterate through open datasets closing them in the hdf5 file
-// Close the hdf5 file
+// Report the control cycles that were dropped from each dataset
+// Queue the job that closes the datasets and then the hdf5 file behind any
+// blocks still being read, nothing here waits for the I/O thread
 
 int32_t HDF5Read_finish(CSOUND *csound, void *inReference)
 {
     HDF5Read *self = inReference;
+    int32_t count = self->datasets != NULL ? self->inputArgumentCount : 0;
     int32_t i;
-    for (i = 0; i < self->inputArgumentCount; ++i) {
 
-      HDF5Dataset *dataset = &self->datasets[i];
+    if (UNLIKELY(self->hdf5File == NULL)) {
+
+      return OK;
+    }
+
+    for (i = 0; i < count; ++i) {
 
-      HDF5ERROR(H5Dclose(dataset->datasetID));
+      HDF5IO_reportOverruns(csound, &self->datasets[i], "hdf5read");
     }
 
-    HDF5ERROR(H5Fclose(self->hdf5File->fileHandle));
+    HDF5IO_closeLater(csound, self->io, self->hdf5File, self->datasets,
+                      count, false);
+    self->hdf5File = NULL;
 
     return OK;
 }
@@ -1055,8 +1881,8 @@ void HDF5Read_initialiseHDF5Dataset(CSOUND *csound, HDF5Read *self,
 
     if (UNLIKELY(result <= 0)) {
 
-      csound->Die(csound, "%s", Str("hdf5read: Error, dataset does not exist or "
-                              "cannot be found in file"));
+      HDF5DIE("%s", Str("hdf5read: Error, dataset does not exist or "
+                        "cannot be found in file"));
     }
 
     dataset->datasetID = H5Dopen2(self->hdf5File->fileHandle,
@@ -1122,8 +1948,8 @@ void HDF5Read_checkReadTypeSanity(CSOUND *csound, HDF5Read *self,
     }
     else {
 
-      csound->Die(csound, "%s", Str("hdf5read: Unable to read saved type of "
-                              "dataset, exiting"));
+      HDF5DIE("%s", Str("hdf5read: Unable to read saved type of "
+                        "dataset, exiting"));
     }
 }
 
@@ -1387,6 +2213,88 @@ void HDF5Read_openDatasets(CSOUND *csound, HDF5Read *self)
     }
 }
 
+// Set up the blocks of the datasets that are read ahead
+//
+// Only a-rate and k-rate variables and k-rate arrays are buffered, a-rate
+// arrays are stored one array element after the other in memory so are read
+// directly
+// A block holds the rows for the set amount of control cycles, or the whole
+// dataset if it is shorter
+// Read the first block straight away so the first control cycles don't
+// find it missing, then ask the I/O thread to fill the rest of the ring
+
+void HDF5Read_initialiseBlocks(CSOUND *csound, HDF5Read *self)
+{
+    hsize_t kcycles = (hsize_t)self->io->blockKcycles;
+    int32_t i, j;
+
+    for (i = 0; i < self->inputArgumentCount; ++i) {
+
+      HDF5Dataset *dataset = &self->datasets[i];
+      hsize_t blockRows = 0;
+
+      dataset->blockRows = 0;
+
+      if (kcycles == 0
+          ||
+          dataset->readAll == true
+          ||
+          dataset->rank > H5S_MAX_RANK) {
+
+        continue;
+      }
+
+      switch (dataset->readType) {
+
+      case ARATE_VAR: {
+
+        blockRows = kcycles * self->ksmps;
+        dataset->frameSize = 1;
+        break;
+      }
+      case KRATE_VAR: {
+
+        blockRows = kcycles;
+        dataset->frameSize = 1;
+        break;
+      }
+      case KRATE_ARRAY: {
+
+        if (dataset->rank > 1) {
+
+          blockRows = kcycles;
+          dataset->frameSize = dataset->elementCount;
+        }
+        break;
+      }
+      default: {
+
+        break;
+      }
+      }
+
+      if (blockRows > dataset->datasetSize[0]) {
+
+        blockRows = dataset->datasetSize[0];
+      }
+
+      if (blockRows == 0) {
+
+        continue;
+      }
+
+      HDF5IO_initialiseBlocks(csound, self->io, dataset, dataset->datasetID,
+                              self->hdf5File->floatSize, HDF5IO_READ,
+                              blockRows, dataset->datasetSize);
+
+      for (j = 0; j < dataset->blockCount; ++j) {
+
+        HDF5Read_fetchBlock(csound, self, dataset, &dataset->blocks[j],
+                            j == 0);
+      }
+    }
+}
+
 
 static OENTRY localops[] = {
 
@@ -1409,6 +2317,16 @@ static OENTRY localops[] = {
     .iopadr = (SUBR)HDF5Read_initialise,
     .kopadr = (SUBR)HDF5Read_process,
     .aopadr = NULL
+  },
+  {
+    .opname = "hdf5buffer",
+    .dsblksiz = sizeof(HDF5Buffer),
+    .thread = 1,
+    .outypes = "",
+    .intypes = "io",
+    .iopadr = (SUBR)HDF5Buffer_initialise,
+    .kopadr = NULL,
+    .aopadr = NULL
   }
 };
 
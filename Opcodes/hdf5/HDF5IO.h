@@ -44,7 +44,83 @@ typedef struct _fft {
     AUXCH mem;
 } nFFT;
 
+// A job for the I/O thread, either a block of rows moved between memory
+// and a dataset or closing a file.
+// Writers fill a block and hand it over, readers hand over an empty block
+// and pick it up once it has been filled. Nobody waits for a block, an
+// opcode that finds its next block still busy counts an overrun.
 
+typedef enum HDF5IOJobType
+{
+    HDF5IO_READ,
+    HDF5IO_WRITE,
+    HDF5IO_CLOSE
+} HDF5IOJobType;
+
+typedef struct HDF5IOJob
+{
+    struct HDF5IOJob *next;
+    HDF5IOJobType type;
+    hid_t datasetID;
+    hid_t floatSize;
+    int32_t rank;
+    hsize_t offset[H5S_MAX_RANK];
+    hsize_t count[H5S_MAX_RANK];
+    MYFLT *data;
+    volatile int32_t busy;
+
+} HDF5IOJob;
+
+// A dataset closed by the I/O thread, with the size it is to be left at
+// and the ring of blocks to free
+
+typedef struct HDF5IOCloseDataset
+{
+    hid_t datasetID;
+    int32_t rank;
+    bool resize;
+    hsize_t size[H5S_MAX_RANK];
+    void *ring;
+
+} HDF5IOCloseDataset;
+
+// Closing a file once the I/O thread has finished the jobs queued before
+// it, the opcode that opened the file may be gone by then so the job
+// holds everything it needs and is freed when it is done
+
+typedef struct HDF5IOClose
+{
+    HDF5IOJob job;
+    hid_t fileHandle;
+    int32_t datasetCount;
+    HDF5IOCloseDataset *datasets;
+
+} HDF5IOClose;
+
+// The I/O thread shared by all hdf5 opcodes of a Csound instance
+//
+// hdf5Mutex serialises every call into the hdf5 library, in real time the
+// performance thread only ever tries to take it, queueMutex protects the
+// job queue, workLock wakes the thread when jobs are queued and doneLock
+// wakes offline renders waiting for a block
+
+typedef struct HDF5IOThread
+{
+    CSOUND *csound;
+    void *thread;
+    void *queueMutex;
+    void *hdf5Mutex;
+    void *workLock;
+    void *doneLock;
+    HDF5IOJob *first, *last;
+    volatile int32_t running;
+    volatile int32_t pending;
+    bool locked;
+    bool realtime;
+    int32_t blockKcycles;
+    int32_t ringBlocks;
+
+} HDF5IOThread;
 
 typedef struct HDF5Dataset
 {
@@ -71,6 +147,15 @@ typedef struct HDF5Dataset
 
     bool readAll;
 
+    size_t frameSize;
+    hsize_t blockRows;
+    HDF5IOJob *blocks;
+    int32_t blockCount;
+    int32_t currentBlock;
+    hsize_t blockFill;
+    hsize_t nextRow;
+    uint32_t overruns;
+
 } HDF5Dataset;
 
 typedef struct HDF5File
@@ -82,6 +167,16 @@ typedef struct HDF5File
 } HDF5File;
 
 
+typedef struct HDF5Buffer
+{
+    OPDS h;
+    MYFLT *kcycles;
+    MYFLT *blocks;
+
+} HDF5Buffer;
+
+int32_t HDF5Buffer_initialise(CSOUND *csound, HDF5Buffer *self);
+
 HDF5File *HDF5IO_newHDF5File(CSOUND *csound, AUXCH *hdf5FileMemory,
                              STRINGDAT *path, bool openForWriting);
 
@@ -97,6 +192,7 @@ typedef struct HDF5Write
     AUXCH hdf5FileMemory;
     HDF5Dataset *datasets;
     AUXCH datasetsMemory;
+    HDF5IOThread *io;
 
 } HDF5Write;
 
@@ -128,6 +224,7 @@ typedef struct HDF5Read
     HDF5Dataset *datasets;
     AUXCH datasetsMemory;
     bool isSampleAccurate;
+    HDF5IOThread *io;
 
 } HDF5Read;
 
@@ -140,3 +237,5 @@ int32_t HDF5Read_finish(CSOUND *csound, void *inReference);
 void HDF5Read_checkArgumentSanity(CSOUND *csound, const HDF5Read *self);
 
 void HDF5Read_openDatasets(CSOUND *csound, HDF5Read *self);
+
+void HDF5Read_initialiseBlocks(CSOUND *csound, HDF5Read *self);
@@ -0,0 +1,365 @@
+/*
+    hrtfdb.c: shared HRTF data for the hrtf opcodes
+
+    Copyright (C) 2026 The Csound Core Developers
+
+    This file is part of Csound.
+
+    The Csound Library is free software; you can redistribute it
+    and/or modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    Csound is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with Csound; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+    02110-1301 USA
+*/
+
+/* The hrtf opcodes all read the same pair of spectral data files and
+   derive the same tables from them.  This keeps one copy of those per
+   Csound instance, so starting many spatialised notes does the work
+   once instead of once per note. */
+
+#include "csoundCore.h"
+#include "hrtfdb.h"
+
+#include <math.h>
+
+#define SQUARE(X) ((X)*(X))
+
+/* static filter pairs kept per entry before new positions go uncached */
+#define HRTF_MAXSTATICS (256)
+
+typedef struct {
+    void    *lock;
+    HRTFDB  *list;
+} HRTFDB_GLOBALS;
+
+/* endian issues: swap bytes for ppc */
+#ifdef WORDS_BIGENDIAN
+static int32_t swap4bytes(CSOUND* csound, MEMFIL* mfp)
+{
+    char c1, c2, c3, c4;
+    char *p = mfp->beginp;
+    int32_t  size = mfp->length;
+
+    while (size >= 4)
+      {
+        c1 = p[0]; c2 = p[1]; c3 = p[2]; c4 = p[3];
+        p[0] = c4; p[1] = c3; p[2] = c2; p[3] = c1;
+        size -= 4; p +=4;
+      }
+
+    return OK;
+}
+#else
+static int32_t (*swap4bytes)(CSOUND*, MEMFIL*) = NULL;
+#endif
+
+static int32_t hrtfdb_reset(CSOUND *csound, void *userData)
+{
+    HRTFDB_GLOBALS *g = (HRTFDB_GLOBALS*) userData;
+    if (g->lock != NULL) {
+      csound->DestroyMutex(g->lock);
+      g->lock = NULL;
+    }
+    g->list = NULL;             /* entries go with the rest of memory */
+    return OK;
+}
+
+static HRTFDB_GLOBALS *hrtfdb_globals(CSOUND *csound)
+{
+    HRTFDB_GLOBALS *g =
+      (HRTFDB_GLOBALS*) csound->QueryGlobalVariable(csound, "::hrtfdb");
+    if (g == NULL) {
+      if (csound->CreateGlobalVariable(csound, "::hrtfdb",
+                                       sizeof(HRTFDB_GLOBALS)) != 0)
+        return NULL;
+      g = (HRTFDB_GLOBALS*) csound->QueryGlobalVariable(csound, "::hrtfdb");
+      g->lock = csound->Create_Mutex(0);
+      csound->RegisterResetCallback(csound, g, hrtfdb_reset);
+    }
+    return g;
+}
+
+static MEMFIL *hrtfdb_load(CSOUND *csound, const char *name,
+                           int32_t irlength, const char *side)
+{
+    MEMFIL *mfp = csound->ldmemfile2withCB(csound, name,
+                                           CSFTYPE_FLOATS_BINARY, swap4bytes);
+    if (UNLIKELY(mfp == NULL)) {
+      csound->InitError(csound,
+                        Str("\n\n\nCannot load %s data file, exiting\n\n"),
+                        side);
+      return NULL;
+    }
+    if (UNLIKELY(mfp->length <
+                 (int64_t) HRTF_NMEAS * irlength * (int64_t) sizeof(float))) {
+      csound->InitError(csound,
+                        Str("%s HRTF data file %s is too short for "
+                            "%d point impulses"), side, name, irlength);
+      return NULL;
+    }
+    return mfp;
+}
+
+HRTFDB *hrtfdb_open(CSOUND *csound, const char *filel, const char *filer,
+                    MYFLT sr)
+{
+    HRTFDB_GLOBALS *g = hrtfdb_globals(csound);
+    HRTFDB *db;
+    MEMFIL *fpl, *fpr;
+    int32_t i, irlength = (sr == FL(96000.0) ? 256 : 128);
+
+    if (UNLIKELY(g == NULL)) {
+      csound->InitError(csound, "%s", Str("hrtf: cannot create database"));
+      return NULL;
+    }
+    csound->LockMutex(g->lock);
+    for (db = g->list; db != NULL; db = db->nxt) {
+      if (db->sr == sr && !strcmp(db->filel, filel) &&
+          !strcmp(db->filer, filer)) {
+        db->refcount++;
+        csound->UnlockMutex(g->lock);
+        return db;
+      }
+    }
+    if (UNLIKELY((fpl = hrtfdb_load(csound, filel, irlength, "left")) == NULL ||
+                 (fpr = hrtfdb_load(csound, filer, irlength, "right")) == NULL)) {
+      csound->UnlockMutex(g->lock);
+      return NULL;
+    }
+    db = (HRTFDB*) csound->Calloc(csound, sizeof(HRTFDB));
+    strNcpy(db->filel, filel, MAXNAME);
+    strNcpy(db->filer, filer, MAXNAME);
+    db->sr = sr;
+    db->irlength = irlength;
+    db->irlengthpad = 2 * irlength;
+    db->overlapsize = irlength - 1;
+    db->refcount = 1;
+    db->left = (const float*) fpl->beginp;
+    db->right = (const float*) fpr->beginp;
+
+    db->minphasewin = (MYFLT*) csound->Calloc(csound,
+                                              2 * irlength * sizeof(MYFLT));
+    db->stftwin = db->minphasewin + irlength;
+    /* min phase win defined for irlength point impulse! */
+    db->minphasewin[0] = FL(1.0);
+    for (i = 1; i < (irlength / 2); i++)
+      db->minphasewin[i] = FL(2.0);
+    db->minphasewin[(irlength / 2)] = FL(1.0);
+    /* hann window for the stft */
+    for (i = 0; i < irlength; i++)
+      db->stftwin[i] =
+        FL(0.5) - (FL(0.5) * COS(i * TWOPI_F / (MYFLT)(irlength - 1)));
+
+    db->nxt = g->list;
+    g->list = db;
+    csound->UnlockMutex(g->lock);
+    return db;
+}
+
+void hrtfdb_close(CSOUND *csound, HRTFDB *db)
+{
+    HRTFDB_GLOBALS *g = hrtfdb_globals(csound);
+    HRTFDB **pp;
+
+    if (db == NULL || g == NULL)
+      return;
+    csound->LockMutex(g->lock);
+    if (--db->refcount > 0) {
+      csound->UnlockMutex(g->lock);
+      return;
+    }
+    for (pp = &g->list; *pp != NULL; pp = &(*pp)->nxt)
+      if (*pp == db) {
+        *pp = db->nxt;
+        break;
+      }
+    csound->UnlockMutex(g->lock);
+    while (db->statics != NULL) {
+      HRTFSTATIC *st = db->statics;
+      db->statics = st->nxt;
+      csound->Free(csound, st);
+    }
+    if (db->diffuse != NULL)
+      csound->Free(csound, db->diffuse);
+    csound->Free(csound, db->minphasewin);
+    csound->Free(csound, db);
+}
+
+/* measurements on the median plane occur once in the data set, all the
+   others stand for a mirrored pair */
+static int32_t hrtf_median(int32_t i)
+{
+    return (i == 0 || i == 28 || i == 29 || i == 59 || i == 60 || i == 96  ||
+            i == 97 || i == 133 || i == 134 || i == 170 || i == 171 ||
+            i == 207 || i == 208 || i == 244  || i == 245 || i == 275 ||
+            i == 276 || i == 304  || i == 305 || i == 328 || i == 346 ||
+            i == 347 || i == 359 || i == 360 || i == 366 || i == 367);
+}
+
+MYFLT *hrtfdb_diffuse(CSOUND *csound, HRTFDB *db)
+{
+    HRTFDB_GLOBALS *g = hrtfdb_globals(csound);
+    int32_t irlength = db->irlength, irlengthpad = db->irlengthpad;
+    const float *fpindexl = db->left, *fpindexr = db->right;
+    MYFLT *tmp, *power, *num, *ave, *coheru, *coherv, *buffl, *buffr;
+    MYFLT *filt, *filtu, *filtv;
+    MYFLT rel, rer, iml, imr, retemp, imtemp, coher;
+    int32_t i, j, skip = 0, median;
+
+    csound->LockMutex(g->lock);
+    if (db->diffuse != NULL) {
+      csound->UnlockMutex(g->lock);
+      return db->diffuse;
+    }
+
+    tmp = (MYFLT*) csound->Calloc(csound, 7 * irlength * sizeof(MYFLT));
+    power = tmp; num = tmp + irlength; ave = tmp + 2 * irlength;
+    coheru = tmp + 3 * irlength; coherv = tmp + 4 * irlength;
+    buffl = tmp + 5 * irlength; buffr = tmp + 6 * irlength;
+
+    /* diffuse field power and l * conj r, doubled for the mirrored
+       measurements as the data set is symmetrical */
+    for (i = 0; i < HRTF_NMEAS; i++, skip += irlength) {
+      median = hrtf_median(i);
+      for (j = 0; j < irlength; j++) {
+        buffl[j] = fpindexl[skip + j];
+        buffr[j] = fpindexr[skip + j];
+      }
+
+      /* 0 Hz and Nyq: may be a negative real val, no need for fabs()
+         as squaring anyway! */
+      if (median) {
+        power[0] = power[0] + SQUARE(buffl[0]);
+        power[1] = power[1] + SQUARE(buffl[1]);
+        num[0] = num[0] + (buffl[0] * buffr[0]);
+        num[1] = num[1] + (buffl[1] * buffr[1]);
+      }
+      else {
+        power[0] = power[0] + SQUARE(buffl[0]) + SQUARE(buffr[0]);
+        power[1] = power[1] + SQUARE(buffl[1]) + SQUARE(buffr[1]);
+        num[0] = num[0] + (buffl[0] * buffr[0]) + (buffr[0] * buffl[0]);
+        num[1] = num[1] + (buffl[1] * buffr[1]) + (buffr[1] * buffl[1]);
+      }
+
+      for (j = 2; j < irlength; j += 2) {
+        if (median)
+          power[j] = power[j] + (MYFLT)SQUARE(buffl[j]);
+        else
+          power[j] = power[j] + (MYFLT)SQUARE(buffl[j]) +
+            (MYFLT)SQUARE(buffr[j]);
+        power[j + 1] = FL(0.0);
+
+        /* back to rectangular: (a c + b d) + i(- a d + b c) */
+        rel = buffl[j] * COS(buffl[j + 1]);
+        iml = buffl[j] * SIN(buffl[j + 1]);
+        rer = buffr[j] * COS(buffr[j + 1]);
+        imr = buffr[j] * SIN(buffr[j + 1]);
+        if (median) {
+          num[j] = num[j] + ((rel * rer) + (iml * imr));
+          num[j + 1] = num[j + 1] + ((rel * -imr) + (iml * rer));
+        }
+        else {
+          num[j] = num[j] + ((rel * rer) + (iml * imr)) +
+            ((rer * rel) + (imr * iml));
+          num[j + 1] = num[j + 1] + ((rel * -imr) + (iml * rer)) +
+            ((rer * -iml) + (imr * rel));
+        }
+      }
+    }
+
+    for (i = 0; i < irlength; i++)
+      ave[i] = SQRT(power[i] / FL(710.0));
+
+    /* magnitudes of sum of conjugates; 0 & nyq = fabs() */
+    num[0] = FABS(num[0]);
+    num[1] = FABS(num[1]);
+    for (i = 2; i < irlength; i += 2) {
+      retemp = num[i];
+      imtemp = num[i + 1];
+      num[i] = SQRT(SQUARE(retemp) + SQUARE(imtemp));
+      num[i + 1] = FL(0.0);
+    }
+
+    /* coherence: sqrt(powl * powr) is just power in the symmetric case */
+    for (i = 0; i < irlength; i++) {
+      if (i > 1 && (i & 1)) {
+        coheru[i] = coherv[i] = FL(0.0);
+        continue;
+      }
+      coher = num[i] / power[i];
+      coheru[i] = SQRT((FL(1.0) + coher) / FL(2.0));
+      coherv[i] = SQRT((FL(1.0) - coher) / FL(2.0));
+    }
+
+    /* no need to go back to rectangular for fft, as phase = 0 */
+    csound->InverseRealFFT(csound, ave, irlength);
+    csound->InverseRealFFT(csound, coheru, irlength);
+    csound->InverseRealFFT(csound, coherv, irlength);
+
+    /* centre the impulses, zero pad and back to the frequency domain */
+    filt = (MYFLT*) csound->Calloc(csound, 3 * irlengthpad * sizeof(MYFLT));
+    filtu = filt + irlengthpad;
+    filtv = filtu + irlengthpad;
+    for (i = 0; i < irlength; i++) {
+      filt[i] = ave[(i + (irlength / 2)) % irlength];
+      filtu[i] = coheru[(i + (irlength / 2)) % irlength];
+      filtv[i] = coherv[(i + (irlength / 2)) % irlength];
+    }
+    csound->RealFFT(csound, filt, irlengthpad);
+    csound->RealFFT(csound, filtu, irlengthpad);
+    csound->RealFFT(csound, filtv, irlengthpad);
+    csound->Free(csound, tmp);
+
+    db->diffuse = filt;
+    csound->UnlockMutex(g->lock);
+    return filt;
+}
+
+HRTFSTATIC *hrtfdb_find_static(CSOUND *csound, HRTFDB *db,
+                               MYFLT angle, MYFLT elev, MYFLT radius)
+{
+    HRTFDB_GLOBALS *g = hrtfdb_globals(csound);
+    HRTFSTATIC *st;
+
+    csound->LockMutex(g->lock);
+    for (st = db->statics; st != NULL; st = st->nxt)
+      if (st->angle == angle && st->elev == elev && st->radius == radius)
+        break;
+    csound->UnlockMutex(g->lock);
+    return st;
+}
+
+HRTFSTATIC *hrtfdb_add_static(CSOUND *csound, HRTFDB *db,
+                              MYFLT angle, MYFLT elev, MYFLT radius,
+                              const MYFLT *left, const MYFLT *right)
+{
+    HRTFDB_GLOBALS *g = hrtfdb_globals(csound);
+    size_t nbytes = db->irlengthpad * sizeof(MYFLT);
+    HRTFSTATIC *st;
+
+    if (db->nstatics >= HRTF_MAXSTATICS)
+      return NULL;
+    st = (HRTFSTATIC*) csound->Malloc(csound, sizeof(HRTFSTATIC) + 2 * nbytes);
+    st->angle = angle;
+    st->elev = elev;
+    st->radius = radius;
+    st->left = (MYFLT*) (st + 1);
+    st->right = st->left + db->irlengthpad;
+    memcpy(st->left, left, nbytes);
+    memcpy(st->right, right, nbytes);
+    csound->LockMutex(g->lock);
+    st->nxt = db->statics;
+    db->statics = st;
+    db->nstatics++;
+    csound->UnlockMutex(g->lock);
+    return st;
+}
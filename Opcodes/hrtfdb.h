@@ -0,0 +1,77 @@
+/*
+    hrtfdb.h: shared HRTF data for the hrtf opcodes
+
+    Copyright (C) 2026 The Csound Core Developers
+
+    This file is part of Csound.
+
+    The Csound Library is free software; you can redistribute it
+    and/or modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    Csound is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with Csound; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+    02110-1301 USA
+*/
+
+#ifndef CSOUND_HRTFDB_H
+#define CSOUND_HRTFDB_H
+
+/* measurements held in an mit style data file (one side of the head,
+   the other side is read by swapping ears) */
+#define HRTF_NMEAS      (368)
+
+/* filter pair for a fixed source position, as built by hrtfstat */
+typedef struct hrtfstatic_ {
+    struct hrtfstatic_ *nxt;
+    MYFLT   angle, elev, radius;
+    MYFLT   *left, *right;          /* irlengthpad point spectra */
+} HRTFSTATIC;
+
+/* One entry per pair of data files and processing rate, shared
+   read-only by every instance that uses them.  Entries are reference
+   counted and go away with their last user. */
+typedef struct hrtfdb_ {
+    struct hrtfdb_ *nxt;
+    char    filel[MAXNAME], filer[MAXNAME];
+    MYFLT   sr;
+    int32_t irlength, irlengthpad, overlapsize;
+    int32_t refcount;
+    /* mag/phase spectra, straight from the (byte swapped) files */
+    const float *left, *right;
+    /* minimum phase cepstral window and stft window, irlength points */
+    MYFLT   *minphasewin, *stftwin;
+    /* diffuse field and coherence filters for hrtfreverb: three
+       irlengthpad point spectra, built on first use */
+    MYFLT   *diffuse;
+    HRTFSTATIC *statics;
+    int32_t nstatics;
+} HRTFDB;
+
+/* Find or load the data for files filel/filer at rate sr (44100, 48000
+   or 96000) and take a reference to it.  Reports an init error and
+   returns NULL if either file cannot be used. */
+HRTFDB *hrtfdb_open(CSOUND *, const char *filel, const char *filer,
+                    MYFLT sr);
+/* Drop a reference taken by hrtfdb_open(). */
+void hrtfdb_close(CSOUND *, HRTFDB *);
+/* Diffuse field average, u and v coherence spectra, each irlengthpad
+   points long, one after the other. */
+MYFLT *hrtfdb_diffuse(CSOUND *, HRTFDB *);
+/* Look up a static filter pair for a position, or NULL. */
+HRTFSTATIC *hrtfdb_find_static(CSOUND *, HRTFDB *,
+                               MYFLT angle, MYFLT elev, MYFLT radius);
+/* Keep a copy of a freshly built pair; returns the shared copy, or NULL
+   if the cache is full and the caller should keep its own. */
+HRTFSTATIC *hrtfdb_add_static(CSOUND *, HRTFDB *,
+                              MYFLT angle, MYFLT elev, MYFLT radius,
+                              const MYFLT *left, const MYFLT *right);
+
+#endif  /* CSOUND_HRTFDB_H */
@@ -24,6 +24,7 @@
 /* #include "csdl.h" */
 #include "csoundCore.h"
 #include "interlocks.h"
+#include "hrtfdb.h"
 
 #define SQUARE(X) ((X)*(X))
 
@@ -34,27 +35,6 @@
 static const int32_t elevationarray[14] =
   {56, 60, 72, 72, 72, 72, 72, 60, 56, 45, 36, 24, 12, 1 };
 
-/* for ppc byte switch */
-#ifdef WORDS_BIGENDIAN
-static int32_t swap4bytes(CSOUND* csound, MEMFIL* mfp)
-{
-    char c1, c2, c3, c4;
-    char *p = mfp->beginp;
-    int32_t  size = mfp->length;
-
-    while (size >= 4)
-      {
-        c1 = p[0]; c2 = p[1]; c3 = p[2]; c4 = p[3];
-        p[0] = c4; p[1] = c3; p[2] = c2; p[3] = c1;
-        size -= 4; p +=4;
-      }
-
-    return OK;
-}
-#else
-static int32_t (*swap4bytes)(CSOUND*, MEMFIL*) = NULL;
-#endif
-
 /* low pass filter for overall surface shape */
 MYFLT filter(MYFLT* sig, MYFLT highcoeff, MYFLT lowcoeff,
              MYFLT *del, int32_t vecsize, MYFLT sr)
@@ -223,18 +203,26 @@ typedef struct
   /* wall filter q*/
   MYFLT q;
 
-  /* file pointers*/
-  float *fpbeginl, *fpbeginr;
+  /* shared data set, file pointers*/
+  HRTFDB *db;
+  const float *fpbeginl, *fpbeginr;
 
 } early;
 
+static int32_t early_deinit(CSOUND *csound, void *pp)
+{
+    early *p = (early *) pp;
+    hrtfdb_close(csound, p->db);
+    p->db = NULL;
+    return OK;
+}
+
 static int32_t early_init(CSOUND *csound, early *p)
 {
     /* iterator */
     int32_t i;
 
     /* left and right data files: spectral mag, phase format.*/
-    MEMFIL *fpl=NULL, *fpr=NULL;
     char filel[MAXNAME],filer[MAXNAME];
 
     /* processing sizes*/
@@ -317,24 +305,17 @@ static int32_t early_init(CSOUND *csound, early *p)
     strNcpy(filel, (char*) p->ifilel->data, MAXNAME-1); //filel[MAXNAME-1]='\0';
     strNcpy(filer, (char*) p->ifiler->data, MAXNAME-1); //filer[MAXNAME-1]='\0';
 
-    /* reading files, with byte swap */
-    fpl = csound->ldmemfile2withCB(csound, filel, CSFTYPE_FLOATS_BINARY,
-                                   swap4bytes);
-    if (UNLIKELY(fpl == NULL))
-      return
-        csound->InitError(csound,
-                          Str("\n\n\nCannot load left data file, exiting\n\n"));
-
-    fpr = csound->ldmemfile2withCB(csound, filer, CSFTYPE_FLOATS_BINARY,
-                                   swap4bytes);
-    if (UNLIKELY(fpr == NULL))
-      return
-        csound->InitError(csound,
-                          Str("\n\n\nCannot load right data file, exiting\n\n"));
+    /* shared, byte swapped data */
+    if (p->db != NULL)
+      hrtfdb_close(csound, p->db);
+    p->db = hrtfdb_open(csound, filel, filer, sr);
+    if (UNLIKELY(p->db == NULL))
+      return NOTOK;
+    csound->RegisterDeinitCallback(csound, p, early_deinit);
 
     /* file handles */
-    p->fpbeginl = (float *) fpl->beginp;
-    p->fpbeginr = (float *) fpr->beginp;
+    p->fpbeginl = p->db->left;
+    p->fpbeginr = p->db->right;
 
     /* setup structure values */
     p->irlength = irlength;
@@ -812,8 +793,8 @@ static int32_t early_process(CSOUND *csound, early *p)
     MYFLT *hrtfrpadold = (MYFLT *)p->hrtfrpadold.auxp;
 
     /* pointers into HRTF files: floating point data(even in 64 bit csound) */
-    float *fpindexl = (float *)p->fpbeginl;
-    float *fpindexr = (float *)p->fpbeginr;
+    const float *fpindexl = p->fpbeginl;
+    const float *fpindexr = p->fpbeginr;
 
     /* local copies */
     MYFLT srcx = *p->srcx;
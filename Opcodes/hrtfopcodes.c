@@ -23,6 +23,7 @@
 
 #include "csoundCore.h"
 #include "interlocks.h"
+#include "hrtfdb.h"
 
 #include <math.h>
 /* definitions */
@@ -121,25 +122,6 @@ static const float minphasedels[368] =
 };
 
 
-#ifdef WORDS_BIGENDIAN
-static int32_t swap4bytes(CSOUND* csound, MEMFIL* mfp)
-{
-    char c1, c2, c3, c4;
-    char *p = mfp->beginp;
-    int32_t  size = mfp->length;
-
-    while (size >= 4)
-      {
-        c1 = p[0]; c2 = p[1]; c3 = p[2]; c4 = p[3];
-        p[0] = c4; p[1] = c3; p[2] = c2; p[3] = c1;
-        size -= 4; p +=4;
-      }
-
-    return OK;
-}
-#else
-static int32_t (*swap4bytes)(CSOUND*, MEMFIL*) = NULL;
-#endif
 
 /* Csound hrtf magnitude interpolation, phase truncation object */
 
@@ -160,7 +142,9 @@ typedef struct
         /* check if relative source has changed! */
         MYFLT anglev, elevv;
 
-        float *fpbeginl,*fpbeginr;
+        /* shared data set */
+        HRTFDB *db;
+        const float *fpbeginl,*fpbeginr;
 
         /* see definitions in INIT */
         int32_t irlength, irlengthpad, overlapsize;
@@ -209,8 +193,8 @@ typedef struct
 
         /* min phase buffers */
         AUXCH logmagl,logmagr,xhatwinl,xhatwinr,expxhatwinl,expxhatwinr;
-        /* min phase window: a static buffer */
-        AUXCH win;
+        /* min phase window: shared */
+        const MYFLT *win;
         MYFLT delayfloat;
 
         /* delay */
@@ -219,18 +203,23 @@ typedef struct
 }
 hrtfmove;
 
+static int32_t hrtfmove_deinit(CSOUND *csound, void *pp)
+{
+    hrtfmove *p = (hrtfmove *) pp;
+    hrtfdb_close(csound, p->db);
+    p->db = NULL;
+    return OK;
+}
+
 static int32_t hrtfmove_init(CSOUND *csound, hrtfmove *p)
 {
     /* left and right data files: spectral mag, phase format. */
-    MEMFIL *fpl = NULL,*fpr = NULL;
-    int32_t i;
     char filel[MAXNAME],filer[MAXNAME];
 
     int32_t mode = (int32_t)*p->omode;
     int32_t fade = (int32_t)*p->ofade;
     MYFLT sr = *p->osr;
 
-    MYFLT *win;
 
     /* time domain impulse length, padded, overlap add */
     int32_t irlength=0, irlengthpad=0, overlapsize=0;
@@ -280,20 +269,13 @@ static int32_t hrtfmove_init(CSOUND *csound, hrtfmove *p)
     strNcpy(filel, (char*) p->ifilel->data, MAXNAME-1); //filel[MAXNAME-1]='\0';
     strNcpy(filer, (char*) p->ifiler->data, MAXNAME-1); //filel[MAXNAME-1]='\0';
 
-    /* reading files, with byte swap */
-    fpl = csound->ldmemfile2withCB(csound, filel, CSFTYPE_FLOATS_BINARY,
-                                   swap4bytes);
-    if (UNLIKELY(fpl == NULL))
-      return
-        csound->InitError(csound,
-                          Str("\n\n\nCannot load left data file, exiting\n\n"));
-
-    fpr = csound->ldmemfile2withCB(csound, filer, CSFTYPE_FLOATS_BINARY,
-                                   swap4bytes);
-    if (UNLIKELY(fpr == NULL))
-      return
-        csound->InitError(csound,
-                          Str("\n\n\nCannot load right data file, exiting\n\n"));
+    /* shared, byte swapped data */
+    if (p->db != NULL)
+      hrtfdb_close(csound, p->db);
+    p->db = hrtfdb_open(csound, filel, filer, sr);
+    if (UNLIKELY(p->db == NULL))
+      return NOTOK;
+    csound->RegisterDeinitCallback(csound, p, hrtfmove_deinit);
 
     p->irlength = irlength;
     p->irlengthpad = irlengthpad;
@@ -303,8 +285,8 @@ static int32_t hrtfmove_init(CSOUND *csound, hrtfmove *p)
     p->fadebuffer = (int32_t)fade*irlength;
 
     /* file handles */
-    p->fpbeginl = (float *) fpl->beginp;
-    p->fpbeginr = (float *) fpr->beginp;
+    p->fpbeginl = p->db->left;
+    p->fpbeginr = p->db->right;
 
     /* common buffers (used by both min phase and phasetrunc) */
     if (!p->insig.auxp || p->insig.size < irlength * sizeof(MYFLT))
@@ -450,18 +432,8 @@ static int32_t hrtfmove_init(CSOUND *csound, hrtfmove *p)
     memset(p->delmeml.auxp, 0, (int32_t)(sr * maxdeltime) * sizeof(MYFLT));
     memset(p->delmemr.auxp, 0, (int32_t)(sr * maxdeltime) * sizeof(MYFLT));
 
-    if (!p->win.auxp || p->win.size < irlength * sizeof(MYFLT))
-      csound->AuxAlloc(csound, irlength*sizeof(MYFLT), &p->win);
-
-    win = (MYFLT *)p->win.auxp;
-
     /* min phase win defined for irlength point impulse! */
-    win[0] = FL(1.0);
-    for(i = 1; i < (irlength / 2); i++)
-      win[i] = FL(2.0);
-    win[(irlength / 2)] = FL(1.0);
-    for(i = ((irlength / 2) + 1); i < irlength; i++)
-      win[i] = FL(0.0);
+    p->win = p->db->minphasewin;
 
     p->mdtl = (int32_t)(FL(0.00095) * sr);
     p->mdtr = (int32_t)(FL(0.00095) * sr);
@@ -509,8 +481,8 @@ static int32_t hrtfmove_process(CSOUND *csound, hrtfmove *p)
     int32_t counter = p->counter;
 
     /* pointers into HRTF files: floating point data (even in 64 bit csound) */
-    float *fpindexl;
-    float *fpindexr;
+    const float *fpindexl;
+    const float *fpindexr;
 
     int32_t i,elevindex, angleindex, skip = 0;
 
@@ -578,7 +550,7 @@ static int32_t hrtfmove_process(CSOUND *csound, hrtfmove *p)
     MYFLT *expxhatwinr = (MYFLT *)p->expxhatwinr.auxp;
 
     /* min phase window */
-    MYFLT *win = (MYFLT *)p->win.auxp;
+    const MYFLT *win = p->win;
 
     /* min phase delay variables */
     MYFLT *delmeml = (MYFLT *)p->delmeml.auxp;
@@ -596,8 +568,8 @@ static int32_t hrtfmove_process(CSOUND *csound, hrtfmove *p)
     MYFLT outvdl, outvdr, vdtl, vdtr, fracl, fracr, rpl, rpr;
 
     /* start indices at correct value (start of file)/ zero indices. */
-    fpindexl = (float *) p->fpbeginl;
-    fpindexr = (float *) p->fpbeginr;
+    fpindexl = p->fpbeginl;
+    fpindexr = p->fpbeginr;
 
     if (UNLIKELY(offset)) {
       memset(outsigl, '\0', offset*sizeof(MYFLT));
@@ -1360,6 +1332,11 @@ typedef struct
         int32_t counter;
         MYFLT sr;
 
+        /* shared data set */
+        HRTFDB *db;
+        /* filter spectra in use: shared, or hrtflpad/hrtfrpad */
+        MYFLT *hrtfl, *hrtfr;
+
         /* hrtf data padded */
         AUXCH hrtflpad,hrtfrpad;
         /* in and output buffers */
@@ -1384,10 +1361,17 @@ typedef struct
 }
 hrtfstat;
 
+static int32_t hrtfstat_deinit(CSOUND *csound, void *pp)
+{
+    hrtfstat *p = (hrtfstat *) pp;
+    hrtfdb_close(csound, p->db);
+    p->db = NULL;
+    return OK;
+}
+
 static int32_t hrtfstat_init(CSOUND *csound, hrtfstat *p)
 {
     /* left and right data files: spectral mag, phase format. */
-    MEMFIL *fpl = NULL, *fpr = NULL;
     char filel[MAXNAME], filer[MAXNAME];
 
     /* interpolation values */
@@ -1412,8 +1396,8 @@ static int32_t hrtfstat_init(CSOUND *csound, hrtfstat *p)
     MYFLT sr = *p->osr;
 
         /* pointers into HRTF files */
-    float *fpindexl=NULL;
-    float *fpindexr=NULL;
+    const float *fpindexl=NULL;
+    const float *fpindexr=NULL;
 
     /* time domain impulse length, padded, overlap add */
     int32_t irlength=0, irlengthpad=0, overlapsize=0;
@@ -1436,6 +1420,7 @@ static int32_t hrtfstat_init(CSOUND *csound, hrtfstat *p)
 
     /* shift */
     int32_t shift;
+    HRTFSTATIC *st;
     MYFLT *leftshiftbuffer;
     MYFLT *rightshiftbuffer;
 
@@ -1467,20 +1452,13 @@ static int32_t hrtfstat_init(CSOUND *csound, hrtfstat *p)
     strNcpy(filel, (char*) p->ifilel->data, MAXNAME-1); //filel[MAXNAME-1]='\0';
     strNcpy(filer, (char*) p->ifiler->data, MAXNAME-1); //filel[MAXNAME-1]='\0';
 
-    /* reading files, with byte swap */
-    fpl = csound->ldmemfile2withCB(csound, filel, CSFTYPE_FLOATS_BINARY,
-                                   swap4bytes);
-    if (UNLIKELY(fpl == NULL))
-      return
-        csound->InitError(csound,
-                          Str("\n\n\nCannot load left data file, exiting\n\n"));
-
-    fpr = csound->ldmemfile2withCB(csound, filer, CSFTYPE_FLOATS_BINARY,
-                                   swap4bytes);
-    if (UNLIKELY(fpr == NULL))
-      return
-        csound->InitError(csound,
-                          Str("\n\n\nCannot load right data file, exiting\n\n"));
+    /* shared, byte swapped data */
+    if (p->db != NULL)
+      hrtfdb_close(csound, p->db);
+    p->db = hrtfdb_open(csound, filel, filer, sr);
+    if (UNLIKELY(p->db == NULL))
+      return NOTOK;
+    csound->RegisterDeinitCallback(csound, p, hrtfstat_deinit);
 
     p->irlength = irlength;
     p->irlengthpad = irlengthpad;
@@ -1490,8 +1468,8 @@ static int32_t hrtfstat_init(CSOUND *csound, hrtfstat *p)
 
     /* start indices at correct value (start of file)/ zero indices.
        (do not need to store here, as only accessing in INIT) */
-    fpindexl = (float *) fpl->beginp;
-    fpindexr = (float *) fpr->beginp;
+    fpindexl = p->db->left;
+    fpindexr = p->db->right;
 
     /* buffers */
     if (!p->insig.auxp || p->insig.size < irlength * sizeof(MYFLT))
@@ -1500,16 +1478,8 @@ static int32_t hrtfstat_init(CSOUND *csound, hrtfstat *p)
       csound->AuxAlloc(csound, irlengthpad*sizeof(MYFLT), &p->outl);
     if (!p->outr.auxp || p->outr.size < irlengthpad * sizeof(MYFLT))
       csound->AuxAlloc(csound, irlengthpad*sizeof(MYFLT), &p->outr);
-    if (!p->hrtflpad.auxp || p->hrtflpad.size < irlengthpad * sizeof(MYFLT))
-      csound->AuxAlloc(csound, irlengthpad*sizeof(MYFLT), &p->hrtflpad);
-    if (!p->hrtfrpad.auxp || p->hrtfrpad.size < irlengthpad * sizeof(MYFLT))
-      csound->AuxAlloc(csound, irlengthpad*sizeof(MYFLT), &p->hrtfrpad);
     if (!p->complexinsig.auxp || p->complexinsig.size < irlengthpad * sizeof(MYFLT))
       csound->AuxAlloc(csound, irlengthpad*sizeof(MYFLT), &p-> complexinsig);
-    if (!p->hrtflfloat.auxp || p->hrtflfloat.size < irlength * sizeof(MYFLT))
-      csound->AuxAlloc(csound, irlength*sizeof(MYFLT), &p->hrtflfloat);
-    if (!p->hrtfrfloat.auxp || p->hrtfrfloat.size < irlength * sizeof(MYFLT))
-      csound->AuxAlloc(csound, irlength*sizeof(MYFLT), &p->hrtfrfloat);
     if (!p->outspecl.auxp || p->outspecl.size < irlengthpad * sizeof(MYFLT))
       csound->AuxAlloc(csound, irlengthpad*sizeof(MYFLT), &p->outspecl);
     if (!p->outspecr.auxp || p->outspecr.size < irlengthpad * sizeof(MYFLT))
@@ -1522,16 +1492,50 @@ static int32_t hrtfstat_init(CSOUND *csound, hrtfstat *p)
     memset(p->insig.auxp, 0, irlength * sizeof(MYFLT));
     memset(p->outl.auxp, 0, irlengthpad * sizeof(MYFLT));
     memset(p->outr.auxp, 0, irlengthpad * sizeof(MYFLT));
-    memset(p->hrtflpad.auxp, 0, irlengthpad * sizeof(MYFLT));
-    memset(p->hrtfrpad.auxp, 0, irlengthpad * sizeof(MYFLT));
     memset(p->complexinsig.auxp, 0, irlengthpad * sizeof(MYFLT));
-    memset(p->hrtflfloat.auxp, 0, irlength * sizeof(MYFLT));
-    memset(p->hrtfrfloat.auxp, 0, irlength * sizeof(MYFLT));
     memset(p->outspecl.auxp, 0, irlengthpad * sizeof(MYFLT));
     memset(p->outspecr.auxp, 0, irlengthpad * sizeof(MYFLT));
     memset(p->overlapl.auxp, 0, overlapsize * sizeof(MYFLT));
     memset(p->overlapr.auxp, 0, overlapsize * sizeof(MYFLT));
 
+    if(r <= 0 || r > 15)
+      r = FL(8.8);
+
+    if(elev > FL(90.0))
+      elev = FL(90.0);
+    if(elev < FL(-40.0))
+      elev = FL(-40.0);
+
+    while(angle < FL(0.0))
+      angle += FL(360.0);
+    while(angle >= FL(360.0))
+      angle -= FL(360.0);
+
+    p->counter = 0;
+
+    /* another instance may already have built this position */
+    st = hrtfdb_find_static(csound, p->db, angle, elev, r);
+    if (st != NULL) {
+      p->hrtfl = st->left;
+      p->hrtfr = st->right;
+      return OK;
+    }
+
+    /* hrtf data padded, and working buffers to build it */
+    if (!p->hrtflpad.auxp || p->hrtflpad.size < irlengthpad * sizeof(MYFLT))
+      csound->AuxAlloc(csound, irlengthpad*sizeof(MYFLT), &p->hrtflpad);
+    if (!p->hrtfrpad.auxp || p->hrtfrpad.size < irlengthpad * sizeof(MYFLT))
+      csound->AuxAlloc(csound, irlengthpad*sizeof(MYFLT), &p->hrtfrpad);
+    if (!p->hrtflfloat.auxp || p->hrtflfloat.size < irlength * sizeof(MYFLT))
+      csound->AuxAlloc(csound, irlength*sizeof(MYFLT), &p->hrtflfloat);
+    if (!p->hrtfrfloat.auxp || p->hrtfrfloat.size < irlength * sizeof(MYFLT))
+      csound->AuxAlloc(csound, irlength*sizeof(MYFLT), &p->hrtfrfloat);
+
+    memset(p->hrtflpad.auxp, 0, irlengthpad * sizeof(MYFLT));
+    memset(p->hrtfrpad.auxp, 0, irlengthpad * sizeof(MYFLT));
+    memset(p->hrtflfloat.auxp, 0, irlength * sizeof(MYFLT));
+    memset(p->hrtfrfloat.auxp, 0, irlength * sizeof(MYFLT));
+
     /* interpolation values */
     if (!p->lowl1.auxp || p->lowl1.size < irlength * sizeof(MYFLT))
       csound->AuxAlloc(csound, irlength * sizeof(MYFLT), &p->lowl1);
@@ -1589,19 +1593,6 @@ static int32_t hrtfstat_init(CSOUND *csound, hrtfstat *p)
     hrtflpad = (MYFLT *)p->hrtflpad.auxp;
     hrtfrpad = (MYFLT *)p->hrtfrpad.auxp;
 
-    if(r <= 0 || r > 15)
-      r = FL(8.8);
-
-    if(elev > FL(90.0))
-      elev = FL(90.0);
-    if(elev < FL(-40.0))
-      elev = FL(-40.0);
-
-    while(angle < FL(0.0))
-      angle += FL(360.0);
-    while(angle >= FL(360.0))
-      angle -= FL(360.0);
-
     /* two nearest elev indices to avoid recalculating */
     elevindexstore = (elev - minelev) / elevincrement;
     elevindexlow = (int32_t)elevindexstore;
@@ -1868,8 +1859,10 @@ static int32_t hrtfstat_init(CSOUND *csound, hrtfstat *p)
     csound->RealFFT(csound, hrtflpad, irlengthpad);
     csound->RealFFT(csound, hrtfrpad, irlengthpad);
 
-        /* initialize counter */
-    p->counter = 0;
+    /* share it, or keep our own if the cache is full */
+    st = hrtfdb_add_static(csound, p->db, angle, elev, r, hrtflpad, hrtfrpad);
+    p->hrtfl = st != NULL ? st->left : hrtflpad;
+    p->hrtfr = st != NULL ? st->right : hrtfrpad;
 
     return OK;
 }
@@ -1887,8 +1880,8 @@ static int32_t hrtfstat_process(CSOUND *csound, hrtfstat *p)
     MYFLT *outl = (MYFLT *)p->outl.auxp;
     MYFLT *outr = (MYFLT *)p->outr.auxp;
 
-    MYFLT *hrtflpad = (MYFLT *)p->hrtflpad.auxp;
-    MYFLT *hrtfrpad = (MYFLT *)p->hrtfrpad.auxp;
+    MYFLT *hrtflpad = p->hrtfl;
+    MYFLT *hrtfrpad = p->hrtfr;
 
     MYFLT *complexinsig = (MYFLT *)p->complexinsig.auxp;
     MYFLT *outspecl = (MYFLT *)p->outspecl.auxp;
@@ -2019,7 +2012,9 @@ MYFLT *ooverlap, *oradius, *osr;
 
         int32_t hopsize;
 
-        float *fpbeginl,*fpbeginr;
+        /* shared data set */
+        HRTFDB *db;
+        const float *fpbeginl,*fpbeginr;
 
         /* to keep track of process */
         int32_t counter, t;
@@ -2039,26 +2034,30 @@ MYFLT *ooverlap, *oradius, *osr;
         /* interpolation buffers */
         AUXCH lowl1,lowr1,lowl2,lowr2,highl1,highr1,highl2,highr2;
 
-        /* stft window */
-        AUXCH win;
+        /* stft window: shared */
+        const MYFLT *win;
         /* used for skipping into next stft array on way in and out */
         AUXCH overlapskipin, overlapskipout;
 
 }
 hrtfmove2;
 
+static int32_t hrtfmove2_deinit(CSOUND *csound, void *pp)
+{
+    hrtfmove2 *p = (hrtfmove2 *) pp;
+    hrtfdb_close(csound, p->db);
+    p->db = NULL;
+    return OK;
+}
+
 static int32_t hrtfmove2_init(CSOUND *csound, hrtfmove2 *p)
 {
     /* left and right data files: spectral mag, phase format. */
-    MEMFIL *fpl = NULL, *fpr = NULL;
-
     char filel[MAXNAME], filer[MAXNAME];
 
     /* time domain impulse length */
     int32_t irlength=0;
 
-    /* stft window */
-    MYFLT *win;
     /* overlap skip buffers */
     int32_t *overlapskipin, *overlapskipout;
     //MYFLT *inbuf;
@@ -2089,27 +2088,20 @@ static int32_t hrtfmove2_init(CSOUND *csound, hrtfmove2 *p)
     strNcpy(filel, (char*) p->ifilel->data, MAXNAME-1); //filel[MAXNAME-1] = '\0';
     strNcpy(filer, (char*) p->ifiler->data, MAXNAME-1); //filer[MAXNAME-1] = '\0';
 
-    /* reading files, with byte swap */
-    fpl = csound->ldmemfile2withCB(csound, filel, CSFTYPE_FLOATS_BINARY,
-                                   swap4bytes);
-    if (UNLIKELY(fpl == NULL))
-     return
-        csound->InitError(csound,
-                          Str("\n\n\nCannot load left data file, exiting\n\n"));
-
-    fpr = csound->ldmemfile2withCB(csound, filer, CSFTYPE_FLOATS_BINARY,
-                                   swap4bytes);
-    if (UNLIKELY(fpr == NULL))
-      return
-        csound->InitError(csound,
-                          Str("\n\n\nCannot load right data file, exiting\n\n"));
+    /* shared, byte swapped data */
+    if (p->db != NULL)
+      hrtfdb_close(csound, p->db);
+    p->db = hrtfdb_open(csound, filel, filer, sr);
+    if (UNLIKELY(p->db == NULL))
+      return NOTOK;
+    csound->RegisterDeinitCallback(csound, p, hrtfmove2_deinit);
 
     p->irlength = irlength;
     p->sroverN = sr / irlength;
 
     /* file handles */
-    p->fpbeginl = (float *) fpl->beginp;
-    p->fpbeginr = (float *) fpr->beginp;
+    p->fpbeginl = p->db->left;
+    p->fpbeginr = p->db->right;
 
     if(overlap != 2 && overlap != 4 && overlap != 8 && overlap != 16)
       overlap = 4;
@@ -2176,25 +2168,20 @@ static int32_t hrtfmove2_init(CSOUND *csound, hrtfmove2 *p)
     memset(p->highr1.auxp, 0, irlength * sizeof(MYFLT));
     memset(p->highr2.auxp, 0, irlength * sizeof(MYFLT));
 
-    if (!p->win.auxp || p->win.size < irlength * sizeof(MYFLT))
-      csound->AuxAlloc(csound, irlength * sizeof(MYFLT), &p->win);
     if (!p->overlapskipin.auxp || p->overlapskipin.size < overlap * sizeof(int32_t))
       csound->AuxAlloc(csound, overlap * sizeof(int32_t), &p->overlapskipin);
     if (!p->overlapskipout.auxp ||
         p->overlapskipout.size < overlap * sizeof(int32_t))
       csound->AuxAlloc(csound, overlap * sizeof(int32_t), &p->overlapskipout);
 
-    memset(p->win.auxp, 0, irlength * sizeof(MYFLT));
     memset(p->overlapskipin.auxp, 0, overlap * sizeof(int32_t));
     memset(p->overlapskipout.auxp, 0, overlap * sizeof(int32_t));
 
-    win = (MYFLT *)p->win.auxp;
     overlapskipin = (int32_t *)p->overlapskipin.auxp;
     overlapskipout = (int32_t *)p->overlapskipout.auxp;
 
     /* window is Hanning */
-    for(i = 0; i < irlength; i++)
-      win[i] = FL(0.5) - (FL(0.5) * COS(i * TWOPI_F / (MYFLT)(irlength - 1)));
+    p->win = p->db->stftwin;
 
     for(i = 0; i < overlap; i++)
       {
@@ -2247,7 +2234,7 @@ static int32_t hrtfmove2_process(CSOUND *csound, hrtfmove2 *p)
 
     int32_t hopsize = p->hopsize;
 
-    MYFLT *win = (MYFLT *)p->win.auxp;
+    const MYFLT *win = p->win;
     int32_t *overlapskipin = (int32_t *)p->overlapskipin.auxp;
     int32_t *overlapskipout = (int32_t *)p->overlapskipout.auxp;
 
@@ -2255,8 +2242,8 @@ static int32_t hrtfmove2_process(CSOUND *csound, hrtfmove2 *p)
     int32_t t = p ->t;
 
         /* pointers into HRTF files */
-    float *fpindexl;
-    float *fpindexr;
+    const float *fpindexl;
+    const float *fpindexr;
 
     int32_t i, skip = 0;
     uint32_t offset = p->h.insdshead->ksmps_offset;
@@ -2291,8 +2278,8 @@ static int32_t hrtfmove2_process(CSOUND *csound, hrtfmove2 *p)
 
 
     /* start indices at correct value (start of file)/ zero indices. */
-    fpindexl = (float *) p->fpbeginl;
-    fpindexr = (float *) p->fpbeginr;
+    fpindexl = p->fpbeginl;
+    fpindexr = p->fpbeginr;
 
     if (UNLIKELY(offset)) {
       memset(outsigl, '\0', offset*sizeof(MYFLT));
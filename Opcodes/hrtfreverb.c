@@ -23,30 +23,10 @@
 
 #include "csoundCore.h"
 #include "interlocks.h"
+#include "hrtfdb.h"
 
 #define SQUARE(X) ((X)*(X))
 
-/* endian issues: swap bytes for ppc */
-#ifdef WORDS_BIGENDIAN
-static int32_t swap4bytes(CSOUND* csound, MEMFIL* mfp)
-{
-    char c1, c2, c3, c4;
-    char *p = mfp->beginp;
-    int32_t  size = mfp->length;
-
-    while (size >= 4)
-      {
-        c1 = p[0]; c2 = p[1]; c3 = p[2]; c4 = p[3];
-        p[0] = c4; p[1] = c3; p[2] = c2; p[3] = c1;
-        size -= 4; p +=4;
-      }
-
-    return OK;
-}
-#else
-static int32_t (*swap4bytes)(CSOUND*, MEMFIL*) = NULL;
-#endif
-
 /* matrices for feedback delay network (fdn) */
 #define mthird (-FL(1.0) / 3)
 #define tthird (FL(2.0) / 3)
@@ -197,9 +177,11 @@ typedef struct
     AUXCH del1t, del2t, del3t, del4t, del5t, del6t;
     AUXCH del1tf, del2tf, del3tf, del4tf, del5tf, del6tf,
           del7tf, del8tf, del9tf, del10tf, del11tf, del12tf;
-    /* filter variables, spectral manipulations */
-    AUXCH power, HRTFave, num, denom, cohermags, coheru, coherv;
-    AUXCH filtout, filtuout, filtvout, filtpad, filtupad, filtvpad;
+    /* shared data set */
+    HRTFDB *db;
+    /* diffuse field and coherence filters, shared: irlengthpad points
+       each of average, u and v */
+    MYFLT *filt;
 
     /* output of matrix cycle, with IIRs in combs and FIR tone, then l and
        r o/p processed with u and v coherence filters */
@@ -214,9 +196,6 @@ typedef struct
     MYFLT b;
     /* 1st order FIR mem */
     MYFLT inoldl, inoldr;
-    /* for storing hrtf data used to create filters */
-    AUXCH buffl, buffr;
-
     /* counter */
     int32_t counter;
 
@@ -224,13 +203,18 @@ typedef struct
 
 }hrtfreverb;
 
+static int32_t hrtfreverb_deinit(CSOUND *csound, void *pp)
+{
+    hrtfreverb *p = (hrtfreverb *) pp;
+    hrtfdb_close(csound, p->db);
+    p->db = NULL;
+    return OK;
+}
+
 int32_t hrtfreverb_init(CSOUND *csound, hrtfreverb *p)
 {
     /* left and right data files: spectral mag, phase format */
-    MEMFIL *fpl = NULL, *fpr = NULL;
     char filel[MAXNAME],filer[MAXNAME];
-    /* files contain floats */
-    float *fpindexl, *fpindexr;
 
     /* processing sizes */
     int32_t irlength=0, irlengthpad=0, overlapsize=0;
@@ -238,21 +222,13 @@ int32_t hrtfreverb_init(CSOUND *csound, hrtfreverb *p)
     /* pointers used to fill buffers in data structure */
     int32_t *delaysp;
     MYFLT *gip, *aip;
-    MYFLT *powerp, *HRTFavep, *nump, *denomp, *cohermagsp, *coherup, *cohervp;
-    MYFLT *filtoutp, *filtuoutp, *filtvoutp, *filtpadp, *filtupadp, *filtvpadp;
-    MYFLT *bufflp, *buffrp;
 
-    /* iterators, file skip */
-    int32_t i, j;
-    int32_t skip = 0;
-    int32_t skipdouble = 0;
+    /* iterators */
+    int32_t i;
 
     /* used in choice of delay line lengths */
     int32_t basedelay=0;
 
-    /* local filter variables for spectral manipulations */
-    MYFLT rel, rer, retemp, iml, imr, imtemp;
-
     /* setup filters */
     MYFLT T, alpha, aconst, exp;
     int32_t clipcheck = 0;
@@ -317,23 +293,13 @@ int32_t hrtfreverb_init(CSOUND *csound, hrtfreverb *p)
     strNcpy(filel, (char*) p->ifilel->data, MAXNAME-1);
     strNcpy(filer, (char*) p->ifiler->data, MAXNAME-1);
 
-    /* reading files, with byte swap */
-    fpl = csound->ldmemfile2withCB(csound, filel,
-                                   CSFTYPE_FLOATS_BINARY, swap4bytes);
-    if (UNLIKELY(fpl == NULL))
-      return
-        csound->InitError(csound,
-                          Str("\n\n\nCannot load left data file, exiting\n\n"));
-
-    fpr = csound->ldmemfile2withCB(csound, filer, CSFTYPE_FLOATS_BINARY,swap4bytes);
-    if (UNLIKELY(fpr == NULL))
-      return
-        csound->InitError(csound,
-                          Str("\n\n\nCannot load right data file, exiting\n\n"));
-
-    /* do not need to be in p, as only used in init */
-    fpindexl = (float *)fpl->beginp;
-    fpindexr = (float *)fpr->beginp;
+    /* shared, byte swapped data */
+    if (p->db != NULL)
+      hrtfdb_close(csound, p->db);
+    p->db = hrtfdb_open(csound, filel, filer, sr);
+    if (UNLIKELY(p->db == NULL))
+      return NOTOK;
+    csound->RegisterDeinitCallback(csound, p, hrtfreverb_deinit);
 
     /* setup structure values */
     p->irlength = irlength;
@@ -341,39 +307,6 @@ int32_t hrtfreverb_init(CSOUND *csound, hrtfreverb *p)
     p->overlapsize = overlapsize;
 
     /* allocate memory */
-    if (!p->power.auxp || p->power.size < irlength * sizeof(MYFLT))
-      csound->AuxAlloc(csound, irlength * sizeof(MYFLT), &p->power);
-    if (!p->HRTFave.auxp || p->HRTFave.size < irlength * sizeof(MYFLT))
-      csound->AuxAlloc(csound, irlength * sizeof(MYFLT), &p->HRTFave);
-    if (!p->num.auxp || p->num.size < irlength * sizeof(MYFLT))
-      csound->AuxAlloc(csound, irlength * sizeof(MYFLT), &p->num);
-    if (!p->denom.auxp || p->denom.size < irlength * sizeof(MYFLT))
-      csound->AuxAlloc(csound, irlength * sizeof(MYFLT), &p->denom);
-    if (!p->cohermags.auxp || p->cohermags.size < irlength * sizeof(MYFLT))
-      csound->AuxAlloc(csound, irlength * sizeof(MYFLT), &p->cohermags);
-    if (!p->coheru.auxp || p->coheru.size < irlength * sizeof(MYFLT))
-      csound->AuxAlloc(csound, irlength * sizeof(MYFLT), &p->coheru);
-    if (!p->coherv.auxp || p->coherv.size < irlength * sizeof(MYFLT))
-      csound->AuxAlloc(csound, irlength * sizeof(MYFLT), &p->coherv);
-
-    if (!p->filtout.auxp || p->filtout.size < irlength * sizeof(MYFLT))
-      csound->AuxAlloc(csound, irlength * sizeof(MYFLT), &p->filtout);
-    if (!p->filtuout.auxp || p->filtuout.size < irlength * sizeof(MYFLT))
-      csound->AuxAlloc(csound, irlength * sizeof(MYFLT), &p->filtuout);
-    if (!p->filtvout.auxp || p->filtvout.size < irlength * sizeof(MYFLT))
-      csound->AuxAlloc(csound, irlength * sizeof(MYFLT), &p->filtvout);
-    if (!p->filtpad.auxp || p->filtpad.size < irlengthpad * sizeof(MYFLT))
-      csound->AuxAlloc(csound, irlengthpad * sizeof(MYFLT), &p->filtpad);
-    if (!p->filtupad.auxp || p->filtupad.size < irlengthpad * sizeof(MYFLT))
-      csound->AuxAlloc(csound, irlengthpad * sizeof(MYFLT), &p->filtupad);
-    if (!p->filtvpad.auxp || p->filtvpad.size < irlengthpad * sizeof(MYFLT))
-      csound->AuxAlloc(csound, irlengthpad * sizeof(MYFLT), &p->filtvpad);
-
-    /* zero numerator and power buffer, as they accumulate */
-    memset(p->power.auxp, 0, irlength * sizeof(MYFLT));
-    memset(p->num.auxp, 0, irlength * sizeof(MYFLT));
-    /* no need to zero other above mem, as it will be filled in init */
-
     if (!p->matrixlu.auxp || p->matrixlu.size < irlengthpad * sizeof(MYFLT))
       csound->AuxAlloc(csound, irlengthpad * sizeof(MYFLT), &p->matrixlu);
     if (!p->matrixrv.auxp || p->matrixrv.size < irlengthpad * sizeof(MYFLT))
@@ -400,18 +333,6 @@ int32_t hrtfreverb_init(CSOUND *csound, hrtfreverb *p)
     memset(p->olhrtfl.auxp, 0, overlapsize * sizeof(MYFLT));
     memset(p->olhrtfr.auxp, 0, overlapsize * sizeof(MYFLT));
 
-    if (!p->buffl.auxp || p->buffl.size < irlength * sizeof(MYFLT))
-      csound->AuxAlloc(csound, irlength * sizeof(MYFLT), &p->buffl);
-    if (!p->buffr.auxp || p->buffr.size < irlength * sizeof(MYFLT))
-      csound->AuxAlloc(csound, irlength * sizeof(MYFLT), &p->buffr);
-
-    memset(p->buffl.auxp, 0, irlength * sizeof(MYFLT));
-    memset(p->buffr.auxp, 0, irlength * sizeof(MYFLT));
-
-    /* buffers to store hrtf data */
-    bufflp = (MYFLT *)p->buffl.auxp;
-    buffrp = (MYFLT *)p->buffr.auxp;
-
     /* 0 delay iterators */
     p->u = p->v = p->w = p->x = p->y = p->z = 0;
     p->ut = p->vt = p->wt = p->xt = p->yt = p->zt = 0;
@@ -633,206 +554,9 @@ int32_t hrtfreverb_init(CSOUND *csound, hrtfreverb *p)
         memset(p->del12tf.auxp, 0, delaysp[23] * sizeof(MYFLT));
       }
 
-    powerp = (MYFLT *)p->power.auxp;
-    HRTFavep = (MYFLT *)p->HRTFave.auxp;
-    nump = (MYFLT *)p->num.auxp;
-    denomp = (MYFLT *)p->denom.auxp;
-    cohermagsp = (MYFLT *)p->cohermags.auxp;
-    coherup = (MYFLT *)p->coheru.auxp;
-    cohervp = (MYFLT *)p->coherv.auxp;
-
-    /* usually, just go through all files; in this case, just doubled due
-       to symmetry (with exceptions, as below) */
-    for(i = 0; i < 368; i ++)
-      {
-        /* if at a measurement where no doubling for symmetry necessary... */
-        if(i == 0 || i == 28 || i == 29 || i == 59 || i == 60 || i == 96  ||
-           i == 97 || i == 133 || i == 134 || i == 170 || i == 171 ||
-           i == 207 || i == 208 || i == 244  || i == 245 || i == 275 ||
-           i == 276 || i == 304  || i == 305 || i == 328 || i == 346 ||
-           i == 347 || i == 359 || i == 360 || i == 366 || i == 367)
-          skipdouble = 1;
-        else
-          skipdouble = 0;
-
-        for(j = 0; j < irlength; j ++)
-          {
-            bufflp[j] = fpindexl[skip + j];
-            buffrp[j] = fpindexr[skip + j];
-          }
-
-        /* deal with 0 hz and nyq: may be a negative real val, no need for
-           fabs() as squaring anyway! */
-        /* skipdouble: l = r */
-        if(skipdouble)
-          {
-            powerp[0] = powerp[0] + SQUARE(bufflp[0]);
-            powerp[1] = powerp[1] + SQUARE(bufflp[1]);
-          }
-        /* include both */
-        else
-          {
-            powerp[0] = powerp[0] + SQUARE(bufflp[0]) + SQUARE(buffrp[0]);
-            powerp[1] = powerp[1] + SQUARE(bufflp[1]) + SQUARE(buffrp[1]);
-          }
-
-        for(j = 2; j < irlength; j += 2)
-          {
-            if(skipdouble)
-              powerp[j] = powerp[j] + (MYFLT)SQUARE(bufflp[j]);
-            else
-              powerp[j] = powerp[j] + (MYFLT)SQUARE(bufflp[j]) +
-                (MYFLT)SQUARE(buffrp[j]);
-            powerp[j + 1] = FL(0.0);
-          }
-        skip += irlength;
-        }
-
-    for(i = 0; i < irlength; i++)
-      HRTFavep[i] = SQRT(powerp[i] / FL(710.0));
-
-    fpindexl = (float *)fpl->beginp;
-    fpindexr = (float *)fpr->beginp;
-    skip = 0;
-
-    /* coherence values */
-    for(i = 0; i< 368; i++)
-      {
-        /* if at a measurement where no doubling for symmetry necessary... */
-        if(i == 0 || i == 28 || i == 29 || i == 59 || i == 60 || i == 96  ||
-           i == 97 || i == 133 || i == 134 || i == 170 || i == 171 ||
-           i == 207 || i == 208 || i == 244  || i == 245 || i == 275 ||
-           i == 276 || i == 304  || i == 305 || i == 328 || i == 346 ||
-           i == 347 || i == 359 || i == 360 || i == 366 || i == 367)
-          skipdouble = 1;
-        else
-          skipdouble = 0;
-
-        for(j = 0; j < irlength; j ++)
-          {
-            bufflp[j] = fpindexl[skip + j];
-            buffrp[j] = fpindexr[skip + j];
-          }
-
-        /* back to rectangular to find numerator: need complex nos */
-        /* 0Hz and Nyq ok as real */
-        if(skipdouble)
-          {
-            nump[0] = nump[0] + (bufflp[0] * buffrp[0]);
-            nump[1] = nump[1] + (bufflp[1] * buffrp[1]);
-          }
-        else
-          {
-            nump[0] = nump[0] + (bufflp[0] * buffrp[0]) + (buffrp[0] * bufflp[0]);
-            nump[1] = nump[1] + (bufflp[1] * buffrp[1]) + (buffrp[1] * bufflp[1]);
-          }
-
-        /* complex multiplication */
-        /* (a + i b)(c + i d) */
-        /* = (a c - b d) + i(a d + b c) */
-        /* conjugate: d becomes -d ->
-           = (a c + b d) + i(- a d + b c) */
-        /* doing l * conj r and r * conj l here, as dataset symmetrical...
-           for non symmetrical, just go through all and do l * conj r */
-        for(j = 2; j < irlength; j += 2)
-          {
-            rel = bufflp[j] * COS(bufflp[j + 1]);
-            iml = bufflp[j] * SIN(bufflp[j + 1]);
-            rer = buffrp[j] * COS(buffrp[j + 1]);
-            imr = buffrp[j] * SIN(buffrp[j + 1]);
-            if(skipdouble)
-              {
-                nump[j] = nump[j] + ((rel * rer) + (iml * imr));
-                nump[j + 1] = nump[j + 1] + ((rel * -imr) + (iml * rer));
-              }
-            else
-              {
-                nump[j] = nump[j] + ((rel * rer) + (iml * imr)) +
-                  ((rer * rel) + (imr * iml));
-                nump[j + 1] = nump[j + 1] + ((rel * -imr) + (iml * rer)) +
-                  ((rer * -iml) + (imr * rel));
-              }
-          }
-        skip += irlength;
-      }
-
-    /* 0 & nyq = fabs() for mag... */
-    nump[0] = FABS(nump[0]);
-    nump[1] = FABS(nump[1]);
-
-    /* magnitudes of sum of conjugates */
-    for(i = 2; i < irlength; i += 2)
-      {
-        retemp = nump[i];
-        imtemp = nump[i + 1];
-        nump[i] = SQRT(SQUARE(retemp) + SQUARE(imtemp));
-        nump[i + 1] = FL(0.0);
-      }
-
-    /* sqrt (powl * powr) powl = powr in symmetric case, so just power[] needed */
-    for(i = 0; i < irlength; i++)
-      denomp[i] = powerp[i];
-
-    /* coherence values */
-    cohermagsp[0] = nump[0] / denomp[0];
-    cohermagsp[1] = nump[1] / denomp[1];
-
-    for(i = 2; i < irlength; i += 2)
-      {
-        cohermagsp[i] = nump[i] / denomp[i];
-        cohermagsp[i+1] = FL(0.0);
-      }
-
-    /* coherence formula */
-    coherup[0] = SQRT((FL(1.0) + cohermagsp[0]) / FL(2.0));
-    coherup[1] = SQRT((FL(1.0) + cohermagsp[1]) / FL(2.0));
-    cohervp[0] = SQRT((FL(1.0) - cohermagsp[0]) / FL(2.0));
-    cohervp[1] = SQRT((FL(1.0) - cohermagsp[1]) / FL(2.0));
-
-    for(i = 2; i < irlength; i += 2)
-      {
-        coherup[i] = SQRT((FL(1.0) + cohermagsp[i]) / FL(2.0));
-        cohervp[i] = SQRT((FL(1.0) - cohermagsp[i]) / FL(2.0));
-        coherup[i + 1] = FL(0.0);
-        cohervp[i + 1] = FL(0.0);
-      }
-
-    /* no need to go back to rectangular for fft, as phase = 0, so same */
-    csound->InverseRealFFT(csound, HRTFavep, irlength);
-    csound->InverseRealFFT(csound, coherup, irlength);
-    csound->InverseRealFFT(csound, cohervp, irlength);
-
-    filtoutp = (MYFLT *)p->filtout.auxp;
-    filtuoutp = (MYFLT *)p->filtuout.auxp;
-    filtvoutp = (MYFLT *)p->filtvout.auxp;
-    filtpadp = (MYFLT *)p->filtpad.auxp;
-    filtupadp = (MYFLT *)p->filtupad.auxp;
-    filtvpadp = (MYFLT *)p->filtvpad.auxp;
-
-    /* shift */
-    for(i = 0; i < irlength; i++)
-      {
-        filtoutp[i] = HRTFavep[(i + (irlength / 2)) % irlength];
-        filtuoutp[i] = coherup[(i + (irlength / 2)) % irlength];
-        filtvoutp[i] = cohervp[(i + (irlength / 2)) % irlength];
-      }
-
-    for(i = 0; i < irlength; i++)
-      {
-        filtpadp[i] = filtoutp[i];
-        filtupadp[i] = filtuoutp[i];
-        filtvpadp[i] = filtvoutp[i];
-      }
-    for(i = irlength; i < irlengthpad; i++)
-      {
-        filtpadp[i] = FL(0.0);
-        filtupadp[i] = FL(0.0);
-        filtvpadp[i] = FL(0.0);
-      }
-
-    csound->RealFFT(csound, filtpadp, irlengthpad);
-    csound->RealFFT(csound, filtupadp, irlengthpad);
-    csound->RealFFT(csound, filtvpadp, irlengthpad);
+    /* diffuse field average and coherence filters, built once per data
+       set */
+    p->filt = hrtfdb_diffuse(csound, p->db);
 
     T = FL(1.0) / sr;
 
@@ -941,9 +665,9 @@ int32_t hrtfreverb_process(CSOUND *csound, hrtfreverb *p)
     MYFLT inoldr = p->inoldr;
 
     /* filters, created in INIT */
-    MYFLT *filtpadp = (MYFLT *)p->filtpad.auxp;
-    MYFLT *filtupadp = (MYFLT *)p->filtupad.auxp;
-    MYFLT *filtvpadp = (MYFLT *)p->filtvpad.auxp;
+    MYFLT *filtpadp = p->filt;
+    MYFLT *filtupadp = p->filt + irlengthpad;
+    MYFLT *filtvpadp = p->filt + 2 * irlengthpad;
 
     MYFLT sr = p->sr;
 
@@ -21,6 +21,8 @@
     02110-1301 USA
 */
 #include "OpcodeBase.hpp"
+#include <cstring>
+#include <deque>
 #include <map>
 #include <vector>
 
@@ -33,40 +35,135 @@ using namespace csound;
 //#define ENABLE_MIXER_KDEBUG
 
 /**
- * The mixer busses are laid out:
- * busses[csound][bus][channel][frame].
- * std::map<CSOUND *, std::map<size_t, std::vector< std::vector<MYFLT> > > >
- * *busses = 0;
+ * Mixer state of one Csound instance, stored in the global pointer "mixer".
  *
- * The mixer send matrix is laid out:
- * matrix[csound][send][bus].
- * std::map<CSOUND *, std::map<size_t, std::map<size_t, MYFLT> > > *matrix = 0;
+ * Bus and send numbers are arbitrary, so they are mapped to storage once,
+ * at init time; the performance functions only use the resolved pointers.
+ *
+ * Bus signals are kept in blocks of MIXER_BLOCK_BUSSES busses, each bus
+ * being nchnls channels of ksmps frames, so that MixerClear clears a few
+ * contiguous arrays and the addresses handed out never move. The module
+ * is created before the orchestra is compiled, so the sizes are taken
+ * when the first mixer opcode is initialised.
+ *
+ * Gains also live in a deque (stable addresses) and are found through
+ * gainIndex[send, bus] at init time.
+ *
+ * With more than one performance thread (-j), MixerSend does not add to
+ * the bus but stores its input times the gain in a buffer of its own,
+ * stamped with the k-cycle, and each MixerReceive sums the buffers of its
+ * bus channel itself. The sends then touch only their own state, and the
+ * summing for different busses runs in parallel in the receiving
+ * instruments, which the scheduler already orders after the senders
+ * (MixerSend writes, MixerReceive reads the channel interlock). A note can
+ * start or end on any thread, so the lists of sends are only changed and
+ * read with the mixer lock held.
  */
 
+#define MIXER_BLOCK_BUSSES 64
+
+struct MixerSendSlot {
+  MYFLT *signal;   // gain * input, summed over the sends of one k-cycle
+  uint64_t kcycle; // last k-cycle the input was sent in
+};
+
+struct MixerBuss {
+  MYFLT *signal; // channels * frames
+  std::vector<std::vector<MixerSendSlot *>> sends; // per channel, for -j
+};
+
+struct Mixer {
+  size_t channels;
+  size_t frames;
+  bool deferred;
+  void *lock; // guards MixerBuss::sends
+  std::map<size_t, size_t> bussIndex;
+  std::deque<MixerBuss> busses; // stable addresses for MixerSend
+  std::vector<MYFLT *> blocks;
+  std::map<std::pair<size_t, size_t>, MYFLT *> gainIndex;
+  std::deque<MYFLT> gains;
+  Mixer() : channels(0), frames(0), deferred(false), lock(0) {}
+  ~Mixer() {
+    for (size_t i = 0; i < blocks.size(); i++)
+      delete[] blocks[i];
+  }
+  size_t bussSize() const { return channels * frames; }
+};
+
+static Mixer *getMixer(CSOUND *csound) {
+  Mixer *mixer = 0;
+  csound::QueryGlobalPointer(csound, "mixer", mixer);
+  if (mixer->frames == 0) {
+    mixer->channels = csound->GetNchnls(csound);
+    mixer->frames = csound->GetKsmps(csound);
+  }
+  if (mixer->busses.empty()) {
+    OPARMS oparms;
+    csound->GetOParms(csound, &oparms);
+    mixer->deferred = (oparms.numThreads > 1);
+  }
+  return mixer;
+}
+
 /**
- * Creates the buss if it does not already exist.
+ * Creates the buss if it does not already exist, and returns its index.
  */
-static void createBuss(CSOUND *csound, size_t buss) {
+static size_t createBuss(CSOUND *csound, Mixer *mixer, size_t buss) {
 #ifdef ENABLE_MIXER_IDEBUG
   csound->Message(csound, "createBuss: csound %p buss %d...\n", csound, buss);
+#else
+  IGN(csound);
 #endif
-  std::map<CSOUND *, std::map<size_t, std::vector<std::vector<MYFLT>>>>
-      *busses = 0;
-  csound::QueryGlobalPointer(csound, "busses", busses);
-  if ((*busses)[csound].find(buss) == (*busses)[csound].end()) {
-    size_t channels = csound->GetNchnls(csound);
-    size_t frames = csound->GetKsmps(csound);
-    (*busses)[csound][buss].resize(channels);
-    for (size_t channel = 0; channel < channels; channel++) {
-      (*busses)[csound][buss][channel].resize(frames);
-    }
+  std::map<size_t, size_t>::iterator it = mixer->bussIndex.find(buss);
+  if (it != mixer->bussIndex.end()) {
 #ifdef ENABLE_MIXER_IDEBUG
-    csound->Message(csound, "createBuss: created buss.\n");
+    csound->Message(csound, "createBuss: buss already exists.\n");
 #endif
-  } else {
+    return it->second;
+  }
+  size_t index = mixer->busses.size();
+  size_t slot = index % MIXER_BLOCK_BUSSES;
+  if (slot == 0) {
+    MYFLT *block = new MYFLT[MIXER_BLOCK_BUSSES * mixer->bussSize()];
+    std::memset(block, 0,
+                sizeof(MYFLT) * MIXER_BLOCK_BUSSES * mixer->bussSize());
+    mixer->blocks.push_back(block);
+  }
+  MixerBuss b;
+  b.signal = mixer->blocks.back() + slot * mixer->bussSize();
+  b.sends.resize(mixer->channels);
+  mixer->busses.push_back(b);
+  mixer->bussIndex[buss] = index;
 #ifdef ENABLE_MIXER_IDEBUG
-    csound->Message(csound, "createBuss: buss already exists.\n");
+  csound->Message(csound, "createBuss: created buss.\n");
 #endif
+  return index;
+}
+
+/**
+ * Returns the address of the gain from send to buss, creating it at 0.
+ */
+static MYFLT *getGain(Mixer *mixer, size_t send, size_t buss) {
+  std::pair<size_t, size_t> key(send, buss);
+  std::map<std::pair<size_t, size_t>, MYFLT *>::iterator it =
+      mixer->gainIndex.find(key);
+  if (it != mixer->gainIndex.end())
+    return it->second;
+  mixer->gains.push_back(FL(0.0));
+  MYFLT *gain = &mixer->gains.back();
+  mixer->gainIndex[key] = gain;
+  return gain;
+}
+
+/**
+ * out[i] += in[i] * gain; the non-aliasing pointers let the compiler
+ * vectorise this.
+ */
+static inline void mixerAccumulate(MYFLT *__restrict out,
+                                   const MYFLT *__restrict in, MYFLT gain,
+                                   size_t frames) {
+  for (size_t i = 0; i < frames; i++) {
+    out[i] += in[i] * gain;
   }
 }
 
@@ -84,28 +181,31 @@ struct MixerSetLevel : public OpcodeBase<MixerSetLevel> {
   // State.
   size_t send;
   size_t buss;
-  std::map<CSOUND *, std::map<size_t, std::map<size_t, MYFLT>>> *matrix;
+  MYFLT *gain;
   int init(CSOUND *csound) {
 #ifdef ENABLE_MIXER_IDEBUG
     warn(csound, "MixerSetLevel::init...\n");
 #endif
-    csound::QueryGlobalPointer(csound, "matrix", matrix);
+    Mixer *mixer = getMixer(csound);
     send = static_cast<size_t>(*isend);
     buss = static_cast<size_t>(*ibuss);
-    createBuss(csound, buss);
-    (*matrix)[csound][send][buss] = *kgain;
+    createBuss(csound, mixer, buss);
+    gain = getGain(mixer, send, buss);
+    *gain = *kgain;
 #ifdef ENABLE_MIXER_IDEBUG
     warn(csound, "MixerSetLevel::init: csound %p send %d buss %d gain %f\n",
-         csound, send, buss, (*matrix)[csound][send][buss]);
+         csound, send, buss, *gain);
 #endif
     return OK;
   }
   int kontrol(CSOUND *csound) {
-    (*matrix)[csound][send][buss] = *kgain;
+    *gain = *kgain;
 #ifdef ENABLE_MIXER_KDEBUG
     warn(csound, "MixerSetLevel::kontrol: csound %p send %d buss "
                  "%d gain %f\n",
-         csound, send, buss, (*matrix)[csound][send][buss]);
+         csound, send, buss, *gain);
+#else
+    IGN(csound);
 #endif
     return OK;
   }
@@ -125,23 +225,26 @@ struct MixerGetLevel : public OpcodeBase<MixerGetLevel> {
   // State.
   size_t send;
   size_t buss;
-  std::map<CSOUND *, std::map<size_t, std::map<size_t, MYFLT>>> *matrix;
+  MYFLT *gain;
   int init(CSOUND *csound) {
 #ifdef ENABLE_MIXER_IDEBUG
     warn(csound, "MixerGetLevel::init...\n");
 #endif
-    csound::QueryGlobalPointer(csound, "matrix", matrix);
+    Mixer *mixer = getMixer(csound);
     send = static_cast<size_t>(*isend);
     buss = static_cast<size_t>(*ibuss);
-    createBuss(csound, buss);
+    createBuss(csound, mixer, buss);
+    gain = getGain(mixer, send, buss);
     return OK;
   }
   int noteoff(CSOUND *) { return OK; }
   int kontrol(CSOUND *csound) {
 #ifdef ENABLE_MIXER_KDEBUG
     warn(csound, "MixerGetLevel::kontrol...\n");
+#else
+    IGN(csound);
 #endif
-    *kgain = (*matrix)[csound][send][buss];
+    *kgain = *gain;
     return OK;
   }
 };
@@ -151,7 +254,7 @@ struct MixerGetLevel : public OpcodeBase<MixerGetLevel> {
  * Routes a signal from a send to a channel of a mixer bus.
  * The gain of the send is controlled by the previously set mixer level.
  */
-struct MixerSend : public OpcodeBase<MixerSend> {
+struct MixerSend : public OpcodeNoteoffBase<MixerSend> {
   // No outputs.
   // Inputs.
   MYFLT *ainput;
@@ -164,20 +267,38 @@ struct MixerSend : public OpcodeBase<MixerSend> {
   size_t channel;
   size_t frames;
   MYFLT *busspointer;
-  std::map<CSOUND *, std::map<size_t, std::vector<std::vector<MYFLT>>>> *busses;
-  std::map<CSOUND *, std::map<size_t, std::map<size_t, MYFLT>>> *matrix;
+  MYFLT *gain;
+  Mixer *mixer;
+  std::vector<MixerSendSlot *> *sends; // non-null if deferred
+  MixerSendSlot slot;
+  AUXCH signal;
   int init(CSOUND *csound) {
 #ifdef ENABLE_MIXER_IDEBUG
     warn(csound, "MixerSend::init...\n");
 #endif
-    csound::QueryGlobalPointer(csound, "busses", busses);
-    csound::QueryGlobalPointer(csound, "matrix", matrix);
+    mixer = getMixer(csound);
     send = static_cast<size_t>(*isend);
     buss = static_cast<size_t>(*ibuss);
-    createBuss(csound, buss);
+    size_t index = createBuss(csound, mixer, buss);
     channel = static_cast<size_t>(*ichannel);
+    if (UNLIKELY(channel >= mixer->channels))
+      return csound->InitError(csound, Str("MixerSend: channel %d out of "
+                                           "range"), (int) channel);
     frames = opds.insdshead->ksmps;
-    busspointer = &(*busses)[csound][buss][channel].front();
+    busspointer = mixer->busses[index].signal + channel * mixer->frames;
+    gain = getGain(mixer, send, buss);
+    // on reinit the slot is still registered, possibly to another buss
+    noteoff(csound);
+    if (mixer->deferred && frames == mixer->frames) {
+      if (signal.auxp == 0 || signal.size < sizeof(MYFLT) * frames)
+        csound->AuxAlloc(csound, sizeof(MYFLT) * frames, &signal);
+      slot.signal = (MYFLT *)signal.auxp;
+      slot.kcycle = ~(uint64_t) 0;
+      csound->LockMutex(mixer->lock);
+      sends = &mixer->busses[index].sends[channel];
+      sends->push_back(&slot);
+      csound->UnlockMutex(mixer->lock);
+    }
 #ifdef ENABLE_MIXER_IDEBUG
     warn(csound, "MixerSend::init: instance %p send %d buss "
                  "%d channel %d frames %d busspointer %p\n",
@@ -185,19 +306,39 @@ struct MixerSend : public OpcodeBase<MixerSend> {
 #endif
     return OK;
   }
-  int noteoff(CSOUND *) { return OK; }
+  int noteoff(CSOUND *csound) {
+    if (sends != 0) {
+      csound->LockMutex(mixer->lock);
+      for (size_t i = 0; i < sends->size(); i++) {
+        if ((*sends)[i] == &slot) {
+          sends->erase(sends->begin() + i);
+          break;
+        }
+      }
+      csound->UnlockMutex(mixer->lock);
+      sends = 0;
+    }
+    return OK;
+  }
   int audio(CSOUND *csound) {
 #ifdef ENABLE_MIXER_KDEBUG
     warn(csound, "MixerSend::audio...\n");
 #endif
-    MYFLT gain = (*matrix)[csound][send][buss];
-    for (size_t i = 0; i < frames; i++) {
-      busspointer[i] += (ainput[i] * gain);
+    if (sends != 0) {
+      // summed by MixerReceive; a send can run more than once a k-cycle
+      uint64_t kcycle = csound->GetKcounter(csound);
+      if (slot.kcycle != kcycle) {
+        std::memset(slot.signal, 0, sizeof(MYFLT) * frames);
+        slot.kcycle = kcycle;
+      }
+      mixerAccumulate(slot.signal, ainput, *gain, frames);
+      return OK;
     }
+    mixerAccumulate(busspointer, ainput, *gain, frames);
 #ifdef ENABLE_MIXER_KDEBUG
     warn(csound, "MixerSend::audio: instance %d send %d buss "
                  "%d gain %f busspointer %p\n",
-         csound, send, buss, gain, busspointer);
+         csound, send, buss, *gain, busspointer);
 #endif
     return OK;
   }
@@ -221,17 +362,22 @@ struct MixerReceive : public OpcodeBase<MixerReceive> {
   size_t channel;
   size_t frames;
   MYFLT *busspointer;
-  std::map<CSOUND *, std::map<size_t, std::vector<std::vector<MYFLT>>>> *busses;
+  Mixer *mixer;
+  std::vector<MixerSendSlot *> *sends;
   int init(CSOUND *csound) {
-    csound::QueryGlobalPointer(csound, "busses", busses);
+    mixer = getMixer(csound);
     buss = static_cast<size_t>(*ibuss);
     channel = static_cast<size_t>(*ichannel);
     frames = opds.insdshead->ksmps;
-    createBuss(csound, buss);
+    size_t index = createBuss(csound, mixer, buss);
+    if (UNLIKELY(channel >= mixer->channels))
+      return csound->InitError(csound, Str("MixerReceive: channel %d out of "
+                                           "range"), (int) channel);
+    sends = &mixer->busses[index].sends[channel];
 #ifdef ENABLE_MIXER_IDEBUG
     warn(csound, "MixerReceive::init...\n");
 #endif
-    busspointer = &(*busses)[csound][buss][channel].front();
+    busspointer = mixer->busses[index].signal + channel * mixer->frames;
 #ifdef ENABLE_MIXER_IDEBUG
     warn(csound, "MixerReceive::init csound %p buss %d channel "
                  "%d frames %d busspointer %p\n",
@@ -243,11 +389,18 @@ struct MixerReceive : public OpcodeBase<MixerReceive> {
   int audio(CSOUND *csound) {
 #ifdef ENABLE_MIXER_KDEBUG
     warn(csound, "MixerReceive::audio...\n");
-#else
-    IGN(csound);
 #endif
-    for (size_t i = 0; i < frames; i++) {
-      aoutput[i] = busspointer[i];
+    std::memcpy(aoutput, busspointer, sizeof(MYFLT) * frames);
+    if (mixer->deferred) {
+      uint64_t kcycle = csound->GetKcounter(csound);
+      size_t n = (frames < mixer->frames ? frames : mixer->frames);
+      csound->LockMutex(mixer->lock);
+      for (size_t i = 0; i < sends->size(); i++) {
+        const MixerSendSlot *slot = (*sends)[i];
+        if (slot->kcycle == kcycle)
+          mixerAccumulate(aoutput, slot->signal, FL(1.0), n);
+      }
+      csound->UnlockMutex(mixer->lock);
     }
 #ifdef ENABLE_MIXER_KDEBUG
     warn(csound, "MixerReceive::audio aoutput %p busspointer %p\n", aoutput,
@@ -268,31 +421,27 @@ struct MixerClear : public OpcodeBase<MixerClear> {
   // No output.
   // No input.
   // State.
-  std::map<CSOUND *, std::map<size_t, std::vector<std::vector<MYFLT>>>> *busses;
+  Mixer *mixer;
   int init(CSOUND *csound) {
-    csound::QueryGlobalPointer(csound, "busses", busses);
+    mixer = getMixer(csound);
     return OK;
   }
   int audio(CSOUND *csound) {
 #ifdef ENABLE_MIXER_KDEBUG
-    warn(csound, "MixerClear::audio...\n")
+    warn(csound, "MixerClear::audio...\n");
+#else
+    IGN(csound);
 #endif
-        for (std::map<size_t, std::vector<std::vector<MYFLT>>>::iterator busi =
-                 (*busses)[csound].begin();
-             busi != (*busses)[csound].end(); ++busi) {
-      for (std::vector<std::vector<MYFLT>>::iterator channeli =
-               busi->second.begin();
-           channeli != busi->second.end(); ++channeli) {
-        for (std::vector<MYFLT>::iterator framei = (*channeli).begin();
-             framei != (*channeli).end(); ++framei) {
-          *framei = 0;
-        }
-      }
+    size_t used = mixer->busses.size();
+    for (size_t i = 0; i < mixer->blocks.size(); i++) {
+      size_t n = (used > MIXER_BLOCK_BUSSES ? MIXER_BLOCK_BUSSES : used);
+      std::memset(mixer->blocks[i], 0, sizeof(MYFLT) * n * mixer->bussSize());
+      used -= n;
     }
 #ifdef ENABLE_MIXER_KDEBUG
-    warn(csound, "MixerClear::audio\n")
+    warn(csound, "MixerClear::audio\n");
 #endif
-        return OK;
+    return OK;
   }
 };
 
@@ -316,14 +465,9 @@ static OENTRY localops[] = {
     {NULL, 0, 0, 0, NULL, NULL, (SUBR)NULL, (SUBR)NULL, (SUBR)NULL}};
 
 PUBLIC int csoundModuleCreate_mixer(CSOUND *csound) {
-  std::map<CSOUND *, std::map<size_t, std::vector<std::vector<MYFLT>>>>
-      *busses = 0;
-  busses =
-      new std::map<CSOUND *, std::map<size_t, std::vector<std::vector<MYFLT>>>>;
-  csound::CreateGlobalPointer(csound, "busses", busses);
-  std::map<CSOUND *, std::map<size_t, std::map<size_t, MYFLT>>> *matrix = 0;
-  matrix = new std::map<CSOUND *, std::map<size_t, std::map<size_t, MYFLT>>>;
-  csound::CreateGlobalPointer(csound, "matrix", matrix);
+  Mixer *mixer = new Mixer();
+  mixer->lock = csound->Create_Mutex(0);
+  csound::CreateGlobalPointer(csound, "mixer", mixer);
   return OK;
 }
 
@@ -342,48 +486,15 @@ PUBLIC int csoundModuleInit_mixer(CSOUND *csound) {
   return err;
 }
 
-/*
- * The mixer busses are laid out:
- * busses[csound][bus][channel][frame].
- * std::map<CSOUND *, std::map<size_t,
- *          std::vector< std::vector<MYFLT> > > > *busses = 0;
- * The mixer send matrix is laid out:
- * matrix[csound][send][bus].
- * std::map<CSOUND *, std::map<size_t, std::map<size_t, MYFLT> > > *matrix = 0;
- */
 PUBLIC int csoundModuleDestroy_mixer(CSOUND *csound) {
-  std::map<CSOUND *, std::map<size_t, std::vector<std::vector<MYFLT>>>>
-      *busses = 0;
-  csound::QueryGlobalPointer(csound, "busses", busses);
-  if (busses) {
-    for (std::map<size_t, std::vector<std::vector<MYFLT>>>::iterator busi =
-             (*busses)[csound].begin();
-         busi != (*busses)[csound].end(); ++busi) {
-      for (std::vector<std::vector<MYFLT>>::iterator channeli =
-               busi->second.begin();
-           channeli != busi->second.end(); ++channeli) {
-        channeli->resize(0);
-      }
-      busi->second.clear();
-    }
-    busses->clear();
-    csound->DestroyGlobalVariable(csound, "busses");
-    delete busses;
-    busses = nullptr;
-  }
-  std::map<CSOUND *, std::map<size_t, std::map<size_t, MYFLT>>> *matrix = 0;
-  csound::QueryGlobalPointer(csound, "matrix", matrix);
-  if (matrix) {
-    // std::map<CSOUND *, std::map<size_t, std::map<size_t, MYFLT> > >
-    for (std::map<size_t, std::map<size_t, MYFLT>>::iterator matrixi =
-             (*matrix)[csound].begin();
-         matrixi != (*matrix)[csound].end(); ++matrixi) {
-      matrixi->second.clear();
-    }
-    matrix->clear();
-    csound->DestroyGlobalVariable(csound, "matrix");
-    delete matrix;
-    matrix = nullptr;
+  Mixer *mixer = 0;
+  csound::QueryGlobalPointer(csound, "mixer", mixer);
+  if (mixer) {
+    csound->DestroyGlobalVariable(csound, "mixer");
+    if (mixer->lock != 0)
+      csound->DestroyMutex(mixer->lock);
+    delete mixer;
+    mixer = nullptr;
   }
   return OK;
 }
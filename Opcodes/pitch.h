@@ -90,6 +90,21 @@ typedef struct {
     MYFLT       *instrnum, *ipercent, *iopc;    /* IV - Oct 31 2002 */
 } CPU_PERC;
 
+typedef struct {
+    OPDS        h;
+    MYFLT       *instrnum, *ival, *irelease;
+} VOICEOPT;
+
+typedef struct {
+    OPDS        h;
+    MYFLT       *ithreshold, *ipriority, *irelease;
+} LOADSHED;
+
+typedef struct {
+    OPDS        h;
+    MYFLT       *instrnum, *imode, *isleepdb, *itime, *iwakedb;
+} AUTOSLEEP;
+
 typedef struct {
     OPDS    h;
     MYFLT   *sr, *kamp, *kcps, *ifn, *ifreqtbl, *iamptbl, *icnt, *iphs;
@@ -297,6 +312,13 @@ int32_t macset(CSOUND *, SUM *p);
 int32_t maxalloc(CSOUND *, CPU_PERC *p);
 int32_t mute_inst(CSOUND *, MUTE *p);
 int32_t maxalloc_S(CSOUND *, CPU_PERC *p);
+int32_t voicesteal(CSOUND *, VOICEOPT *p);
+int32_t voicesteal_S(CSOUND *, VOICEOPT *p);
+int32_t voiceprio(CSOUND *, VOICEOPT *p);
+int32_t voiceprio_S(CSOUND *, VOICEOPT *p);
+int32_t loadshed(CSOUND *, LOADSHED *p);
+int32_t autosleep(CSOUND *, AUTOSLEEP *p);
+int32_t autosleep_S(CSOUND *, AUTOSLEEP *p);
 int32_t mute_inst_S(CSOUND *, MUTE *p);
 int32_t pfun(CSOUND *, PFUN *p);
 int32_t pfunk_init(CSOUND *, PFUNK *p);
@@ -28,6 +28,7 @@
 #include "spectra.h"
 #include "pitch.h"
 #include "uggab.h"
+#include "voices.h"
 
 int32_t mute_inst(CSOUND *csound, MUTE *p)
 {
@@ -183,6 +184,107 @@ int32_t maxalloc_S(CSOUND *csound, CPU_PERC *p)
     return OK;
 }
 
+/* voice stealing and load shedding, see Engine/voices.c */
+
+static INSTRTXT *voice_instr(CSOUND *csound, MYFLT *instrnum, int isstring)
+{
+    int32_t n;
+
+    if (isstring)
+      n = csound->strarg2insno(csound, ((STRINGDAT *)instrnum)->data, 1);
+    else if (csound->ISSTRCOD(*instrnum)) {
+      char *ss = get_arg_string(csound,*instrnum);
+      n = csound->strarg2insno(csound,ss,1);
+    }
+    else n = *instrnum;
+    if (n > 0 && n <= csound->engineState.maxinsno)
+      return csound->engineState.instrtxtp[n];
+    return NULL;
+}
+
+static int32_t voicesteal_(CSOUND *csound, VOICEOPT *p, int isstring)
+{
+    INSTRTXT *tp = voice_instr(csound, p->instrnum, isstring);
+    int32_t mode = (int32_t) *p->ival;
+
+    if (UNLIKELY(mode < VOICE_REFUSE || mode > VOICE_QUIETEST))
+      return csound->InitError(csound, Str("voicesteal: invalid mode %d"),
+                               mode);
+    if (tp != NULL) {           /* If instrument exists */
+      tp->vsteal = mode;
+      tp->vrelease = *p->irelease;
+    }
+    return OK;
+}
+
+int32_t voicesteal(CSOUND *csound, VOICEOPT *p)
+{
+    return voicesteal_(csound, p, 0);
+}
+
+int32_t voicesteal_S(CSOUND *csound, VOICEOPT *p)
+{
+    return voicesteal_(csound, p, 1);
+}
+
+int32_t voiceprio(CSOUND *csound, VOICEOPT *p)
+{
+    INSTRTXT *tp = voice_instr(csound, p->instrnum, 0);
+    if (tp != NULL)
+      tp->vpriority = (int32_t) *p->ival;
+    return OK;
+}
+
+int32_t voiceprio_S(CSOUND *csound, VOICEOPT *p)
+{
+    INSTRTXT *tp = voice_instr(csound, p->instrnum, 1);
+    if (tp != NULL)
+      tp->vpriority = (int32_t) *p->ival;
+    return OK;
+}
+
+int32_t loadshed(CSOUND *csound, LOADSHED *p)
+{
+    /* an offline render has no deadline and must not depend on
+       how fast the machine is */
+    if (!csound->oparms->realtime)
+      return OK;
+    csoundVoiceSetShedding(csound, *p->ithreshold,
+                           (int) *p->ipriority, *p->irelease);
+    return OK;
+}
+
+static int32_t autosleep_(CSOUND *csound, AUTOSLEEP *p, int isstring)
+{
+    INSTRTXT *tp = voice_instr(csound, p->instrnum, isstring);
+    int32_t mode = (int32_t) *p->imode;
+    MYFLT sleepdb = *p->isleepdb < FL(0.0) ? *p->isleepdb : FL(-120.0);
+    MYFLT wakedb = *p->iwakedb < FL(0.0) ? *p->iwakedb : sleepdb + FL(6.0);
+
+    if (UNLIKELY(mode < VOICE_AWAKE || mode > VOICE_TURNOFF))
+      return csound->InitError(csound, Str("autosleep: invalid mode %d"),
+                               mode);
+    if (wakedb < sleepdb)
+      wakedb = sleepdb;
+    if (tp != NULL) {           /* If instrument exists */
+      tp->vsleep = mode;
+      tp->vsleepthr = csound->e0dbfs * POWER(FL(10.0), sleepdb / FL(20.0));
+      tp->vwakethr = csound->e0dbfs * POWER(FL(10.0), wakedb / FL(20.0));
+      tp->vsleeptime = *p->itime > FL(0.0) ? *p->itime : FL(0.5);
+    }
+    return OK;
+}
+
+int32_t autosleep(CSOUND *csound, AUTOSLEEP *p)
+{
+    return autosleep_(csound, p, 0);
+}
+
+int32_t autosleep_S(CSOUND *csound, AUTOSLEEP *p)
+{
+    return autosleep_(csound, p, 1);
+}
+
 int32_t pfun(CSOUND *csound, PFUN *p)
 {
     int32_t n = (int32_t)MYFLT2LONG(*p->pnum);
@@ -124,6 +124,8 @@ struct _SFBANK {
         int32_t instrs_num;
         instrType *instr;
         SHORT *sampleData;
+        MYFLT *sampleDataF;     /* sampleData as MYFLT, if sfload was asked */
+        int32_t mapped;         /* main_chunk.ckDATA is in a shared mapping */
         CHUNKS chunk;
 } PACKED;
 typedef struct _SFBANK SFBANK;
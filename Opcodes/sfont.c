@@ -45,6 +45,7 @@
 
 
 static int32_t chunk_read(CSOUND *, FILE *f, CHUNK *chunk);
+static DWORD dword(char *p);
 static void fill_SfPointers(CSOUND *);
 static int32_t  fill_SfStruct(CSOUND *);
 static void layerDefaults(layerType *layer);
@@ -53,6 +54,7 @@ static void splitDefaults(splitType *split);
 #define MAX_SFONT               (10)
 #define MAX_SFPRESET            (16384)
 #define GLOBAL_ATTENUATION      (FL(0.3))
+#define SF_GUARD                (4)
 
 #define ONETWELTH               (0.08333333333333333333333333333)
 #define TWOTOTWELTH             (1.05946309435929526456182529495)
@@ -64,6 +66,7 @@ typedef struct _sfontg {
   int32_t maxSFndx;
   presetType **presetp;
   SHORT **sampleBase;
+  MYFLT **sampleBaseF;
   MYFLT pitches[128];
 } sfontg;
 
@@ -88,17 +91,50 @@ int32_t sfont_ModuleDestroy(CSOUND *csound)
         csound->Free(csound, sfArray[j].instr[l].split);
       }
       csound->Free(csound, sfArray[j].instr);
-      csound->Free(csound, sfArray[j].chunk.main_chunk.ckDATA);
+      if (sfArray[j].mapped)
+        csoundUnmapFile(sfArray[j].chunk.main_chunk.ckDATA);
+      else
+        csound->Free(csound, sfArray[j].chunk.main_chunk.ckDATA);
+      if (sfArray[j].sampleDataF != NULL)
+        csound->Free(csound, sfArray[j].sampleDataF - SF_GUARD);
     }
     csound->Free(csound, sfArray);
     globals->currSFndx = 0;
     csound->Free(csound, globals->presetp);
     csound->Free(csound, globals->sampleBase);
+    csound->Free(csound, globals->sampleBaseF);
 
     csound->DestroyGlobalVariable(csound, "::sfontg");
     return 0;
 }
 
+/* On little-endian hosts a bank can be used as it sits in the file, so
+   it is mapped rather than read in: parsing the presets only touches the
+   header pages, sample data is paged in as it is played, and every
+   instance in the process that loads the same file shares the mapping. */
+static int32_t SoundFontMap(SFBANK *soundFont, const char *path)
+{
+#ifndef WORDS_BIGENDIAN
+    CHUNK *main_chunk = &soundFont->chunk.main_chunk;
+    size_t len;
+    BYTE *base = (BYTE *) csoundMapFile(path, &len);
+    if (base == NULL) return NOTOK;
+    if (len < 8 || memcmp(base, "RIFF", 4) != 0 ||
+        (size_t) dword((char *) base + 4) > len - 8) {
+      csoundUnmapFile(base);
+      return NOTOK;
+    }
+    memcpy(main_chunk->ckID, base, 4);
+    main_chunk->ckSize = dword((char *) base + 4);
+    main_chunk->ckDATA = base + 8;
+    soundFont->mapped = 1;
+    return OK;
+#else
+    (void) soundFont; (void) path;
+    return NOTOK;               /* data is byte swapped in place */
+#endif
+}
+
 static void SoundFontLoad(CSOUND *csound, char *fname)
 {
     FILE *fil;
@@ -107,6 +143,8 @@ static void SoundFontLoad(CSOUND *csound, char *fname)
     sfontg *globals;
     globals = (sfontg *) (csound->QueryGlobalVariable(csound, "::sfontg"));
     soundFont = globals->soundFont;
+    globals->sfArray[globals->currSFndx].sampleDataF = NULL;
+    globals->sfArray[globals->currSFndx].mapped = 0;
     fd = csound->FileOpen2(csound, &fil, CSFILE_STD, fname, "rb",
                              "SFDIR;SSDIR", CSFTYPE_SOUNDFONT, 0);
     if (UNLIKELY(fd == NULL)) {
@@ -122,7 +160,8 @@ static void SoundFontLoad(CSOUND *csound, char *fname)
     /* } */
     strNcpy(soundFont->name, csound->GetFileName(fd), 256);
     //soundFont->name[255]='\0';
-    if (UNLIKELY(chunk_read(csound, fil, &soundFont->chunk.main_chunk)<0))
+    if (SoundFontMap(soundFont, csound->GetFileName(fd)) != OK &&
+        UNLIKELY(chunk_read(csound, fil, &soundFont->chunk.main_chunk)<0))
       csound->Message(csound, Str("sfont: failed to read file\n"));
     csound->FileClose(csound, fd);
     globals->soundFont = soundFont;
@@ -130,6 +169,22 @@ static void SoundFontLoad(CSOUND *csound, char *fname)
     fill_SfStruct(csound);
 }
 
+/* Keep a MYFLT copy of the sample data of a bank so that the players
+   need not convert every read.  SF_GUARD zeros either side cover the
+   points the cubic interpolator reads around the data. */
+static void SoundFontConvert(CSOUND *csound, SFBANK *sf)
+{
+    size_t n, nsamps;
+    MYFLT *data;
+    if (sf->chunk.smplChunk == NULL || sf->sampleDataF != NULL) return;
+    nsamps = sf->chunk.smplChunk->ckSize / sizeof(SHORT);
+    data = (MYFLT *) csound->Calloc(csound,
+                                    (nsamps + 2*SF_GUARD)*sizeof(MYFLT));
+    data += SF_GUARD;
+    for (n = 0; n < nsamps; n++) data[n] = (MYFLT) sf->sampleData[n];
+    sf->sampleDataF = data;
+}
+
 static int32_t compare(presetType * elem1, presetType *elem2)
 {
     if (elem1->bank * 128 + elem1->prog >  elem2->bank * 128 + elem2->prog)
@@ -139,7 +194,8 @@ static int32_t compare(presetType * elem1, presetType *elem2)
 }
 
 /* syntax:
-        ihandle SfLoad "filename"
+        ihandle SfLoad "filename" [, iconvert]
+   a non-zero iconvert keeps the samples as MYFLT for faster playback
 */
 
 static char *Gfname;            /* NOT THREAD SAFE */
@@ -167,6 +223,7 @@ static int32_t SfLoad_(CSOUND *csound, SFLOAD *p, int32_t istring)
     SoundFontLoad(csound, fname);
     *p->ihandle = (float) globals->currSFndx;
     sf = &globals->sfArray[globals->currSFndx];
+    if (*p->iconvert != FL(0.0)) SoundFontConvert(csound, sf);
     qsort(sf->preset, sf->presets_num, sizeof(presetType),
         (int32_t (*)(const void *, const void * )) compare);
     csound->Free(csound,fname);
@@ -248,6 +305,7 @@ static int32_t SfAssignAllPresets(CSOUND *csound, SFPASSIGN *p)
                                 j, prs->name, prs->prog, prs->bank);
       globals->presetp[pHandle] = &sf->preset[j];
       globals->sampleBase[pHandle] = sf->sampleData;
+      globals->sampleBaseF[pHandle] = sf->sampleDataF;
       pHandle++;
     }
     if (enableMsgs)
@@ -292,6 +350,7 @@ static int32_t SfPreset(CSOUND *csound, SFPRESET *p)
         {
           globals->presetp[presetHandle] = &sf->preset[j];
           globals->sampleBase[presetHandle] = sf->sampleData;
+          globals->sampleBaseF[presetHandle] = sf->sampleDataF;
           break;
         }
     }
@@ -308,17 +367,196 @@ static int32_t SfPreset(CSOUND *csound, SFPRESET *p)
     return OK;
 }
 
+/* Block renderer shared by the sfplay and sfinstr families.  Each split
+   is taken over the whole block in three passes: the phase pass works
+   out the read positions and deals with the loop or the end of the
+   sample, the interpolation pass reads the sample data without any
+   tests, and the mixing pass applies level and envelope in a plain
+   multiply-add that the compiler can vectorise.  Splits whose bank was
+   converted by sfload read MYFLT data and skip the 16 bit conversion. */
+
+static void sf_work_alloc(CSOUND *csound, SFSPLITS *sp, uint32_t ksmps)
+{
+    size_t size = ksmps * (2*sizeof(MYFLT) + sizeof(int32));
+    if (sp->work.auxp == NULL || sp->work.size < size)
+      csound->AuxAlloc(csound, size, &sp->work);
+}
+
+/* unlooped splits stop sounding at the end of the sample */
+static inline int32_t sf_active(const SFSPLITS *sp, int32_t j)
+{
+    return sp->mode[j] == 1 || sp->mode[j] == 3 || sp->phs[j] < sp->end[j];
+}
+
+/* one k-cycle step of the split envelope, once per block */
+static inline MYFLT sf_envelope(SFSPLITS *sp, int32_t j, MYFLT ienv)
+{
+    if (ienv > 1) {
+      if (sp->ti[j] < sp->attack[j]) sp->env[j] += sp->attr[j];
+      else if (sp->ti[j] < sp->decay[j] + sp->attack[j])
+        sp->env[j] *= sp->decr[j];
+      else sp->env[j] = sp->sustain[j];
+      sp->ti[j]++;
+    }
+    else if (ienv > 0) {
+      if (sp->ti[j] < sp->attack[j]) sp->env[j] += sp->attr[j];
+      else if (sp->ti[j] < sp->decay[j] + sp->attack[j])
+        sp->env[j] += sp->decr[j];
+      else sp->env[j] = sp->sustain[j];
+      sp->ti[j]++;
+    }
+    return sp->env[j];
+}
+
+/* Fill idx/frac for samples offset.. of split j, 'back' samples behind
+   the phase (1 for cubic, which reads one sample before the point).
+   freq is read with stride fstride, 0 for a k-rate frequency.  Returns
+   the end of the rendered span, short of nsmps if an unlooped split
+   ran off its end. */
+static uint32_t sf_phases(SFSPLITS *sp, int32_t j, const MYFLT *freq,
+                          int32_t fstride, double back, int32 *idx,
+                          MYFLT *frac, uint32_t offset, uint32_t nsmps)
+{
+    double phs = sp->phs[j], si = sp->si[j];
+    uint32_t n;
+    if (sp->mode[j] == 1 || sp->mode[j] == 3) {
+      double startloop = sp->startloop[j], endloop = sp->endloop[j];
+      double looplength = endloop - startloop;
+      int32_t flag = 0;
+      for (n = offset; n < nsmps; n++) {
+        double ph = phs - back;
+        idx[n] = (int32) ph;
+        frac[n] = (MYFLT) (ph - idx[n]);
+        phs += si * freq[n*fstride];
+        if (phs >= startloop) flag = 1;
+        if (flag) {
+          while (phs >= endloop) phs -= looplength;
+          while (phs < startloop) phs += looplength;
+        }
+      }
+    }
+    else {
+      double end = sp->end[j];
+      for (n = offset; n < nsmps; n++) {
+        double ph = phs - back;
+        idx[n] = (int32) ph;
+        frac[n] = (MYFLT) (ph - idx[n]);
+        phs += si * freq[n*fstride];
+        if (phs > end) { n++; break; }
+        if (phs < 0.0) phs = 0.0;
+      }
+    }
+    sp->phs[j] = phs;
+    return n;
+}
+
+static inline MYFLT sf_cubic(MYFLT ym1, MYFLT y0, MYFLT y1, MYFLT y2,
+                             MYFLT fract)
+{
+    MYFLT frsq = fract*fract;
+    MYFLT frcu = frsq*ym1;
+    MYFLT t1   = y2 + FL(3.0)*y0;
+    return y0 + FL(0.5)*frcu +
+      fract*(y1 - frcu/FL(6.0) - t1/FL(6.0) - ym1/FL(3.0)) +
+      frsq*fract*(t1/FL(6.0) - FL(0.5)*y1) + frsq*(FL(0.5)* y1 - y0);
+}
+
+static void sf_interp(const SFSPLITS *sp, int32_t j, int32_t cubic,
+                      const int32 *idx, const MYFLT *frac, MYFLT *out,
+                      uint32_t offset, uint32_t stop)
+{
+    uint32_t n;
+    if (sp->fbase[j] != NULL) {
+      const MYFLT *b = sp->fbase[j];
+      if (cubic)
+        for (n = offset; n < stop; n++) {
+          const MYFLT *s = b + idx[n];
+          out[n] = sf_cubic(s[0], s[1], s[2], s[3], frac[n]);
+        }
+      else
+        for (n = offset; n < stop; n++) {
+          const MYFLT *s = b + idx[n];
+          out[n] = s[0] + (s[1] - s[0])*frac[n];
+        }
+    }
+    else {
+      const SHORT *b = sp->base[j];
+      if (cubic)
+        for (n = offset; n < stop; n++) {
+          const SHORT *s = b + idx[n];
+          out[n] = sf_cubic(s[0], s[1], s[2], s[3], frac[n]);
+        }
+      else
+        for (n = offset; n < stop; n++) {
+          const SHORT *s = b + idx[n];
+          out[n] = s[0] + (s[1] - s[0])*frac[n];
+        }
+    }
+}
+
+static inline void sf_mix(MYFLT *out, const MYFLT *in, MYFLT gain,
+                          uint32_t offset, uint32_t stop)
+{
+    uint32_t n;
+    for (n = offset; n < stop; n++) out[n] += gain * in[n];
+}
+
+/* Render all splits of a note into out1 (and out2 if stereo, in which
+   case leftlevel/rightlevel pan them) and apply the amplitude. */
+static void sf_render(OPDS *h, SFSPLITS *sp, MYFLT *out1, MYFLT *out2,
+                      MYFLT *xamp, MYFLT *xfreq, MYFLT ienv, int32_t cubic)
+{
+    uint32_t offset = h->insdshead->ksmps_offset;
+    uint32_t early  = h->insdshead->ksmps_no_end;
+    uint32_t n, nsmps = h->insdshead->ksmps;
+    MYFLT   *smp = (MYFLT *) sp->work.auxp, *frac = smp + nsmps;
+    int32   *idx = (int32 *) (frac + nsmps);
+    int32_t fstride = IS_ASIG_ARG(xfreq) ? 1 : 0;
+    int32_t j;
+
+    memset(out1, 0, nsmps*sizeof(MYFLT));
+    if (out2 != NULL) memset(out2, 0, nsmps*sizeof(MYFLT));
+    if (UNLIKELY(early)) nsmps -= early;
+
+    for (j = 0; j < sp->spltNum; j++) {
+      MYFLT env;
+      uint32_t stop;
+      if (!sf_active(sp, j)) continue;
+      env = sf_envelope(sp, j, ienv);
+      stop = sf_phases(sp, j, xfreq, fstride, cubic ? 1.0 : 0.0,
+                       idx, frac, offset, nsmps);
+      sf_interp(sp, j, cubic, idx, frac, smp, offset, stop);
+      sf_mix(out1, smp, sp->leftlevel[j]*env, offset, stop);
+      if (out2 != NULL)
+        sf_mix(out2, smp, sp->rightlevel[j]*env, offset, stop);
+    }
+
+    if (IS_ASIG_ARG(xamp)) {
+      for (n=offset;n<nsmps;n++) out1[n] *= xamp[n];
+      if (out2 != NULL)
+        for (n=offset;n<nsmps;n++) out2[n] *= xamp[n];
+    }
+    else {
+      MYFLT famp = *xamp;
+      for (n=offset;n<nsmps;n++) out1[n] *= famp;
+      if (out2 != NULL)
+        for (n=offset;n<nsmps;n++) out2[n] *= famp;
+    }
+}
+
 static int32_t SfPlay_set(CSOUND *csound, SFPLAY *p)
 {
     DWORD index = (DWORD) *p->ipresethandle;
     presetType *preset;
     SHORT *sBase;
+    MYFLT *sBaseF;
 
     int32_t layersNum, j, spltNum = 0, flag = (int32_t) *p->iflag;
     sfontg *globals;
     globals = (sfontg *) (csound->QueryGlobalVariable(csound, "::sfontg"));
     preset = globals->presetp[index];
     sBase = globals->sampleBase[index];
+    sBaseF = globals->sampleBaseF[index];
 
     if (!UNLIKELY(preset!=NULL)) {
       return csound->InitError(csound, Str("sfplay: invalid or "
@@ -351,13 +589,13 @@ static int32_t SfPlay_set(CSOUND *csound, SFPLAY *p)
             orgfreq = globals->pitches[orgkey];
             if (flag) {
               freq = orgfreq * pow(2.0, ONETWELTH * tuneCorrection);
-              p->si[spltNum]= (freq/(orgfreq*orgfreq))*
+              p->sp.si[spltNum]= (freq/(orgfreq*orgfreq))*
                                sample->dwSampleRate*csound->onedsr;
             }
             else {
               freq = orgfreq * pow(2.0, ONETWELTH * tuneCorrection) *
                 pow(2.0, ONETWELTH * (split->scaleTuning*0.01) * (notnum-orgkey));
-              p->si[spltNum]= (freq/orgfreq) * sample->dwSampleRate*csound->onedsr;
+              p->sp.si[spltNum]= (freq/orgfreq) * sample->dwSampleRate*csound->onedsr;
             }
             attenuation = (MYFLT) (layer->initialAttenuation +
                                    split->initialAttenuation);
@@ -367,280 +605,62 @@ static int32_t SfPlay_set(CSOUND *csound, SFPLAY *p)
             if (pan > 1.0) pan = 1.0;
             else if (pan < 0.0) pan = 0.0;
             /* Suggested fix from steven yi Oct 2002 */
-            p->base[spltNum] = sBase + start;
-            p->phs[spltNum] = (double) split->startOffset + *p->ioffset;
-            p->end[spltNum] = sample->dwEnd + split->endOffset - start;
-            p->startloop[spltNum] =
+            p->sp.base[spltNum] = sBase + start;
+            p->sp.fbase[spltNum] = sBaseF != NULL ? sBaseF + start : NULL;
+            p->sp.phs[spltNum] = (double) split->startOffset + *p->ioffset;
+            p->sp.end[spltNum] = sample->dwEnd + split->endOffset - start;
+            p->sp.startloop[spltNum] =
               sample->dwStartloop + split->startLoopOffset  - start;
-            p->endloop[spltNum] =
+            p->sp.endloop[spltNum] =
               sample->dwEndloop + split->endLoopOffset - start;
-            p->leftlevel[spltNum] = (MYFLT) sqrt(1.0-pan) * attenuation;
-            p->rightlevel[spltNum] = (MYFLT) sqrt(pan) * attenuation;
-            p->mode[spltNum]= split->sampleModes;
-            p->attack[spltNum] = split->attack*CS_EKR;
-            p->decay[spltNum] = split->decay*CS_EKR;
-            p->sustain[spltNum] = split->sustain;
-            p->release[spltNum] = split->release*CS_EKR;
+            p->sp.leftlevel[spltNum] = (MYFLT) sqrt(1.0-pan) * attenuation;
+            p->sp.rightlevel[spltNum] = (MYFLT) sqrt(pan) * attenuation;
+            p->sp.mode[spltNum]= split->sampleModes;
+            p->sp.attack[spltNum] = split->attack*CS_EKR;
+            p->sp.decay[spltNum] = split->decay*CS_EKR;
+            p->sp.sustain[spltNum] = split->sustain;
+            p->sp.release[spltNum] = split->release*CS_EKR;
 
             if (*p->ienv > 1) {
-              p->attr[spltNum] = 1.0/(CS_EKR*split->attack);
-              p->decr[spltNum] = pow((split->sustain+0.0001),
+              p->sp.attr[spltNum] = 1.0/(CS_EKR*split->attack);
+              p->sp.decr[spltNum] = pow((split->sustain+0.0001),
                                      1.0/(CS_EKR*
                                           split->decay+0.0001));
-              if (split->attack != 0.0) p->env[spltNum] = 0.0;
-              else p->env[spltNum] = 1.0;
+              if (split->attack != 0.0) p->sp.env[spltNum] = 0.0;
+              else p->sp.env[spltNum] = 1.0;
             }
             else if (*p->ienv > 0) {
-              p->attr[spltNum] = 1.0/(CS_EKR*split->attack);
-              p->decr[spltNum] = (split->sustain-1.0)/(CS_EKR*
+              p->sp.attr[spltNum] = 1.0/(CS_EKR*split->attack);
+              p->sp.decr[spltNum] = (split->sustain-1.0)/(CS_EKR*
                                                        split->decay);
-              if (split->attack != 0.0) p->env[spltNum] = 0.0;
-              else p->env[spltNum] = 1.0;
+              if (split->attack != 0.0) p->sp.env[spltNum] = 0.0;
+              else p->sp.env[spltNum] = 1.0;
             }
             else {
-              p->env[spltNum] = 1.0;
+              p->sp.env[spltNum] = 1.0;
             }
-            p->ti[spltNum] = 0;
+            p->sp.ti[spltNum] = 0;
             spltNum++;
           }
         }
       }
     }
-    p->spltNum = spltNum;
+    p->sp.spltNum = spltNum;
+    sf_work_alloc(csound, &p->sp, CS_KSMPS);
     return OK;
 }
 
-#define Linear_interpolation \
-        SHORT *curr_samp = *base + (int32) *phs;\
-        MYFLT fract = (MYFLT) *phs - (MYFLT)((int32)*phs);\
-        MYFLT out = (*curr_samp + (*(curr_samp+1) - *curr_samp)*fract);
-
-#define Cubic_interpolation \
-        MYFLT phs1 = (MYFLT) *phs -FL(1.0);\
-        int32_t   x0 = (int32)phs1 ;\
-        MYFLT fract = (MYFLT)(phs1 - x0);\
-        SHORT *ftab = *base + x0;\
-        MYFLT ym1= *ftab++;\
-        MYFLT y0 = *ftab++;\
-        MYFLT y1 = *ftab++;\
-        MYFLT y2 = *ftab;\
-        MYFLT frsq = fract*fract;\
-        MYFLT frcu = frsq*ym1;\
-        MYFLT t1   = y2 + FL(3.0)*y0;\
-        MYFLT out =  y0 + FL(0.5)*frcu + \
-                fract*(y1 - frcu/FL(6.0) - t1/FL(6.0) - ym1/FL(3.0)) + \
-                frsq*fract*(t1/FL(6.0) - FL(0.5)*y1) + frsq*(FL(0.5)* y1 - y0);
-
-#define Looped \
-        if (*phs >= *startloop) flag = 1;                 \
-        if (flag) {                                       \
-          while (*phs >= *endloop) *phs -= looplength;    \
-          while (*phs < *startloop) *phs += looplength;   \
-        }
-
-#define ExpEnvelope \
-        if (*tinc < *attack) *env += *attr;                        \
-        else if (*tinc < *decay + *attack) *env *= *decr;          \
-        else *env = *sustain;                                      \
-        (*tinc)++;                                                 \
-
-#define LinEnvelope \
-        if (*tinc < *attack) *env += *attr;                        \
-        else if (*tinc < *decay + *attack) *env += *decr;          \
-        else *env = *sustain;                                      \
-        (*tinc)++;                                                 \
-
-#define Unlooped \
-        if (*phs > *end) break;           \
-        if (*phs < FL(0.0)) *phs = FL(0.0);       \
-
-#define Mono_out \
-        out1[n] +=  *attenuation * out * (*env); \
-        *phs += si;
-
-#define Stereo_out \
-        out1[n] += *left * out * (*env);\
-        out2[n] += *right * out * (*env);\
-        *phs += si;
-
 static int32_t SfPlay(CSOUND *csound, SFPLAY *p)
 {
     IGN(csound);
-    MYFLT   *out1 = p->out1, *out2 = p->out2, *env = p->env;
-    uint32_t offset = p->h.insdshead->ksmps_offset;
-    uint32_t early  = p->h.insdshead->ksmps_no_end;
-    uint32_t n, nsmps = CS_KSMPS;
-    int32_t      j = p->spltNum;
-    SHORT **base = p->base;
-    DWORD *end = p->end,  *startloop= p->startloop, *endloop= p->endloop,
-          *tinc = p->ti;
-    SHORT *mode = p->mode;
-    double *sampinc = p->si, *phs = p->phs;
-    MYFLT *left= p->leftlevel, *right= p->rightlevel, *attack = p->attack,
-      *decr = p->decr, *decay = p->decay, *sustain= p->sustain,
-      *release = p->release, *attr = p->attr;
-
-
-    memset(out1, 0, nsmps*sizeof(MYFLT));
-    memset(out2, 0, nsmps*sizeof(MYFLT));
-    if (UNLIKELY(early)) nsmps -= early;
-
-    if (IS_ASIG_ARG(p->xfreq)) {
-      while (j--) {
-        double looplength = *endloop - *startloop;
-        MYFLT *freq = p->xfreq;
-
-        if (*mode == 1 || *mode ==3) {
-          int32_t flag =0;
-          if (*p->ienv > 1) { ExpEnvelope }
-          else if (*p->ienv > 0) { LinEnvelope }
-          for (n=offset;n<nsmps;n++) {
-            double si = *sampinc * freq[n];
-            Linear_interpolation Stereo_out Looped
-          }
-        }
-        else if (*phs < *end) {
-          if (*p->ienv > 1) { ExpEnvelope }
-          else if (*p->ienv > 0) { LinEnvelope }
-          for (n=offset;n<nsmps;n++) {
-            double si = *sampinc * freq[n];
-            Linear_interpolation Stereo_out  Unlooped
-          }
-        }
-        phs++; base++; sampinc++; endloop++; startloop++;
-        left++; right++, mode++, end++; attack++; decay++; sustain++;
-        release++; tinc++; env++; attr++; decr++;
-      }
-    }
-    else {
-      MYFLT freq = *p->xfreq;
-      while (j--) {
-        double looplength = *endloop - *startloop;
-        double si = *sampinc * freq;
-        if (*mode == 1 || *mode ==3) {
-          int32_t flag =0;
-          if (*p->ienv > 1) { ExpEnvelope }
-          else if (*p->ienv > 0) { LinEnvelope }
-          for (n=offset;n<nsmps;n++) {
-            Linear_interpolation Stereo_out     Looped
-          }
-        }
-        else if (*phs < *end) {
-          if (*p->ienv > 1) { ExpEnvelope }
-          else if (*p->ienv > 0) { LinEnvelope }
-          for (n=offset;n<nsmps;n++) {
-            Linear_interpolation Stereo_out Unlooped
-          }
-        }
-        phs++; base++; sampinc++; endloop++; startloop++;
-        left++; right++, mode++, end++; attack++; decay++; sustain++;
-        release++; tinc++; env++; attr++; decr++;
-      }
-    }
-    if (IS_ASIG_ARG(p->xamp)) {
-      MYFLT *amp = p->xamp;
-      for (n=offset;n<nsmps;n++) {
-        out1[n] *= amp[n];
-        out2[n] *= amp[n];
-      }
-    }
-    else {
-      MYFLT famp = *p->xamp;
-      for (n=offset;n<nsmps;n++) {
-        out1[n] *= famp;
-        out2[n] *= famp;
-      }
-    }
+    sf_render(&p->h, &p->sp, p->out1, p->out2, p->xamp, p->xfreq, *p->ienv, 0);
     return OK;
 }
 
 static int32_t SfPlay3(CSOUND *csound, SFPLAY *p)
 {
     IGN(csound);
-    MYFLT    *out1 = p->out1, *out2 = p->out2, *env = p->env;
-    uint32_t offset = p->h.insdshead->ksmps_offset;
-    uint32_t early  = p->h.insdshead->ksmps_no_end;
-    uint32_t n, nsmps = CS_KSMPS;
-    int32_t      j = p->spltNum;
-    SHORT **base = p->base;
-    DWORD *end = p->end,  *startloop = p->startloop,
-          *endloop = p->endloop, *tinc = p->ti;
-    SHORT *mode = p->mode;
-    double *sampinc = p->si, *phs = p->phs;
-    MYFLT *left= p->leftlevel, *right= p->rightlevel, *attack = p->attack,
-          *decr = p->decr, *decay = p->decay, *sustain= p->sustain,
-          *release = p->release, *attr = p->attr;
-
-    memset(out1, 0, nsmps*sizeof(MYFLT));
-    memset(out2, 0, nsmps*sizeof(MYFLT));
-    if (UNLIKELY(early)) nsmps -= early;
-
-    if (IS_ASIG_ARG(p->xfreq)) {
-      while (j--) {
-        double looplength = *endloop - *startloop;
-        MYFLT *freq = p->xfreq;
-/*         nsmps = CS_KSMPS; */
-        if (*mode == 1 || *mode ==3) {
-          int32_t flag =0;
-          if (*p->ienv > 1) { ExpEnvelope }
-          else if (*p->ienv > 0) { LinEnvelope }
-          for (n=offset;n<nsmps;n++) {
-            double si = *sampinc * freq[n];
-            Cubic_interpolation Stereo_out      Looped
-          }
-        }
-        else if (*phs < *end) {
-          if (*p->ienv > 1) { ExpEnvelope }
-          else if (*p->ienv > 0) { LinEnvelope }
-          for (n=offset;n<nsmps;n++) {
-            double si = *sampinc * freq[n];
-            Cubic_interpolation Stereo_out      Unlooped
-          }
-        }
-        phs++; base++; sampinc++; endloop++; startloop++;
-        left++; right++, mode++, end++; attack++; decay++; sustain++;
-        release++; tinc++; env++; attr++; decr++;
-      }
-    }
-    else {
-      MYFLT freq = *p->xfreq;
-      while (j--) {
-        double looplength = *endloop - *startloop, si = *sampinc * freq;
-        if (*mode == 1 || *mode ==3) {
-          int32_t flag =0;
-          if (*p->ienv > 1) { ExpEnvelope }
-          else if (*p->ienv > 0) { LinEnvelope }
-          for (n=offset;n<nsmps;n++) {
-            Cubic_interpolation Stereo_out      Looped
-          }
-        }
-        else if (*phs < *end) {
-          if (*p->ienv > 1) { ExpEnvelope }
-          else if (*p->ienv > 0) { LinEnvelope }
-          for (n=offset;n<nsmps;n++) {
-            Cubic_interpolation Stereo_out      Unlooped
-          }
-        }
-        phs++; base++; sampinc++; endloop++; startloop++;
-        left++; right++, mode++, end++; attack++; decay++; sustain++;
-        release++; tinc++; env++; attr++; decr++;
-      }
-    }
-
-    if (IS_ASIG_ARG(p->xamp)) {
-      MYFLT *amp = p->xamp;
-      for (n=offset;n<nsmps;n++) {
-        out1[n] *= amp[n];
-        out2[n] *= amp[n];
-      }
-    }
-    else {
-      MYFLT famp = *p->xamp;
-      for (n=offset;n<nsmps;n++) {
-        out1[n] *= famp;
-        out2[n] *= famp;
-      }
-    }
+    sf_render(&p->h, &p->sp, p->out1, p->out2, p->xamp, p->xfreq, *p->ienv, 1);
     return OK;
 }
 
@@ -649,11 +669,13 @@ static int32_t SfPlayMono_set(CSOUND *csound, SFPLAYMONO *p)
     DWORD index = (DWORD) *p->ipresethandle;
     presetType *preset;
     SHORT *sBase;
+    MYFLT *sBaseF;
     int32_t layersNum, j, spltNum = 0, flag=(int32_t) *p->iflag;
     sfontg *globals;
     globals = (sfontg *) (csound->QueryGlobalVariable(csound, "::sfontg"));
     preset = globals->presetp[index];
     sBase = globals->sampleBase[index];
+    sBaseF = globals->sampleBaseF[index];
 
     if (UNLIKELY(!preset)) {
       return csound->InitError(csound, Str("sfplaym: invalid or "
@@ -684,229 +706,71 @@ static int32_t SfPlayMono_set(CSOUND *csound, SFPLAYMONO *p)
             orgfreq = globals->pitches[orgkey] ;
             if (flag) {
               freq = orgfreq * pow(2.0, ONETWELTH * tuneCorrection);
-              p->si[spltNum]= (freq/(orgfreq*orgfreq))*
+              p->sp.si[spltNum]= (freq/(orgfreq*orgfreq))*
                                sample->dwSampleRate*csound->onedsr;
             }
             else {
               freq = orgfreq * pow(2.0, ONETWELTH * tuneCorrection) *
                 pow( 2.0, ONETWELTH* (split->scaleTuning*0.01) * (notnum-orgkey));
-              p->si[spltNum]= (freq/orgfreq) * sample->dwSampleRate*csound->onedsr;
+              p->sp.si[spltNum]= (freq/orgfreq) * sample->dwSampleRate*csound->onedsr;
             }
-            p->attenuation[spltNum] =
+            p->sp.leftlevel[spltNum] =
               POWER(FL(2.0), (-FL(1.0)/FL(60.0)) * (layer->initialAttenuation +
                                                     split->initialAttenuation)) *
               GLOBAL_ATTENUATION;
-            p->base[spltNum] =  sBase+ start;
-            p->phs[spltNum] = (double) split->startOffset + *p->ioffset;
-            p->end[spltNum] = sample->dwEnd + split->endOffset - start;
-            p->startloop[spltNum] = sample->dwStartloop +
+            p->sp.base[spltNum] =  sBase+ start;
+            p->sp.fbase[spltNum] = sBaseF != NULL ? sBaseF + start : NULL;
+            p->sp.phs[spltNum] = (double) split->startOffset + *p->ioffset;
+            p->sp.end[spltNum] = sample->dwEnd + split->endOffset - start;
+            p->sp.startloop[spltNum] = sample->dwStartloop +
               split->startLoopOffset - start;
-            p->endloop[spltNum] = sample->dwEndloop + split->endLoopOffset - start;
-            p->mode[spltNum]= split->sampleModes;
-            p->attack[spltNum] = split->attack*CS_EKR;
-            p->decay[spltNum] = split->decay*CS_EKR;
-            p->sustain[spltNum] = split->sustain;
-            p->release[spltNum] = split->release*CS_EKR;
+            p->sp.endloop[spltNum] = sample->dwEndloop + split->endLoopOffset - start;
+            p->sp.mode[spltNum]= split->sampleModes;
+            p->sp.attack[spltNum] = split->attack*CS_EKR;
+            p->sp.decay[spltNum] = split->decay*CS_EKR;
+            p->sp.sustain[spltNum] = split->sustain;
+            p->sp.release[spltNum] = split->release*CS_EKR;
 
             if (*p->ienv > 1) {
-             p->attr[spltNum] = 1.0/(CS_EKR*split->attack);
-             p->decr[spltNum] = pow((split->sustain+0.0001),
+             p->sp.attr[spltNum] = 1.0/(CS_EKR*split->attack);
+             p->sp.decr[spltNum] = pow((split->sustain+0.0001),
                                     1.0/(CS_EKR*
                                          split->decay+0.0001));
-            if (split->attack != 0.0) p->env[spltNum] = 0.0;
-            else p->env[spltNum] = 1.0;
+            if (split->attack != 0.0) p->sp.env[spltNum] = 0.0;
+            else p->sp.env[spltNum] = 1.0;
             }
             else if (*p->ienv > 0) {
-            p->attr[spltNum] = 1.0/(CS_EKR*split->attack);
-            p->decr[spltNum] = (split->sustain-1.0)/(CS_EKR*
+            p->sp.attr[spltNum] = 1.0/(CS_EKR*split->attack);
+            p->sp.decr[spltNum] = (split->sustain-1.0)/(CS_EKR*
                                                      split->decay);
-            if (split->attack != 0.0) p->env[spltNum] = 0.0;
-            else p->env[spltNum] = 1.0;
+            if (split->attack != 0.0) p->sp.env[spltNum] = 0.0;
+            else p->sp.env[spltNum] = 1.0;
             }
             else {
-              p->env[spltNum] = 1.0;
+              p->sp.env[spltNum] = 1.0;
             }
-            p->ti[spltNum] = 0;
+            p->sp.ti[spltNum] = 0;
             spltNum++;
           }
         }
       }
     }
-    p->spltNum = spltNum;
+    p->sp.spltNum = spltNum;
+    sf_work_alloc(csound, &p->sp, CS_KSMPS);
     return OK;
 }
 
 static int32_t SfPlayMono(CSOUND *csound, SFPLAYMONO *p)
 {
     IGN(csound);
-    MYFLT   *out1 = p->out1 , *env  = p->env;
-    uint32_t offset = p->h.insdshead->ksmps_offset;
-    uint32_t early  = p->h.insdshead->ksmps_no_end;
-    uint32_t n, nsmps = CS_KSMPS;
-    int32_t      j = p->spltNum;
-    SHORT **base = p->base;
-    DWORD *end= p->end, *startloop= p->startloop, *endloop= p->endloop,
-          *tinc = p->ti;
-    SHORT *mode = p->mode;
-    double *sampinc = p->si, *phs = p->phs;
-    MYFLT *attenuation = p->attenuation, *attack = p->attack, *decr = p->decr,
-          *decay = p->decay, *sustain= p->sustain, *release = p->release,
-          *attr = p->attr;
-
-    memset(out1, 0, nsmps*sizeof(MYFLT));
-    if (UNLIKELY(early)) nsmps -= early;
-
-    if (IS_ASIG_ARG(p->xfreq)) {
-      while (j--) {
-        double looplength = *endloop - *startloop;
-        MYFLT *freq = p->xfreq;
-
-        if (*mode == 1 || *mode ==3) {
-          int32_t flag =0;
-          for (n=offset;n<nsmps;n++) {
-            double si = *sampinc * freq[n];
-            if (*p->ienv > 1) { ExpEnvelope }
-            else if (*p->ienv > 0) { LinEnvelope }
-            { Linear_interpolation Mono_out Looped }
-          }
-        }
-        else if (*phs < *end) {
-          for (n=offset;n<nsmps;n++) {
-            double si = *sampinc * freq[n];
-            if (*p->ienv > 1) { ExpEnvelope }
-            else if (*p->ienv > 0) { LinEnvelope }
-            { Linear_interpolation Mono_out Unlooped }
-          }
-        }
-        phs++; base++; sampinc++; endloop++; startloop++;
-        attenuation++, mode++, end++; attack++; decay++; sustain++;
-        release++; tinc++; env++; attr++; decr++;
-      }
-    }
-    else {
-      MYFLT freq = *p->xfreq;
-      while (j--) {
-        double looplength = *endloop - *startloop;
-        double si = *sampinc * freq;
-        if (*mode == 1 || *mode ==3) {
-          int32_t flag =0;
-          for (n=offset;n<nsmps;n++) {
-            if (*p->ienv > 1) { ExpEnvelope }
-            else if (*p->ienv > 0) { LinEnvelope }
-            { Linear_interpolation Mono_out Looped }
-          }
-        }
-        else if (*phs < *end) {
-          for (n=offset;n<nsmps;n++) {
-            if (*p->ienv > 1) { ExpEnvelope }
-            else if (*p->ienv > 0) { LinEnvelope }
-            { Linear_interpolation Mono_out Unlooped }
-          }
-        }
-        phs++; base++; sampinc++; endloop++; startloop++;
-        attenuation++, mode++, end++; attack++; decay++; sustain++;
-        release++; tinc++; env++; attr++; decr++;
-      }
-    }
-    if (IS_ASIG_ARG(p->xamp)) {
-      MYFLT *amp = p->xamp;
-      for (n=offset;n<nsmps;n++) {
-        out1[n] *= amp[n];
-      }
-    }
-    else {
-      MYFLT famp = *p->xamp;
-      for (n=offset;n<nsmps;n++) {
-        out1[n] *= famp;
-      }
-    }
+    sf_render(&p->h, &p->sp, p->out1, NULL, p->xamp, p->xfreq, *p->ienv, 0);
     return OK;
 }
 
 static int32_t SfPlayMono3(CSOUND *csound, SFPLAYMONO *p)
 {
     IGN(csound);
-    MYFLT   *out1 = p->out1, *env = p->env;
-    uint32_t offset = p->h.insdshead->ksmps_offset;
-    uint32_t early  = p->h.insdshead->ksmps_no_end;
-    uint32_t n, nsmps = CS_KSMPS;
-    int32_t      j = p->spltNum;
-    SHORT  **base = p->base;
-    DWORD   *end = p->end,  *startloop = p->startloop,
-            *endloop = p->endloop, *tinc = p->ti;
-    SHORT   *mode = p->mode;
-    double *sampinc = p->si, *phs = p->phs;
-    MYFLT *attenuation = p->attenuation,*attack = p->attack, *decr = p->decr,
-          *decay = p->decay, *sustain= p->sustain, *release = p->release,
-          *attr = p->attr;
-
-    memset(out1, 0, nsmps*sizeof(MYFLT));
-    if (UNLIKELY(early)) nsmps -= early;
-    if (IS_ASIG_ARG(p->xfreq)) {
-      while (j--) {
-        double looplength = *endloop - *startloop;
-        MYFLT *freq = p->xfreq;
-
-        if (*mode == 1 || *mode ==3) {
-          int32_t flag =0;
-          if (*p->ienv > 1) { ExpEnvelope }
-          else if (*p->ienv > 0) { LinEnvelope }
-          for (n=offset;n<nsmps;n++) {
-            double si = *sampinc * freq[n];
-            Cubic_interpolation Mono_out        Looped
-          }
-        }
-        else if (*phs < *end) {
-          if (*p->ienv > 1) { ExpEnvelope }
-          else if (*p->ienv > 0) { LinEnvelope }
-          for (n=offset;n<nsmps;n++) {
-            double si = *sampinc * freq[n];
-            Cubic_interpolation Mono_out        Unlooped
-          }
-        }
-        phs++; base++; sampinc++; endloop++; startloop++;
-        attenuation++, mode++, end++; attack++; decay++; sustain++;
-        release++; tinc++; env++; attr++; decr++;
-      }
-    }
-    else {
-      MYFLT freq = *p->xfreq;
-      while (j--) {
-        double looplength = *endloop - *startloop;
-        double si = *sampinc * freq;
-        if (*mode == 1 || *mode ==3) {
-          int32_t flag =0;
-          if (*p->ienv > 1) { ExpEnvelope }
-          else if (*p->ienv > 0) { LinEnvelope }
-          for (n=offset;n<nsmps;n++) {
-            Cubic_interpolation Mono_out Looped
-          }
-        }
-        else if (*phs < *end) {
-          if (*p->ienv > 1) { ExpEnvelope }
-          else if (*p->ienv > 0) { LinEnvelope }
-          for (n=offset;n<nsmps;n++) {
-            Cubic_interpolation Mono_out Unlooped
-          }
-        }
-        phs++; base++; sampinc++; endloop++; startloop++;
-        attenuation++, mode++, end++; attack++; decay++; sustain++;
-        release++; tinc++; env++; attr++; decr++;
-      }
-    }
-    if (IS_ASIG_ARG(p->xamp)) {
-      MYFLT *amp = p->xamp;
-      for (n=offset;n<nsmps;n++) {
-        out1[n] *= amp[n];
-      }
-    }
-    else {
-      MYFLT famp = *p->xamp;
-      for (n=offset;n<nsmps;n++) {
-        out1[n] *= famp;
-      }
-    }
-
+    sf_render(&p->h, &p->sp, p->out1, NULL, p->xamp, p->xfreq, *p->ienv, 1);
     return OK;
 }
 
@@ -923,6 +787,7 @@ static int32_t SfInstrPlay_set(CSOUND *csound, SFIPLAY *p)
     else {
       instrType *layer = &sf->instr[(int32_t) *p->instrNum];
       SHORT *sBase = sf->sampleData;
+      MYFLT *sBaseF = sf->sampleDataF;
       int32_t spltNum = 0, flag=(int32_t) *p->iflag;
       int32_t vel= (int32_t) *p->ivel, notnum= (int32_t) *p->inotnum;
       int32_t splitsNum = layer->splits_num, k;
@@ -942,13 +807,13 @@ static int32_t SfInstrPlay_set(CSOUND *csound, SFIPLAY *p)
           orgfreq = globals->pitches[orgkey] ;
           if (flag) {
             freq = orgfreq * pow(2.0, ONETWELTH * tuneCorrection);
-            p->si[spltNum] = (freq/(orgfreq*orgfreq))*
+            p->sp.si[spltNum] = (freq/(orgfreq*orgfreq))*
                               sample->dwSampleRate*csound->onedsr;
           }
           else {
             freq = orgfreq * pow(2.0, ONETWELTH * tuneCorrection)
               * pow( 2.0, ONETWELTH* (split->scaleTuning*0.01)*(notnum - orgkey));
-            p->si[spltNum] = (freq/orgfreq)*(sample->dwSampleRate*csound->onedsr);
+            p->sp.si[spltNum] = (freq/orgfreq)*(sample->dwSampleRate*csound->onedsr);
           }
           attenuation = (MYFLT) (split->initialAttenuation);
           attenuation = POWER(FL(2.0), (-FL(1.0)/FL(60.0)) * attenuation) *
@@ -956,43 +821,45 @@ static int32_t SfInstrPlay_set(CSOUND *csound, SFIPLAY *p)
           pan = (MYFLT)  split->pan / FL(1000.0) + FL(0.5);
           if (pan > FL(1.0)) pan =FL(1.0);
           else if (pan < FL(0.0)) pan = FL(0.0);
-          p->base[spltNum] = sBase + start;
-          p->phs[spltNum] = (double) split->startOffset + *p->ioffset;
-          p->end[spltNum] = sample->dwEnd + split->endOffset - start;
-          p->startloop[spltNum] = sample->dwStartloop +
+          p->sp.base[spltNum] = sBase + start;
+          p->sp.fbase[spltNum] = sBaseF != NULL ? sBaseF + start : NULL;
+          p->sp.phs[spltNum] = (double) split->startOffset + *p->ioffset;
+          p->sp.end[spltNum] = sample->dwEnd + split->endOffset - start;
+          p->sp.startloop[spltNum] = sample->dwStartloop +
             split->startLoopOffset - start;
-          p->endloop[spltNum] = sample->dwEndloop + split->endLoopOffset - start;
-          p->leftlevel[spltNum] = (FL(1.0)-pan) * attenuation;
-          p->rightlevel[spltNum] = pan * attenuation;
-          p->mode[spltNum]= split->sampleModes;
+          p->sp.endloop[spltNum] = sample->dwEndloop + split->endLoopOffset - start;
+          p->sp.leftlevel[spltNum] = (FL(1.0)-pan) * attenuation;
+          p->sp.rightlevel[spltNum] = pan * attenuation;
+          p->sp.mode[spltNum]= split->sampleModes;
 
-          p->attack[spltNum] = split->attack*CS_EKR;
-          p->decay[spltNum] = split->decay*CS_EKR;
-          p->sustain[spltNum] = split->sustain;
-          p->release[spltNum] = split->release*CS_EKR;
+          p->sp.attack[spltNum] = split->attack*CS_EKR;
+          p->sp.decay[spltNum] = split->decay*CS_EKR;
+          p->sp.sustain[spltNum] = split->sustain;
+          p->sp.release[spltNum] = split->release*CS_EKR;
 
           if (*p->ienv > 1) {
-            p->attr[spltNum] = 1.0/(CS_EKR*split->attack);
-            p->decr[spltNum] = pow((split->sustain+0.0001),
+            p->sp.attr[spltNum] = 1.0/(CS_EKR*split->attack);
+            p->sp.decr[spltNum] = pow((split->sustain+0.0001),
                                    1.0/(CS_EKR*split->decay+0.0001));
-            if (split->attack != 0.0) p->env[spltNum] = 0.0;
-            else p->env[spltNum] = 1.0;
+            if (split->attack != 0.0) p->sp.env[spltNum] = 0.0;
+            else p->sp.env[spltNum] = 1.0;
           }
           else if (*p->ienv > 0) {
-            p->attr[spltNum] = 1.0/(CS_EKR*split->attack);
-            p->decr[spltNum] = (split->sustain-1.0)/(CS_EKR*
+            p->sp.attr[spltNum] = 1.0/(CS_EKR*split->attack);
+            p->sp.decr[spltNum] = (split->sustain-1.0)/(CS_EKR*
                                                      split->decay);
-            if (split->attack != 0.0) p->env[spltNum] = 0.0;
-            else p->env[spltNum] = 1.0;
+            if (split->attack != 0.0) p->sp.env[spltNum] = 0.0;
+            else p->sp.env[spltNum] = 1.0;
           }
           else {
-            p->env[spltNum] = 1.0;
+            p->sp.env[spltNum] = 1.0;
           }
-          p->ti[spltNum] = 0;
+          p->sp.ti[spltNum] = 0;
           spltNum++;
         }
       }
-      p->spltNum = spltNum;
+      p->sp.spltNum = spltNum;
+      sf_work_alloc(csound, &p->sp, CS_KSMPS);
     }
     return OK;
 }
@@ -1000,183 +867,14 @@ static int32_t SfInstrPlay_set(CSOUND *csound, SFIPLAY *p)
 static int32_t SfInstrPlay(CSOUND *csound, SFIPLAY *p)
 {
     IGN(csound);
-    MYFLT *out1= p->out1, *out2= p->out2, *env = p->env;
-    uint32_t offset = p->h.insdshead->ksmps_offset;
-    uint32_t early  = p->h.insdshead->ksmps_no_end;
-    uint32_t n, nsmps = CS_KSMPS;
-    int32_t      j = p->spltNum;
-    SHORT **base = p->base;
-    DWORD *end= p->end,  *startloop= p->startloop,
-          *endloop= p->endloop, *tinc = p->ti;
-    SHORT *mode = p->mode;
-    double *sampinc = p->si, *phs = p->phs;
-    MYFLT *left= p->leftlevel, *right= p->rightlevel, *attack = p->attack,
-          *decr = p->decr, *decay = p->decay, *sustain= p->sustain,
-          *release = p->release, *attr = p->attr;
-
-    memset(out1, 0, nsmps*sizeof(MYFLT));
-    memset(out2, 0, nsmps*sizeof(MYFLT));
-    if (UNLIKELY(early)) nsmps -= early;
-
-    if (IS_ASIG_ARG(p->xfreq)) {
-      while (j--) {
-        double looplength = *endloop - *startloop;
-        MYFLT *freq = p->xfreq;
-
-        if (*mode == 1 || *mode ==3) {
-          int32_t flag =0;
-          if (*p->ienv > 1) { ExpEnvelope }
-          else if (*p->ienv > 0) { LinEnvelope }
-          for (n=offset;n<nsmps;n++) {
-            double si = *sampinc * freq[n];
-            Linear_interpolation        Stereo_out      Looped
-          }
-        }
-        else if (*phs < *end) {
-          if (*p->ienv > 1) { ExpEnvelope }
-          else if (*p->ienv > 0) { LinEnvelope }
-          for (n=offset;n<nsmps;n++) {
-            double si = *sampinc * freq[n];
-            Linear_interpolation Stereo_out     Unlooped
-          }
-        }
-        phs++; base++; sampinc++; endloop++; startloop++;
-        left++; right++, mode++, end++; attack++; decay++; sustain++;
-        release++; tinc++; env++; attr++; decr++;
-      }
-    }
-    else {
-      MYFLT freq = *p->xfreq;
-      while (j--) {
-        double looplength = *endloop - *startloop;
-        double si = *sampinc * freq;
-        if (*mode == 1 || *mode ==3) {
-          int32_t flag =0;
-          if (*p->ienv > 1) { ExpEnvelope }
-          else if (*p->ienv > 0) { LinEnvelope }
-          for (n=offset;n<nsmps;n++) {
-            Linear_interpolation        Stereo_out      Looped
-          }
-        }
-        else if (*phs < *end) {
-          if (*p->ienv > 1) { ExpEnvelope }
-          else if (*p->ienv > 0) { LinEnvelope }
-          for (n=offset;n<nsmps;n++) {
-            Linear_interpolation        Stereo_out      Unlooped
-          }
-        }
-        phs++; base++; sampinc++; endloop++; startloop++;
-        left++; right++, mode++, end++; attack++; decay++; sustain++;
-        release++; tinc++; env++; attr++; decr++;
-      }
-    }
-
-    if (IS_ASIG_ARG(p->xamp)) {
-      MYFLT *amp = p->xamp;
-      for (n=offset;n<nsmps;n++) {
-        out1[n] *= amp[n];
-        out2[n] *= amp[n];
-      }
-    }
-    else {
-      MYFLT famp = *p->xamp;
-      for (n=offset;n<nsmps;n++) {
-        out1[n] *= famp;
-        out2[n] *= famp;
-      }
-    }
+    sf_render(&p->h, &p->sp, p->out1, p->out2, p->xamp, p->xfreq, *p->ienv, 0);
     return OK;
 }
 
 static int32_t SfInstrPlay3(CSOUND *csound, SFIPLAY *p)
 {
-   IGN(csound);
-    MYFLT *out1= p->out1, *out2= p->out2,*env =p->env;
-    uint32_t offset = p->h.insdshead->ksmps_offset;
-    uint32_t early  = p->h.insdshead->ksmps_no_end;
-    uint32_t n, nsmps = CS_KSMPS;
-    int32_t      j = p->spltNum;
-    SHORT **base = p->base;
-    DWORD *end= p->end,  *startloop= p->startloop,
-          *endloop= p->endloop, *tinc = p->ti;
-    SHORT *mode = p->mode;
-    double *sampinc = p->si, *phs = p->phs;
-    MYFLT *left= p->leftlevel, *right= p->rightlevel,
-      *attack = p->attack, *decr = p->decr,
-      *decay = p->decay, *sustain= p->sustain, *release = p->release,
-      *attr = p->attr;
-
-    memset(out1, 0, nsmps*sizeof(MYFLT));
-    memset(out2, 0, nsmps*sizeof(MYFLT));
-    if (UNLIKELY(early)) nsmps -= early;
-
-    if (IS_ASIG_ARG(p->xfreq)) {
-      while (j--) {
-        double looplength = *endloop - *startloop;
-        MYFLT *freq = p->xfreq;
-
-        if (*mode == 1 || *mode ==3) {
-          int32_t flag =0;
-          if (*p->ienv > 1) { ExpEnvelope }
-          else if (*p->ienv > 0) { LinEnvelope }
-          for (n=offset;n<nsmps;n++) {
-            double si = *sampinc * freq[n];
-            Cubic_interpolation Stereo_out      Looped
-          }
-        }
-        else if (*phs < *end) {
-          if (*p->ienv > 1) { ExpEnvelope }
-          else if (*p->ienv > 0) { LinEnvelope }
-          for (n=offset;n<nsmps;n++) {
-            double si = *sampinc * freq[n];
-            Cubic_interpolation Stereo_out      Unlooped
-          }
-        }
-        phs++; base++; sampinc++; endloop++; startloop++;
-        left++; right++, mode++, end++; attack++; decay++; sustain++;
-        release++; tinc++; env++; attr++; decr++;
-      }
-    }
-    else {
-      MYFLT freq = *p->xfreq;
-      while (j--) {
-        double looplength = *endloop - *startloop;
-        double si = *sampinc * freq;
-        if (*mode == 1 || *mode ==3) {
-          int32_t flag =0;
-          if (*p->ienv > 1) { ExpEnvelope }
-          else if (*p->ienv > 0) { LinEnvelope }
-          for (n=offset;n<nsmps;n++) {
-            Cubic_interpolation Stereo_out      Looped
-          }
-        }
-        else if (*phs < *end) {
-          if (*p->ienv > 1) { ExpEnvelope }
-          else if (*p->ienv > 0) { LinEnvelope }
-          for (n=offset;n<nsmps;n++) {
-            Cubic_interpolation Stereo_out      Unlooped
-          }
-        }
-        phs++; base++; sampinc++; endloop++; startloop++;
-        left++; right++, mode++, end++; attack++; decay++; sustain++;
-        release++; tinc++; env++; attr++; decr++;
-      }
-    }
-
-    if (IS_ASIG_ARG(p->xamp)) {
-      MYFLT *amp = p->xamp;
-      for (n=offset;n<nsmps;n++) {
-        out1[n] *= amp[n];
-        out2[n] *= amp[n];
-      }
-    }
-    else {
-      MYFLT famp = *p->xamp;
-      for (n=offset;n<nsmps;n++) {
-        out1[n] *= famp;
-        out2[n] *= famp;
-      }
-    }
+    IGN(csound);
+    sf_render(&p->h, &p->sp, p->out1, p->out2, p->xamp, p->xfreq, *p->ienv, 1);
     return OK;
 }
 
@@ -1193,6 +891,7 @@ static int32_t SfInstrPlayMono_set(CSOUND *csound, SFIPLAYMONO *p)
     else {
       instrType *layer = &sf->instr[(int32_t) *p->instrNum];
       SHORT *sBase = sf->sampleData;
+      MYFLT *sBaseF = sf->sampleDataF;
       int32_t spltNum = 0, flag=(int32_t) *p->iflag;
       int32_t vel= (int32_t) *p->ivel, notnum= (int32_t) *p->inotnum;
       int32_t splitsNum = layer->splits_num, k;
@@ -1211,52 +910,54 @@ static int32_t SfInstrPlayMono_set(CSOUND *csound, SFIPLAYMONO *p)
           orgfreq = globals->pitches[orgkey];
           if (flag) {
             freq = orgfreq * pow(2.0, ONETWELTH * tuneCorrection);
-            p->si[spltNum] = (freq/(orgfreq*orgfreq))*
+            p->sp.si[spltNum] = (freq/(orgfreq*orgfreq))*
                               sample->dwSampleRate*csound->onedsr;
           }
           else {
             freq = orgfreq * pow(2.0, ONETWELTH * tuneCorrection)
               * pow( 2.0, ONETWELTH* (split->scaleTuning*0.01) * (notnum-orgkey));
-            p->si[spltNum] = (freq/orgfreq)*(sample->dwSampleRate*csound->onedsr);
+            p->sp.si[spltNum] = (freq/orgfreq)*(sample->dwSampleRate*csound->onedsr);
           }
-          p->attenuation[spltNum] = (MYFLT) pow(2.0, (-1.0/60.0)*
+          p->sp.leftlevel[spltNum] = (MYFLT) pow(2.0, (-1.0/60.0)*
                                                 split->initialAttenuation)
             * GLOBAL_ATTENUATION;
-          p->base[spltNum] = sBase+ start;
-          p->phs[spltNum] = (double) split->startOffset + *p->ioffset;
-          p->end[spltNum] = sample->dwEnd + split->endOffset - start;
-          p->startloop[spltNum] = sample->dwStartloop +
+          p->sp.base[spltNum] = sBase+ start;
+          p->sp.fbase[spltNum] = sBaseF != NULL ? sBaseF + start : NULL;
+          p->sp.phs[spltNum] = (double) split->startOffset + *p->ioffset;
+          p->sp.end[spltNum] = sample->dwEnd + split->endOffset - start;
+          p->sp.startloop[spltNum] = sample->dwStartloop +
             split->startLoopOffset - start;
-          p->endloop[spltNum] = sample->dwEndloop + split->endLoopOffset - start;
-          p->mode[spltNum]= split->sampleModes;
-          p->attack[spltNum] = split->attack*CS_EKR;
-          p->decay[spltNum] = split->decay*CS_EKR;
-          p->sustain[spltNum] = split->sustain;
-          p->release[spltNum] = split->release*CS_EKR;
+          p->sp.endloop[spltNum] = sample->dwEndloop + split->endLoopOffset - start;
+          p->sp.mode[spltNum]= split->sampleModes;
+          p->sp.attack[spltNum] = split->attack*CS_EKR;
+          p->sp.decay[spltNum] = split->decay*CS_EKR;
+          p->sp.sustain[spltNum] = split->sustain;
+          p->sp.release[spltNum] = split->release*CS_EKR;
 
           if (*p->ienv > 1) {
-            p->attr[spltNum] = 1.0/(CS_EKR*split->attack);
-            p->decr[spltNum] = pow((split->sustain+0.0001),
+            p->sp.attr[spltNum] = 1.0/(CS_EKR*split->attack);
+            p->sp.decr[spltNum] = pow((split->sustain+0.0001),
                                    1.0/(CS_EKR*
                                         split->decay+0.0001));
-            if (split->attack != 0.0) p->env[spltNum] = 0.0;
-            else p->env[spltNum] = 1.0;
+            if (split->attack != 0.0) p->sp.env[spltNum] = 0.0;
+            else p->sp.env[spltNum] = 1.0;
           }
           else if (*p->ienv > 0) {
-            p->attr[spltNum] = 1.0/(CS_EKR*split->attack);
-            p->decr[spltNum] = (split->sustain-1.0)/(CS_EKR*
+            p->sp.attr[spltNum] = 1.0/(CS_EKR*split->attack);
+            p->sp.decr[spltNum] = (split->sustain-1.0)/(CS_EKR*
                                                      split->decay);
-            if (split->attack != 0.0) p->env[spltNum] = 0.0;
-            else p->env[spltNum] = 1.0;
+            if (split->attack != 0.0) p->sp.env[spltNum] = 0.0;
+            else p->sp.env[spltNum] = 1.0;
           }
           else {
-            p->env[spltNum] = 1.0;
+            p->sp.env[spltNum] = 1.0;
           }
-          p->ti[spltNum] = 0;
+          p->sp.ti[spltNum] = 0;
           spltNum++;
         }
       }
-      p->spltNum = spltNum;
+      p->sp.spltNum = spltNum;
+      sf_work_alloc(csound, &p->sp, CS_KSMPS);
     }
     return OK;
 }
@@ -1264,175 +965,14 @@ static int32_t SfInstrPlayMono_set(CSOUND *csound, SFIPLAYMONO *p)
 static int32_t SfInstrPlayMono(CSOUND *csound, SFIPLAYMONO *p)
 {
     IGN(csound);
-    MYFLT *out1= p->out1, *env = p->env;
-    uint32_t offset = p->h.insdshead->ksmps_offset;
-    uint32_t early  = p->h.insdshead->ksmps_no_end;
-     uint32_t n, nsmps = CS_KSMPS;
-    int32_t      j = p->spltNum;
-    SHORT **base = p->base;
-    DWORD *end= p->end,  *startloop= p->startloop, *endloop= p->endloop,
-      *tinc = p->ti;
-    SHORT *mode = p->mode;
-
-    double *sampinc = p->si, *phs = p->phs;
-    MYFLT *attenuation = p->attenuation, *attack = p->attack, *decr = p->decr,
-      *decay = p->decay, *sustain= p->sustain, *release = p->release,
-      *attr = p->attr;
-
-    memset(out1, 0, nsmps*sizeof(MYFLT));
-    if (UNLIKELY(early)) nsmps -= early;
-
-    if (IS_ASIG_ARG(p->xfreq)) {
-      while (j--) {
-        double looplength = *endloop - *startloop;
-        MYFLT *freq = p->xfreq;
-
-        if (*mode == 1 || *mode ==3) {
-          int32_t flag =0;
-          if (*p->ienv > 1) { ExpEnvelope }
-          else if (*p->ienv > 0) { LinEnvelope }
-          for (n=offset;n<nsmps;n++) {
-            double si = *sampinc * freq[n];
-            Linear_interpolation        Mono_out        Looped
-          }
-        }
-        else if (*phs < *end) {
-          if (*p->ienv > 1) { ExpEnvelope }
-          else if (*p->ienv > 0) { LinEnvelope }
-          for (n=offset;n<nsmps;n++) {
-            double si = *sampinc * freq[n];
-            Linear_interpolation Mono_out       Unlooped
-          }
-        }
-        phs++; base++; sampinc++; endloop++; startloop++;
-        attenuation++, mode++, end++; attack++; decay++; sustain++;
-        release++; tinc++; env++; attr++; decr++;
-      }
-    }
-    else {
-      MYFLT freq = *p->xfreq;
-      while (j--) {
-        double looplength = *endloop - *startloop;
-        double si = *sampinc * freq;
-        if (*mode == 1 || *mode ==3) {
-          int32_t flag =0;
-          if (*p->ienv > 1) { ExpEnvelope }
-          else if (*p->ienv > 0) { LinEnvelope }
-          for (n=offset;n<nsmps;n++) {
-            Linear_interpolation Mono_out Looped
-          }
-        }
-        else if (*phs < *end) {
-          if (*p->ienv > 1) { ExpEnvelope }
-          else if (*p->ienv > 0) { LinEnvelope }
-          for (n=offset;n<nsmps;n++) {
-            Linear_interpolation Mono_out Unlooped
-          }
-        }
-        phs++; base++; sampinc++; endloop++; startloop++;
-        attenuation++, mode++, end++; attack++; decay++; sustain++;
-        release++; tinc++; env++; attr++; decr++;
-      }
-    }
-    if (IS_ASIG_ARG(p->xamp)) {
-      MYFLT *amp = p->xamp;
-      for (n=offset;n<nsmps;n++) {
-        out1[n] *= amp[n];
-      }
-    }
-    else {
-      MYFLT famp = *p->xamp;
-      for (n=offset;n<nsmps;n++) {
-        out1[n] *= famp;
-      }
-    }
+    sf_render(&p->h, &p->sp, p->out1, NULL, p->xamp, p->xfreq, *p->ienv, 0);
     return OK;
 }
 
 static int32_t SfInstrPlayMono3(CSOUND *csound, SFIPLAYMONO *p)
 {
     IGN(csound);
-    MYFLT *out1= p->out1, *env = p->env  ;
-    uint32_t offset = p->h.insdshead->ksmps_offset;
-    uint32_t early  = p->h.insdshead->ksmps_no_end;
-    uint32_t n, nsmps = CS_KSMPS;
-    int32_t      j = p->spltNum;
-    SHORT **base = p->base;
-    DWORD *end= p->end,  *startloop= p->startloop,
-          *endloop= p->endloop, *tinc = p->ti;
-    SHORT *mode = p->mode;
-    double *sampinc = p->si, *phs = p->phs;
-    MYFLT *attenuation = p->attenuation,*attack = p->attack, *decr = p->decr,
-      *decay = p->decay, *sustain= p->sustain, *release = p->release,
-      *attr = p->attr;
-
-    memset(out1, 0, nsmps*sizeof(MYFLT));
-    if (UNLIKELY(early)) nsmps -= early;
-
-    if (IS_ASIG_ARG(p->xfreq)) {
-      while (j--) {
-        double looplength = *endloop - *startloop;
-        MYFLT *freq = p->xfreq;
-
-        if (*mode == 1 || *mode ==3) {
-          int32_t flag =0;
-          if (*p->ienv > 1) { ExpEnvelope }
-          else if (*p->ienv > 0) { LinEnvelope }
-          for (n=offset;n<nsmps;n++) {
-            double si = *sampinc * freq[n];
-            Cubic_interpolation Mono_out Looped
-          }
-        }
-        else if (*phs < *end) {
-          if (*p->ienv > 1) { ExpEnvelope }
-          else if (*p->ienv > 0) { LinEnvelope }
-          for (n=offset;n<nsmps;n++) {
-            double si = *sampinc * freq[n];
-            Cubic_interpolation Mono_out Unlooped
-          }
-        }
-        phs++; base++; sampinc++; endloop++; startloop++;
-        attenuation++, mode++, end++; attack++; decay++; sustain++;
-        release++; tinc++; env++; attr++; decr++;
-      }
-    }
-    else {
-      MYFLT freq = *p->xfreq;
-      while (j--) {
-        double looplength = *endloop - *startloop;
-        double si = *sampinc * freq;
-        if (*mode == 1 || *mode ==3) {
-          int32_t flag =0;
-          if (*p->ienv > 1) { ExpEnvelope }
-          else if (*p->ienv > 0) { LinEnvelope }
-          for (n=offset;n<nsmps;n++) {
-            Cubic_interpolation Mono_out Looped
-          }
-        }
-        else if (*phs < *end) {
-          if (*p->ienv > 1) { ExpEnvelope }
-          else if (*p->ienv > 0) { LinEnvelope }
-          for (n=offset;n<nsmps;n++) {
-            Cubic_interpolation Mono_out Unlooped
-          }
-        }
-        phs++; base++; sampinc++; endloop++; startloop++;
-        attenuation++, mode++, end++; attack++; decay++; sustain++;
-        release++; tinc++; env++; attr++; decr++;
-      }
-    }
-    if (IS_ASIG_ARG(p->xamp)) {
-      MYFLT *amp = p->xamp;
-      for (n=offset;n<nsmps;n++) {
-        out1[n] *= amp[n];
-      }
-    }
-    else {
-      MYFLT famp = *p->xamp;
-      for (n=offset;n<nsmps;n++) {
-        out1[n] *= famp;
-      }
-    }
+    sf_render(&p->h, &p->sp, p->out1, NULL, p->xamp, p->xfreq, *p->ienv, 1);
     return OK;
 }
 
@@ -2570,8 +2110,8 @@ static int32_t sflooper_process(CSOUND *csound, sflooper *p)
 #define S       sizeof
 
 static OENTRY localops[] = {
-  { "sfload",S(SFLOAD),     0, 1,    "i",    "S",      (SUBR)SfLoad_S, NULL, NULL },
-   { "sfload.i",S(SFLOAD),     0, 1,    "i",    "i",   (SUBR)SfLoad, NULL, NULL },
+  { "sfload",S(SFLOAD),     0, 1,    "i",    "So",     (SUBR)SfLoad_S, NULL, NULL },
+   { "sfload.i",S(SFLOAD),     0, 1,    "i",    "io",  (SUBR)SfLoad, NULL, NULL },
   { "sfpreset",S(SFPRESET), 0, 1,    "i",    "iiii",   (SUBR)SfPreset         },
   { "sfplay", S(SFPLAY), 0, 3, "aa", "iixxiooo",
     (SUBR)SfPlay_set, (SUBR)SfPlay     },
@@ -2613,6 +2153,8 @@ int32_t sfont_ModuleCreate(CSOUND *csound)
       (presetType **) csound->Malloc(csound, MAX_SFPRESET *sizeof(presetType *));
     globals->sampleBase =
       (SHORT **) csound->Malloc(csound, MAX_SFPRESET*sizeof(SHORT *));
+    globals->sampleBaseF =
+      (MYFLT **) csound->Malloc(csound, MAX_SFPRESET*sizeof(MYFLT *));
     globals->currSFndx = 0;
     globals->maxSFndx = MAX_SFONT;
     for (j=0; j<128; j++) {
@@ -27,7 +27,7 @@
 
 typedef struct {
         OPDS    h;
-        MYFLT   *ihandle, *fname;
+        MYFLT   *ihandle, *fname, *iconvert;
 } SFLOAD;
 
 typedef struct {
@@ -47,59 +47,45 @@ typedef struct {
 
 #define MAXSPLT 10
 
+/* playback state of the splits sounding in one sfplay or sfinstr note */
 typedef struct {
-        OPDS    h;
-        MYFLT   *out1, *out2, *ivel, *inotnum,*xamp, *xfreq;
-        MYFLT   *ipresethandle, *iflag, *ioffset, *ienv;
         int32_t     spltNum;
         SHORT   *base[MAXSPLT], mode[MAXSPLT];
+        MYFLT   *fbase[MAXSPLT];        /* converted by sfload, or NULL */
         DWORD   end[MAXSPLT], startloop[MAXSPLT], endloop[MAXSPLT], ti[MAXSPLT];
         double  si[MAXSPLT],phs[MAXSPLT];
+        /* the mono opcodes keep their level in leftlevel */
         MYFLT   leftlevel[MAXSPLT], rightlevel[MAXSPLT], attack[MAXSPLT],
                 decay[MAXSPLT], sustain[MAXSPLT], release[MAXSPLT];
         MYFLT   attr[MAXSPLT], decr[MAXSPLT];
         MYFLT   env[MAXSPLT];
+        AUXCH   work;                   /* ksmps of positions and samples */
+} SFSPLITS;
+
+typedef struct {
+        OPDS    h;
+        MYFLT   *out1, *out2, *ivel, *inotnum,*xamp, *xfreq;
+        MYFLT   *ipresethandle, *iflag, *ioffset, *ienv;
+        SFSPLITS sp;
 } SFPLAY;
 
 typedef struct {
         OPDS    h;
         MYFLT   *out1, *ivel, *inotnum,*xamp, *xfreq, *ipresethandle,
                 *iflag, *ioffset, *ienv;
-        int32_t     spltNum;
-        SHORT   *base[MAXSPLT], mode[MAXSPLT];
-        DWORD   end[MAXSPLT], startloop[MAXSPLT], endloop[MAXSPLT], ti[MAXSPLT];
-        double  si[MAXSPLT],phs[MAXSPLT];
-        MYFLT   attenuation[MAXSPLT],attack[MAXSPLT], decay[MAXSPLT],
-                sustain[MAXSPLT], release[MAXSPLT];
-        MYFLT   attr[MAXSPLT], decr[MAXSPLT];
-        MYFLT   env[MAXSPLT];
+        SFSPLITS sp;
 } SFPLAYMONO;
 
 typedef struct {
         OPDS    h;
         MYFLT   *out1, *ivel, *inotnum, *xamp, *xfreq, *instrNum;
         MYFLT   *sfBank, *iflag, *ioffset, *ienv;
-        int32_t     spltNum;
-        SHORT   *base[MAXSPLT], mode[MAXSPLT];
-        DWORD   end[MAXSPLT], startloop[MAXSPLT], endloop[MAXSPLT], ti[MAXSPLT];
-        double  si[MAXSPLT],phs[MAXSPLT];
-        MYFLT   attenuation[MAXSPLT],attack[MAXSPLT], decay[MAXSPLT],
-                sustain[MAXSPLT], release[MAXSPLT];
-        MYFLT   attr[MAXSPLT], decr[MAXSPLT];
-        MYFLT   env[MAXSPLT];
+        SFSPLITS sp;
 } SFIPLAYMONO;
 
 typedef struct {
         OPDS    h;
         MYFLT   *out1, *out2, *ivel, *inotnum, *xamp, *xfreq;
         MYFLT   *instrNum, *sfBank, *iflag, *ioffset, *ienv;
-        int32_t
-        spltNum;
-        SHORT   *base[MAXSPLT], mode[MAXSPLT];
-        DWORD   end[MAXSPLT], startloop[MAXSPLT], endloop[MAXSPLT], ti[MAXSPLT];
-        double  si[MAXSPLT],phs[MAXSPLT];
-        MYFLT   leftlevel[MAXSPLT], rightlevel[MAXSPLT],attack[MAXSPLT],
-                decay[MAXSPLT], sustain[MAXSPLT], release[MAXSPLT];
-        MYFLT   attr[MAXSPLT], decr[MAXSPLT];
-        MYFLT   env[MAXSPLT];
+        SFSPLITS sp;
 } SFIPLAY;
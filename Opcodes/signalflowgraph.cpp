@@ -129,6 +129,7 @@
 #include <cmath>
 #include <cstdio>
 #include <cstring>
+#include <deque>
 #include <functional>
 #include <iostream>
 #include <map>
@@ -232,26 +233,141 @@ bool operator<(const EventBlock &a, const EventBlock &b) {
 // Identifiers are always "sourcename:outletname" and "sinkname:inletname",
 // or "sourcename:idname:outletname" and "sinkname:inletname."
 
+/**
+ * Sums one block of samples into another; the restrict qualifiers let
+ * the compiler vectorize the loop.
+ */
+static inline void sfg_accumulate(MYFLT *__restrict sink,
+                                  const MYFLT *__restrict source, size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    sink[i] += source[i];
+  }
+}
+
+/**
+ * Compiled connection table for one signal type. Outlet ids are resolved
+ * to integer port slots once, at init time. Each inlet instance owns a
+ * Sink holding a contiguous array of the signals of all active outlet
+ * instances connected to it. The arrays are updated incrementally as
+ * outlet and inlet instances come and go, so that performance only walks
+ * one flat array and never touches the maps.
+ */
+template <typename Signal> struct PortTable {
+  typedef std::vector<Signal> Sources;
+  struct Sink {
+    std::vector<size_t> slots;
+    Sources sources;
+  };
+  struct OutletPort {
+    Sources instances;
+    std::vector<Sources *> sinks;
+  };
+  std::map<std::string, size_t> slotsForSourceOutletIds;
+  std::deque<OutletPort> outletPorts;
+  std::vector<Sink *> sinks;
+  template <typename T> static void erase(std::vector<T> &items, T item) {
+    typename std::vector<T>::iterator it =
+        std::find(items.begin(), items.end(), item);
+    if (it != items.end()) {
+      *it = items.back();
+      items.pop_back();
+    }
+  }
+  size_t outletSlot(const std::string &sourceOutletId) {
+    std::map<std::string, size_t>::iterator it =
+        slotsForSourceOutletIds.find(sourceOutletId);
+    if (it != slotsForSourceOutletIds.end()) {
+      return it->second;
+    }
+    size_t slot = outletPorts.size();
+    outletPorts.push_back(OutletPort());
+    slotsForSourceOutletIds[sourceOutletId] = slot;
+    return slot;
+  }
+  /**
+   * Adds an outlet instance's signal to its port and to every connected
+   * inlet instance; returns the number of instances of the outlet.
+   */
+  size_t addOutlet(size_t slot, Signal signal) {
+    OutletPort &port = outletPorts[slot];
+    port.instances.push_back(signal);
+    for (size_t i = 0, n = port.sinks.size(); i < n; ++i) {
+      port.sinks[i]->push_back(signal);
+    }
+    return port.instances.size();
+  }
+  size_t removeOutlet(size_t slot, Signal signal) {
+    OutletPort &port = outletPorts[slot];
+    erase(port.instances, signal);
+    for (size_t i = 0, n = port.sinks.size(); i < n; ++i) {
+      erase(*port.sinks[i], signal);
+    }
+    return port.instances.size();
+  }
+  /**
+   * Returns the Sink previously owned by an inlet instance, or a new one;
+   * opcode memory is reused across notes, so the pointer may be stale.
+   */
+  Sink *sink(Sink *existing) {
+    if (std::find(sinks.begin(), sinks.end(), existing) != sinks.end()) {
+      return existing;
+    }
+    Sink *created = new Sink;
+    sinks.push_back(created);
+    return created;
+  }
+  /**
+   * Connects an inlet instance to the currently active instances of all
+   * outlets feeding it; returns the number of outlet ports.
+   */
+  size_t connect(Sink *sink, const std::vector<std::string> &sourceOutletIds) {
+    sink->slots.clear();
+    sink->sources.clear();
+    for (size_t i = 0, n = sourceOutletIds.size(); i < n; ++i) {
+      size_t slot = outletSlot(sourceOutletIds[i]);
+      if (std::find(sink->slots.begin(), sink->slots.end(), slot) !=
+          sink->slots.end()) {
+        continue;
+      }
+      OutletPort &port = outletPorts[slot];
+      sink->slots.push_back(slot);
+      port.sinks.push_back(&sink->sources);
+      sink->sources.insert(sink->sources.end(), port.instances.begin(),
+                           port.instances.end());
+    }
+    return sink->slots.size();
+  }
+  void disconnect(Sink *sink) {
+    for (size_t i = 0, n = sink->slots.size(); i < n; ++i) {
+      erase(outletPorts[sink->slots[i]].sinks, &sink->sources);
+    }
+    sink->slots.clear();
+    sink->sources.clear();
+  }
+  void clear() {
+    for (size_t i = 0, n = sinks.size(); i < n; ++i) {
+      delete sinks[i];
+    }
+    sinks.clear();
+    outletPorts.clear();
+    slotsForSourceOutletIds.clear();
+  }
+};
+
 struct SignalFlowGraphState {
   CSOUND *csound;
   void *signal_flow_ports_lock;
   void *signal_flow_ftables_lock;
-  std::map<std::string, std::vector<Outleta *>> aoutletsForSourceOutletIds;
-  std::map<std::string, std::vector<Outletk *>> koutletsForSourceOutletIds;
+  PortTable<const MYFLT *> aports;
+  PortTable<const MYFLT *> kports;
+  PortTable<ARRAYDAT *> vports;
   std::map<std::string, std::vector<Outletf *>> foutletsForSourceOutletIds;
-  std::map<std::string, std::vector<Outletv *>> voutletsForSourceOutletIds;
   std::map<std::string, std::vector<Outletkid *>> kidoutletsForSourceOutletIds;
-  std::map<std::string, std::vector<Inleta *>> ainletsForSinkInletIds;
-  std::map<std::string, std::vector<Inletk *>> kinletsForSinkInletIds;
   std::map<std::string, std::vector<Inletf *>> finletsForSinkInletIds;
-  std::map<std::string, std::vector<Inletv *>> vinletsForSinkInletIds;
   std::map<std::string, std::vector<Inletkid *>> kidinletsForSinkInletIds;
   std::map<std::string, std::vector<std::string>> connections;
   std::map<EventBlock, int> functionTablesForEvtblks;
-  std::vector<std::vector<std::vector<Outleta *> *> *> aoutletVectors;
-  std::vector<std::vector<std::vector<Outletk *> *> *> koutletVectors;
   std::vector<std::vector<std::vector<Outletf *> *> *> foutletVectors;
-  std::vector<std::vector<std::vector<Outletv *> *> *> voutletVectors;
   std::vector<std::vector<std::vector<Outletkid *> *> *> kidoutletVectors;
   SignalFlowGraphState(CSOUND *csound_) {
     csound = csound_;
@@ -261,20 +377,14 @@ struct SignalFlowGraphState {
   ~SignalFlowGraphState() {}
   void clear() {
     LockGuard guard(csound, signal_flow_ports_lock);
-    aoutletsForSourceOutletIds.clear();
-    ainletsForSinkInletIds.clear();
-    aoutletVectors.clear();
-    koutletsForSourceOutletIds.clear();
-    kinletsForSinkInletIds.clear();
-    koutletVectors.clear();
+    aports.clear();
+    kports.clear();
+    vports.clear();
     foutletsForSourceOutletIds.clear();
-    voutletsForSourceOutletIds.clear();
     kidoutletsForSourceOutletIds.clear();
-    vinletsForSinkInletIds.clear();
     kidinletsForSinkInletIds.clear();
     finletsForSinkInletIds.clear();
     foutletVectors.clear();
-    voutletVectors.clear();
     kidoutletVectors.clear();
     connections.clear();
   }
@@ -282,7 +392,9 @@ struct SignalFlowGraphState {
 
 // For true thread-safety, access to shared data must be protected.
 // We will use one critical section for each logically independent
-// potential data race here: ports and ftables.
+// potential data race here: ports and ftables. The a, k, and v ports
+// only change the connection tables at init and deinit time; at
+// performance time the lock merely guards a flat walk of one array.
 
 struct Outleta : public OpcodeNoteoffBase<Outleta> {
   /**
@@ -294,11 +406,16 @@ struct Outleta : public OpcodeNoteoffBase<Outleta> {
    * State.
    */
   char sourceOutletId[0x100];
+  size_t slot;
+  int registered;
   SignalFlowGraphState *sfg_globals;
   int init(CSOUND *csound) {
     // warn(csound, "BEGAN Outleta::init()...\n");
     csound::QueryGlobalPointer(csound, "sfg_globals", sfg_globals);
     LockGuard guard(csound, sfg_globals->signal_flow_ports_lock);
+    if (registered) {
+      sfg_globals->aports.removeOutlet(slot, asignal);
+    }
     sourceOutletId[0] = 0;
     const char *insname =
         csound->GetInstrumentList(csound)[opds.insdshead->insno]->insname;
@@ -308,30 +425,27 @@ struct Outleta : public OpcodeNoteoffBase<Outleta> {
       std::sprintf(sourceOutletId, "%d:%s", opds.insdshead->insno,
                    (char *)Sname->data);
     }
-    std::vector<Outleta *> &aoutlets =
-        sfg_globals->aoutletsForSourceOutletIds[sourceOutletId];
-    if (std::find(aoutlets.begin(), aoutlets.end(), this) == aoutlets.end()) {
-      aoutlets.push_back(this);
-      warn(csound, Str("Created instance 0x%x of %d instances of outlet %s\n"),
-           this, aoutlets.size(), sourceOutletId);
-    }
+    slot = sfg_globals->aports.outletSlot(sourceOutletId);
+    size_t instances = sfg_globals->aports.addOutlet(slot, asignal);
+    registered = 1;
+    warn(csound, Str("Created instance 0x%x of %d instances of outlet %s\n"),
+         this, instances, sourceOutletId);
     // warn(csound, "ENDED Outleta::init()...\n");
     return OK;
   }
   int noteoff(CSOUND *csound) {
     LockGuard guard(csound, sfg_globals->signal_flow_ports_lock);
-    std::vector<Outleta *> &aoutlets =
-        sfg_globals->aoutletsForSourceOutletIds[sourceOutletId];
-    std::vector<Outleta *>::iterator thisoutlet =
-        std::find(aoutlets.begin(), aoutlets.end(), this);
-    aoutlets.erase(thisoutlet);
-    warn(csound, Str("Removed instance 0x%x of %d instances of outleta %s\n"),
-         this, aoutlets.size(), sourceOutletId);
+    if (registered) {
+      size_t instances = sfg_globals->aports.removeOutlet(slot, asignal);
+      registered = 0;
+      warn(csound, Str("Removed instance 0x%x of %d instances of outleta %s\n"),
+           this, instances, sourceOutletId);
+    }
     return OK;
   }
 };
 
-struct Inleta : public OpcodeBase<Inleta> {
+struct Inleta : public OpcodeNoteoffBase<Inleta> {
   /**
    * Output.
    */
@@ -344,26 +458,17 @@ struct Inleta : public OpcodeBase<Inleta> {
    * State.
    */
   char sinkInletId[0x100];
-  std::vector<std::vector<Outleta *> *> *sourceOutlets;
-  int sampleN;
+  PortTable<const MYFLT *>::Sink *sink;
+  int connected;
   SignalFlowGraphState *sfg_globals;
   int init(CSOUND *csound) {
     csound::QueryGlobalPointer(csound, "sfg_globals", sfg_globals);
     LockGuard guard(csound, sfg_globals->signal_flow_ports_lock);
     warn(csound, "BEGAN Inleta::init()...\n");
-    sampleN = opds.insdshead->ksmps;
-    warn(csound, "sourceOutlets: 0x%x\n", sourceOutlets);
-    // think problem is here
-    // should always create
-    if (std::find(sfg_globals->aoutletVectors.begin(),
-                  sfg_globals->aoutletVectors.end(),
-                  sourceOutlets) == sfg_globals->aoutletVectors.end()) {
-      sourceOutlets = new std::vector<std::vector<Outleta *> *>;
-      sfg_globals->aoutletVectors.push_back(sourceOutlets);
-    } else {
-      sourceOutlets->clear();
+    if (connected) {
+      sfg_globals->aports.disconnect(sink);
     }
-    warn(csound, "sourceOutlets: 0x%x\n", sourceOutlets);
+    sink = sfg_globals->aports.sink(sink);
     sinkInletId[0] = 0;
     const char *insname =
         csound->GetInstrumentList(csound)[opds.insdshead->insno]->insname;
@@ -373,60 +478,37 @@ struct Inleta : public OpcodeBase<Inleta> {
       std::sprintf(sinkInletId, "%d:%s", opds.insdshead->insno,
                    (char *)Sname->data);
     }
-    std::vector<Inleta *> &ainlets =
-        sfg_globals->ainletsForSinkInletIds[sinkInletId];
-    if (std::find(ainlets.begin(), ainlets.end(), this) == ainlets.end()) {
-      ainlets.push_back(this);
-      warn(csound, Str("Created instance 0x%x of inlet %s\n"), this,
-           sinkInletId);
-    }
     // Find source outlets connecting to this.
     // Any number of sources may connect to any number of sinks.
-    std::vector<std::string> &sourceOutletIds =
-        sfg_globals->connections[sinkInletId];
-    for (size_t i = 0, n = sourceOutletIds.size(); i < n; i++) {
-      const std::string &sourceOutletId = sourceOutletIds[i];
-      std::vector<Outleta *> &aoutlets =
-          sfg_globals->aoutletsForSourceOutletIds[sourceOutletId];
-      if (std::find(sourceOutlets->begin(), sourceOutlets->end(), &aoutlets) ==
-          sourceOutlets->end()) {
-        sourceOutlets->push_back(&aoutlets);
-        warn(csound, Str("Connected instances of outlet %s to instance 0x%x of "
-                         "inlet %s.\n"),
-             sourceOutletId.c_str(), this, sinkInletId);
-      }
-    }
+    size_t ports = sfg_globals->aports.connect(
+        sink, sfg_globals->connections[sinkInletId]);
+    connected = 1;
+    warn(csound, Str("Connected %d outlets with %d instances to instance 0x%x "
+                     "of inlet %s.\n"),
+         ports, sink->sources.size(), this, sinkInletId);
     warn(csound, "ENDED Inleta::init().\n");
     return OK;
   }
+  int noteoff(CSOUND *csound) {
+    LockGuard guard(csound, sfg_globals->signal_flow_ports_lock);
+    if (connected) {
+      sfg_globals->aports.disconnect(sink);
+      connected = 0;
+    }
+    return OK;
+  }
   /**
    * Sum arate values from active outlets feeding this inlet.
    */
   int audio(CSOUND *csound) {
     LockGuard guard(csound, sfg_globals->signal_flow_ports_lock);
-    // warn(csound, "BEGAN Inleta::audio()...\n");
-    // Zero the inlet buffer.
-    for (int sampleI = 0; sampleI < sampleN; sampleI++) {
-      asignal[sampleI] = FL(0.0);
-    }
-    // Loop over the source connections...
-    for (size_t sourceI = 0, sourceN = sourceOutlets->size(); sourceI < sourceN;
-         sourceI++) {
-      // Loop over the source connection instances...
-      std::vector<Outleta *> *instances = sourceOutlets->at(sourceI);
-      for (size_t instanceI = 0, instanceN = instances->size();
-           instanceI < instanceN; instanceI++) {
-        Outleta *sourceOutlet = instances->at(instanceI);
-        // Skip inactive instances.
-        if (sourceOutlet->opds.insdshead->actflg) {
-          for (int sampleI = 0, sampleN = ksmps(); sampleI < sampleN;
-               ++sampleI) {
-            asignal[sampleI] += sourceOutlet->asignal[sampleI];
-          }
-        }
-      }
+    size_t sampleN = ksmps();
+    const std::vector<const MYFLT *> &sources = sink->sources;
+    std::memset(asignal, 0, sampleN * sizeof(MYFLT));
+    for (size_t sourceI = 0, sourceN = sources.size(); sourceI < sourceN;
+         ++sourceI) {
+      sfg_accumulate(asignal, sources[sourceI], sampleN);
     }
-    // warn(csound, "ENDED Inleta::audio().\n");
     return OK;
   }
 };
@@ -441,10 +523,15 @@ struct Outletk : public OpcodeNoteoffBase<Outletk> {
    * State.
    */
   char sourceOutletId[0x100];
+  size_t slot;
+  int registered;
   SignalFlowGraphState *sfg_globals;
   int init(CSOUND *csound) {
     csound::QueryGlobalPointer(csound, "sfg_globals", sfg_globals);
     LockGuard guard(csound, sfg_globals->signal_flow_ports_lock);
+    if (registered) {
+      sfg_globals->kports.removeOutlet(slot, ksignal);
+    }
     const char *insname =
         csound->GetInstrumentList(csound)[opds.insdshead->insno]->insname;
     if (insname) {
@@ -453,29 +540,26 @@ struct Outletk : public OpcodeNoteoffBase<Outletk> {
       std::sprintf(sourceOutletId, "%d:%s", opds.insdshead->insno,
                    (char *)Sname->data);
     }
-    std::vector<Outletk *> &koutlets =
-        sfg_globals->koutletsForSourceOutletIds[sourceOutletId];
-    if (std::find(koutlets.begin(), koutlets.end(), this) == koutlets.end()) {
-      koutlets.push_back(this);
-      warn(csound, Str("Created instance 0x%x of %d instances of outlet %s\n"),
-           this, koutlets.size(), sourceOutletId);
-    }
+    slot = sfg_globals->kports.outletSlot(sourceOutletId);
+    size_t instances = sfg_globals->kports.addOutlet(slot, ksignal);
+    registered = 1;
+    warn(csound, Str("Created instance 0x%x of %d instances of outlet %s\n"),
+         this, instances, sourceOutletId);
     return OK;
   }
   int noteoff(CSOUND *csound) {
     LockGuard guard(csound, sfg_globals->signal_flow_ports_lock);
-    std::vector<Outletk *> &koutlets =
-        sfg_globals->koutletsForSourceOutletIds[sourceOutletId];
-    std::vector<Outletk *>::iterator thisoutlet =
-        std::find(koutlets.begin(), koutlets.end(), this);
-    koutlets.erase(thisoutlet);
-    warn(csound, Str("Removed 0x%x of %d instances of outletk %s\n"), this,
-         koutlets.size(), sourceOutletId);
+    if (registered) {
+      size_t instances = sfg_globals->kports.removeOutlet(slot, ksignal);
+      registered = 0;
+      warn(csound, Str("Removed 0x%x of %d instances of outletk %s\n"), this,
+           instances, sourceOutletId);
+    }
     return OK;
   }
 };
 
-struct Inletk : public OpcodeBase<Inletk> {
+struct Inletk : public OpcodeNoteoffBase<Inletk> {
   /**
    * Output.
    */
@@ -488,21 +572,16 @@ struct Inletk : public OpcodeBase<Inletk> {
    * State.
    */
   char sinkInletId[0x100];
-  std::vector<std::vector<Outletk *> *> *sourceOutlets;
-  int ksmps;
+  PortTable<const MYFLT *>::Sink *sink;
+  int connected;
   SignalFlowGraphState *sfg_globals;
   int init(CSOUND *csound) {
     csound::QueryGlobalPointer(csound, "sfg_globals", sfg_globals);
     LockGuard guard(csound, sfg_globals->signal_flow_ports_lock);
-    ksmps = opds.insdshead->ksmps;
-    if (std::find(sfg_globals->koutletVectors.begin(),
-                  sfg_globals->koutletVectors.end(),
-                  sourceOutlets) == sfg_globals->koutletVectors.end()) {
-      sourceOutlets = new std::vector<std::vector<Outletk *> *>;
-      sfg_globals->koutletVectors.push_back(sourceOutlets);
-    } else {
-      sourceOutlets->clear();
+    if (connected) {
+      sfg_globals->kports.disconnect(sink);
     }
+    sink = sfg_globals->kports.sink(sink);
     sinkInletId[0] = 0;
     const char *insname =
         csound->GetInstrumentList(csound)[opds.insdshead->insno]->insname;
@@ -512,28 +591,21 @@ struct Inletk : public OpcodeBase<Inletk> {
       std::sprintf(sinkInletId, "%d:%s", opds.insdshead->insno,
                    (char *)Sname->data);
     }
-    std::vector<Inletk *> &kinlets =
-        sfg_globals->kinletsForSinkInletIds[sinkInletId];
-    if (std::find(kinlets.begin(), kinlets.end(), this) == kinlets.end()) {
-      kinlets.push_back(this);
-      warn(csound, Str("Created instance 0x%x of inlet %s\n"), this,
-           sinkInletId);
-    }
     // Find source outlets connecting to this.
     // Any number of sources may connect to any number of sinks.
-    std::vector<std::string> &sourceOutletIds =
-        sfg_globals->connections[sinkInletId];
-    for (size_t i = 0, n = sourceOutletIds.size(); i < n; i++) {
-      const std::string &sourceOutletId = sourceOutletIds[i];
-      std::vector<Outletk *> &koutlets =
-          sfg_globals->koutletsForSourceOutletIds[sourceOutletId];
-      if (std::find(sourceOutlets->begin(), sourceOutlets->end(), &koutlets) ==
-          sourceOutlets->end()) {
-        sourceOutlets->push_back(&koutlets);
-        warn(csound, Str("Connected instances of outlet %s to instance 0x%x"
-                         "of inlet %s.\n"),
-             sourceOutletId.c_str(), this, sinkInletId);
-      }
+    size_t ports = sfg_globals->kports.connect(
+        sink, sfg_globals->connections[sinkInletId]);
+    connected = 1;
+    warn(csound, Str("Connected %d outlets with %d instances to instance 0x%x "
+                     "of inlet %s.\n"),
+         ports, sink->sources.size(), this, sinkInletId);
+    return OK;
+  }
+  int noteoff(CSOUND *csound) {
+    LockGuard guard(csound, sfg_globals->signal_flow_ports_lock);
+    if (connected) {
+      sfg_globals->kports.disconnect(sink);
+      connected = 0;
     }
     return OK;
   }
@@ -542,22 +614,13 @@ struct Inletk : public OpcodeBase<Inletk> {
    */
   int kontrol(CSOUND *csound) {
     LockGuard guard(csound, sfg_globals->signal_flow_ports_lock);
-    // Zero the inlet buffer.
-    *ksignal = FL(0.0);
-    // Loop over the source connections...
-    for (size_t sourceI = 0, sourceN = sourceOutlets->size(); sourceI < sourceN;
-         sourceI++) {
-      // Loop over the source connection instances...
-      const std::vector<Outletk *> *instances = sourceOutlets->at(sourceI);
-      for (size_t instanceI = 0, instanceN = instances->size();
-           instanceI < instanceN; instanceI++) {
-        const Outletk *sourceOutlet = instances->at(instanceI);
-        // Skip inactive instances.
-        if (sourceOutlet->opds.insdshead->actflg) {
-          *ksignal += *sourceOutlet->ksignal;
-        }
-      }
+    const std::vector<const MYFLT *> &sources = sink->sources;
+    MYFLT sum = FL(0.0);
+    for (size_t sourceI = 0, sourceN = sources.size(); sourceI < sourceN;
+         ++sourceI) {
+      sum += *sources[sourceI];
     }
+    *ksignal = sum;
     return OK;
   }
 };
@@ -768,11 +831,16 @@ struct Outletv : public OpcodeNoteoffBase<Outletv> {
    * State.
    */
   char sourceOutletId[0x100];
+  size_t slot;
+  int registered;
   SignalFlowGraphState *sfg_globals;
   int init(CSOUND *csound) {
     warn(csound, "BEGAN Outletv::init()...\n");
     csound::QueryGlobalPointer(csound, "sfg_globals", sfg_globals);
     LockGuard guard(csound, sfg_globals->signal_flow_ports_lock);
+    if (registered) {
+      sfg_globals->vports.removeOutlet(slot, vsignal);
+    }
     sourceOutletId[0] = 0;
     const char *insname =
         csound->GetInstrumentList(csound)[opds.insdshead->insno]->insname;
@@ -782,34 +850,31 @@ struct Outletv : public OpcodeNoteoffBase<Outletv> {
       std::sprintf(sourceOutletId, "%d:%s", opds.insdshead->insno,
                    (char *)Sname->data);
     }
-    std::vector<Outletv *> &voutlets =
-        sfg_globals->voutletsForSourceOutletIds[sourceOutletId];
-    if (std::find(voutlets.begin(), voutlets.end(), this) == voutlets.end()) {
-      voutlets.push_back(this);
-      warn(csound,
-           Str("Created instance 0x%x of %d instances of outlet %s (out "
-               "arraydat: 0x%x dims: %2d size: %4d [%4d] data: 0x%x (0x%x))\n"),
-           this, voutlets.size(), sourceOutletId, vsignal, vsignal->dimensions,
-           vsignal->sizes[0], vsignal->arrayMemberSize, vsignal->data,
-           &vsignal->data);
-    }
+    slot = sfg_globals->vports.outletSlot(sourceOutletId);
+    size_t instances = sfg_globals->vports.addOutlet(slot, vsignal);
+    registered = 1;
+    warn(csound,
+         Str("Created instance 0x%x of %d instances of outlet %s (out "
+             "arraydat: 0x%x dims: %2d size: %4d [%4d] data: 0x%x (0x%x))\n"),
+         this, instances, sourceOutletId, vsignal, vsignal->dimensions,
+         vsignal->sizes[0], vsignal->arrayMemberSize, vsignal->data,
+         &vsignal->data);
     warn(csound, "ENDED Outletv::init()...\n");
     return OK;
   }
   int noteoff(CSOUND *csound) {
     LockGuard guard(csound, sfg_globals->signal_flow_ports_lock);
-    std::vector<Outletv *> &voutlets =
-        sfg_globals->voutletsForSourceOutletIds[sourceOutletId];
-    std::vector<Outletv *>::iterator thisoutlet =
-        std::find(voutlets.begin(), voutlets.end(), this);
-    voutlets.erase(thisoutlet);
-    warn(csound, Str("Removed 0x%x of %d instances of outletv %s\n"), this,
-         voutlets.size(), sourceOutletId);
+    if (registered) {
+      size_t instances = sfg_globals->vports.removeOutlet(slot, vsignal);
+      registered = 0;
+      warn(csound, Str("Removed 0x%x of %d instances of outletv %s\n"), this,
+           instances, sourceOutletId);
+    }
     return OK;
   }
 };
 
-struct Inletv : public OpcodeBase<Inletv> {
+struct Inletv : public OpcodeNoteoffBase<Inletv> {
   /**
    * Output.
    */
@@ -822,16 +887,15 @@ struct Inletv : public OpcodeBase<Inletv> {
    * State.
    */
   char sinkInletId[0x100];
-  std::vector<std::vector<Outletv *> *> *sourceOutlets;
+  PortTable<ARRAYDAT *>::Sink *sink;
+  int connected;
   size_t arraySize;
   size_t myFltsPerArrayElement;
-  int sampleN;
   SignalFlowGraphState *sfg_globals;
   int init(CSOUND *csound) {
     warn(csound, "BEGAN Inletv::init()...\n");
     csound::QueryGlobalPointer(csound, "sfg_globals", sfg_globals);
     LockGuard guard(csound, sfg_globals->signal_flow_ports_lock);
-    sampleN = opds.insdshead->ksmps;
     // The array elements may be krate (1 MYFLT) or arate (ksmps MYFLT).
     myFltsPerArrayElement = vsignal->arrayMemberSize / sizeof(MYFLT);
     warn(csound, "myFltsPerArrayElement: %d\n", myFltsPerArrayElement);
@@ -841,16 +905,10 @@ struct Inletv : public OpcodeBase<Inletv> {
       arraySize *= vsignal->sizes[dimension];
     }
     warn(csound, "arraySize: %d\n", arraySize);
-    warn(csound, "sourceOutlets: 0x%x\n", sourceOutlets);
-    if (std::find(sfg_globals->voutletVectors.begin(),
-                  sfg_globals->voutletVectors.end(),
-                  sourceOutlets) == sfg_globals->voutletVectors.end()) {
-      sourceOutlets = new std::vector<std::vector<Outletv *> *>;
-      sfg_globals->voutletVectors.push_back(sourceOutlets);
-    } else {
-      sourceOutlets->clear();
+    if (connected) {
+      sfg_globals->vports.disconnect(sink);
     }
-    warn(csound, "sourceOutlets: 0x%x\n", sourceOutlets);
+    sink = sfg_globals->vports.sink(sink);
     sinkInletId[0] = 0;
     const char *insname =
         csound->GetInstrumentList(csound)[opds.insdshead->insno]->insname;
@@ -860,65 +918,40 @@ struct Inletv : public OpcodeBase<Inletv> {
       std::sprintf(sinkInletId, "%d:%s", opds.insdshead->insno,
                    (char *)Sname->data);
     }
-    std::vector<Inletv *> &vinlets =
-        sfg_globals->vinletsForSinkInletIds[sinkInletId];
-    if (std::find(vinlets.begin(), vinlets.end(), this) == vinlets.end()) {
-      vinlets.push_back(this);
-      warn(csound, Str("Created instance 0x%x of inlet %s (in arraydat: 0x%x "
-                       "dims: %2d size: %4d [%4d] data: 0x%x (0x%x))\n"),
-           this, sinkInletId, vsignal, vsignal->dimensions, vsignal->sizes[0],
-           vsignal->arrayMemberSize, vsignal->data, &vsignal->data);
-    }
     // Find source outlets connecting to this.
     // Any number of sources may connect to any number of sinks.
-    std::vector<std::string> &sourceOutletIds =
-        sfg_globals->connections[sinkInletId];
-    for (size_t i = 0, n = sourceOutletIds.size(); i < n; i++) {
-      const std::string &sourceOutletId = sourceOutletIds[i];
-      std::vector<Outletv *> &voutlets =
-          sfg_globals->voutletsForSourceOutletIds[sourceOutletId];
-      if (std::find(sourceOutlets->begin(), sourceOutlets->end(), &voutlets) ==
-          sourceOutlets->end()) {
-        sourceOutlets->push_back(&voutlets);
-        warn(csound, Str("Connected instances of outlet %s to instance 0x%x of "
-                         "inlet %s\n"),
-             sourceOutletId.c_str(), this, sinkInletId);
-      }
-    }
+    size_t ports = sfg_globals->vports.connect(
+        sink, sfg_globals->connections[sinkInletId]);
+    connected = 1;
+    warn(csound, Str("Connected %d outlets with %d instances to instance 0x%x "
+                     "of inlet %s (in arraydat: 0x%x dims: %2d size: %4d "
+                     "[%4d] data: 0x%x (0x%x))\n"),
+         ports, sink->sources.size(), this, sinkInletId, vsignal,
+         vsignal->dimensions, vsignal->sizes[0], vsignal->arrayMemberSize,
+         vsignal->data, &vsignal->data);
     warn(csound, "ENDED Inletv::init().\n");
     return OK;
   }
+  int noteoff(CSOUND *csound) {
+    LockGuard guard(csound, sfg_globals->signal_flow_ports_lock);
+    if (connected) {
+      sfg_globals->vports.disconnect(sink);
+      connected = 0;
+    }
+    return OK;
+  }
   /**
-   * Sum values from active outlets feeding this inlet.
+   * Sum values from active outlets feeding this inlet. The array data
+   * pointer is read at performance time, since arrays may be resized.
    */
   int audio(CSOUND *csound) {
-    // warn(csound, "BEGAN Inletv::audio()...\n");
     LockGuard guard(csound, sfg_globals->signal_flow_ports_lock);
-    for (uint32_t signalI = 0; signalI < arraySize; ++signalI) {
-      vsignal->data[signalI] = FL(0.0);
-    }
-    // Loop over the source connections...
-    for (size_t sourceI = 0, sourceN = sourceOutlets->size(); sourceI < sourceN;
-         sourceI++) {
-      // Loop over the source connection instances...
-      std::vector<Outletv *> *instances = sourceOutlets->at(sourceI);
-      for (size_t instanceI = 0, instanceN = instances->size();
-           instanceI < instanceN; instanceI++) {
-        Outletv *sourceOutlet = instances->at(instanceI);
-        // Skip inactive instances.
-        if (sourceOutlet->opds.insdshead->actflg) {
-          for (uint32_t signalI = 0; signalI < arraySize; ++signalI) {
-            ARRAYDAT *insignal = sourceOutlet->vsignal;
-            MYFLT *indata = insignal->data;
-            // warn(csound, "Inletv::audio: sourceOutlet: 0%x in arraydat: 0x%x
-            // data: 0x%x (0x%x)\n", sourceOutlet, insignal, indata,
-            // &insignal->data);
-            vsignal->data[signalI] += indata[signalI];
-          }
-        }
-      }
+    const std::vector<ARRAYDAT *> &sources = sink->sources;
+    std::memset(vsignal->data, 0, arraySize * sizeof(MYFLT));
+    for (size_t sourceI = 0, sourceN = sources.size(); sourceI < sourceN;
+         ++sourceI) {
+      sfg_accumulate(vsignal->data, sources[sourceI]->data, arraySize);
     }
-    // warn(csound, "ENDED Inletv::audio().\n");
     return OK;
   }
 };
@@ -1280,6 +1280,13 @@ static OENTRY spectra_localops[] = {
 { "maxalloc", S(CPU_PERC),0, 1,   "",     "Si",   (SUBR)maxalloc_S, NULL, NULL  },
 { "cpuprc", S(CPU_PERC),0, 1,     "",     "ii",   (SUBR)cpuperc, NULL, NULL   },
 { "maxalloc", S(CPU_PERC),0, 1,   "",     "ii",   (SUBR)maxalloc, NULL, NULL  },
+{ "voicesteal", S(VOICEOPT),0, 1, "",     "Sij",  (SUBR)voicesteal_S, NULL, NULL },
+{ "voicesteal", S(VOICEOPT),0, 1, "",     "iij",  (SUBR)voicesteal, NULL, NULL },
+{ "voiceprio", S(VOICEOPT),0, 1,  "",     "Si",   (SUBR)voiceprio_S, NULL, NULL },
+{ "voiceprio", S(VOICEOPT),0, 1,  "",     "ii",   (SUBR)voiceprio, NULL, NULL },
+{ "loadshed", S(LOADSHED),0, 1,   "",     "ipj",  (SUBR)loadshed, NULL, NULL  },
+{ "autosleep", S(AUTOSLEEP),0, 1, "",     "Siooo", (SUBR)autosleep_S, NULL, NULL },
+{ "autosleep", S(AUTOSLEEP),0, 1, "",     "iiooo", (SUBR)autosleep, NULL, NULL },
 { "active", 0xffff                                                          },
 { "active.iS", S(INSTCNT),0,1,    "i",    "Soo",   (SUBR)instcount_S, NULL, NULL },
 { "active.kS", S(INSTCNT),0,2,    "k",    "Soo",   NULL, (SUBR)instcount_S, NULL },
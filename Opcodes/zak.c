@@ -71,6 +71,70 @@
 /* There are currently no limits on the size of these spaces.  */
 /* From 6.12 these are in a GlobalVariable anf NOT CSOUND structure -- JPff */
 
+/* Sparse za space keeps one bit per za location, set when the location
+ * is written and cleared when zacl clears it, so that a clean location
+ * is known to be all zero.  zacl then only touches written locations,
+ * and reads of clean locations need not look at za space at all.  The
+ * read counts are not locked, so they are approximate under -j.
+ */
+
+#define ZA_BIT(indx)    ((uint64_t) 1 << ((indx) & 63))
+
+static inline int32_t za_clean(ZAK_GLOBALS *zak, int32_t indx)
+{
+    return zak->sparse && !(zak->zadirty[indx >> 6] & ZA_BIT(indx));
+}
+
+static inline void za_touch(ZAK_GLOBALS *zak, int32_t indx)
+{
+    if (zak->sparse) {
+      zak->zadirty[indx >> 6] |= ZA_BIT(indx);
+      zak->zawrites[indx]++;
+    }
+}
+
+static inline void za_read(ZAK_GLOBALS *zak, int32_t indx)
+{
+    if (zak->sparse)
+      zak->zareads[indx]++;
+}
+
+static inline int32_t za_lowbit(uint64_t bits)
+{
+#if defined(__GNUC__)
+    return __builtin_ctzll(bits);
+#else
+    int32_t n = 0;
+    while (!(bits & 1)) {
+      bits >>= 1;
+      n++;
+    }
+    return n;
+#endif
+}
+
+/* Clear the written locations from first to last and mark them clean. */
+static void za_clear_dirty(ZAK_GLOBALS *zak, int32_t first, int32_t last,
+                           uint32_t ksmps)
+{
+    int32_t w, wfirst = first >> 6, wlast = last >> 6;
+    for (w = wfirst; w <= wlast; w++) {
+      uint64_t bits = zak->zadirty[w];
+      if (bits == 0)
+        continue;
+      if (w == wfirst)
+        bits &= ~(uint64_t) 0 << (first & 63);
+      if (w == wlast)
+        bits &= ~(uint64_t) 0 >> (63 - (last & 63));
+      zak->zadirty[w] &= ~bits;
+      while (bits) {
+        int32_t indx = (w << 6) + za_lowbit(bits);
+        memset(zak->zastart + (indx * ksmps), 0, ksmps*sizeof(MYFLT));
+        bits &= bits - 1;
+      }
+    }
+}
+
 /* zakinit is an opcode which must be called once to reserve the memory
  * for zk and za spaces.
  */
@@ -115,6 +179,17 @@ int32_t zakinit(CSOUND *csound, ZAKINIT *p)
 
     length = (zak->zalast + 1L) * sizeof(MYFLT) * CS_KSMPS;
     zak->zastart = (MYFLT*) csound->Calloc(csound, length);
+
+    /* Optionally track written za locations; see za_clear_dirty(). */
+    if (*p->isparse != FL(0.0)) {
+      zak->sparse = 1;
+      zak->zadirty = (uint64_t*)
+        csound->Calloc(csound, ((zak->zalast + 64L) >> 6) * sizeof(uint64_t));
+      zak->zawrites = (uint32_t*)
+        csound->Calloc(csound, (zak->zalast + 1L) * sizeof(uint32_t));
+      zak->zareads = (uint32_t*)
+        csound->Calloc(csound, (zak->zalast + 1L) * sizeof(uint32_t));
+    }
     return OK;
 }
 
@@ -463,6 +538,11 @@ int32_t zar(CSOUND *csound, ZAR *p)
                                Str("zar index < 0. Returning 0."));
     }
     else {
+      za_read(zak, indx);
+      if (za_clean(zak, indx)) {
+        memset(writeloc, 0, nsmps*sizeof(MYFLT));
+        return OK;
+      }
       /* Now read from the array in za space and write to the destination.
        * See notes in zkr() on pointer arithmetic.     */
       readloc = zak->zastart + (indx * CS_KSMPS);
@@ -510,6 +590,11 @@ int32_t zarg(CSOUND *csound, ZARG *p)
                                  Str("zarg index < 0. Returning 0."));
       }
       else {
+        za_read(zak, indx);
+        if (za_clean(zak, indx)) {
+          memset(writeloc, 0, nsmps*sizeof(MYFLT));
+          return OK;
+        }
         /* Now read from the array in za space multiply by kgain and write
          * to the destination.       */
         readloc = zak->zastart + (indx * CS_KSMPS);
@@ -554,6 +639,7 @@ int32_t zaw(CSOUND *csound, ZAW *p)
     }
     else {
         /* Now write to the array in za space pointed to by indx.    */
+      za_touch(zak, indx);
       writeloc = zak->zastart + (indx * CS_KSMPS);
       if (UNLIKELY(offset)) memset(writeloc, '\0', offset*sizeof(MYFLT));
       if (UNLIKELY(early)) {
@@ -595,6 +681,7 @@ int32_t zawm(CSOUND *csound, ZAWM *p)
     }
     else {
       /* Now write to the array in za space pointed to by indx.    */
+      za_touch(zak, indx);
       writeloc = zak->zastart + (indx * CS_KSMPS);
       if (*p->mix == 0) {
         /* Normal write mode.  */
@@ -659,7 +746,16 @@ int32_t zamod(CSOUND *csound, ZAMOD *p)
     }
     else {                      /* Now read the values from za space.    */
       readloc = zak->zastart + (indx * CS_KSMPS);
+      za_read(zak, indx);
       if (UNLIKELY(early)) nsmps -= early;
+      if (za_clean(zak, indx)) {  /* Modulating by a zero location */
+        if (mflag == 0)
+          memcpy(&writeloc[offset], &readsig[offset],
+                 (nsmps-offset)*sizeof(MYFLT));
+        else
+          memset(&writeloc[offset], 0, (nsmps-offset)*sizeof(MYFLT));
+        return OK;
+      }
       if (mflag == 0) {
         for (n=offset; n<nsmps; n++) {
           writeloc[n] = readsig[n] + readloc[n];
@@ -701,6 +797,9 @@ int32_t zacl(CSOUND *csound, ZACL *p)
           return csound->PerfError(csound, &(p->h),
                                    Str("zacl first > last. Not clearing."));
         }
+        else if (zak->sparse) { /* Only clear written locations */
+          za_clear_dirty(zak, first, last, CS_KSMPS);
+        }
         else {  /* Now clear the appropriate locations in za space. */
           loopcount = (last - first + 1) * CS_KSMPS;
           writeloc = zak->zastart + (first * CS_KSMPS);
@@ -711,10 +810,45 @@ int32_t zacl(CSOUND *csound, ZACL *p)
     return OK;
 }
 
+/*-----------------------------------*/
+
+/* zastat reports how often a za location has been written and read,
+ * if zakinit was asked for a sparse za space, and 0 otherwise. */
+int32_t zastatset(CSOUND *csound, ZASTAT *p)
+{
+    ZAK_GLOBALS* zak =
+      (ZAK_GLOBALS*) csound->QueryGlobalVariable(csound, "_zak_globals");
+    if (UNLIKELY(zak == NULL)) {
+      return csound->InitError(csound, Str("No za space: "
+                                           "zakinit has not been called yet."));
+    }
+    p->zz = zak;
+    return OK;
+}
+
+int32_t zastat(CSOUND *csound, ZASTAT *p)
+{
+    ZAK_GLOBALS* zak = (ZAK_GLOBALS*) p->zz;
+    int32_t indx = (int32_t) *p->ndx;
+
+    if (UNLIKELY((indx > zak->zalast) || (indx < 0))) {
+      *p->kwrites = *p->kreads = FL(0.0);
+      return csound->PerfError(csound, &(p->h),
+                               Str("zastat index out of range."));
+    }
+    if (zak->sparse) {
+      *p->kwrites = (MYFLT) zak->zawrites[indx];
+      *p->kreads  = (MYFLT) zak->zareads[indx];
+    }
+    else
+      *p->kwrites = *p->kreads = FL(0.0);
+    return OK;
+}
+
 #define S(x)    sizeof(x)
 
 static OENTRY zak_localops[] = {
-  { "zakinit", S(ZAKINIT), ZB, 1,  "",   "ii",   (SUBR)zakinit, NULL,  NULL      },
+  { "zakinit", S(ZAKINIT), ZB, 1,  "",   "iio",   (SUBR)zakinit, NULL,  NULL      },
   { "zir",    S(ZKR),ZR,  1,   "i",  "i",    (SUBR)zir,     NULL,  NULL      },
   { "zkr",    S(ZKR),ZR,  3,   "k",  "k",    (SUBR)zkset,   (SUBR)zkr,   NULL},
   { "ziw",    S(ZKW),ZW, 1,   "",   "ii",   (SUBR)ziw,     NULL,  NULL      },
@@ -728,7 +862,8 @@ static OENTRY zak_localops[] = {
   { "zaw",    S(ZAW),    ZW, 3,   "",  "ak",   (SUBR)zaset,  (SUBR)zaw  },
   { "zawm",   S(ZAWM),   ZB, 3,   "",  "akp",  (SUBR)zaset,  (SUBR)zawm },
   { "zamod",  S(ZAMOD),  ZB, 3,   "a", "ak",   (SUBR)zaset,  (SUBR)zamod},
-  { "zacl",   S(ZACL),   ZW, 3,   "",  "kk",   (SUBR)zaset,  (SUBR)zacl}
+  { "zacl",   S(ZACL),   ZW, 3,   "",  "kk",   (SUBR)zaset,  (SUBR)zacl},
+  { "zastat", S(ZASTAT), ZR, 3,   "kk", "k",   (SUBR)zastatset, (SUBR)zastat}
 };
 
 LINKAGE_BUILTIN(zak_localops)
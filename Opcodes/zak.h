@@ -27,6 +27,14 @@ typedef struct {
     int64_t       zklast;
     MYFLT         *zastart;
     int64_t       zalast;
+    /* Sparse za space (zakinit isparse != 0): one bit per channel marks
+     * channels written since they were last cleared; a clean channel is
+     * always all zero.  Cleared by csoundGetZaBounds(), as raw access
+     * cannot be tracked. */
+    int32_t       sparse;
+    uint64_t      *zadirty;
+    uint32_t      *zawrites;    /* Per channel usage statistics */
+    uint32_t      *zareads;
 } ZAK_GLOBALS;
 
 
@@ -42,6 +50,7 @@ typedef struct {
                                  * patching */
         MYFLT   *isizek;        /* Number of locations for i or k rate
                                  * variables */
+        MYFLT   *isparse;       /* Non zero to track written za locations */
 } ZAKINIT;
 
 /* ZKR data structure for zir() and zkr(). */
@@ -132,6 +141,15 @@ typedef struct {
         void    *zz;
 } ZAMOD;
 
+/* ZASTAT data structure for zastat(). */
+typedef struct {
+        OPDS    h;
+        MYFLT   *kwrites;       /* Number of writes to the za location */
+        MYFLT   *kreads;        /* Number of reads from it */
+        MYFLT   *ndx;           /* Location in za space */
+        void    *zz;
+} ZASTAT;
+
 /* ZACL data structure for zacl(). */
 typedef struct {
         OPDS    h;
@@ -146,6 +164,8 @@ int zamod(CSOUND*,ZAMOD *p);
 int zar(CSOUND*,ZAR *p);
 int zarg(CSOUND*,ZARG *p);
 int zaset(CSOUND*,ZAR *p);
+int zastat(CSOUND*,ZASTAT *p);
+int zastatset(CSOUND*,ZASTAT *p);
 int zaw(CSOUND*,ZAW *p);
 int zawm(CSOUND*,ZAWM *p);
 int zir(CSOUND*,ZKR *p);
@@ -226,6 +226,16 @@ static const char *longUsageList[] = {
   Str_noop("--input=FNAME           sound input filename"),
   Str_noop("--output=FNAME          sound output filename"),
   Str_noop("--logfile=FNAME         log output to file"),
+  Str_noop("--batch=FNAME           render the jobs listed in FNAME "
+                                    "(csound frontend)"),
+  Str_noop("--batch-jobs=N          number of concurrent batch renders"),
+  Str_noop("--segments=T1,T2,...    render the score in segments split at "
+                                    "T1,T2,... concurrently (csound frontend)"),
+  Str_noop("--segment-tail=SECS     keep rendering each segment for SECS"),
+  Str_noop("--segment-jobs=N        number of concurrent segment renders"),
+  Str_noop("--segment-output=FNAME  write the stitched render to FNAME "
+                                    "instead of the -o file"),
+  Str_noop("--segment-verify        compare with a single-pass render"),
   " ",
   Str_noop("--nosound               no sound onto disk or device"),
   Str_noop("--tempo=N               use uninterpreted beats of the score, "
@@ -288,7 +298,13 @@ static const char *longUsageList[] = {
   Str_noop("                          velocity number to pfield N as amplitude"),
   Str_noop("--no-default-paths      turn off relative paths from CSD/ORC/SCO"),
   Str_noop("--sample-accurate       use sample-accurate timing of score events"),
+  Str_noop("--inline-udos           inline calls to simple UDOs into "
+                                    "instruments"),
   Str_noop("--realtime              realtime priority mode"),
+  Str_noop("--profile[=FNAME]       time each opcode and instrument, print a "
+                                    "report and write it as JSON to FNAME"),
+  Str_noop("--timing[=SECS]         time each k-cycle against its deadline, "
+                                    "print a summary every SECS seconds"),
   Str_noop("--nchnls=N              override number of audio channels"),
   Str_noop("--nchnls_i=N            override number of input audio channels"),
   Str_noop("--0dbfs=N               override 0dbfs (max positive signal amplitude)"),
@@ -1041,11 +1057,33 @@ static int decode_long(CSOUND *csound, char *s, int argc, char **argv)
       O->sampleAccurate = 1;
       return 1;
     }
+    else if (!(strcmp(s, "inline-udos"))) {
+      O->inlineUdos = 1;
+      return 1;
+    }
+    else if (!(strcmp(s, "no-inline-udos"))) {
+      O->inlineUdos = 0;
+      return 1;
+    }
     else if (!(strcmp(s, "realtime"))) {
       csound->Message(csound, Str("realtime mode enabled\n"));
       O->realtime = 1;
       return 1;
     }
+    else if (!(strncmp(s, "profile", 7)) && (s[7] == '\0' || s[7] == '=')) {
+      csoundSetProfiling(csound, 1);
+      if (s[7] == '=') {
+        s += 8;
+        if (*s==3) s++;           /* skip ETX */
+        if (UNLIKELY(*s == '\0')) dieu(csound, Str("no profile file name"));
+        csound->profile_json = cs_strdup(csound, s);
+      }
+      return 1;
+    }
+    else if (!(strncmp(s, "timing", 6)) && (s[6] == '\0' || s[6] == '=')) {
+      csoundSetTiming(csound, 1, 0.0, s[6] == '=' ? atof(s + 7) : 0.0);
+      return 1;
+    }
     else if (!(strncmp(s, "nchnls=", 7))) {
       s += 7;
       O->nchnls_override = atoi(s);
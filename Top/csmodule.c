@@ -74,6 +74,7 @@
 #include <string.h>
 #include <errno.h>
 #include <setjmp.h>
+#include <sys/stat.h>
 
 #include "csoundCore.h"
 #include "csmodule.h"
@@ -134,6 +135,10 @@ static  const   char    *InfoFunc_Name =      "csoundModuleInfo";
 static  const   char    *plugindir_envvar =   "OPCODE6DIR";
 static  const   char    *plugindir64_envvar = "OPCODE6DIR64";
 
+/* environment variable storing path to the plugin manifest (optional) */
+static  const   char    *manifest_envvar =    "OPCODE6MANIFEST";
+static  const   char    *manifest_varname =   "_PLUGIN_MANIFEST";
+
 /* default directory to load plugins from if environment variable is not set */
 #if !(defined (NACL))
 #if !(defined(_CSOUND_RELEASE_) && (defined(LINUX) || defined(__MACH__)))
@@ -388,93 +393,301 @@ static int csoundCheckOpcodeDeny(CSOUND * csound, const char *fname)
     return 0;
 }
 
+/* ---------------------------------------------------------------------- */
+/* Plugin manifest                                                        */
+/*                                                                        */
+/* If OPCODE6MANIFEST names a file, plugin libraries are not all opened   */
+/* at start-up. The manifest records, for every library found in the      */
+/* plugin directories, its size and modification time and the opcode and  */
+/* GEN names it registers. Libraries that register no names (audio and    */
+/* MIDI drivers, utilities) are still loaded eagerly, the others only     */
+/* when the parser or a named GEN lookup asks for one of their names.     */
+/* If any library was added, removed or changed, or the file is missing   */
+/* or was written by a different build, all plugins are loaded as before  */
+/* and the manifest is rewritten once they have been initialised.         */
+/* ---------------------------------------------------------------------- */
+
+#define PLUGIN_SKIP     0       /* not a plugin, or could not be loaded  */
+#define PLUGIN_EAGER    1       /* registers no names, always loaded     */
+#define PLUGIN_LAZY     2       /* loaded on first use of one of its names */
+
+typedef struct pluginLib_s {
+    struct pluginLib_s *nxt;
+    char        *path;
+    int64_t     size, mtime;
+    int         mode;
+    int         loaded;
+    int         seen;           /* found while checking the manifest     */
+    void        *module;        /* csoundModule_t, while rebuilding      */
+    CONS_CELL   *opcodes;       /* names registered by the library       */
+    CONS_CELL   *gens;
+} PLUGIN_LIB;
+
+typedef struct {
+    char        *path;          /* manifest file                         */
+    char        *dirs;          /* plugin search path it describes       */
+    int         rebuild;        /* write manifest after module init      */
+    int         stale;
+    PLUGIN_LIB  *libs;
+    PLUGIN_LIB  *current;       /* library being initialised             */
+    CS_HASH_TABLE *opnames;     /* name -> CONS_CELL list of PLUGIN_LIB  */
+    CS_HASH_TABLE *gennames;
+} PLUGIN_MANIFEST;
+
+
+static inline PLUGIN_MANIFEST *get_manifest(CSOUND *csound)
+{
+    return (PLUGIN_MANIFEST*) csoundQueryGlobalVariable(csound,
+                                                        manifest_varname);
+}
+
+static void manifest_header(char *buf, size_t n)
+{
+    snprintf(buf, n, "csound-plugin-manifest %d.%d %d",
+             CS_APIVERSION, CS_APISUBVER, (int) sizeof(MYFLT));
+}
+
+static void manifest_clear(CSOUND *csound, PLUGIN_MANIFEST *pm)
+{
+    if (pm->opnames != NULL)
+      cs_hash_table_free(csound, pm->opnames);
+    if (pm->gennames != NULL)
+      cs_hash_table_free(csound, pm->gennames);
+    pm->opnames = cs_hash_table_create(csound);
+    pm->gennames = cs_hash_table_create(csound);
+    pm->libs = pm->current = NULL;
+}
+
+static PLUGIN_LIB *manifest_new_lib(CSOUND *csound, PLUGIN_MANIFEST *pm,
+                                    const char *path, int64_t size,
+                                    int64_t mtime, int mode)
+{
+    PLUGIN_LIB  *lib = (PLUGIN_LIB*) csound->Calloc(csound, sizeof(PLUGIN_LIB));
+
+    lib->path = cs_strdup(csound, (char*) path);
+    lib->size = size;
+    lib->mtime = mtime;
+    lib->mode = mode;
+    lib->nxt = pm->libs;
+    pm->libs = lib;
+    return lib;
+}
+
+static void manifest_add_name(CSOUND *csound, PLUGIN_MANIFEST *pm,
+                              PLUGIN_LIB *lib, const char *name, int gen)
+{
+    CS_HASH_TABLE *tab = (gen ? pm->gennames : pm->opnames);
+    CONS_CELL     *libs, *c;
+    char          *key;
+
+    libs = (CONS_CELL*) cs_hash_table_get(csound, tab, (char*) name);
+    for (c = libs; c != NULL; c = c->next)
+      if (c->value == (void*) lib)
+        return;
+    cs_hash_table_put(csound, tab, (char*) name, cs_cons(csound, lib, libs));
+    key = cs_hash_table_get_key(csound, tab, (char*) name);
+    if (gen)
+      lib->gens = cs_cons(csound, key, lib->gens);
+    else
+      lib->opcodes = cs_cons(csound, key, lib->opcodes);
+}
+
+static int plugin_file_stat(const char *path, int64_t *size, int64_t *mtime)
+{
+    struct stat st;
+
+    if (stat(path, &st) != 0)
+      return -1;
+    *size = (int64_t) st.st_size;
+    *mtime = (int64_t) st.st_mtime;
+    return 0;
+}
+
+/* read manifest file, returns non-zero if it is missing or unusable */
+
+static int manifest_read(CSOUND *csound, PLUGIN_MANIFEST *pm)
+{
+    FILE        *f;
+    PLUGIN_LIB  *lib = NULL;
+    char        line[1100], hdr[64];
+    long long   size, mtime;
+    int         mode, pos, len, err = 0, hdrok = 0, dirsok = 0;
+
+    f = fopen(pm->path, "r");
+    if (f == NULL)
+      return -1;
+    manifest_header(hdr, sizeof(hdr));
+    while (fgets(line, sizeof(line), f) != NULL) {
+      len = (int) strlen(line);
+      while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+        line[--len] = '\0';
+      if (line[0] == '\0' || line[0] == '#')
+        continue;
+      if (strncmp(line, "csound-plugin-manifest ", 23) == 0) {
+        hdrok = (strcmp(line, hdr) == 0);
+        err = (hdrok ? 0 : -1);
+      }
+      else if (strncmp(line, "dirs ", 5) == 0) {
+        dirsok = (strcmp(line + 5, pm->dirs) == 0);
+        err = (dirsok ? 0 : -1);
+      }
+      else if (sscanf(line, "lib %d %lld %lld %n",
+                      &mode, &size, &mtime, &pos) == 3 &&
+               mode >= PLUGIN_SKIP && mode <= PLUGIN_LAZY) {
+        lib = manifest_new_lib(csound, pm, line + pos,
+                               (int64_t) size, (int64_t) mtime, mode);
+      }
+      else if (lib != NULL && strncmp(line, "op ", 3) == 0)
+        manifest_add_name(csound, pm, lib, line + 3, 0);
+      else if (lib != NULL && strncmp(line, "gen ", 4) == 0)
+        manifest_add_name(csound, pm, lib, line + 4, 1);
+      else
+        err = -1;
+      if (err)
+        break;
+    }
+    fclose(f);
+    return (err || !hdrok || !dirsok ? -1 : 0);
+}
+
+static void manifest_write(CSOUND *csound, PLUGIN_MANIFEST *pm)
+{
+    FILE        *f;
+    PLUGIN_LIB  *lib;
+    CONS_CELL   *c;
+    char        hdr[64], *tmp;
+    int         n = 0;
+
+    tmp = (char*) csound->Malloc(csound, strlen(pm->path) + 5);
+    sprintf(tmp, "%s.tmp", pm->path);
+    f = fopen(tmp, "w");
+    if (UNLIKELY(f == NULL)) {
+      csound->Warning(csound, Str("could not write plugin manifest '%s': %s"),
+                      pm->path, strerror(errno));
+      csound->Free(csound, tmp);
+      return;
+    }
+    manifest_header(hdr, sizeof(hdr));
+    fprintf(f, "%s\ndirs %s\n", hdr, pm->dirs);
+    for (lib = pm->libs; lib != NULL; lib = lib->nxt, n++) {
+      fprintf(f, "lib %d %lld %lld %s\n", lib->mode, (long long) lib->size,
+              (long long) lib->mtime, lib->path);
+      for (c = lib->opcodes; c != NULL; c = c->next)
+        fprintf(f, "op %s\n", (char*) c->value);
+      for (c = lib->gens; c != NULL; c = c->next)
+        fprintf(f, "gen %s\n", (char*) c->value);
+    }
+    if (UNLIKELY(fclose(f) != 0 || rename(tmp, pm->path) != 0)) {
+      csound->Warning(csound, Str("could not write plugin manifest '%s': %s"),
+                      pm->path, strerror(errno));
+      remove(tmp);
+    }
+    else if (UNLIKELY(csound->oparms->odebug))
+      csound->Message(csound, Str("Wrote plugin manifest '%s' (%d files)\n"),
+                      pm->path, n);
+    csound->Free(csound, tmp);
+}
+
 /**
- * Load plugin libraries for Csound instance 'csound', and call
- * pre-initialisation functions.
- * Return value is CSOUND_SUCCESS if there was no error, CSOUND_ERROR if
- * some modules could not be loaded or initialised, and CSOUND_MEMORY
- * if a memory allocation failure has occured.
+ * Record that the library currently being initialised registers the
+ * opcode or named GEN 'name'. Only does anything while the plugin
+ * manifest is being rebuilt.
  */
-int csoundLoadModules(CSOUND *csound)
+void csoundPluginManifestRecord(CSOUND *csound, const char *name, int gen)
+{
+    PLUGIN_MANIFEST *pm = get_manifest(csound);
+
+    if (pm == NULL || !pm->rebuild || pm->current == NULL)
+      return;
+    manifest_add_name(csound, pm, pm->current, name, gen);
+    pm->current->mode = PLUGIN_LAZY;
+}
+
+/**
+ * Load and initialise the not yet loaded libraries that register the
+ * opcode (gen == 0) or named GEN (gen != 0) 'name', or all of them if
+ * 'name' is NULL. Returns the number of libraries loaded.
+ */
+int csoundLoadLazyPlugins(CSOUND *csound, const char *name, int gen)
 {
+    PLUGIN_MANIFEST *pm = get_manifest(csound);
+    PLUGIN_LIB      *lib;
+    CONS_CELL       *c;
+    int             cnt = 0;
+
+    if (pm == NULL || pm->rebuild)
+      return 0;
+    if (name == NULL) {
+      for (lib = pm->libs; lib != NULL; lib = lib->nxt) {
+        if (!lib->loaded) {
+          lib->loaded = 1;
+          if (csoundLoadAndInitModule(csound, lib->path) == CSOUND_SUCCESS)
+            cnt++;
+        }
+      }
+      return cnt;
+    }
+    c = (CONS_CELL*) cs_hash_table_get(csound, (gen ? pm->gennames
+                                                     : pm->opnames),
+                                       (char*) name);
+    for ( ; c != NULL; c = c->next) {
+      lib = (PLUGIN_LIB*) c->value;
+      if (lib->loaded)
+        continue;
+      lib->loaded = 1;          /* do not retry if it fails */
+      if (UNLIKELY(csound->oparms->odebug))
+        csound->Message(csound, Str("Loading '%s' for '%s'\n"),
+                        lib->path, name);
+      if (UNLIKELY(csoundLoadAndInitModule(csound, lib->path)
+                   != CSOUND_SUCCESS))
+        csound->Warning(csound, Str("could not load plugin '%s'"), lib->path);
+      else
+        cnt++;
+    }
+    return cnt;
+}
+
 #if (defined(HAVE_DIRENT_H) && (TARGET_OS_IPHONE == 0))
+
+typedef int (*PLUGIN_SCAN_FN)(CSOUND *, const char *, void *);
+
+/* call 'fn' with the full path of every plugin library in the */
+/* directory list 'dirs', returning the most serious error     */
+
+static int scan_plugin_dirs(CSOUND *csound, const char *dirs,
+                            PLUGIN_SCAN_FN fn, void *userdata)
+{
     DIR             *dir;
     struct dirent   *f;
-    const char      *dname, *fname;
+    const char      *fname;
     char            buf[1024];
     int             i, n, len, err = CSOUND_SUCCESS;
-    char   *dname1, *end;
-    int     read_directory = 1;
-    char sep =
+    char   *dlist, *dname1, *th;
+    char sep[2] =
 #ifdef WIN32
-    ';';
+    ";";
 #else
-    ':';
+    ":";
 #endif
 
-    if (UNLIKELY(csound->csmodule_db != NULL))
-      return CSOUND_ERROR;
-
-    /* open plugin directory */
-    dname = csoundGetEnv(csound, (sizeof(MYFLT) == sizeof(float) ?
-                                  plugindir_envvar : plugindir64_envvar));
-    if (dname == NULL) {
-#if ENABLE_OPCODEDIR_WARNINGS
-      csound->opcodedirWasOK = 0;
-#  ifdef USE_DOUBLE
-      dname = csoundGetEnv(csound, plugindir_envvar);
-      if (dname == NULL)
-#  endif
-#endif
-#ifdef  CS_DEFAULT_PLUGINDIR
-        dname = CS_DEFAULT_PLUGINDIR;
-#else
-      dname = "";
-#endif
-    }
-
     /* We now loop through the directory list */
-    while(read_directory) {
-      /* find separator */
-    if((end = strchr(dname, sep)) != NULL) {
-      *end = '\0';
-      /* copy directory name */
-      dname1 = cs_strdup(csound, (char *) dname);
-      /* move to next directory name */
-      dname = end + 1;
-    } else {
-      /* copy last directory name) */
-      dname1 = cs_strdup(csound, (char *) dname);
-      read_directory = 0;
-    }
-
-    /* protect for the case where there is an
-       extra separator at the end */
-    if(*dname1 == '\0') {
-      csound->Free(csound, dname1);
-      break;
-    }
-
+    dlist = cs_strdup(csound, (char*) dirs);
+    for (dname1 = cs_strtok_r(dlist, sep, &th); dname1 != NULL;
+         dname1 = cs_strtok_r(NULL, sep, &th)) {
     dir = opendir(dname1);
     if (UNLIKELY(dir == (DIR*) NULL)) {
       csound->Warning(csound, Str("Error opening plugin directory '%s': %s"),
                                dname1, strerror(errno));
-      csound->Free(csound, dname1);
       continue;
     }
 
     if(UNLIKELY(csound->oparms->odebug))
       csound->Message(csound, "Opening plugin directory: %s\n", dname1);
-    /* load database for deferred plugin loading */
-/*     n = csoundLoadOpcodeDB(csound, dname); */
-/*     if (n != 0) */
-/*       return n; */
     /* scan all files in directory */
     while ((f = readdir(dir)) != NULL) {
       fname = &(f->d_name[0]);
       if (UNLIKELY(fname[0]=='_')) continue;
       n = len = (int) strlen(fname);
-      if (UNLIKELY(fname[0]=='_')) continue;
 #if defined(WIN32)
       strcpy(buf, "dll");
       n -= 4;
@@ -494,8 +707,8 @@ int csoundLoadModules(CSOUND *csound)
       } while (buf[++i] != '\0');
       if (buf[i] != '\0')
         continue;
-      /* found a dynamic library, attempt to open it */
-      if (UNLIKELY(((int) strlen(dname) + len + 2) > 1024)) {
+      /* found a dynamic library */
+      if (UNLIKELY(((int) strlen(dname1) + len + 2) > 1024)) {
         csound->Warning(csound, Str("path name too long, skipping '%s'"),
                                 fname);
         continue;
@@ -506,18 +719,153 @@ int csoundLoadModules(CSOUND *csound)
         continue;
       }
       snprintf(buf, 1024, "%s%c%s", dname1, DIRSEP, fname);
-      if (UNLIKELY(csound->oparms->odebug)) {
-        csoundMessage(csound, Str("Loading '%s'\n"), buf);
-       }
-      n = csoundLoadExternal(csound, buf);
-      if (UNLIKELY(UNLIKELY(n == CSOUND_ERROR)))
-        continue;               /* ignore non-plugin files */
+      n = fn(csound, buf, userdata);
       if (UNLIKELY(n < err))
         err = n;                /* record serious errors */
     }
     closedir(dir);
-    csound->Free(csound, dname1);
     }
+    csound->Free(csound, dlist);
+    return err;
+}
+
+/* attempt to open a library found in the plugin directories */
+
+static int load_plugin_file(CSOUND *csound, const char *path, void *userdata)
+{
+    PLUGIN_MANIFEST *pm = (PLUGIN_MANIFEST*) userdata;
+    void            *prv = csound->csmodule_db;
+    int64_t         size, mtime;
+    int             n;
+
+    if (UNLIKELY(csound->oparms->odebug)) {
+      csoundMessage(csound, Str("Loading '%s'\n"), path);
+    }
+    n = csoundLoadExternal(csound, path);
+    if (pm != NULL && plugin_file_stat(path, &size, &mtime) == 0) {
+      PLUGIN_LIB  *lib;
+      lib = manifest_new_lib(csound, pm, path, size, mtime,
+                             (csound->csmodule_db != prv ?
+                              PLUGIN_EAGER : PLUGIN_SKIP));
+      lib->loaded = 1;
+      lib->module = (csound->csmodule_db != prv ? csound->csmodule_db : NULL);
+    }
+    if (UNLIKELY(n == CSOUND_ERROR))
+      return CSOUND_SUCCESS;    /* ignore non-plugin files */
+    return n;
+}
+
+/* compare a library found in the plugin directories with the manifest */
+
+static int check_plugin_file(CSOUND *csound, const char *path, void *userdata)
+{
+    PLUGIN_MANIFEST *pm = (PLUGIN_MANIFEST*) userdata;
+    PLUGIN_LIB      *lib;
+    int64_t         size, mtime;
+
+    (void) csound;
+    for (lib = pm->libs; lib != NULL; lib = lib->nxt)
+      if (strcmp(lib->path, path) == 0)
+        break;
+    if (lib == NULL || plugin_file_stat(path, &size, &mtime) != 0 ||
+        size != lib->size || mtime != lib->mtime)
+      pm->stale = 1;
+    else
+      lib->seen = 1;
+    return CSOUND_SUCCESS;
+}
+
+/* set up lazy loading from a valid manifest, returns non-zero if the */
+/* manifest does not describe the plugin directories any more         */
+
+static int load_plugins_lazy(CSOUND *csound, PLUGIN_MANIFEST *pm, int *err)
+{
+    PLUGIN_LIB  *lib;
+    int         n, nlazy = 0;
+
+    if (manifest_read(csound, pm) != 0)
+      return -1;
+    scan_plugin_dirs(csound, pm->dirs, check_plugin_file, (void*) pm);
+    for (lib = pm->libs; lib != NULL; lib = lib->nxt)
+      if (!lib->seen)
+        pm->stale = 1;
+    if (pm->stale)
+      return -1;
+    for (lib = pm->libs; lib != NULL; lib = lib->nxt) {
+      if (lib->mode == PLUGIN_LAZY) {
+        nlazy++;
+        continue;
+      }
+      lib->loaded = 1;
+      if (lib->mode == PLUGIN_EAGER) {
+        n = load_plugin_file(csound, lib->path, NULL);
+        if (UNLIKELY(n < *err))
+          *err = n;
+      }
+    }
+    if (UNLIKELY(csound->oparms->odebug))
+      csound->Message(csound, Str("Plugin manifest '%s': %d libraries "
+                                  "deferred\n"), pm->path, nlazy);
+    return 0;
+}
+
+#endif  /* HAVE_DIRENT_H */
+
+/**
+ * Load plugin libraries for Csound instance 'csound', and call
+ * pre-initialisation functions.
+ * Return value is CSOUND_SUCCESS if there was no error, CSOUND_ERROR if
+ * some modules could not be loaded or initialised, and CSOUND_MEMORY
+ * if a memory allocation failure has occured.
+ */
+int csoundLoadModules(CSOUND *csound)
+{
+#if (defined(HAVE_DIRENT_H) && (TARGET_OS_IPHONE == 0))
+    const char      *dname, *mname;
+    PLUGIN_MANIFEST *pm = NULL;
+    int             err = CSOUND_SUCCESS;
+
+    if (UNLIKELY(csound->csmodule_db != NULL))
+      return CSOUND_ERROR;
+
+    /* open plugin directory */
+    dname = csoundGetEnv(csound, (sizeof(MYFLT) == sizeof(float) ?
+                                  plugindir_envvar : plugindir64_envvar));
+    if (dname == NULL) {
+#if ENABLE_OPCODEDIR_WARNINGS
+      csound->opcodedirWasOK = 0;
+#  ifdef USE_DOUBLE
+      dname = csoundGetEnv(csound, plugindir_envvar);
+      if (dname == NULL)
+#  endif
+#endif
+#ifdef  CS_DEFAULT_PLUGINDIR
+        dname = CS_DEFAULT_PLUGINDIR;
+#else
+      dname = "";
+#endif
+    }
+
+    /* load database for deferred plugin loading */
+    mname = csoundGetEnv(csound, manifest_envvar);
+    if (mname != NULL && mname[0] != '\0' &&
+        csoundCreateGlobalVariable(csound, manifest_varname,
+                                   sizeof(PLUGIN_MANIFEST)) == CSOUND_SUCCESS) {
+      pm = get_manifest(csound);
+      pm->path = cs_strdup(csound, (char*) mname);
+      pm->dirs = cs_strdup(csound, (char*) dname);
+      manifest_clear(csound, pm);
+      if (load_plugins_lazy(csound, pm, &err) == 0)
+        return (err == CSOUND_INITIALIZATION ? CSOUND_ERROR : err);
+      if (UNLIKELY(csound->oparms->odebug))
+        csound->Message(csound, Str("Plugin manifest '%s' is missing or out "
+                                    "of date, loading all plugins\n"),
+                        pm->path);
+      manifest_clear(csound, pm);
+      pm->rebuild = 1;
+    }
+
+    err = scan_plugin_dirs(csound, dname, load_plugin_file, (void*) pm);
     return (err == CSOUND_INITIALIZATION ? CSOUND_ERROR : err);
 #else
     return CSOUND_SUCCESS;
@@ -627,6 +975,7 @@ static CS_NOINLINE int csoundInitModule(CSOUND *csound, csoundModule_t *m)
 int csoundInitModules(CSOUND *csound)
 {
     csoundModule_t  *m;
+    PLUGIN_MANIFEST *pm;
     int             i, retval = CSOUND_SUCCESS;
     /* For regular Csound, init_static_modules is not compiled or called.
      * For some builds of Csound, e.g. for PNaCl, init_static_modules is
@@ -636,12 +985,27 @@ int csoundInitModules(CSOUND *csound)
 #if defined(INIT_STATIC_MODULES)
     retval = init_static_modules(csound);
 #endif
+    pm = get_manifest(csound);
+    if (pm != NULL && !pm->rebuild)
+      pm = NULL;
     /* call init functions */
     for (m = (csoundModule_t*) csound->csmodule_db; m != NULL; m = m->nxt) {
+      if (pm != NULL) {
+        /* attribute the names registered by this module to its file */
+        for (pm->current = pm->libs; pm->current != NULL;
+             pm->current = pm->current->nxt)
+          if (pm->current->module == (void*) m)
+            break;
+      }
       i = csoundInitModule(csound, m);
       if (UNLIKELY(i != CSOUND_SUCCESS && i < retval))
         retval = i;
     }
+    if (pm != NULL) {
+      pm->current = NULL;
+      pm->rebuild = 0;
+      manifest_write(csound, pm);
+    }
     /* return with error code */
     return retval;
 }
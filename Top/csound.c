@@ -55,6 +55,9 @@
 #include "namedins.h"
 #include "pvfileio.h"
 #include "fftlib.h"
+#include "resample.h"
+#include "profile.h"
+#include "voices.h"
 #include "cs_par_base.h"
 #include "cs_par_orc_semantics.h"
 //#include "cs_par_dispatch.h"
@@ -233,6 +236,7 @@ static int csoundGetZaBounds(CSOUND *csound, MYFLT **zastart){
       return -1;
     }
     *zastart = zz->zastart;
+    zz->sparse = 0;             /* Raw access: written locations untracked */
     return zz->zalast;
 }
 
@@ -500,11 +504,14 @@ static const CSOUND cenviron_ = {
     csoundGetHostData,
     strNcpy,
     csoundGetZaBounds,
+    csoundResampleSetup,
+    csoundResample,
+    csoundResampleDestroy,
+    csoundArrayReserve,
     {
       NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
       NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
-      NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
-      NULL, NULL, NULL, NULL
+      NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL
     },
     /* ------- private data (not to be used by hosts or externals) ------- */
     /* callback function pointers */
@@ -566,6 +573,8 @@ static const CSOUND cenviron_ = {
         0,
         0,
         FL(0.0),
+        0, FL(0.0), 0, 0,
+        0, FL(0.0), FL(0.0), FL(0.0), NULL,
         NULL,
         NULL,
         0,
@@ -699,6 +708,8 @@ static const CSOUND cenviron_ = {
    0,
    0,
    0,
+   0, 0, FL(0.0), FL(0.0), FL(0.0),
+   0, 0, NULL,
     FL(0.0),
     NULL,
     NULL,
@@ -907,7 +918,8 @@ static const CSOUND cenviron_ = {
       0.4,          /*    vbr quality  */
       0,            /*    ksmps_override */
       0,             /*    fft_lib */
-      0
+      0,            /*    echo */
+      0             /*    inlineUdos */
     },
 
     {0, 0, {0}}, /* REMOT_BUF */
@@ -978,7 +990,20 @@ static const CSOUND cenviron_ = {
     NULL,           /* message_string */
     0,              /* message_string_queue_items */
     0,              /* message_string_queue_wp */
-    NULL            /* message_string_queue */
+    NULL,           /* message_string_queue */
+    0,              /* perf_array_allocs */
+    NULL,           /* alloc_queue_cond */
+    NULL,           /* alloc_queue_mutex */
+    0,              /* alloc_queue_sleeping */
+    0,              /* init_latency_count */
+    0.0, 0.0,       /* init_latency_total, init_latency_max */
+    0,              /* profiling */
+    NULL,           /* profiler */
+    NULL,           /* profile_json */
+    0,              /* timing */
+    NULL,           /* timer */
+    NULL,           /* voices */
+    SPINLOCK_INIT   /* auxcache_spinlock */
     /*, NULL */           /* self-reference */
 };
 
@@ -1519,16 +1544,18 @@ inline static int nodePerf(CSOUND *csound, int index, int numThreads)
 #else
         done = insds->init_done;
 #endif
-        if (done) {
+        if (done && !CS_VOICE_ASLEEP(csound, insds)) {
+          uint64_t prof_start =
+            UNLIKELY(csound->profiling) ? csoundProfileTicks() : 0;
           opstart = (OPDS*)task_map[which_task];
           if (insds->ksmps == csound->ksmps) {
             insds->spin = csound->spin;
-            insds->spout = csound->spraw;
+            insds->spout = CS_VOICE_SPOUT(csound, insds, index);
             insds->kcounter =  csound->kcounter;
             while ((opstart = opstart->nxtp) != NULL) {
               /* In case of jumping need this repeat of opstart */
               opstart->insdshead->pds = opstart;
-              (*opstart->opadr)(csound, opstart); /* run each opcode */
+              CS_PERF_OPCODE(csound, opstart, index); /* run each opcode */
               opstart = opstart->insdshead->pds;
             }
           } else {
@@ -1539,7 +1566,7 @@ inline static int nodePerf(CSOUND *csound, int index, int numThreads)
             int early = insds->ksmps_no_end;
             OPDS  *opstart;
             insds->spin = csound->spin;
-            insds->spout = csound->spraw;
+            insds->spout = CS_VOICE_SPOUT(csound, insds, index);
             insds->kcounter =  csound->kcounter*csound->ksmps;
 
             /* we have to deal with sample-accurate code
@@ -1560,12 +1587,15 @@ inline static int nodePerf(CSOUND *csound, int index, int numThreads)
               opstart = (OPDS*) insds;
               while ((opstart = opstart->nxtp) != NULL) {
                 opstart->insdshead->pds = opstart;
-                (*opstart->opadr)(csound, opstart); /* run each opcode */
+                CS_PERF_OPCODE(csound, opstart, index); /* run each opcode */
                 opstart = opstart->insdshead->pds;
               }
               insds->kcounter++;
             }
           }
+          CS_VOICE_MIX(csound, insds, index);
+          if (UNLIKELY(prof_start != 0))
+            csoundProfileInstr(csound, insds, index, prof_start);
           insds->ksmps_offset = 0; /* reset sample-accuracy offset */
           insds->ksmps_no_end = 0;  /* reset end of loop samples */
           played_count++;
@@ -1647,6 +1677,7 @@ unsigned long kperfThread(void * cs)
 int kperf_nodebug(CSOUND *csound)
 {
     INSDS *ip;
+    double vstart = 0.0;
     /* update orchestra time */
     csound->kcounter = ++(csound->global_kcounter);
     csound->icurTime += csound->ksmps;
@@ -1654,6 +1685,7 @@ int kperf_nodebug(CSOUND *csound)
 
    /* call message_dequeue to run API calls */
     message_dequeue(csound);
+    CS_TIMING_MARK(csound, CS_MARK_MESSAGES);
 
 
     /* if skipping time on request by 'a' score statement: */
@@ -1664,6 +1696,8 @@ int kperf_nodebug(CSOUND *csound)
     /* if i-time only, return now */
     if (UNLIKELY(csound->initonly))
       return 1;
+    if (UNLIKELY(csound->profiling))
+      csoundProfileKcycle(csound);
     /* PC GUI needs attention, but avoid excessively frequent */
     /* calls of csoundYield() */
     if (UNLIKELY(--(csound->evt_poll_cnt) < 0)) {
@@ -1678,6 +1712,8 @@ int kperf_nodebug(CSOUND *csound)
     /* clear spout */
     memset(csound->spout, 0, csound->nspout*sizeof(MYFLT));
     memset(csound->spraw, 0, csound->nspout*sizeof(MYFLT));
+    if (UNLIKELY(csound->voices != NULL))
+      vstart = csoundTimingNow();
     ip = csound->actanchor.nxtact;
 
     if (ip != NULL) {
@@ -1686,6 +1722,7 @@ int kperf_nodebug(CSOUND *csound)
       if (csound->multiThreadedThreadInfo != NULL) {
         if (csound->dag_changed) dag_build(csound, ip);
         else dag_reinit(csound);     /* set to initial state */
+        CS_TIMING_MARK(csound, CS_MARK_DAG);
 
         /* process this partition */
         csound->WaitBarrier(csound->barrier1);
@@ -1712,18 +1749,21 @@ int kperf_nodebug(CSOUND *csound)
             ip->ksmps_no_end = ip->no_end;
           }
           done = ATOMIC_GET(ip->init_done);
-          if (done == 1) {/* if init-pass has been done */
+          if (done == 1 &&        /* if init-pass has been done */
+              !CS_VOICE_ASLEEP(csound, ip)) {
             int error = 0;
             OPDS  *opstart = (OPDS*) ip;
+            uint64_t prof_start =
+              UNLIKELY(csound->profiling) ? csoundProfileTicks() : 0;
             ip->spin = csound->spin;
-            ip->spout = csound->spraw;
+            ip->spout = CS_VOICE_SPOUT(csound, ip, 0);
             ip->kcounter =  csound->kcounter;
             if (ip->ksmps == csound->ksmps) {
               while (error == 0 &&
                      (opstart = opstart->nxtp) != NULL &&
                      ip->actflg) {
                 opstart->insdshead->pds = opstart;
-                error = (*opstart->opadr)(csound, opstart); /* run each opcode */
+                error = CS_PERF_OPCODE(csound, opstart, 0); /* run each opcode */
                 opstart = opstart->insdshead->pds;
               }
             } else {
@@ -1735,7 +1775,7 @@ int kperf_nodebug(CSOUND *csound)
                 int early = ip->ksmps_no_end;
                 OPDS  *opstart;
                 ip->spin = csound->spin;
-                ip->spout = csound->spraw;
+                ip->spout = CS_VOICE_SPOUT(csound, ip, 0);
                 ip->kcounter =  csound->kcounter*csound->ksmps/lksmps;
 
                 /* we have to deal with sample-accurate code
@@ -1757,12 +1797,15 @@ int kperf_nodebug(CSOUND *csound)
                   while (error ==  0 && (opstart = opstart->nxtp) != NULL
                          && ip->actflg) {
                     opstart->insdshead->pds = opstart;
-                    error = (*opstart->opadr)(csound, opstart); /* run each opcode */
+                    error = CS_PERF_OPCODE(csound, opstart, 0); /* run each opcode */
                     opstart = opstart->insdshead->pds;
                   }
                   ip->kcounter++;
                 }
             }
+            CS_VOICE_MIX(csound, ip, 0);
+            if (UNLIKELY(prof_start != 0))
+              csoundProfileInstr(csound, ip, 0, prof_start);
           }
           /*else csound->Message(csound, "time %f\n",
                                  csound->kcounter/csound->ekr);*/
@@ -1773,12 +1816,16 @@ int kperf_nodebug(CSOUND *csound)
       }
     }
 
+    if (UNLIKELY(vstart != 0.0))
+      csoundVoiceKcycle(csound, csoundTimingNow() - vstart);
+    CS_TIMING_MARK(csound, CS_MARK_PERF);
     if (!csound->spoutactive) { /* results now in spout? */
       memset(csound->spout, 0, csound->nspout * sizeof(MYFLT));
       memset(csound->spraw, 0, csound->nspout * sizeof(MYFLT));
     }
     make_interleave(csound);
     csound->spoutran(csound); /* send to audio_out */
+    CS_TIMING_MARK(csound, CS_MARK_SPOUTRAN);
     //#ifdef ANDROID
     //struct timespec ts;
     //clock_gettime(CLOCK_MONOTONIC, &ts);
@@ -2121,7 +2168,9 @@ PUBLIC int csoundPerformKsmps(CSOUND *csound)
     if(!csound->oparms->realtime) // no API lock in realtime mode
       csoundLockMutex(csound->API_lock);
     do {
+      CS_TIMING_MARK(csound, CS_MARK_START);
       done = sensevents(csound);
+      CS_TIMING_MARK(csound, CS_MARK_SENSEVENTS);
       if (UNLIKELY(done)) {
         if(!csound->oparms->realtime) // no API lock in realtime mode
          csoundUnlockMutex(csound->API_lock);
@@ -2156,7 +2205,10 @@ static int csoundPerformKsmpsInternal(CSOUND *csound)
       return ((returnValue - CSOUND_EXITJMP_SUCCESS) | CSOUND_EXITJMP_SUCCESS);
     }
    do {
-     if (UNLIKELY((done = sensevents(csound)))) {
+     CS_TIMING_MARK(csound, CS_MARK_START);
+     done = sensevents(csound);
+     CS_TIMING_MARK(csound, CS_MARK_SENSEVENTS);
+     if (UNLIKELY(done)) {
        csoundMessage(csound,
                      Str("Score finished in csoundPerformKsmpsInternal().\n"));
         return done;
@@ -2170,6 +2222,7 @@ PUBLIC int csoundPerformBuffer(CSOUND *csound)
 {
     int returnValue;
     int done;
+    double start;
     /* VL: 1.1.13 if not compiled (csoundStart() not called)  */
     if (UNLIKELY(!(csound->engineStatus & CS_STATE_COMP))) {
       csound->Warning(csound,
@@ -2184,13 +2237,17 @@ PUBLIC int csoundPerformBuffer(CSOUND *csound)
 #endif
       return ((returnValue - CSOUND_EXITJMP_SUCCESS) | CSOUND_EXITJMP_SUCCESS);
     }
+    start = UNLIKELY(csound->timing) ? csoundTimingNow() : 0.0;
     csound->sampsNeeded += csound->oparms_.outbufsamps;
     while (csound->sampsNeeded > 0) {
      if(!csound->oparms->realtime) {// no API lock in realtime mode
       csoundLockMutex(csound->API_lock);
      }
       do {
-        if (UNLIKELY((done = sensevents(csound)))){
+        CS_TIMING_MARK(csound, CS_MARK_START);
+        done = sensevents(csound);
+        CS_TIMING_MARK(csound, CS_MARK_SENSEVENTS);
+        if (UNLIKELY(done)){
           if(!csound->oparms->realtime) // no API lock in realtime mode
             csoundUnlockMutex(csound->API_lock);
           return done;
@@ -2201,6 +2258,8 @@ PUBLIC int csoundPerformBuffer(CSOUND *csound)
       }
       csound->sampsNeeded -= csound->nspout;
     }
+    if (UNLIKELY(csound->timing && start > 0.0))
+      csoundTimingBuffer(csound, start);
     return 0;
 }
 
@@ -2231,7 +2290,10 @@ PUBLIC int csoundPerform(CSOUND *csound)
         if(!csound->oparms->realtime)
            csoundLockMutex(csound->API_lock);
       do {
-        if (UNLIKELY((done = sensevents(csound)))) {
+        CS_TIMING_MARK(csound, CS_MARK_START);
+        done = sensevents(csound);
+        CS_TIMING_MARK(csound, CS_MARK_SENSEVENTS);
+        if (UNLIKELY(done)) {
           csoundMessage(csound, Str("Score finished in csoundPerform().\n"));
           if(!csound->oparms->realtime)
           csoundUnlockMutex(csound->API_lock);
@@ -2270,6 +2332,19 @@ PUBLIC int64_t csoundGetCurrentTimeSamples(CSOUND *csound){
   return csound->icurTime;
 }
 
+PUBLIC long csoundGetArrayReallocations(CSOUND *csound){
+  return csound->perf_array_allocs;
+}
+
+PUBLIC long csoundGetInitLatency(CSOUND *csound, double *mean, double *max){
+  long n = csound->init_latency_count;
+  if (mean != NULL)
+    *mean = n > 0 ? csound->init_latency_total / n : 0.0;
+  if (max != NULL)
+    *max = csound->init_latency_max;
+  return n;
+}
+
 PUBLIC MYFLT csoundGetSr(CSOUND *csound)
 {
     return csound->esr;
@@ -3084,6 +3159,7 @@ static CS_NOINLINE int opcode_list_new_oentry(CSOUND *csound,
       return CSOUND_ERROR;
 
     shortName = get_opcode_short_name(csound, ep->opname);
+    csoundPluginManifestRecord(csound, shortName, 0);
 
     head = cs_hash_table_get(csound, csound->opcodes, shortName);
     entryCopy = csound->Malloc(csound, sizeof(OENTRY));
@@ -3239,6 +3315,7 @@ static void reset(CSOUND *csound)
     /* delete temporary files created by this Csound instance */
     remove_tmpfiles(csound);
     rlsmemfiles(csound);
+    rlspvxmemfiles(csound);
 
      while (csound->filedir[n])        /* Clear source directory */
        csound->Free(csound,csound->filedir[n++]);
@@ -556,6 +556,14 @@ PUBLIC void csoundCondSignal(void* condVar) {
         pthread_cond_signal(condVar);
 }
 
+PUBLIC void csoundDestroyCondVar(void* condVar)
+{
+  if (condVar != NULL) {
+    pthread_cond_destroy((pthread_cond_t*) condVar);
+    free(condVar);
+  }
+}
+
 /* ------------------------------------------------------------------------ */
 
 #elif defined(WIN32)
@@ -781,6 +789,11 @@ PUBLIC void csoundCondSignal(void* condVar) {
     WakeConditionVariable(cv);
 }
 
+/* Windows condition variables need no cleanup */
+PUBLIC void csoundDestroyCondVar(void* condVar) {
+    free(condVar);
+}
+
 // REMOVE FOLLOWING BARRIER DEFINITION WINDOWS SUPPORT LIMITED to WIN 8.1+
 typedef struct barrier {
     CRITICAL_SECTION* mut;
@@ -813,7 +826,7 @@ PUBLIC void *csoundCreateBarrier(unsigned int max)
 PUBLIC int csoundDestroyBarrier(void *barrier)
 {
     win_barrier_t *winb = (win_barrier_t*)barrier;
-    free(winb->cond);
+    csoundDestroyCondVar(winb->cond);
     csoundDestroyMutex(winb->mut);
     free(winb);
     return 0;
@@ -960,6 +973,10 @@ PUBLIC void csoundCondSignal(void* condVar) {
  // notImplementedWarning_("csoundCreateCondSignal");
 }
 
+PUBLIC void csoundDestroyCondVar(void* condVar) {
+  //notImplementedWarning_("csoundDestroyCondVar");
+}
+
 PUBLIC long csoundRunCommand(const char * const *argv, int noWait) {
   //notImplementedWarning_("csoundRunCommand");
     return 0;
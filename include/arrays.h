@@ -34,14 +34,8 @@ static inline void tabensure(CSOUND *csound, ARRAYDAT *p, int size)
         p->arrayMemberSize = var->memBlockSize;
       }
       ss = p->arrayMemberSize*size;
-      if (p->data==NULL) {
-        p->data = (MYFLT*)csound->Calloc(csound, ss);
-        p->allocated = ss;
-      }
-      else if (ss > p->allocated) {
-        p->data = (MYFLT*) csound->ReAlloc(csound, p->data, ss);
-        p->allocated = ss;
-      }
+      if (p->data==NULL || ss > p->allocated)
+        csound->ArrayReserve(csound, p, ss);
       if (p->dimensions==0) {
         p->dimensions = 1;
         p->sizes = (int32_t*)csound->Malloc(csound, sizeof(int32_t));
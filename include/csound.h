@@ -661,6 +661,41 @@ extern "C" {
                                     void *channelValuePtr,
                                     const void *channelType);
 
+#define CS_TIMING_BINS  (40)    /* load histogram bins, 5% each */
+#define CS_TIMING_RING  (32)    /* late k-cycles kept */
+
+  /**
+   * Real-time render timing, filled in by csoundGetTiming().
+   * All times are in seconds. The load of a k-cycle is its render
+   * time divided by ksmps/sr, the time it has before its output is due.
+   */
+  typedef struct {
+    uint64_t kcycles;           /* k-cycles timed */
+    uint64_t overruns;          /* k-cycles with a load above 1 */
+    double   deadline;          /* ksmps/sr */
+    double   last, mean, max;   /* render time of a k-cycle */
+    /* mean time per k-cycle spent reading score and line events, running
+       queued API calls, building the thread DAG (with -j), performing
+       instruments and writing the output */
+    double   sensevents, messages, dag, perf, spoutran;
+    uint64_t buffers;           /* csoundPerformBuffer() calls timed */
+    uint64_t buffer_overruns;
+    double   buffer_last, buffer_max;
+    /* k-cycles by load: bin i counts loads from i/20 up to (i+1)/20,
+       the last bin everything above */
+    uint64_t histogram[CS_TIMING_BINS];
+  } CS_TIMING_INFO;
+
+  /**
+   * A k-cycle whose load went above the warning level, as returned by
+   * csoundGetTimingEvents().
+   */
+  typedef struct {
+    uint64_t kcycle;            /* k-cycle number since the start */
+    double   total;
+    double   sensevents, messages, dag, perf, spoutran;
+  } CS_TIMING_EVENT;
+
 #ifndef CSOUND_CSDL_H
 
   /** @defgroup INSTANTIATION Instantiation
@@ -1015,6 +1050,65 @@ extern "C" {
    */
   PUBLIC int64_t csoundGetCurrentTimeSamples(CSOUND *csound);
 
+  /**
+   * Return the number of times array storage had to be allocated or
+   * grown during performance rather than at init time. A non-zero
+   * count means some array opcode is not real-time safe; sizing the
+   * array at init or reserving capacity with reservearray avoids it.
+   */
+  PUBLIC long csoundGetArrayReallocations(CSOUND *csound);
+
+  /**
+   * In --realtime mode, return the number of notes started so far by
+   * the event insertion thread, and set *mean and *max (either may be
+   * NULL) to the time in seconds from a note being queued to the end
+   * of its init pass.
+   */
+  PUBLIC long csoundGetInitLatency(CSOUND *csound, double *mean, double *max);
+
+  /**
+   * Switch the opcode profiler on (non-zero) or off. While it is on,
+   * the time spent in every opcode perf function and in each
+   * instrument's perf chain is counted; switching it off and on again
+   * keeps counting into the same totals. Also enabled by --profile.
+   */
+  PUBLIC void csoundSetProfiling(CSOUND *csound, int enable);
+
+  /**
+   * Report the profiler totals per instrument, per opcode and per
+   * source line. With path NULL the report is printed as messages,
+   * otherwise it is written to path as JSON. Returns CSOUND_ERROR if
+   * nothing has been profiled or the file cannot be written.
+   */
+  PUBLIC int csoundWriteProfile(CSOUND *csound, const char *path);
+
+  /**
+   * Switch k-cycle timing on (non-zero) or off. Switching it on clears
+   * the totals. k-cycles whose load (render time over ksmps/sr) goes
+   * above 'warn' are kept for csoundGetTimingEvents(); warn <= 0 means
+   * 0.8. If 'period' is above zero a summary is printed every 'period'
+   * seconds of rendered audio. Also enabled by --timing[=period].
+   */
+  PUBLIC void csoundSetTiming(CSOUND *csound, int enable,
+                              double warn, double period);
+
+  /**
+   * Copy the k-cycle timing totals into *info. This does not block the
+   * performance thread and may be called from any thread; fields are
+   * read one at a time, so a k-cycle finishing meanwhile may be counted
+   * in some and not others. Returns CSOUND_ERROR if timing was never
+   * switched on.
+   */
+  PUBLIC int csoundGetTiming(CSOUND *csound, CS_TIMING_INFO *info);
+
+  /**
+   * Copy up to 'max' of the most recent late k-cycles, newest first,
+   * into 'events' and return how many were copied. Like
+   * csoundGetTiming() this never blocks the performance thread.
+   */
+  PUBLIC int csoundGetTimingEvents(CSOUND *csound, CS_TIMING_EVENT *events,
+                                   int max);
+
   /**
    * Return the size of MYFLT in bytes.
    */
@@ -2243,6 +2337,9 @@ extern "C" {
   /** Signals a conditional variable */
   PUBLIC void csoundCondSignal(void* condVar);
 
+  /** Destroys a conditional variable created with csoundCreateCondVar() */
+  PUBLIC void csoundDestroyCondVar(void* condVar);
+
   /**
    * Waits for at least the specified number of milliseconds,
    * yielding the CPU to other threads.
@@ -262,6 +262,7 @@ typedef struct CORFIL {
     int     ksmps_override;
     int     fft_lib;
     int     echo;
+    int     inlineUdos;     /* inline simple UDO calls into their callers */
   } OPARMS;
 
   typedef struct arglst {
@@ -309,6 +310,7 @@ typedef struct CORFIL {
     unsigned        int outArgCount;
     char            intype;         /* Type of first input argument (g,k,a,w etc) */
     char            pftype;         /* Type of output argument (k,a etc) */
+    int             profslot;       /* Profiler counter slot (profile.c) */
   } TEXT;
 
 
@@ -340,11 +342,20 @@ typedef struct CORFIL {
     int     pending_release;        /* To count instruments in release phase */
     int     maxalloc;
     MYFLT   cpuload;                /* % load this instrumemnt makes */
+    int     vsteal;                 /* voice stealing policy (voices.c) */
+    MYFLT   vrelease;               /* fade time of stolen voices */
+    int     vpriority;              /* load shedding priority */
+    int     vfading;                /* stolen or shed voices fading out */
+    int     vsleep;                 /* sleep or turn off silent voices */
+    MYFLT   vsleepthr, vwakethr;    /* silence and wake levels */
+    MYFLT   vsleeptime;             /* silence to wait for, in seconds */
+    void    *vwatch;                /* globals that wake a sleeping voice */
     struct opcodinfo *opcode_info;  /* UDO info (when instrs are UDOs) */
     char    *insname;               /* instrument name */
     int     instcnt;                /* Count number of instances ever */
     int     isNew;                  /* is this a new definition */
     int     nocheckpcnt;            /* Control checks on pcnt */
+    void    *auxcache;              /* AUXCH blocks for reuse (auxfd.c) */
   } INSTRTXT;
 
   typedef struct namedInstr {
@@ -569,6 +580,13 @@ typedef struct CORFIL {
     int      init_done;
     int      tieflag;
     int      reinitflag;
+    int      vflags;       /* voice management state (voices.c) */
+    int64_t  vstart;       /* icurTime at note start */
+    MYFLT    vgain, vstep; /* fade gain of a stolen voice, per-sample step */
+    MYFLT    vlevel;       /* output peak in the last k-cycle */
+    int      vsilent;      /* silent k-cycles, -1 until first heard */
+    int      vsleep;       /* asleep, or waiting to be turned off */
+    MYFLT   *vwatch;       /* k-rate globals when it went to sleep */
     MYFLT    retval;
     MYFLT   *lclbas;  /* base for variable memory pool */
     char    *strarg;       /* string argument */
@@ -975,6 +993,8 @@ typedef struct _alloc_data_ {
   MEVENT mep;
   INSDS *ip;
   OPDS *ids;
+  volatile int ready;     /* slot filled in, see alloc_queue_publish() */
+  double qtime;           /* real time it was queued */
 } ALLOC_DATA;
 
 #define MAX_MESSAGE_STR 1024
@@ -1373,12 +1393,18 @@ typedef struct _message_queue_t_ {
     void *(*GetHostData)(CSOUND *);
     char *(*strNcpy)(char *dst, const char *src, size_t siz);
     int (*GetZaBounds)(CSOUND *, MYFLT **);
+    void *(*ResampleSetup)(CSOUND *, MYFLT inrate, MYFLT outrate,
+                           int32_t chans, int32_t quality);
+    int32_t (*Resample)(CSOUND *, void *p, const MYFLT *in, int32_t inframes,
+                        MYFLT *out, int32_t maxout);
+    void (*ResampleDestroy)(CSOUND *, void *p);
+    MYFLT *(*ArrayReserve)(CSOUND *, ARRAYDAT *, size_t bytes);
 
        /**@}*/
     /** @name Placeholders
         To allow the API to grow while maintining backward binary compatibility. */
     /**@{ */
-    SUBR dummyfn_2[36];
+    SUBR dummyfn_2[32];
     /**@}*/
 #ifdef __BUILDING_LIBCSOUND
     /* ------- private data (not to be used by hosts or externals) ------- */
@@ -1795,6 +1821,19 @@ typedef struct _message_queue_t_ {
     volatile unsigned long message_string_queue_items;
     unsigned long message_string_queue_wp;
     message_string_queue_t *message_string_queue;
+    long          perf_array_allocs; /* arrays grown outside an init pass */
+    void          *alloc_queue_cond;  /* event_insert_thread sleeps on this */
+    void          *alloc_queue_mutex;
+    volatile int  alloc_queue_sleeping;
+    long          init_latency_count; /* realtime mode note start times */
+    double        init_latency_total, init_latency_max;
+    int           profiling;          /* time opcodes in kperf */
+    void          *profiler;          /* profile.c counters */
+    char          *profile_json;      /* --profile=FNAME */
+    int           timing;             /* time the stages of each k-cycle */
+    void          *timer;             /* profile.c k-cycle timing totals */
+    void          *voices;            /* voices.c stealing and shedding */
+    spin_lock_t   auxcache_spinlock;  /* auxfd.c creating instrument caches */
     /*struct CSOUND_ **self;*/
     /**@}*/
 #endif  /* __BUILDING_LIBCSOUND */
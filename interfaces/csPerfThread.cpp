@@ -23,6 +23,13 @@
 
 #include <iostream>
 #include <exception>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
 
 #include "csound.hpp"
 #include "csPerfThread.hpp"
@@ -30,11 +37,67 @@
 
 // ----------------------------------------------------------------------------
 
+/**
+ * Link field of queued messages.
+ */
+
+struct CsPerfThreadNode {
+    std::atomic<CsPerfThreadNode*> nxt;
+    CsPerfThreadNode() : nxt((CsPerfThreadNode*) 0) {}
+};
+
+/**
+ * Intrusive FIFO that any number of threads may push to without locking,
+ * and one thread at a time pops from (D. Vyukov's MPSC queue). Push() is
+ * a single atomic exchange, so it is safe on the performance thread; Pop()
+ * may return null while a push is half done, the pushing thread then
+ * completes it a moment later.
+ */
+
+class CsPerfThreadFifo {
+ private:
+    std::atomic<CsPerfThreadNode*> head;
+    CsPerfThreadNode *tail;
+    CsPerfThreadNode stub;
+ public:
+    CsPerfThreadFifo() : head(&stub), tail(&stub) {}
+    void Push(CsPerfThreadNode *n)
+    {
+      n->nxt.store((CsPerfThreadNode*) 0, std::memory_order_relaxed);
+      CsPerfThreadNode *prv = head.exchange(n, std::memory_order_acq_rel);
+      prv->nxt.store(n, std::memory_order_release);
+    }
+    CsPerfThreadNode *Pop()
+    {
+      CsPerfThreadNode *t = tail;
+      CsPerfThreadNode *n = t->nxt.load(std::memory_order_acquire);
+      if (t == &stub) {
+        if (!n)
+          return (CsPerfThreadNode*) 0;
+        tail = t = n;
+        n = n->nxt.load(std::memory_order_acquire);
+      }
+      if (n) {
+        tail = n;
+        return t;
+      }
+      if (t != head.load(std::memory_order_acquire))
+        return (CsPerfThreadNode*) 0;
+      Push(&stub);
+      n = t->nxt.load(std::memory_order_acquire);
+      if (n) {
+        tail = n;
+        return t;
+      }
+      return (CsPerfThreadNode*) 0;
+    }
+};
+
 /**
  * Base class for event messages.
  */
 
-class CsoundPerformanceThreadMessage {
+class CsoundPerformanceThreadMessage : public CsPerfThreadNode {
  protected:
     CsoundPerformanceThread *pt_;
     void SetPaused(int state)
@@ -57,6 +120,10 @@ class CsoundPerformanceThreadMessage {
     {
         csoundUnlockMutex(pt_->recordLock);
     }
+    CsPerfThreadQueue *Queue()
+    {
+      return pt_->msgQueue;
+    }
 
     void QueueMessage(CsoundPerformanceThreadMessage *msg)
     {
@@ -64,16 +131,158 @@ class CsoundPerformanceThreadMessage {
     }
 
  public:
-    CsoundPerformanceThreadMessage *nxt;
+    std::chrono::steady_clock::time_point queued;
     virtual int run() = 0;
     CsoundPerformanceThreadMessage(CsoundPerformanceThread *pt)
     {
       pt_ = pt;
-      nxt = (CsoundPerformanceThreadMessage*) 0;
     }
     virtual ~CsoundPerformanceThreadMessage() {}
 };
 
+/**
+ * Storage for one message. Messages are constructed in place in slots
+ * taken from a pool, and the performance thread hands them back through
+ * a second FIFO once run, so that neither allocation nor destruction
+ * (which may free memory) happens on the audio thread.
+ */
+
+#define CSPT_SLOT_SIZE  512
+#define CSPT_POOL_CHUNK 64
+
+union CsPerfThreadSlot {
+    CsPerfThreadSlot  *next;
+    double            align_;
+    char              data[CSPT_SLOT_SIZE];
+};
+
+class CsPerfThreadQueue {
+ private:
+    void              *poolLock;      // guards the free list (non-RT only)
+    CsPerfThreadSlot  *freeSlots;
+    std::vector<CsPerfThreadSlot*> chunks;
+    int               poolSize, poolFree;
+    CsPerfThreadFifo  retired;        // run messages waiting for recycling
+    void Grow()
+    {
+      CsPerfThreadSlot *c = new CsPerfThreadSlot[CSPT_POOL_CHUNK];
+      chunks.push_back(c);
+      for (int i = 0; i < CSPT_POOL_CHUNK; i++) {
+        c[i].next = freeSlots;
+        freeSlots = &c[i];
+      }
+      poolSize += CSPT_POOL_CHUNK;
+      poolFree += CSPT_POOL_CHUNK;
+    }
+    void Release(CsoundPerformanceThreadMessage *msg)
+    {
+      CsPerfThreadSlot *slot =
+        reinterpret_cast<CsPerfThreadSlot*>(dynamic_cast<void*>(msg));
+      msg->~CsoundPerformanceThreadMessage();
+      slot->next = freeSlots;
+      freeSlots = slot;
+      poolFree++;
+    }
+    // destroy messages returned by the performance thread
+    void ReclaimLocked()
+    {
+      CsPerfThreadNode *n;
+      while ((n = retired.Pop()) != (CsPerfThreadNode*) 0)
+        Release(static_cast<CsoundPerformanceThreadMessage*>(n));
+    }
+ public:
+    CsPerfThreadFifo  pending;        // messages not yet run
+    // statistics, the counters are only written by one side each
+    std::atomic<unsigned long long> nQueued, nProcessed;
+    std::atomic<unsigned long long> nTimed;     // run since ResetStats()
+    std::atomic<int>        maxDepth;
+    std::atomic<long long>  lastLatency, maxLatency, sumLatency; // in ns
+    // FlushMessageQueue() waits on flushCond; the performance thread only
+    // takes flushMutex to wake it when someone is waiting
+    std::mutex              flushMutex;
+    std::condition_variable flushCond;
+    std::atomic<int>        flushWaiters;
+    CsPerfThreadQueue() : poolLock((void*) 0), freeSlots((CsPerfThreadSlot*) 0),
+                          poolSize(0), poolFree(0),
+                          nQueued(0), nProcessed(0), nTimed(0), maxDepth(0),
+                          lastLatency(0), maxLatency(0), sumLatency(0),
+                          flushWaiters(0)
+    {
+      poolLock = csoundCreateMutex(0);
+      Grow();
+    }
+    ~CsPerfThreadQueue()
+    {
+      Reclaim();
+      for (size_t i = 0; i < chunks.size(); i++)
+        delete[] chunks[i];
+      if (poolLock)
+        csoundDestroyMutex(poolLock);
+    }
+    void *Alloc()
+    {
+      CsPerfThreadSlot *slot;
+      csoundLockMutex(poolLock);
+      ReclaimLocked();
+      if (!freeSlots)
+        Grow();
+      slot = freeSlots;
+      freeSlots = slot->next;
+      poolFree--;
+      csoundUnlockMutex(poolLock);
+      return (void*) slot;
+    }
+    // called on the performance thread only
+    void Retire(CsoundPerformanceThreadMessage *msg)
+    {
+      retired.Push(msg);
+    }
+    void Recycle(CsoundPerformanceThreadMessage *msg)
+    {
+      csoundLockMutex(poolLock);
+      Release(msg);
+      csoundUnlockMutex(poolLock);
+    }
+    void Reclaim()
+    {
+      csoundLockMutex(poolLock);
+      ReclaimLocked();
+      csoundUnlockMutex(poolLock);
+    }
+    // called on the performance thread after running messages
+    void WakeFlush()
+    {
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (flushWaiters.load(std::memory_order_relaxed) > 0) {
+        std::lock_guard<std::mutex> lk(flushMutex);
+        flushCond.notify_all();
+      }
+    }
+    void GetPoolStats(int *size, int *nfree)
+    {
+      csoundLockMutex(poolLock);
+      ReclaimLocked();
+      *size = poolSize;
+      *nfree = poolFree;
+      csoundUnlockMutex(poolLock);
+    }
+};
+
+/**
+ * Construct a message of type T in a pool slot.
+ */
+
+template <typename T, typename... A>
+static T *newMessage(CsPerfThreadQueue *q, CsoundPerformanceThread *pt,
+                     A&&... args)
+{
+    static_assert(sizeof(T) <= sizeof(CsPerfThreadSlot),
+                  "message does not fit in a pool slot");
+    if (!q)
+      return (T*) 0;
+    return new (q->Alloc()) T(pt, std::forward<A>(args)...);
+}
+
 /**
  * Unpause performance
  */
@@ -262,7 +471,7 @@ class CsPerfThreadMsg_Stop : public CsoundPerformanceThreadMessage {
     : CsoundPerformanceThreadMessage(pt)
     {
       CsoundPerformanceThreadMessage::QueueMessage(
-                                         new CsPerfThreadMsg_StopRecord(pt));
+          newMessage<CsPerfThreadMsg_StopRecord>(Queue(), pt));
     }
     int run()
     {
@@ -287,7 +496,7 @@ class CsPerfThreadMsg_ScoreEvent : public CsoundPerformanceThreadMessage {
     int     absp2mode;
     int     pcnt;
     MYFLT   *pp;
-    MYFLT   p[10];
+    MYFLT   p[40];
  public:
     CsPerfThreadMsg_ScoreEvent(CsoundPerformanceThread *pt,
                                int absp2mode, char opcod,
@@ -297,15 +506,16 @@ class CsPerfThreadMsg_ScoreEvent : public CsoundPerformanceThreadMessage {
       this->opcod = opcod;
       this->absp2mode = absp2mode;
       this->pcnt = pcnt;
-      if (pcnt <= 10)
+      if (pcnt <= 40)
         this->pp = &(this->p[0]);
       else
         this->pp = new MYFLT[(unsigned int) pcnt];
       for (int i = 0; i < pcnt; i++)
         this->pp[i] = p[i];
     }
-    int run() {
-      CSOUND  *csound = pt_->GetCsound();
+    static int send(CSOUND *csound, int absp2mode, char opcod,
+                    int pcnt, MYFLT *pp)
+    {
       if (absp2mode && pcnt > 1) {
         double  p2 = (double) pp[1] - csoundGetScoreTime(csound);
         if (p2 < 0.0) {
@@ -324,13 +534,80 @@ class CsPerfThreadMsg_ScoreEvent : public CsoundPerformanceThreadMessage {
                        "WARNING: could not create score event\n");
       return 0;
     }
+    int run() {
+      return send(pt_->GetCsound(), absp2mode, opcod, pcnt, pp);
+    }
     ~CsPerfThreadMsg_ScoreEvent()
     {
-      if (pcnt > 10)
+      if (pcnt > 40)
         delete[] pp;
     }
 };
 
+/**
+ * Several score events delivered in the same control period
+ *
+ * nevt:      number of events
+ * opcod:     score opcode of each event
+ * pcnt:      number of p-fields of each event
+ * *p:        p-fields of all events, one after the other
+ */
+
+class CsPerfThreadMsg_ScoreEvents : public CsoundPerformanceThreadMessage {
+ private:
+    int     absp2mode;
+    int     nevt;
+    int     ntot;
+    char    *opcods;
+    int     *pcnts;
+    MYFLT   *pp;
+    void    *mem;
+    MYFLT   buf[48];
+ public:
+    CsPerfThreadMsg_ScoreEvents(CsoundPerformanceThread *pt, int absp2mode,
+                                int nevt, const char *opcod, const int *pcnt,
+                                const MYFLT *p)
+    : CsoundPerformanceThreadMessage(pt)
+    {
+      size_t  bytes;
+      this->absp2mode = absp2mode;
+      this->nevt = nevt;
+      ntot = 0;
+      for (int i = 0; i < nevt; i++)
+        ntot += pcnt[i];
+      // p-fields first, then counts and opcodes, to keep them aligned
+      bytes = sizeof(MYFLT) * ntot + (sizeof(int) + 1) * nevt;
+      mem = (void*) 0;
+      if (bytes <= sizeof(buf))
+        pp = &(buf[0]);
+      else
+        pp = (MYFLT*) (mem = (void*) new MYFLT[bytes / sizeof(MYFLT) + 1]);
+      pcnts = (int*) (pp + ntot);
+      opcods = (char*) (pcnts + nevt);
+      for (int i = 0; i < ntot; i++)
+        pp[i] = p[i];
+      for (int i = 0; i < nevt; i++) {
+        pcnts[i] = pcnt[i];
+        opcods[i] = opcod[i];
+      }
+    }
+    int run()
+    {
+      MYFLT *evt = pp;
+      for (int i = 0; i < nevt; i++) {
+        CsPerfThreadMsg_ScoreEvent::send(pt_->GetCsound(), absp2mode,
+                                         opcods[i], pcnts[i], evt);
+        evt += pcnts[i];
+      }
+      return 0;
+    }
+    ~CsPerfThreadMsg_ScoreEvents()
+    {
+      if (mem)
+        delete[] (MYFLT*) mem;
+    }
+};
+
 /**
  * Score event message as a string
  */
@@ -339,13 +616,13 @@ class CsPerfThreadMsg_InputMessage : public CsoundPerformanceThreadMessage {
  private:
     int     len;
     char    *sp;
-    char    s[128];
+    char    s[400];
  public:
     CsPerfThreadMsg_InputMessage(CsoundPerformanceThread *pt, const char *s)
     : CsoundPerformanceThreadMessage(pt)
     {
       len = (int) strlen(s);
-      if (len < 128)
+      if (len < 400)
         this->sp = &(this->s[0]);
       else
         this->sp = new char[(unsigned int) (len + 1)];
@@ -358,7 +635,7 @@ class CsPerfThreadMsg_InputMessage : public CsoundPerformanceThreadMessage {
     }
     ~CsPerfThreadMsg_InputMessage()
     {
-      if (len >= 128)
+      if (len >= 400)
         delete[] sp;
     }
 };
@@ -397,35 +674,18 @@ int CsoundPerformanceThread::Perform()
 {
     int retval = 0;
     do {
-      while (firstMessage) {
-        csoundLockMutex(queueLock);
-        do {
-          CsoundPerformanceThreadMessage *msg;
-          // get oldest message
-          msg = (CsoundPerformanceThreadMessage*) firstMessage;
-          if (!msg)
-            break;
-          // unlink from FIFO
-          firstMessage = msg->nxt;
-          if (!msg->nxt)
-            lastMessage = (CsoundPerformanceThreadMessage*) 0;
-          // process and destroy message
-          retval = msg->run();
-          delete msg; // TODO: This should be moved out of the Perform function
-        } while (!retval);
+      for (;;) {
+        // when paused, take the pause lock before looking at the queue,
+        // so that a message queued after the check still wakes us up
         if (paused)
           csoundWaitThreadLock(pauseLock, (size_t) 0);
-        // mark queue as empty
-        csoundNotifyThreadLock(flushLock);
-        csoundUnlockMutex(queueLock);
+        retval = RunMessages();
         // if error or end of score, return now
         if (retval)
           goto endOfPerf;
-        // fprintf(stderr, "Error or end of score, returning now.");
-        // if paused, wait until a new message is received, then loop back
         if (!paused)
           break;
-        // VL: if this is paused, then it will double lock.
+        // if paused, wait until a new message is received, then loop back
         csoundWaitThreadLockNoTimeout(pauseLock);
         csoundNotifyThreadLock(pauseLock);
       }
@@ -453,27 +713,56 @@ int CsoundPerformanceThread::Perform()
                               // for the case where stop record was requested
     } while (!retval);
  endOfPerf:
-    status = retval;
+    {
+      std::lock_guard<std::mutex> lk(msgQueue->flushMutex);
+      status = retval;
+    }
     csoundCleanup(csound);
-    // delete any pending messages
-    csoundLockMutex(queueLock);
-    {
-      CsoundPerformanceThreadMessage *msg;
-      msg = (CsoundPerformanceThreadMessage*) firstMessage;
-      firstMessage = (CsoundPerformanceThreadMessage*) 0;
-      lastMessage = (CsoundPerformanceThreadMessage*) 0;
-      while (msg) {
-        CsoundPerformanceThreadMessage *nxt = msg->nxt;
-        delete msg;
-        msg = nxt;
+    // discard any pending messages
+    {
+      CsPerfThreadNode *n;
+      while ((n = msgQueue->pending.Pop()) != (CsPerfThreadNode*) 0) {
+        msgQueue->Retire(static_cast<CsoundPerformanceThreadMessage*>(n));
+        msgQueue->nProcessed.fetch_add(1, std::memory_order_release);
       }
     }
-    csoundNotifyThreadLock(flushLock);
-    csoundUnlockMutex(queueLock);
+    msgQueue->WakeFlush();
     //running = 0;
     return retval;
 }
 
+/**
+ * Runs all queued messages on the performance thread, stopping early if
+ * one returns non-zero (stop or error). Run messages are passed back to
+ * the pool instead of being deleted here.
+ */
+
+int CsoundPerformanceThread::RunMessages()
+{
+    CsPerfThreadNode *n;
+    int retval = 0, nrun = 0;
+    while (!retval &&
+           (n = msgQueue->pending.Pop()) != (CsPerfThreadNode*) 0) {
+      CsoundPerformanceThreadMessage *msg =
+        static_cast<CsoundPerformanceThreadMessage*>(n);
+      long long dt = (long long)
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - msg->queued).count();
+      msgQueue->lastLatency.store(dt, std::memory_order_relaxed);
+      msgQueue->sumLatency.fetch_add(dt, std::memory_order_relaxed);
+      msgQueue->nTimed.fetch_add(1, std::memory_order_relaxed);
+      if (dt > msgQueue->maxLatency.load(std::memory_order_relaxed))
+        msgQueue->maxLatency.store(dt, std::memory_order_relaxed);
+      retval = msg->run();
+      msgQueue->Retire(msg);
+      msgQueue->nProcessed.fetch_add(1, std::memory_order_release);
+      nrun++;
+    }
+    if (nrun)
+      msgQueue->WakeFlush();
+    return retval;
+}
+
 class CsPerfThread_PerformScore {
  private:
     CsoundPerformanceThread *pt;
@@ -506,11 +795,8 @@ extern "C" {
 void CsoundPerformanceThread::csPerfThread_constructor(CSOUND *csound_)
 {
     csound = csound_;
-    firstMessage = (CsoundPerformanceThreadMessage*) 0;
-    lastMessage = (CsoundPerformanceThreadMessage*) 0;
-    queueLock = (void*) 0;
+    msgQueue = (CsPerfThreadQueue*) 0;
     pauseLock = (void*) 0;
-    flushLock = (void*) 0;
     recordLock = (void *) 0;
     perfThread = (void*) 0;
     paused = 1;
@@ -518,25 +804,23 @@ void CsoundPerformanceThread::csPerfThread_constructor(CSOUND *csound_)
     cdata = 0;
     processcallback = 0;
     running = 0;
-    queueLock = csoundCreateMutex(0);
-    if (!queueLock)
-      return;
     pauseLock = csoundCreateThreadLock();
     if (!pauseLock)
       return;
-    flushLock = csoundCreateThreadLock();
-    if (!flushLock)
-      return;
     recordLock = csoundCreateMutex(0);
     if (!recordLock)
       return;
     try {
-      lastMessage = new CsPerfThreadMsg_Pause(this);
+      msgQueue = new CsPerfThreadQueue();
+      CsoundPerformanceThreadMessage *msg =
+        newMessage<CsPerfThreadMsg_Pause>(msgQueue, this);
+      msg->queued = std::chrono::steady_clock::now();
+      msgQueue->nQueued.fetch_add(1, std::memory_order_relaxed);
+      msgQueue->pending.Push(msg);
     }
     catch (std::bad_alloc&) {
       return;
     }
-    firstMessage = lastMessage;
     recordData.cbuf = NULL;
     recordData.sfile = NULL;
     recordData.thread = NULL;
@@ -584,15 +868,12 @@ CsoundPerformanceThread::~CsoundPerformanceThread()
     if (!status)
       this->Stop();     // FIXME: should handle memory errors here
     this->Join();
-    if (queueLock) {
-        csoundDestroyMutex(queueLock);
+    if (msgQueue) {
+        delete msgQueue;
     }
     if (pauseLock) {
         csoundDestroyMutex(pauseLock);
     }
-    if (flushLock) {
-        csoundDestroyMutex(flushLock);
-    }
     if (recordLock) {
         csoundDestroyMutex(recordLock);
 
@@ -603,72 +884,88 @@ CsoundPerformanceThread::~CsoundPerformanceThread()
 
 void CsoundPerformanceThread::QueueMessage(CsoundPerformanceThreadMessage *msg)
 {
+    if (!msg)
+      return;
     if (status) {
-      delete msg;
+      msgQueue->Recycle(msg);
       return;
     }
-    csoundLockMutex(queueLock);
+    msg->queued = std::chrono::steady_clock::now();
+    unsigned long long n =
+      msgQueue->nQueued.fetch_add(1, std::memory_order_acq_rel) + 1;
+    int depth = (int) (n - msgQueue->nProcessed.load(std::memory_order_acquire));
+    int prv = msgQueue->maxDepth.load(std::memory_order_relaxed);
+    while (depth > prv &&
+           !msgQueue->maxDepth.compare_exchange_weak(prv, depth))
+      ;
     // link message into FIFO
-    if (!lastMessage)
-      firstMessage = msg;
-    else
-      lastMessage->nxt = msg;
-    lastMessage = msg;
-    // mark queue as non-empty
-    csoundWaitThreadLock(flushLock, (size_t) 0);
+    msgQueue->pending.Push(msg);
     // wake up from pause
     csoundNotifyThreadLock(pauseLock);
-    csoundUnlockMutex(queueLock);
 }
 
 void CsoundPerformanceThread::Play()
 {
-    QueueMessage(new CsPerfThreadMsg_Play(this));
+    QueueMessage(newMessage<CsPerfThreadMsg_Play>(msgQueue, this));
 }
 
 void CsoundPerformanceThread::Pause()
 {
-    QueueMessage(new CsPerfThreadMsg_Pause(this));
+    QueueMessage(newMessage<CsPerfThreadMsg_Pause>(msgQueue, this));
 }
 
 void CsoundPerformanceThread::TogglePause()
 {
-    QueueMessage(new CsPerfThreadMsg_TogglePause(this));
+    QueueMessage(newMessage<CsPerfThreadMsg_TogglePause>(msgQueue, this));
 }
 
 void CsoundPerformanceThread::Stop()
 {
-    QueueMessage(new CsPerfThreadMsg_Stop(this));
+    QueueMessage(newMessage<CsPerfThreadMsg_Stop>(msgQueue, this));
 }
 
 void CsoundPerformanceThread::Record(std::string filename,
                                      int samplebits,
                                      int numbufs)
 {
-    QueueMessage(new CsPerfThreadMsg_Record(this, filename,
-                                            samplebits, numbufs));
+    QueueMessage(newMessage<CsPerfThreadMsg_Record>(msgQueue, this, filename,
+                                                    samplebits, numbufs));
 }
 
 void CsoundPerformanceThread::StopRecord()
 {
-    QueueMessage(new CsPerfThreadMsg_StopRecord(this));
+    QueueMessage(newMessage<CsPerfThreadMsg_StopRecord>(msgQueue, this));
 }
 
 void CsoundPerformanceThread::ScoreEvent(int absp2mode, char opcod,
                                          int pcnt, const MYFLT *p)
 {
-    QueueMessage(new CsPerfThreadMsg_ScoreEvent(this,
-                                                absp2mode, opcod, pcnt, p));
+    QueueMessage(newMessage<CsPerfThreadMsg_ScoreEvent>(msgQueue, this,
+                                                        absp2mode, opcod,
+                                                        pcnt, p));
+}
+
+void CsoundPerformanceThread::ScoreEvents(int absp2mode, int nevt,
+                                          const char *opcod, const int *pcnt,
+                                          const MYFLT *p)
+{
+    if (nevt <= 0)
+      return;
+    QueueMessage(newMessage<CsPerfThreadMsg_ScoreEvents>(msgQueue, this,
+                                                         absp2mode, nevt,
+                                                         opcod, pcnt, p));
 }
 
 void CsoundPerformanceThread::InputMessage(const char *s)
 {
-    QueueMessage(new CsPerfThreadMsg_InputMessage(this, s));
+    QueueMessage(newMessage<CsPerfThreadMsg_InputMessage>(msgQueue, this, s));
 }
 
 void CsoundPerformanceThread::SetScoreOffsetSeconds(double timeVal)
 {
-    QueueMessage(new CsPerfThreadMsg_SetScoreOffsetSeconds(this, timeVal));
+    QueueMessage(newMessage<CsPerfThreadMsg_SetScoreOffsetSeconds>(msgQueue,
+                                                                   this,
+                                                                   timeVal));
 }
 
 int CsoundPerformanceThread::Join()
@@ -687,32 +984,18 @@ int CsoundPerformanceThread::Join()
     }
 
     // delete any pending messages
-    {
-      CsoundPerformanceThreadMessage *msg;
-      msg = (CsoundPerformanceThreadMessage*) firstMessage;
-      firstMessage = (CsoundPerformanceThreadMessage*) 0;
-      lastMessage = (CsoundPerformanceThreadMessage*) 0;
-      while (msg) {
-        CsoundPerformanceThreadMessage *nxt = msg->nxt;
-        delete msg;
-        msg = nxt;
-      }
+    if (msgQueue) {
+      CsPerfThreadNode *n;
+      while ((n = msgQueue->pending.Pop()) != (CsPerfThreadNode*) 0)
+        msgQueue->Recycle(static_cast<CsoundPerformanceThreadMessage*>(n));
+      msgQueue->Reclaim();
     }
     // delete all thread locks
-    if (queueLock) {
-      csoundDestroyMutex(queueLock);
-      queueLock = (void*) 0;
-    }
     if (pauseLock) {
       csoundNotifyThreadLock(pauseLock);
       csoundDestroyThreadLock(pauseLock);
       pauseLock = (void*) 0;
     }
-    if (flushLock) {
-      csoundNotifyThreadLock(flushLock);
-      csoundDestroyThreadLock(flushLock);
-      flushLock = (void*) 0;
-    }
 
     running = 0;
     return retval;
@@ -725,10 +1008,56 @@ int CsoundPerformanceThread::Join()
 
 void CsoundPerformanceThread::FlushMessageQueue()
 {
-    if (firstMessage) {
-      csoundWaitThreadLockNoTimeout(flushLock);
-      csoundNotifyThreadLock(flushLock);
+    if (!msgQueue)
+      return;
+    unsigned long long n = msgQueue->nQueued.load(std::memory_order_acquire);
+    {
+      std::unique_lock<std::mutex> lk(msgQueue->flushMutex);
+      msgQueue->flushWaiters.fetch_add(1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      while (!status && perfThread &&
+             msgQueue->nProcessed.load(std::memory_order_acquire) < n)
+        msgQueue->flushCond.wait(lk);
+      msgQueue->flushWaiters.fetch_sub(1, std::memory_order_relaxed);
     }
+    msgQueue->Reclaim();
+}
+
+/**
+ * Returns message queue statistics.
+ */
+
+void CsoundPerformanceThread::GetStats(CsoundPerformanceThreadStats *st)
+{
+    memset(st, 0, sizeof(CsoundPerformanceThreadStats));
+    if (!msgQueue)
+      return;
+    st->messagesProcessed = msgQueue->nProcessed.load(std::memory_order_acquire);
+    st->messagesQueued = msgQueue->nQueued.load(std::memory_order_acquire);
+    st->queueDepth = (int) (st->messagesQueued - st->messagesProcessed);
+    st->maxQueueDepth = msgQueue->maxDepth.load(std::memory_order_relaxed);
+    st->lastLatency =
+      1.0e-9 * (double) msgQueue->lastLatency.load(std::memory_order_relaxed);
+    st->maxLatency =
+      1.0e-9 * (double) msgQueue->maxLatency.load(std::memory_order_relaxed);
+    // average over the messages run since ResetStats(), not all of them
+    unsigned long long cnt = msgQueue->nTimed.load(std::memory_order_relaxed);
+    if (cnt)
+      st->averageLatency =
+        1.0e-9 * (double) msgQueue->sumLatency.load(std::memory_order_relaxed)
+        / (double) cnt;
+    msgQueue->GetPoolStats(&st->poolSize, &st->poolFree);
+}
+
+void CsoundPerformanceThread::ResetStats()
+{
+    if (!msgQueue)
+      return;
+    msgQueue->maxDepth.store(0, std::memory_order_relaxed);
+    msgQueue->lastLatency.store(0, std::memory_order_relaxed);
+    msgQueue->maxLatency.store(0, std::memory_order_relaxed);
+    msgQueue->sumLatency.store(0, std::memory_order_relaxed);
+    msgQueue->nTimed.store(0, std::memory_order_relaxed);
 }
 
 
@@ -834,6 +1163,13 @@ PUBLIK void CsoundPTscoreEvent(Cpt pt, int absp2mode, char opcod, int pcnt, MYFL
   cpt->ScoreEvent(absp2mode, opcod, pcnt, p);
 }
 
+PUBLIK void CsoundPTscoreEvents(Cpt pt, int absp2mode, int nevt,
+                                const char *opcod, const int *pcnt, MYFLT *p)
+{
+  CsoundPerformanceThread *cpt = (CsoundPerformanceThread *)pt;
+  cpt->ScoreEvents(absp2mode, nevt, opcod, pcnt, p);
+}
+
 PUBLIK void CsoundPTinputMessage(Cpt pt, const char *s)
 {
   CsoundPerformanceThread *cpt = (CsoundPerformanceThread *)pt;
@@ -858,5 +1194,17 @@ PUBLIK void CsoundPTflushMessageQueue(Cpt pt)
   cpt->FlushMessageQueue();
 }
 
+PUBLIK void CsoundPTgetStats(Cpt pt, CsoundPerformanceThreadStats *st)
+{
+  CsoundPerformanceThread *cpt = (CsoundPerformanceThread *)pt;
+  cpt->GetStats(st);
+}
+
+PUBLIK void CsoundPTresetStats(Cpt pt)
+{
+  CsoundPerformanceThread *cpt = (CsoundPerformanceThread *)pt;
+  cpt->ResetStats();
+}
+
 } // extern "C"
 
@@ -26,6 +26,7 @@
 
 class CsoundPerformanceThreadMessage;
 class CsPerfThread_PerformScore;
+class CsPerfThreadQueue;
 
 #ifdef SWIG
 %include <std_string.i>
@@ -107,6 +108,24 @@ struct PUBLIC pycallbackdata {
 };
 #endif
 
+/**
+ * Message queue statistics of a CsoundPerformanceThread, see GetStats().
+ * Latencies are the time in seconds from queueing a message to the
+ * performance thread running it; the maximum and average are over the
+ * messages run since the last ResetStats().
+ */
+typedef struct {
+    unsigned long long messagesQueued;
+    unsigned long long messagesProcessed;
+    int     queueDepth;         // messages not yet run
+    int     maxQueueDepth;
+    double  lastLatency;
+    double  maxLatency;
+    double  averageLatency;
+    int     poolSize;           // preallocated message slots
+    int     poolFree;
+} CsoundPerformanceThreadStats;
+
 typedef struct {
     void *cbuf;
     void *sfile;
@@ -119,11 +138,8 @@ typedef struct {
 class PUBLIC CsoundPerformanceThread {
  private:
     CSOUND  *csound;
-    volatile CsoundPerformanceThreadMessage *firstMessage;
-    CsoundPerformanceThreadMessage *lastMessage;
-    void    *queueLock;         // this is actually a mutex
+    CsPerfThreadQueue *msgQueue;  // lock-free FIFO and message pool
     void    *pauseLock;
-    void    *flushLock;
     void    *recordLock;
     void    *perfThread;
     int     paused;
@@ -133,6 +149,7 @@ class PUBLIC CsoundPerformanceThread {
     int  running;
     void (*processcallback)(void *cdata);
     int  Perform();
+    int  RunMessages();
     void csPerfThread_constructor(CSOUND *);
     void QueueMessage(CsoundPerformanceThreadMessage *);
  public:
@@ -206,6 +223,14 @@ class PUBLIC CsoundPerformanceThread {
      * performance, instead of the default of relative to the current time.
      */
     void ScoreEvent(int absp2mode, char opcod, int pcnt, const MYFLT *p);
+    /**
+     * Sends 'nevt' score events as one message, so that they all start in
+     * the same control period. opcod[i] and pcnt[i] are the score opcode
+     * and number of p-fields of event i, and 'p' holds the p-fields of
+     * all events one after the other.
+     */
+    void ScoreEvents(int absp2mode, int nevt, const char *opcod,
+                     const int *pcnt, const MYFLT *p);
     /**
      * Sends a score event as a string, similarly to line events (-L).
      */
@@ -226,6 +251,16 @@ class PUBLIC CsoundPerformanceThread {
      * are actually received by the performance thread.
      */
     void FlushMessageQueue();
+    /**
+     * Fills 'st' with message queue statistics: messages queued and run,
+     * current and maximum queue depth, queueing latency, and the size of
+     * the preallocated message pool.
+     */
+    void GetStats(CsoundPerformanceThreadStats *st);
+    /**
+     * Resets the maximum queue depth and latency statistics.
+     */
+    void ResetStats();
     // --------
     CsoundPerformanceThread(Csound *);
     CsoundPerformanceThread(CSOUND *);
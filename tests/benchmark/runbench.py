@@ -0,0 +1,181 @@
+#!/usr/bin/python
+
+# Csound benchmark runner
+#
+# Renders each workload below offline (-n) a number of times and reports
+# the wall clock time and the number of k-cycles rendered per second.
+# Results are written as JSON with sorted keys so that files from
+# different builds can be diffed or handed to --compare.
+
+from __future__ import print_function
+
+import json
+import os
+import platform
+import subprocess
+import sys
+import time
+from optparse import OptionParser
+
+FORMAT_VERSION = 1
+
+SR = 48000
+KSMPS = 32
+flags = ["-n", "-d", "-m0", "--sample-rate=%d" % SR, "--ksmps=%d" % KSMPS]
+
+# name, csd, score duration in seconds, scale with -j
+workloads = [
+    ("polyphony", "polyphony.csd", 12.0, True),
+    ("convolution", "convolution.csd", 10.0, False),
+    ("pvoc", "pvoc.csd", 10.0, True),
+    ("granular", "granular.csd", 10.0, False),
+    ("udo", "udo.csd", 10.0, True),
+]
+
+
+def median(values):
+    s = sorted(values)
+    n = len(s)
+    if n % 2:
+        return s[n // 2]
+    return 0.5 * (s[n // 2 - 1] + s[n // 2])
+
+
+def gitCommit():
+    try:
+        out = subprocess.check_output(["git", "rev-parse", "HEAD"],
+                                      stderr=open(os.devnull, "w"))
+        return out.decode("ascii").strip()
+    except (OSError, subprocess.CalledProcessError):
+        return None
+
+
+def hostInfo():
+    try:
+        import multiprocessing
+        cpus = multiprocessing.cpu_count()
+    except (ImportError, NotImplementedError):
+        cpus = None
+    return {"system": platform.system(),
+            "release": platform.release(),
+            "machine": platform.machine(),
+            "processor": platform.processor(),
+            "python": platform.python_version(),
+            "cpus": cpus}
+
+
+def runOne(options, csd, threads):
+    command = [options.csoundExecutable] + flags
+    if threads > 1:
+        command.append("--num-threads=%d" % threads)
+    command.append(csd)
+    devnull = open(os.devnull, "w")
+    start = time.time()
+    retVal = subprocess.call(command, stdout=devnull, stderr=devnull)
+    wall = time.time() - start
+    devnull.close()
+    return retVal, wall
+
+
+def runWorkload(options, name, csd, duration, threads):
+    kcycles = int(duration * SR / KSMPS)
+    times = []
+    for i in range(options.runs):
+        retVal, wall = runOne(options, csd, threads)
+        if retVal != 0:
+            print("%-12s -j%d  FAILED (return code %d)" % (name, threads, retVal))
+            return {"name": name, "threads": threads, "error": retVal}
+        times.append(wall)
+    best = min(times)
+    med = median(times)
+    result = {"name": name,
+              "threads": threads,
+              "duration": duration,
+              "kcycles": kcycles,
+              "wall": [round(t, 6) for t in times],
+              "wall_min": round(best, 6),
+              "wall_median": round(med, 6),
+              "kcycles_per_sec": round(kcycles / med, 3),
+              "realtime_factor": round(duration / med, 3)}
+    print("%-12s -j%d  %8.3f s  %10.1f k-cycles/s  %7.2fx realtime" %
+          (name, threads, med, result["kcycles_per_sec"],
+           result["realtime_factor"]))
+    return result
+
+
+def compare(results, baselineFile, tolerance):
+    baseline = json.load(open(baselineFile))
+    old = {}
+    for r in baseline.get("results", []):
+        if "kcycles_per_sec" in r:
+            old[(r["name"], r["threads"])] = r["kcycles_per_sec"]
+    slower = 0
+    print("\nChange against %s:" % baselineFile)
+    for r in results:
+        key = (r["name"], r["threads"])
+        if "kcycles_per_sec" not in r or key not in old:
+            continue
+        change = 100.0 * (r["kcycles_per_sec"] - old[key]) / old[key]
+        mark = ""
+        if change < -tolerance:
+            mark = "  SLOWER"
+            slower += 1
+        print("%-12s -j%d  %+7.2f%%%s" % (key[0], key[1], change, mark))
+    return slower
+
+
+if __name__ == "__main__":
+    parser = OptionParser()
+    parser.add_option("--csound-executable", dest="csoundExecutable",
+                      default="../../csound")
+    parser.add_option("--opcode6dir64", dest="opcode6dir64", default="")
+    parser.add_option("--output", dest="output", default="benchmark.json",
+                      help="file to write the results to")
+    parser.add_option("--runs", dest="runs", type="int", default=3,
+                      help="renders of each workload; the median is kept")
+    parser.add_option("--threads", dest="threads", default="1,2,4,8",
+                      help="thread counts for the -j scaling runs")
+    parser.add_option("--only", dest="only", default="",
+                      help="comma separated list of workloads to run")
+    parser.add_option("--compare", dest="compare", default="",
+                      help="earlier results file to compare against")
+    parser.add_option("--tolerance", dest="tolerance", type="float",
+                      default=5.0,
+                      help="percentage slowdown reported as a regression")
+    (options, args) = parser.parse_args()
+
+    if options.opcode6dir64:
+        os.environ["OPCODE6DIR64"] = options.opcode6dir64
+
+    threadCounts = [int(t) for t in options.threads.split(",") if t]
+    only = [w for w in options.only.split(",") if w]
+
+    results = []
+    failed = 0
+    for (name, csd, duration, scales) in workloads:
+        if only and name not in only:
+            continue
+        for threads in (threadCounts if scales else [1]):
+            r = runWorkload(options, name, csd, duration, threads)
+            if "error" in r:
+                failed += 1
+            results.append(r)
+
+    report = {"format": FORMAT_VERSION,
+              "commit": gitCommit(),
+              "host": hostInfo(),
+              "sr": SR,
+              "ksmps": KSMPS,
+              "runs": options.runs,
+              "results": results}
+    f = open(options.output, "w")
+    json.dump(report, f, indent=2, sort_keys=True)
+    f.write("\n")
+    f.close()
+    print("\nResults written to %s" % options.output)
+
+    slower = 0
+    if options.compare:
+        slower = compare(results, options.compare, options.tolerance)
+
+    sys.exit(1 if failed or slower else 0)
@@ -0,0 +1,234 @@
+/*
+ * File:   memalloc_stress_test.c
+ *
+ * Multi-threaded stress test and throughput benchmark for the Csound
+ * memory allocator (Engine/memalloc.c).  Worker threads allocate,
+ * reallocate and free blocks of mixed sizes, and pass some of them to
+ * other threads through shared slots so that blocks are freed by a
+ * different thread from the one that allocated them.  Contents are
+ * checked throughout.  Build with -DUSE_MEMALLOC_REGIONS=ON to compare
+ * the per-thread caches with the global allocation chain.
+ */
+
+#define __BUILDING_LIBCSOUND
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "csoundCore.h"
+#include "CUnit/Basic.h"
+
+#define MAX_THREADS     8
+#define LOCAL_BLOCKS    64
+#define SHARED_BLOCKS   1024
+#define ITERATIONS      200000
+
+typedef struct {
+    CSOUND      *csound;
+    void        *lock;
+    void        *shared[SHARED_BLOCKS];
+    size_t      sharedSize[SHARED_BLOCKS];
+    int         errors;
+} STRESS;
+
+typedef struct {
+    STRESS      *stress;
+    uint32_t    seed;
+} WORKER;
+
+static uint32_t next_random(uint32_t *seed)
+{
+    *seed = *seed * 1664525 + 1013904223;
+    return *seed >> 8;
+}
+
+/* mostly small blocks, some large ones */
+static size_t random_size(uint32_t *seed)
+{
+    if (next_random(seed) % 8 == 0)
+      return 4096 + next_random(seed) % 60000;
+    return 1 + next_random(seed) % 1024;
+}
+
+static void fill(void *p, size_t size)
+{
+    memset(p, (int) (size & 0xFF), size);
+}
+
+static int check(const void *p, size_t size, size_t n)
+{
+    const unsigned char *c = (const unsigned char *) p;
+    size_t i;
+    for (i = 0; i < n; i++)
+      if (c[i] != (unsigned char) (size & 0xFF))
+        return 0;
+    return 1;
+}
+
+int init_suite1(void) {
+    return 0;
+}
+
+int clean_suite1(void) {
+    return 0;
+}
+
+static uintptr_t stress_thread(void *data)
+{
+    WORKER  *w = (WORKER *) data;
+    STRESS  *s = w->stress;
+    CSOUND  *csound = s->csound;
+    void    *local[LOCAL_BLOCKS];
+    size_t  localSize[LOCAL_BLOCKS];
+    int     i, errors = 0;
+
+    memset(local, 0, sizeof(local));
+    for (i = 0; i < ITERATIONS; i++) {
+      int     k = next_random(&w->seed) % LOCAL_BLOCKS;
+      size_t  size = random_size(&w->seed);
+      if (local[k] == NULL) {
+        local[k] = (i & 1) ? csound->Calloc(csound, size)
+                           : csound->Malloc(csound, size);
+        fill(local[k], size);
+        localSize[k] = size;
+        continue;
+      }
+      if (!check(local[k], localSize[k], localSize[k] < 64 ? localSize[k] : 64))
+        errors++;
+      switch (next_random(&w->seed) % 4) {
+      case 0:                   /* resize, keeping the contents */
+        local[k] = csound->ReAlloc(csound, local[k], size);
+        if (!check(local[k], localSize[k],
+                   size < localSize[k] ? size : localSize[k]))
+          errors++;
+        fill(local[k], size);
+        localSize[k] = size;
+        break;
+      case 1: {                 /* swap with another thread */
+        int     j = next_random(&w->seed) % SHARED_BLOCKS;
+        void    *p;
+        size_t  n;
+        csoundLockMutex(s->lock);
+        p = s->shared[j];
+        n = s->sharedSize[j];
+        s->shared[j] = local[k];
+        s->sharedSize[j] = localSize[k];
+        csoundUnlockMutex(s->lock);
+        local[k] = p;
+        localSize[k] = n;
+        break;
+      }
+      default:
+        csound->Free(csound, local[k]);
+        local[k] = NULL;
+      }
+    }
+    for (i = 0; i < LOCAL_BLOCKS; i++)
+      csound->Free(csound, local[i]);
+    csoundLockMutex(s->lock);
+    s->errors += errors;
+    csoundUnlockMutex(s->lock);
+    return 0;
+}
+
+static void run_stress(int nthreads)
+{
+    STRESS  *s = (STRESS *) calloc(1, sizeof(STRESS));
+    WORKER  workers[MAX_THREADS];
+    void    *threads[MAX_THREADS];
+    RTCLOCK clock;
+    double  seconds;
+    int     i;
+
+    s->csound = csoundCreate(NULL);
+    s->lock = csoundCreateMutex(0);
+    csoundInitTimerStruct(&clock);
+    for (i = 0; i < nthreads; i++) {
+      workers[i].stress = s;
+      workers[i].seed = 12345 + i;
+      threads[i] = csoundCreateThread(stress_thread, &workers[i]);
+      CU_ASSERT_PTR_NOT_NULL(threads[i]);
+    }
+    for (i = 0; i < nthreads; i++)
+      csoundJoinThread(threads[i]);
+    seconds = csoundGetRealTime(&clock);
+    for (i = 0; i < SHARED_BLOCKS; i++) {
+      if (s->shared[i] != NULL &&
+          !check(s->shared[i], s->sharedSize[i], s->sharedSize[i]))
+        s->errors++;
+      s->csound->Free(s->csound, s->shared[i]);
+    }
+    CU_ASSERT_EQUAL(s->errors, 0);
+    printf("\n  %d thread(s): %d operations in %.3f s, %.0f ops/s\n",
+           nthreads, nthreads * ITERATIONS, seconds,
+           seconds > 0.0 ? nthreads * ITERATIONS / seconds : 0.0);
+    csoundDestroyMutex(s->lock);
+    csoundDestroy(s->csound);
+    free(s);
+}
+
+void test_stress_1_thread(void) {
+    run_stress(1);
+}
+
+void test_stress_2_threads(void) {
+    run_stress(2);
+}
+
+void test_stress_4_threads(void) {
+    run_stress(4);
+}
+
+void test_stress_8_threads(void) {
+    run_stress(8);
+}
+
+void test_reset_reuse(void) {
+    CSOUND  *csound = csoundCreate(NULL);
+    int     i, pass;
+    for (pass = 0; pass < 3; pass++) {
+      for (i = 0; i < 10000; i++) {
+        char *p = (char *) csound->Calloc(csound, 1 + (i % 5000));
+        CU_ASSERT_EQUAL(p[i % 5000], 0);
+        p[0] = 1;                     /* left for the reset to free */
+      }
+      csoundReset(csound);
+    }
+    csoundDestroy(csound);
+}
+
+int main()
+{
+    CU_pSuite pSuite = NULL;
+
+    /* initialize the CUnit test registry */
+    if (CUE_SUCCESS != CU_initialize_registry())
+        return CU_get_error();
+
+    /* add a suite to the registry */
+    pSuite = CU_add_suite("Memory allocator tests", init_suite1, clean_suite1);
+    if (NULL == pSuite) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    /* add the tests to the suite */
+    if ((NULL == CU_add_test(pSuite, "Stress 1 thread", test_stress_1_thread))
+        || (NULL == CU_add_test(pSuite, "Stress 2 threads",
+                                test_stress_2_threads))
+        || (NULL == CU_add_test(pSuite, "Stress 4 threads",
+                                test_stress_4_threads))
+        || (NULL == CU_add_test(pSuite, "Stress 8 threads",
+                                test_stress_8_threads))
+        || (NULL == CU_add_test(pSuite, "Reset and reuse", test_reset_reuse))
+        ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    /* Run all tests using the CUnit Basic interface */
+    CU_basic_set_mode(CU_BRM_VERBOSE);
+    CU_basic_run_tests();
+    CU_cleanup_registry();
+    return CU_get_error();
+}
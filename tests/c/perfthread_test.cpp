@@ -1,6 +1,7 @@
 #include "csound.hpp"
 #include "csPerfThread.hpp"
 #include <stdio.h>
+#include <string.h>
 #include <CUnit/Basic.h>
 
 int init_suite1(void)
@@ -79,6 +80,99 @@ void test_record(void)
     csound.Reset();
 }
 
+/* several host threads sending events through the message queue at once */
+
+#define PT_PRODUCERS    4
+#define PT_EVENTS       500
+
+static uintptr_t send_events(void *p)
+{
+    CsoundPerformanceThread *pt = (CsoundPerformanceThread*) p;
+    char    msg[512];
+    MYFLT   pf[48];
+
+    memset(pf, 0, sizeof(pf));
+    pf[0] = 1;                          /* i 1 0 0.01 */
+    pf[2] = 0.01;
+    for (int i = 0; i < PT_EVENTS; i++) {
+      if (i % 50 == 0) {
+        /* longer than the inline storage of a message slot */
+        memset(msg, ' ', sizeof(msg));
+        snprintf(msg, 32, "i 1 0 0.01");
+        msg[10] = ' ';
+        msg[sizeof(msg) - 1] = '\0';
+        pt->InputMessage(msg);
+      }
+      else if (i % 50 == 1)
+        pt->ScoreEvent(0, 'i', 48, pf);
+      else
+        pt->ScoreEvent(0, 'i', 3, pf);
+    }
+    return 0;
+}
+
+static void wait_for_count(Csound &csound, MYFLT n)
+{
+    for (int i = 0; i < 500 && csound.GetChannel("count") < n; i++)
+      csoundSleep(10);
+}
+
+void test_message_queue(void)
+{
+    const char  *instrument =
+            "instr 1 \n"
+            "chnset chnget:i(\"count\") + 1, \"count\" \n"
+            "turnoff \n"
+            "endin \n";
+    CsoundPerformanceThreadStats st;
+    void    *threads[PT_PRODUCERS];
+
+    Csound csound;
+    csound.SetOption((char*)"-n");
+    csound.CompileOrc(instrument);
+    csound.ReadScore((char*)"f 0 3600\n");
+    csound.Start();
+    CsoundPerformanceThread performanceThread(csound.GetCsound());
+    performanceThread.Play();
+    for (int i = 0; i < PT_PRODUCERS; i++)
+      threads[i] = csoundCreateThread(send_events, &performanceThread);
+    for (int i = 0; i < PT_PRODUCERS; i++)
+      csoundJoinThread(threads[i]);
+    performanceThread.FlushMessageQueue();
+
+    /* every message run exactly once, none left behind */
+    performanceThread.GetStats(&st);
+    CU_ASSERT_EQUAL(st.messagesQueued, st.messagesProcessed);
+    CU_ASSERT_EQUAL(st.queueDepth, 0);
+    CU_ASSERT(st.maxQueueDepth >= 1);
+    CU_ASSERT(st.averageLatency <= st.maxLatency);
+    /* slots all back in the pool, which grew in whole chunks */
+    CU_ASSERT(st.poolSize >= 64);
+    CU_ASSERT_EQUAL(st.poolSize % 64, 0);
+    CU_ASSERT_EQUAL(st.poolFree, st.poolSize);
+    wait_for_count(csound, PT_PRODUCERS * PT_EVENTS);
+    CU_ASSERT_EQUAL(csound.GetChannel("count"), PT_PRODUCERS * PT_EVENTS);
+
+    /* after a reset the average only covers the new messages */
+    performanceThread.ResetStats();
+    performanceThread.GetStats(&st);
+    CU_ASSERT_EQUAL(st.maxLatency, 0.0);
+    CU_ASSERT_EQUAL(st.averageLatency, 0.0);
+    performanceThread.InputMessage("i 1 0 0.01");
+    performanceThread.FlushMessageQueue();
+    performanceThread.GetStats(&st);
+    CU_ASSERT(st.maxLatency > 0.0);
+    CU_ASSERT_DOUBLE_EQUAL(st.averageLatency, st.maxLatency, 1.0e-9);
+    CU_ASSERT_DOUBLE_EQUAL(st.averageLatency, st.lastLatency, 1.0e-9);
+
+    performanceThread.Stop();
+    performanceThread.Join();
+    /* flushing a finished performance must not wait */
+    performanceThread.FlushMessageQueue();
+    csound.Cleanup();
+    csound.Reset();
+}
+
 int main()
 {
     CU_pSuite pSuite = NULL;
@@ -97,6 +191,7 @@ int main()
     /* add the tests to the suite */
     if ((NULL == CU_add_test(pSuite, "Test Record", test_record))
             || (NULL == CU_add_test(pSuite, "Test Performance Thread", test_perfthread))
+            || (NULL == CU_add_test(pSuite, "Test message queue", test_message_queue))
         )
     {
         CU_cleanup_registry();
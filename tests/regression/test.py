@@ -69,7 +69,36 @@ def runTest():
         ["bugg.csd", "grain3"],
         ["bugline.csd", "comments in score"],
         ["arrayout.csd", "array dimension greater than nchls"],
-        ["bugstr1.csd", "escaes in score strings"]
+        ["bugstr1.csd", "escaes in score strings"],
+        ["hdf5_roundtrip.csd", "hdf5 write and read back offline"],
+        ["voice_steal.csd", "oldest and quietest voice stealing"],
+        ["voice_fade.csd", "stolen voice fades to zero"],
+        ["voice_redefine.csd", "fading voices across a redefinition"],
+        ["autosleep.csd", "autosleep sleeps and wakes"],
+        ["autosleep_turnoff.csd", "autosleep turnoff and remove"]
+    ]
+
+    # rendered once with each set of flags; the outputs must be identical
+    compareTests = [
+        ["inline_inplace.csd", "inlined UDO writing its inputs",
+         "--inline-udos", "--no-inline-udos"],
+        ["inline_globals.csd", "inlined UDO writing globals",
+         "--inline-udos", "--no-inline-udos"],
+        ["inline_alias.csd", "inlined UDO xin/xout aliasing",
+         "--inline-udos", "--no-inline-udos"],
+        ["inline_recursive.csd", "recursive UDO not inlined",
+         "--inline-udos", "--no-inline-udos"],
+        ["mixer_buss.csd", "stereo mixer busses at ksmps 64",
+         "--omacro:MIXER=1", ""],
+        ["mixer_buss.csd", "stereo mixer busses with -j 4",
+         "--omacro:MIXER=1 -j 4", "-j 4"]
+    ]
+    compareArgs = "-d -h --format=float"
+
+    # tests that need options of their own
+    optionTests = [
+        ["segment_onset.csd", "note starting on a segment boundary",
+         "-d -W -o /tmp/csound_test_segments.wav --segments=0.5 --segment-verify"]
     ]
 
     output = ""
@@ -127,6 +156,87 @@ def runTest():
         output += "\n\n"
         counter += 1
 
+    for t in compareTests:
+        filename = t[0]
+        desc = t[1]
+        if(os.sep == '\\'):
+            executable = (csoundExecutable == "") and "..\..\csound.exe" or csoundExecutable
+        else:
+            executable = (csoundExecutable == "") and "../../csound" or csoundExecutable
+
+        retVal = 0
+        csOutput = ""
+        rendered = []
+        for i in (0, 1):
+            outfile = "/tmp/csound_test_render%d.raw"%i
+            command = "%s %s %s -o %s %s 2> %s"%(executable, compareArgs, t[2 + i], outfile, filename, tempfile)
+            print command
+            ret = os.system(command)
+            if ret != 0:
+                retVal = ret
+            f = open(tempfile, "r")
+            csOutput += f.read()
+            f.close()
+            data = ""
+            if os.path.exists(outfile):
+                f = open(outfile, "rb")
+                data = f.read()
+                f.close()
+                os.remove(outfile)
+            rendered.append(data)
+
+        if retVal == 0 and len(rendered[0]) > 0 and rendered[0] == rendered[1]:
+            testPass += 1
+            out = "[pass] - "
+        else:
+            testFail += 1
+            out = "[FAIL] - "
+            if retVal == 0:
+                retVal = 1
+                csOutput += "\noutputs differ (%d and %d bytes)\n"%(len(rendered[0]), len(rendered[1]))
+
+        out += "Test %i: %s (%s)\n\t%s against %s\n"%(counter, desc, filename, t[2], t[3])
+        print out
+        output += "%s\n"%("=" * 80)
+        output += "Test %i: %s (%s)\nReturn Code: %i\n"%(counter, desc, filename, retVal)
+        output += "%s\n\n"%("=" * 80)
+        output += csOutput
+        retVals.append([filename, desc, retVal, csOutput])
+        output += "\n\n"
+        counter += 1
+
+    for t in optionTests:
+        filename = t[0]
+        desc = t[1]
+        if(os.sep == '\\'):
+            executable = (csoundExecutable == "") and "..\..\csound.exe" or csoundExecutable
+        else:
+            executable = (csoundExecutable == "") and "../../csound" or csoundExecutable
+
+        command = "%s %s %s 2> %s"%(executable, t[2], filename, tempfile)
+        print command
+        retVal = os.system(command)
+
+        if retVal == 0:
+            testPass += 1
+            out = "[pass] - "
+        else:
+            testFail += 1
+            out = "[FAIL] - "
+
+        out += "Test %i: %s (%s)\n\t%s\n"%(counter, desc, filename, t[2])
+        print out
+        output += "%s\n"%("=" * 80)
+        output += "Test %i: %s (%s)\nReturn Code: %i\n"%(counter, desc, filename, retVal)
+        output += "%s\n\n"%("=" * 80)
+        f = open(tempfile, "r")
+        csOutput = f.read()
+        f.close()
+        output += csOutput
+        retVals.append([filename, desc, retVal, csOutput])
+        output += "\n\n"
+        counter += 1
+
 #    print output
 
     print "%s\n\n"%("=" * 80)
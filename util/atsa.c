@@ -158,6 +158,7 @@ typedef struct {
     int     highest_bin;
     int     frames;
     int     type;
+    int     nthreads;
 } ANARGS;
 
 /* ATS_FFT
@@ -257,6 +258,23 @@ typedef struct {
     double  **band_energy;
 } ATS_SOUND;
 
+/* ATS_PEAKJOB
+ * ===========
+ * peak detection of all frames, done before tracking
+ * so that frames can be analysed concurrently
+ */
+typedef struct {
+    ANARGS  *anargs;
+    mus_sample_t *buf;
+    int     sflen, M_2, first_point;
+    float   *window, norm;
+    /* fft buffer for each thread */
+    MYFLT   **fftdata;
+    /* peaks found in each frame */
+    ATS_PEAK **peaks;
+    int     *peaks_size;
+} ATS_PEAKJOB;
+
 /* Interface:
  * ==========
  * grouped by file in alphabetical order
@@ -359,6 +377,18 @@ static ATS_PEAK *peak_detection(CSOUND *csound, ATS_FFT *ats_fft,
                                 float lowest_mag, double norm,
                                 int *peaks_size);
 
+/* frame_peaks
+ * ===========
+ * windows and transforms one analysis frame, then detects
+ * its peaks and evaluates their SMR; uses only per-frame
+ * and per-thread data
+ * userData: pointer to ATS_PEAKJOB
+ * thread: thread slot
+ * frame_n: analysis frame number
+ */
+static void frame_peaks(CSOUND *csound, void *userData, int32_t thread,
+                        int64_t frame_n);
+
 /* peak-tracking.c */
 
 /* peak_tracking
@@ -599,7 +629,9 @@ static CS_NOINLINE CS_NORETURN void usage(CSOUND *csound)
     csound->Message(csound, "%s", Str("\t\t(Options: 1=amp.and freq. only, "
                                 "2=amp.,freq. and phase, "
                                 "3=amp.,freq. and residual, "
-                                "4=amp.,freq.,phase, and residual)\n\n"));
+                                "4=amp.,freq.,phase, and residual)\n"));
+    csound->Message(csound, "%s", Str("\t -j number of analysis threads "
+                                      "(1)\n\n"));
     csound->LongJmp(csound, 1);
 }
 
@@ -631,6 +663,7 @@ static int atsa_main(CSOUND *csound, int argc, char **argv)
     anargs->last_peak_cont = ATSA_LPKCONT;
     anargs->SMR_cont = ATSA_SMRCONT;
     anargs->type = ATSA_TYPE;
+    anargs->nthreads = 1;
 
     for (i = 1; i < argc; ++i) {
       if (cur_opt == '\0') {
@@ -712,6 +745,9 @@ static int atsa_main(CSOUND *csound, int argc, char **argv)
       case 'F':
         anargs->type = (int) atoi(s);
         break;
+      case 'j':
+        anargs->nthreads = util_clamp_threads(csound, "atsa", (int) atoi(s));
+        break;
       default:
         usage(csound);
       }
@@ -1082,6 +1118,41 @@ static ATS_PEAK *peak_detection(CSOUND *csound, ATS_FFT *ats_fft,
     return (peaks);
 }
 
+static void frame_peaks(CSOUND *csound, void *userData, int32_t thread,
+                        int64_t frame_n)
+{
+    ATS_PEAKJOB *job = (ATS_PEAKJOB *) userData;
+    ANARGS  *anargs = job->anargs;
+    ATS_FFT fft;
+    int     k, filptr;
+
+    fft.size = anargs->fft_size;
+    fft.rate = anargs->srate;
+    fft.data = job->fftdata[thread];
+    /* half a window from first sample of the frame */
+    filptr = anargs->first_smp - job->M_2 + (int) frame_n * anargs->hop_smp;
+    /* clear fft arrays */
+    for (k = 0; k < (fft.size + 2); k++)
+      fft.data[k] = (MYFLT) 0;
+    /* multiply by window */
+    for (k = 0; k < anargs->win_size; k++) {
+      if ((filptr >= 0) && (filptr < job->sflen))
+        fft.data[(k + job->first_point) % anargs->fft_size] =
+            (MYFLT) job->window[k] * (MYFLT) job->buf[filptr];
+      filptr++;
+    }
+    /* take the fft */
+    csound->RealFFTnp2(csound, fft.data, fft.size);
+    /* peak detection */
+    job->peaks_size[frame_n] = 0;
+    job->peaks[frame_n] =
+        peak_detection(csound, &fft, anargs->lowest_bin, anargs->highest_bin,
+                       anargs->lowest_mag, job->norm, &job->peaks_size[frame_n]);
+    /* evaluate peaks SMR (masking curves) */
+    if (job->peaks[frame_n] != NULL)
+      evaluate_smr(job->peaks[frame_n], job->peaks_size[frame_n]);
+}
+
 /* to_polar
  * ========
  * rectangular to polar conversion
@@ -2010,7 +2081,8 @@ static ATS_SOUND *tracker(CSOUND *csound, ANARGS *anargs, char *soundfile,
     ATS_PEAK *peaks, *tracks = NULL, cpy_peak;
     ATS_FRAME *ana_frames = NULL, *unmatched_peaks = NULL;
     mus_sample_t **bufs;
-    ATS_FFT fft;
+    ATS_PEAKJOB job;
+    RTCLOCK clk;
     SF_INFO sfinfo;
     SNDFILE *sf;
     void    *fd;
@@ -2241,40 +2313,42 @@ static ATS_SOUND *tracker(CSOUND *csound, ANARGS *anargs, char *soundfile,
     /* read sound into memory */
     atsa_sound_read_noninterleaved(sf, bufs, 1, sflen);
 
-    /* make our fft-struct */
-    fft.size = anargs->fft_size;
-    fft.rate = anargs->srate;
-    fft.data =
-        (MYFLT *) csound->Malloc(csound,
-                                 (anargs->fft_size + 2) * sizeof(MYFLT));
+    /* peak detection of all frames, which may run on several threads */
+    job.anargs = anargs;
+    job.buf = bufs[0];
+    job.sflen = sflen;
+    job.M_2 = M_2;
+    job.first_point = first_point;
+    job.window = window;
+    job.norm = norm;
+    job.fftdata = (MYFLT **) csound->Malloc(csound,
+                                            anargs->nthreads * sizeof(MYFLT *));
+    for (k = 0; k < anargs->nthreads; k++)
+      job.fftdata[k] =
+          (MYFLT *) csound->Malloc(csound,
+                                   (anargs->fft_size + 2) * sizeof(MYFLT));
+    job.peaks =
+        (ATS_PEAK **) csound->Malloc(csound,
+                                     anargs->frames * sizeof(ATS_PEAK *));
+    job.peaks_size =
+        (int *) csound->Malloc(csound, anargs->frames * sizeof(int));
+    if (anargs->nthreads > 1)
+      csound->Message(csound, Str("atsa: using %d threads\n"),
+                      anargs->nthreads);
+    csound->InitTimerStruct(&clk);
+    util_parallel_frames(csound, anargs->nthreads, anargs->frames,
+                         frame_peaks, &job);
 
     /* main loop */
     for (frame_n = 0; frame_n < anargs->frames; frame_n++) {
-      /* clear fft arrays */
-      for (k = 0; k < (fft.size + 2); k++)
-        fft.data[k] = (MYFLT) 0;
-      /* multiply by window */
-      for (k = 0; k < anargs->win_size; k++) {
-        if ((filptr >= 0) && (filptr < sflen))
-          fft.data[(k + first_point) % anargs->fft_size] =
-              (MYFLT) window[k] * (MYFLT) bufs[0][filptr];
-        filptr++;
-      }
       /* we keep sample numbers of window midpoints in win_samps array */
-      win_samps[frame_n] = filptr - M_2 - 1;
-      /* move file pointer back */
-      filptr = filptr - anargs->win_size + anargs->hop_smp;
-      /* take the fft */
-      csound->RealFFTnp2(csound, fft.data, fft.size);
-      /* peak detection */
-      peaks_size = 0;
-      peaks =
-          peak_detection(csound, &fft, anargs->lowest_bin, anargs->highest_bin,
-                         anargs->lowest_mag, norm, &peaks_size);
+      win_samps[frame_n] = filptr + anargs->win_size - M_2 - 1;
+      /* move file pointer on */
+      filptr += anargs->hop_smp;
+      peaks = job.peaks[frame_n];
+      peaks_size = job.peaks_size[frame_n];
       /* peak tracking */
       if (peaks != NULL) {
-        /* evaluate peaks SMR (masking curves) */
-        evaluate_smr(peaks, peaks_size);
         if (frame_n) {
           /* initialise or update tracks */
           if ((tracks =
@@ -2342,10 +2416,15 @@ static ATS_SOUND *tracker(CSOUND *csound, ANARGS *anargs, char *soundfile,
                       anargs->first_smp) / (double) anargs->srate;
       }
     }
+    util_report_rate(csound, "atsa", anargs->frames, &clk);
     /* free up some memory */
     csound->Free(csound, window);
     csound->Free(csound, tracks);
-    csound->Free(csound, fft.data);
+    for (k = 0; k < anargs->nthreads; k++)
+      csound->Free(csound, job.fftdata[k]);
+    csound->Free(csound, job.fftdata);
+    csound->Free(csound, job.peaks);
+    csound->Free(csound, job.peaks_size);
     /* init sound */
     csound->Message(csound, "%s", Str("Initializing ATS data..."));
     sound = (ATS_SOUND *) csound->Malloc(csound, sizeof(ATS_SOUND));
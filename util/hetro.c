@@ -95,9 +95,18 @@ typedef struct {
   MYFLT  *auxp;                 /* pointer to input file */
   MYFLT  *adp;                  /* pointer to front of sample file */
   double *c_p,*s_p;             /* pointers to space for sine and cos terms */
+  double *begbufs, *endbufs;    /* bufs that will be refilled each hno */
   int32_t newformat;             /* flag for m/c independent format */
+  int32_t nthreads,              /* harmonics analysed concurrently */
+         thread;                /* thread slot owning this copy */
 } HET;
 
+typedef struct {                /* state for parallel harmonic analysis */
+  HET    *het;                  /* one copy per thread */
+  MYFLT  *cur_est, *max_frq, *max_amp;  /* per harmonic, for messages */
+  int32_t *status;
+} HETJOB;
+
 #if INCSDIF
 static int32_t writesdif(CSOUND*, HET*);
 #endif
@@ -111,6 +120,7 @@ static  void    average(HET *,int32, double *, double *, int32);
 static  void    output(HET *,int32, int32_t, int32_t);
 static  void    output_ph(HET *, int32);
 static  int32_t filedump(HET *, CSOUND *);
+static  void    hetharm(CSOUND *, void *, int32_t, int64_t);
 static  int32_t quit(CSOUND *, char *);
 
 #define sgn(x)  (x<0.0 ? -1 : 1)
@@ -137,6 +147,8 @@ static void init_het(HET *t)
     t->bufsiz    = 1;             /* circular buffer size */
     t->skip      = 0;             /* JPff: this was missing */
     t->newformat = 1;
+    t->nthreads  = 1;
+    t->thread    = 0;
 }
 
 static int32_t hetro(CSOUND *csound, int32_t argc, char **argv)
@@ -144,10 +156,11 @@ static int32_t hetro(CSOUND *csound, int32_t argc, char **argv)
     SNDFILE *infd;
     int32_t i, hno, channel = 1, retval = 0;
     int32   nsamps, smpspc, bufspc, mgfrspc;
-    char    *dsp, *dspace;
-    double  *begbufs, *endbufs;
+    char    *dsp;
     HET     het;
     HET     *t = &het;
+    HETJOB  job;
+    RTCLOCK clk;
     SOUNDIN *p;         /* space allocated by SAsndgetset() */
 
  /* csound->dbfs_to_float = csound->e0dbfs = FL(1.0);   Needed ? */
@@ -234,6 +247,11 @@ static int32_t hetro(CSOUND *csound, int32_t argc, char **argv)
         case 'x':
           het.newformat = 0;
           break;
+        case 'j':
+          FIND(Str("no number of threads"))
+          sscanf(s,"%d",&t->nthreads);
+          t->nthreads = util_clamp_threads(csound, "hetro", t->nthreads);
+          break;
         case '-':
           FIND(Str("no log file"));
           while (*s++) {}; s--;
@@ -304,25 +322,6 @@ static int32_t hetro(CSOUND *csound, int32_t argc, char **argv)
     smpspc = t->smpsin * sizeof(double);
     bufspc = t->bufsiz * sizeof(double);
 //printf("sizes2: smpspc - %d  bufspc - %d\n", smpspc, bufspc);
-    dsp = dspace = csound->Calloc(csound, smpspc * 2 + bufspc * 13);
-    t->c_p = (double *) dsp;      dsp += smpspc;  /* space for the    */
-    t->s_p = (double *) dsp;      dsp += smpspc;  /* quadrature terms */
-    begbufs = (double *) dsp;
-    t->cos_mul = (double *) dsp;  dsp += bufspc;  /* bufs that will be */
-    t->sin_mul = (double *) dsp;  dsp += bufspc;  /* refilled each hno */
-    t->a_term = (double *) dsp;   dsp += bufspc;
-    t->b_term = (double *) dsp;   dsp += bufspc;
-    t->r_ampl = (double *) dsp;   dsp += bufspc;
-    t->ph_av1 = (double *) dsp;   dsp += bufspc;
-    t->ph_av2 = (double *) dsp;   dsp += bufspc;
-    t->ph_av3 = (double *) dsp;   dsp += bufspc;
-    t->r_phase = (double *) dsp;  dsp += bufspc;
-    t->amp_av1 = (double *) dsp;  dsp += bufspc;
-    t->amp_av2 = (double *) dsp;  dsp += bufspc;
-    t->amp_av3 = (double *) dsp;  dsp += bufspc;
-    t->a_avg = (double *) dsp;    dsp += bufspc;
-    endbufs = (double *) dsp;
-
     mgfrspc = t->num_pts * sizeof(MYFLT);
     dsp = csound->Malloc(csound, mgfrspc * t->hmax * 2);
     t->MAGS = (MYFLT **) csound->Malloc(csound,
@@ -335,28 +334,63 @@ static int32_t hetro(CSOUND *csound, int32_t argc, char **argv)
     }
     lpinit(t);                        /* calculate LPF coeffs.  */
     t->adp = t->auxp;           /* point to beg sample data block */
-    for (hno = 0; hno < t->hmax; hno++) { /* for requested harmonics */
-      double *dblp;
-      t->freq_est += t->fund_est; /*   do analysis */
-      t->cur_est = t->freq_est;
-      dblp = begbufs;
-      // TODO? memset(begbufs, '\0', (endbufs-begbufs)*sizeof(double));
-      do {
-        *dblp++ = FL(0.0);                    /* clear all refilling buffers */
-      } while (dblp < endbufs);
-      t->max_frq = FL(0.0);
-      t->max_amp = -FL(1.0);
 
+    /* harmonics are independent: each thread gets its own copy of the
+       analysis state and a contiguous range of harmonics */
+    if (t->nthreads > t->hmax)
+      t->nthreads = t->hmax;
+    job.het = (HET *) csound->Malloc(csound, t->nthreads * sizeof(HET));
+    job.cur_est = (MYFLT *) csound->Malloc(csound,
+                                           t->hmax * 3 * sizeof(MYFLT));
+    job.max_frq = job.cur_est + t->hmax;
+    job.max_amp = job.max_frq + t->hmax;
+    job.status = (int32_t *) csound->Calloc(csound, t->hmax * sizeof(int32_t));
+    for (i = 0; i < t->nthreads; i++) {
+      HET *th = &job.het[i];
+      *th = *t;
+      th->thread = i;
+      dsp = csound->Calloc(csound, smpspc * 2 + bufspc * 13);
+      th->c_p = (double *) dsp;      dsp += smpspc;  /* space for the    */
+      th->s_p = (double *) dsp;      dsp += smpspc;  /* quadrature terms */
+      th->begbufs = (double *) dsp;
+      th->cos_mul = (double *) dsp;  dsp += bufspc;  /* bufs that will be */
+      th->sin_mul = (double *) dsp;  dsp += bufspc;  /* refilled each hno */
+      th->a_term = (double *) dsp;   dsp += bufspc;
+      th->b_term = (double *) dsp;   dsp += bufspc;
+      th->r_ampl = (double *) dsp;   dsp += bufspc;
+      th->ph_av1 = (double *) dsp;   dsp += bufspc;
+      th->ph_av2 = (double *) dsp;   dsp += bufspc;
+      th->ph_av3 = (double *) dsp;   dsp += bufspc;
+      th->r_phase = (double *) dsp;  dsp += bufspc;
+      th->amp_av1 = (double *) dsp;  dsp += bufspc;
+      th->amp_av2 = (double *) dsp;  dsp += bufspc;
+      th->amp_av3 = (double *) dsp;  dsp += bufspc;
+      th->a_avg = (double *) dsp;    dsp += bufspc;
+      th->endbufs = (double *) dsp;
+    }
+    if (t->nthreads > 1)
+      csound->Message(csound, Str("hetro: using %d threads\n"), t->nthreads);
+    csound->InitTimerStruct(&clk);
+    util_parallel_frames(csound, t->nthreads, t->hmax, hetharm, &job);
+    for (hno = 0; hno < t->hmax; hno++) { /* report in order */
       csound->Message(csound,Str("analyzing harmonic #%d\n"),hno);
-      csound->Message(csound,Str("freq estimate %6.1f,"), t->cur_est);
-      if (hetdyn(csound, t, hno) != 0)  /* perform actual computation */
-        return -1;
-      if (!csound->CheckEvents(csound))
-        return -1;
+      csound->Message(csound,Str("freq estimate %6.1f,"), job.cur_est[hno]);
+      if (job.status[hno] != 0) {
+        retval = -1;
+        break;
+      }
       csound->Message(csound, Str(" max found %6.1f, rel amp %6.1f\n"),
-                              t->max_frq, t->max_amp);
+                              job.max_frq[hno], job.max_amp[hno]);
     }
-    csound->Free(csound, dspace);
+    if (retval == 0)
+      util_report_rate(csound, "hetro", (int64_t) t->hmax * t->num_pts, &clk);
+    for (i = 0; i < t->nthreads; i++)
+      csound->Free(csound, job.het[i].c_p);
+    csound->Free(csound, job.het);
+    csound->Free(csound, job.cur_est);
+    csound->Free(csound, job.status);
+    if (UNLIKELY(retval != 0 || !csound->CheckEvents(csound)))
+      return -1;
 #if INCSDIF
     /* RWD if extension is .sdif, write as 1TRC frames */
     if (is_sdiffile(t->outfilnam)) {
@@ -372,6 +406,32 @@ static int32_t hetro(CSOUND *csound, int32_t argc, char **argv)
     return retval;
 }
 
+/* analyse harmonic hno on the analysis state of the given thread */
+
+static void hetharm(CSOUND *csound, void *userData, int32_t thread,
+                    int64_t hno)
+{
+    HETJOB  *job = (HETJOB *) userData;
+    HET     *t = &job->het[thread];
+    double  *dblp;
+    int64_t i;
+
+    t->freq_est = FL(0.0);
+    for (i = 0; i <= hno; i++)    /* accumulate as the serial loop did */
+      t->freq_est += t->fund_est;
+    t->cur_est = t->freq_est;
+    dblp = t->begbufs;
+    do {
+      *dblp++ = FL(0.0);                    /* clear all refilling buffers */
+    } while (dblp < t->endbufs);
+    t->max_frq = FL(0.0);
+    t->max_amp = -FL(1.0);
+    job->status[hno] = hetdyn(csound, t, (int32_t) hno); /* actual computation */
+    job->cur_est[hno] = t->cur_est;
+    job->max_frq[hno] = t->max_frq;
+    job->max_amp[hno] = t->max_amp;
+}
+
 static double GETVAL(HET* t, double *inb, int32 smpl)
 {                               /* get value at position smpl in array inb */
     if (smpl<0) return 0.0;
@@ -394,6 +454,7 @@ static int32_t hetdyn(CSOUND *csound,
     MYFLT   *ptr;
 
     t->jmp_ph = 0;                     /* set initial phase to 0 */
+    t->old_ph = 0;                     /* harmonics are independent */
     temp_a = temp_b = 0;
     cos_p = t->c_p;
     sin_p = t->s_p;
@@ -454,7 +515,7 @@ static int32_t hetdyn(CSOUND *csound,
         /* if next out-time */
         output(t, smplno, hno, outpnt);  /*     place in     */
         lastout = outpnt;                      /*     output array */
-        if (!csound->CheckEvents(csound))
+        if (t->thread == 0 && !csound->CheckEvents(csound))
           return -1;
       }
       if (t->skip) {
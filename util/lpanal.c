@@ -51,6 +51,20 @@ typedef struct {
   WINDAT   pwindow;
 } LPC;
 
+/* Frames are analysed in batches, concurrently when -j is given; pitch
+   tracking keeps state from frame to frame and is done in order. */
+
+#define LP_BATCH  64            /* frames per thread per batch */
+
+typedef struct {
+  CSOUND  *csound;
+  LPC     *lpc;                 /* one per thread */
+  MYFLT   *sig;                 /* nframes * WINDIN */
+  MYFLT   *coef;                /* nframes * nvals */
+  int32_t *poleFound;           /* per frame */
+  int32_t nframes, maxframes, nvals, storePoles;
+} LPBATCH;
+
 #ifdef TRACE
 static  FILE *trace;
 #endif
@@ -84,6 +98,7 @@ static  void    quit(CSOUND *, char *), lpdieu(CSOUND *, char *);
 static  void    usage(CSOUND *);
 static  void    ptable(CSOUND *, MYFLT, MYFLT, MYFLT, int32_t, LPANAL_GLOBALS*);
 static  MYFLT   getpch(CSOUND *, MYFLT *, LPANAL_GLOBALS*);
+static  void    lpframe(CSOUND *, void *, int32_t, int64_t);
 
 /* Search for an argument and report of not found */
 #define FIND(MSG)   if (*s == '\0')  \
@@ -348,7 +363,6 @@ static int32_t lpanal(CSOUND *csound, int32_t argc, char **argv)
     MYFLT   *coef, beg_time, input_dur, sr = FL(0.0);
     char    *infilnam, *outfilnam;
     int32_t     ofd;
-    double  errn, rms1, rms2, filterCoef[MAXPOLES+1];
     MYFLT   *sigbuf, *sigbuf2;      /* changed from short */
     int64_t    n;
     uint32_t     osiz, nb;
@@ -361,17 +375,13 @@ static int32_t lpanal(CSOUND *csound, int32_t argc, char **argv)
 
 /* Added by MR to handle pole storage */
 
-    int32_t     i, j, indic, storePoles;
-    int32_t     poleFound;
-    double  pr, pi, pm, pp, dPI;
-    double  polePart1[MAXPOLES], polePart2[MAXPOLES];
-    double  z1, workArray1[MAXPOLES];
-#ifdef _DEBUG
-    double  polyReal[MAXPOLES], polyImag[MAXPOLES];
-#endif
+    int32_t     i, storePoles;
     LPANAL_GLOBALS *lpg;
     int32_t new_format=0;
     FILE    *oFd;
+    int32_t nthreads = 1, done = 0;
+    LPBATCH b;
+    RTCLOCK clk;
 
     lpc.debug   = 0;
     lpc.verbose = 0;
@@ -396,7 +406,6 @@ static int32_t lpanal(CSOUND *csound, int32_t argc, char **argv)
     *tp           = '\0';
     pchlow        = PITCHMIN;
     pchhigh       = PITCHMAX;
-    dPI           = atan2(0,-1);
 
     /* Default is to store filter coefficients */
     storePoles = FALSE;
@@ -470,6 +479,11 @@ static int32_t lpanal(CSOUND *csound, int32_t argc, char **argv)
         case 'X':
                         new_format = 1;
                         break;
+        case 'j':       FIND(Str("no number of threads"))
+                        sscanf(s,"%d",&nthreads);
+                        nthreads = util_clamp_threads(csound, "lpanal",
+                                                      nthreads);
+                        break;
         default:
           {
             char errmsg[256];
@@ -488,9 +502,6 @@ static int32_t lpanal(CSOUND *csound, int32_t argc, char **argv)
     outfilnam = *argv;
     if (UNLIKELY(lpc.poleCount > MAXPOLES))
       quit(csound,Str("poles exceeds maximum allowed"));
-    /* Allocate space now */
-    coef = (MYFLT*) csound->Malloc(csound, (NDATA+lpc.poleCount*2)*sizeof(MYFLT));
-    /* Space allocated */
     if (UNLIKELY(slice < lpc.poleCount * 5))
       csound->Warning(csound,"%s", Str("hopsize may be too small, "
                                  "recommend at least poleCount * 5\n"));
@@ -599,161 +610,107 @@ static int32_t lpanal(CSOUND *csound, int32_t argc, char **argv)
     csound->dispset(csound, &lpc.pwindow, coef + 4, lpc.poleCount,
                     "pitch: 0000.00   ", 0, "LPC/POLES");
 #endif
-    /* Space for a array */
-    lpc.a = (double (*)[MAXPOLES])
-      csound->Malloc(csound, MAXPOLES * MAXPOLES * sizeof(double));
-    lpc.x = (double *) csound->Malloc(csound,   /* alloc a double array */
-                                      lpc.WINDIN * sizeof(double));
+    /* Space for a arrays, one set per thread */
+    b.csound = csound;
+    b.storePoles = storePoles;
+    b.nvals = lph->nvals;
+    b.nframes = 0;
+    b.maxframes = LP_BATCH * nthreads;
+    b.lpc = (LPC *) csound->Malloc(csound, nthreads * sizeof(LPC));
+    for (i = 0; i < nthreads; i++) {
+      b.lpc[i] = lpc;
+      b.lpc[i].a = (double (*)[MAXPOLES])
+        csound->Malloc(csound, MAXPOLES * MAXPOLES * sizeof(double));
+      b.lpc[i].x = (double *) csound->Malloc(csound, /* alloc a double array */
+                                             lpc.WINDIN * sizeof(double));
+    }
+    b.sig = (MYFLT *) csound->Malloc(csound, (int64_t) b.maxframes
+                                     * lpc.WINDIN * sizeof(MYFLT));
+    b.coef = (MYFLT *) csound->Malloc(csound, (int64_t) b.maxframes
+                                      * b.nvals * sizeof(MYFLT));
+    b.poleFound = (int32_t *) csound->Malloc(csound,
+                                             b.maxframes * sizeof(int32_t));
 #ifdef TRACE
     csound->FileOpen2(csound, &trace, CSFILE_STD, "lpanal.trace", "w", NULL,
                       CSFTYPE_OTHER_TEXT, 0);
 #endif
+    if (nthreads > 1)
+      csound->Message(csound, Str("lpanal: using %d threads\n"), nthreads);
+    csound->InitTimerStruct(&clk);
     /* Do the analysis */
     do {
-      MYFLT *fp1;
-      double *dfp;
-
-      /* Analyze current frame */
-#ifdef TRACE_POLES
-      csound->Message
-        (csound, "%s", Str("Starting new frame...\n"));
-#endif
-      counter++;
-      alpol(&lpc, sigbuf, &errn, &rms1, &rms2, filterCoef);
-      /* Transfer results */
-      coef[0] = (MYFLT)rms2;
-      coef[1] = (MYFLT)rms1;
-      coef[2] = (MYFLT)errn;
-      if (lpc.doPitch)
-        coef[3] = getpch(csound, sigbuf, lpg);
-      else coef[3] = FL(0.0);
-      if (lpc.debug) csound->Message(csound,"%d\t%9.4f\t%9.4f\t%9.4f\t%9.4f\n",
-                                 counter, coef[0], coef[1], coef[2], coef[3]);
+      int32_t f;
+
+      /* Collect a batch of frames */
+      b.nframes = 0;
+      do {
+        memcpy(b.sig + (int64_t) b.nframes++ * lpc.WINDIN, sigbuf,
+               sizeof(MYFLT)*lpc.WINDIN);
+        counter++;
+        memcpy(sigbuf, sigbuf2, sizeof(MYFLT)*slice);
+        /* Get next sound frame */
+        if ((n = csound->getsndin(csound, infd, sigbuf2, slice, p)) == 0 ||
+            counter >= analframes)
+          done = 1;       /* refill til EOF, or nsmps done */
+      } while (!done && b.nframes < b.maxframes);
+
+      /* Analyze them */
+      util_parallel_frames(csound, nthreads, b.nframes, lpframe, &b);
+
+      /* Pitch track and write in order */
+      for (f = 0; f < b.nframes; f++) {
+        coef = b.coef + (int64_t) f * b.nvals;
+        if (lpc.doPitch)
+          coef[3] = getpch(csound, b.sig + (int64_t) f * lpc.WINDIN, lpg);
+        else coef[3] = FL(0.0);
+        if (lpc.debug) csound->Message(csound,"%d\t%9.4f\t%9.4f\t%9.4f\t%9.4f\n",
+                                       counter - b.nframes + f + 1,
+                                       coef[0], coef[1], coef[2], coef[3]);
 #ifdef TRACE
-      if (lpc.debug) fprintf(trace,"%d\t%9.4f\t%9.4f\t%9.4f\t%9.4f\n",
-                         counter, coef[0], coef[1], coef[2], coef[3]);
+        if (lpc.debug) fprintf(trace,"%d\t%9.4f\t%9.4f\t%9.4f\t%9.4f\n",
+                               counter - b.nframes + f + 1,
+                               coef[0], coef[1], coef[2], coef[3]);
 #endif
-  /*  for (fp1=coef+NDATA, dfp=cc+poleCount, n=poleCount; n--; ) */
-  /*    *fp1++ = - (MYFLT) *--dfp; */  /* rev coefs & chng sgn */
 #if 0
-      CS_SPRINTF(lpc.pwindow.caption, "pitch: %8.2f", coef[3]);
-      display(csound, &lpc.pwindow);
+        CS_SPRINTF(lpc.pwindow.caption, "pitch: %8.2f", coef[3]);
+        display(csound, &lpc.pwindow);
 #endif
-
-      /* Prepare buffer for output */
-
-      if (storePoles) {
-        /* Treat (swap) filter coefs for resolution */
-        filterCoef[lpc.poleCount] = 1.0;
-        for (i=0; i<(lpc.poleCount+1)/2; i++) {
-          j = lpc.poleCount-1-i;
-          z1 = filterCoef[i];
-          filterCoef[i] = filterCoef[j];
-          filterCoef[j] = z1;
-        }
-
-        /* Get the Filter Poles */
-
-        polyzero(lpc.poleCount,filterCoef,polePart1,polePart2,
-                 &poleFound,2000,&indic,workArray1);
-
-        if (UNLIKELY(poleFound<lpc.poleCount)) {
+        if (UNLIKELY(b.poleFound[f] < lpc.poleCount)) {
           csound->Message(csound,
-                          Str("Found only %d poles...sorry\n"), poleFound);
+                          Str("Found only %d poles...sorry\n"), b.poleFound[f]);
           csound->Message(csound,
                           Str("wanted %d poles\n"), lpc.poleCount);
           return -1;
         }
-        InvertPoles(lpc.poleCount,polePart1,polePart2);
 
-#ifdef TRACE_POLES
-        DumpPoles(csound,
-                  lpc.poleCount, polePart1, polePart2, 0, "Extracted Poles");
-#endif
-
-#ifdef _DEBUG
-        /* Resynthetize the filter for check */
-        InvertPoles(lpc.poleCount,polePart1,polePart2);
-
-        synthetize(lpc.poleCount,polePart1,polePart2,polyReal,polyImag);
-
-        for (i=0; i<lpc.poleCount; i++) {
-#ifdef TRACE_FILTER
-          csound->Message(csound, "filterCoef: %f\n", filterCoef[i]);
-#endif
-          if (UNLIKELY(filterCoef[i]-polyReal[lpc.poleCount-i]>1e-10))
-            csound->Message(csound, Str("Error in coef %d : %f <> %f\n"),
-                                    i, filterCoef[i], polyReal[lpc.poleCount-i]);
-        }
-        csound->Message(csound,".");
-        InvertPoles(lpc.poleCount,polePart1,polePart2);
-#endif
-        /* Switch to pole magnitude and phase */
-
-        for (i=0; i<lpc.poleCount;i++) {
-          /* Store magnitude and phase (PI,-PI) */
-          pr = polePart1[i];
-          pi = polePart2[i];
-          pm = hypot(pr, pi);
-          if (pm!=0) {
-            pp = atan2(pi,pr);
-            if (pp>dPI)
-              pp = 2*dPI-pp;
-          }
-          else
-            pp = 0;
-          polePart1[i] = pm;
-          polePart2[i] = pp;
+        /* Write frame to disk */
+        if (new_format) {
+          uint32_t i, j;
+          for (i=0, j=0; i<osiz; i+=sizeof(MYFLT), j++)
+            fprintf(oFd, "%a\n", (double)coef[j]);
         }
-
-  /*    DumpPoles(csound, poleCount,polePart1,polePart2,1,"About to store"); */
-
-        /* Store in output buffer */
-        fp1 = coef+NDATA;
-        for (i=0; i<lpc.poleCount;i++) {
-          *fp1++ = (MYFLT)polePart1[i];
-          *fp1++ = (MYFLT)polePart2[i];
-        }
-      }
-      else {
-        /* Move filter data into output buffer */
-        dfp = filterCoef+lpc.poleCount;
-        fp1 = coef+NDATA;
-        for (n=0;n<lpc.poleCount; n++)
-          *fp1++ = - (MYFLT) *--dfp;
-      }
-
-      /* Write frame to disk */
-      if (new_format) {
-        uint32_t i, j;
-        for (i=0, j=0; i<osiz; i+=sizeof(MYFLT), j++)
-          fprintf(oFd, "%a\n", (double)coef[j]);
+        else
+          if (UNLIKELY((nb = write(ofd, (char *)coef, osiz)) != osiz))
+            quit(csound, Str("write error"));
+        if (UNLIKELY(!csound->CheckEvents(csound)))
+          return -1;
       }
-      else
-        if (UNLIKELY((nb = write(ofd, (char *)coef, osiz)) != osiz))
-          quit(csound, Str("write error"));
-      memcpy(sigbuf, sigbuf2, sizeof(MYFLT)*slice);
-
-      /* Some unused stuff. I think from when all snd was in mem */
-      /*  ( MYFLT *fp2; for (fp1=sigbuf, fp2=sigbuf2, n=slice; n--; ) */
-      /* move slice forward */
-      /*              *fp1++ = *fp2++;} */
-
-      /* Get next sound frame */
-      if ((n = csound->getsndin(csound, infd, sigbuf2, slice, p)) == 0)
-        break;          /* refill til EOF */
-      if (UNLIKELY(!csound->CheckEvents(csound)))
-        return -1;
-    } while (counter < analframes); /* or nsmps done */
+    } while (!done);
 #if 0
     /* clean up stuff */
     dispexit(csound);
 #endif
     csound->Message(csound, Str("%d lpc frames written to %s\n"),
                             counter, outfilnam);
-    csound->Free(csound, lpc.a);
-    csound->Free(csound, lpc.x);
-    csound->Free(csound, coef);
+    util_report_rate(csound, "lpanal", counter, &clk);
+    for (i = 0; i < nthreads; i++) {
+      csound->Free(csound, b.lpc[i].a);
+      csound->Free(csound, b.lpc[i].x);
+    }
+    csound->Free(csound, b.lpc);
+    csound->Free(csound, b.sig);
+    csound->Free(csound, b.coef);
+    csound->Free(csound, b.poleFound);
     csound->Free(csound, lpg->Dwind_dbuf);
     for (i=0;  i<FREQS; ++i) {
       csound->Free(csound, lpg->tphi[i]);
@@ -765,6 +722,126 @@ static int32_t lpanal(CSOUND *csound, int32_t argc, char **argv)
     return 0;
 }
 
+/*
+ *
+ *  Analyse one frame of a batch: filter coefficients, or poles
+ *  (added by MR), into the frame's coefficient slot.
+ *  Thread safe, as all state is per frame or per thread.
+ *
+ */
+
+static void lpframe(CSOUND *csound, void *userData, int32_t thread,
+                    int64_t frame)
+{
+    LPBATCH *b = (LPBATCH *) userData;
+    LPC     *lpc = &b->lpc[thread];
+    MYFLT   *coef = b->coef + frame * b->nvals, *fp1;
+    double  errn, rms1, rms2, filterCoef[MAXPOLES+1], *dfp;
+    int32_t i, j, n, indic, poleFound;
+    double  pr, pi, pm, pp, dPI = atan2(0,-1);
+    double  polePart1[MAXPOLES], polePart2[MAXPOLES];
+    double  z1, workArray1[MAXPOLES];
+#ifdef _DEBUG
+    double  polyReal[MAXPOLES], polyImag[MAXPOLES];
+#endif
+    IGN(csound);
+
+    /* Analyze current frame */
+#ifdef TRACE_POLES
+    csound->Message
+      (csound, "%s", Str("Starting new frame...\n"));
+#endif
+    alpol(lpc, b->sig + frame * lpc->WINDIN, &errn, &rms1, &rms2, filterCoef);
+    /* Transfer results */
+    coef[0] = (MYFLT)rms2;
+    coef[1] = (MYFLT)rms1;
+    coef[2] = (MYFLT)errn;
+    coef[3] = FL(0.0);          /* pitch is tracked later, in order */
+    b->poleFound[frame] = lpc->poleCount;
+/*  for (fp1=coef+NDATA, dfp=cc+poleCount, n=poleCount; n--; ) */
+/*    *fp1++ = - (MYFLT) *--dfp; */  /* rev coefs & chng sgn */
+
+    /* Prepare buffer for output */
+
+    if (b->storePoles) {
+      /* Treat (swap) filter coefs for resolution */
+      filterCoef[lpc->poleCount] = 1.0;
+      for (i=0; i<(lpc->poleCount+1)/2; i++) {
+        j = lpc->poleCount-1-i;
+        z1 = filterCoef[i];
+        filterCoef[i] = filterCoef[j];
+        filterCoef[j] = z1;
+      }
+
+      /* Get the Filter Poles */
+
+      polyzero(lpc->poleCount,filterCoef,polePart1,polePart2,
+               &poleFound,2000,&indic,workArray1);
+
+      if (UNLIKELY(poleFound<lpc->poleCount)) {
+        b->poleFound[frame] = poleFound;        /* reported in order */
+        return;
+      }
+      InvertPoles(lpc->poleCount,polePart1,polePart2);
+
+#ifdef TRACE_POLES
+      DumpPoles(csound,
+                lpc->poleCount, polePart1, polePart2, 0, "Extracted Poles");
+#endif
+
+#ifdef _DEBUG
+      /* Resynthetize the filter for check */
+      InvertPoles(lpc->poleCount,polePart1,polePart2);
+
+      synthetize(lpc->poleCount,polePart1,polePart2,polyReal,polyImag);
+
+      for (i=0; i<lpc->poleCount; i++) {
+#ifdef TRACE_FILTER
+        csound->Message(csound, "filterCoef: %f\n", filterCoef[i]);
+#endif
+        if (UNLIKELY(filterCoef[i]-polyReal[lpc->poleCount-i]>1e-10))
+          csound->Message(csound, Str("Error in coef %d : %f <> %f\n"),
+                                  i, filterCoef[i], polyReal[lpc->poleCount-i]);
+      }
+      csound->Message(csound,".");
+      InvertPoles(lpc->poleCount,polePart1,polePart2);
+#endif
+      /* Switch to pole magnitude and phase */
+
+      for (i=0; i<lpc->poleCount;i++) {
+        /* Store magnitude and phase (PI,-PI) */
+        pr = polePart1[i];
+        pi = polePart2[i];
+        pm = hypot(pr, pi);
+        if (pm!=0) {
+          pp = atan2(pi,pr);
+          if (pp>dPI)
+            pp = 2*dPI-pp;
+        }
+        else
+          pp = 0;
+        polePart1[i] = pm;
+        polePart2[i] = pp;
+      }
+
+/*    DumpPoles(csound, poleCount,polePart1,polePart2,1,"About to store"); */
+
+      /* Store in output buffer */
+      fp1 = coef+NDATA;
+      for (i=0; i<lpc->poleCount;i++) {
+        *fp1++ = (MYFLT)polePart1[i];
+        *fp1++ = (MYFLT)polePart2[i];
+      }
+    }
+    else {
+      /* Move filter data into output buffer */
+      dfp = filterCoef+lpc->poleCount;
+      fp1 = coef+NDATA;
+      for (n=0;n<lpc->poleCount; n++)
+        *fp1++ = - (MYFLT) *--dfp;
+    }
+}
+
 static void quit(CSOUND *csound, char *msg)
 {
     csound->Message(csound,"lpanal: %s\n", msg);
@@ -955,6 +1032,7 @@ static const char *usage_txt[] = {
            " (default 0)"),
   Str_noop("-g\tgraphical display of results"),
   Str_noop("-a\t\talternate (pole) file storage"),
+  Str_noop("-j<nthreads>\tanalyse frames on several threads (default 1)"),
   Str_noop("-- fname\tLog output to file"),
   Str_noop("see also:  Csound Manual Appendix"),
     NULL
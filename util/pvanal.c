@@ -117,9 +117,13 @@ static  int32_t pvxanal(CSOUND *csound, SOUNDIN *p, SNDFILE *fd,
                         int64_t srate, int64_t chans, int64_t fftsize,
                         int64_t overlap, int64_t winsize,
                         pv_wtype wintype,
-                        double beta, int32_t displays);
-static  int64_t    generate_frame(CSOUND*, PVX *pvx, MYFLT *fbuf, float *outanal,
-                                        int64_t samps, int32_t frametype);
+                        double beta, int32_t displays, int32_t nthreads);
+static  void    window_frame(PVX *pvx, const MYFLT *fbuf, MYFLT *anal,
+                             int64_t samps);
+static  void    transform_frame(CSOUND *, int64_t N, MYFLT *anal,
+                                double *phase, int32_t frametype);
+static  int64_t convert_frame(PVX *pvx, MYFLT *anal, const double *phase,
+                              float *outanal, int32_t frametype);
 static  void    chan_split(CSOUND*, const MYFLT *inbuf, MYFLT **chbuf,
                                     int64_t insize, int64_t chans);
 static  int32_t     init(CSOUND *csound,
@@ -145,6 +149,7 @@ static  int32_t     quit(CSOUND *, char *msg);
 #define MAXPVXCHANS     (8)
 #define DEFAULT_BUFLEN  (8192)  /* per channel */
 #define DISPFRAMES      30
+#define PVX_BATCH       (64)    /* frames transformed per thread per batch */
 
 static int32_t pvanal(CSOUND *csound, int32_t argc, char **argv)
 {
@@ -164,6 +169,7 @@ static int32_t pvanal(CSOUND *csound, int32_t argc, char **argv)
     char    err_msg[512];
     double  beta = 6.8;
     int32_t displays = 0;
+    int32_t nthreads = 1;
 
 
     if (UNLIKELY(!(--argc)))
@@ -224,6 +230,10 @@ static int32_t pvanal(CSOUND *csound, int32_t argc, char **argv)
           break;
         case 'g':  displays = 1;
             break;
+        case 'j':  FIND(Str("no number of threads"));
+          sscanf(s, "%d", &nthreads);
+          nthreads = util_clamp_threads(csound, "pvanal", nthreads);
+          break;
         case 'G':  FIND(Str("no latch"));
           sscanf(s, "%d", &latch);
           displays = 1;
@@ -301,7 +311,7 @@ static int32_t pvanal(CSOUND *csound, int32_t argc, char **argv)
     if (UNLIKELY(pvxanal(csound, p, infd, outfilnam, p->sr,
                         ((!channel || channel == ALLCHNLS) ? p->nchanls : 1),
                         frameSize, frameIncr, frameSize * 2,
-                         WindowType, beta, displays) != 0)) {
+                         WindowType, beta, displays, nthreads) != 0)) {
       csound->Message(csound, "%s", Str("error generating pvocex file.\n"));
       return -1;
     }
@@ -324,6 +334,7 @@ static const char *pvanal_usage_txt[] = {
   Str_noop("    -H: use Hamming window instead of the default (von Hann)"),
   Str_noop("    -K: use Kaiser window"),
   Str_noop("    -B <beta>: parameter for Kaiser window"),
+  Str_noop("    -j <numThreads>: transform frames on several threads"),
     NULL
 };
 
@@ -403,23 +414,78 @@ static void PVDisplay_Display(PVDISPLAY *p, int32_t frame)
 
 /* cannot add display code, as we may have 8 channels here...*/
 
+/* Frames are windowed in order into a batch, the batch is transformed
+   (FFT and rectangular to polar) on nthreads threads, and the phase
+   differences are then taken and the frames written in order again, so
+   the analysis file does not depend on the number of threads.          */
+
+typedef struct {
+    PVX         **pvx;
+    int64_t     N, chans;
+    int32_t     nframes, maxframes, nthreads, pvfile, displays;
+    MYFLT       *anal;                  /* maxframes * (N + 2) */
+    double      *phase;                 /* maxframes * (N/2 + 1) */
+    float       *frame;                 /* RWD : MUST be 32bit  */
+    int64_t     blocks_written;         /* m/c framecount for user */
+    PVDISPLAY   disp;
+} PVXBATCH;
+
+static void pvx_transform(CSOUND *csound, void *userData,
+                          int32_t thread, int64_t frame)
+{
+    PVXBATCH    *b = (PVXBATCH *) userData;
+    IGN(thread);
+    transform_frame(csound, b->N, b->anal + frame * (b->N + 2),
+                    b->phase + frame * (b->N / 2 + 1), PVOC_AMP_FREQ);
+}
+
+static int32_t pvx_flush(CSOUND *csound, PVXBATCH *b)
+{
+    int32_t     i, k;
+
+    util_parallel_frames(csound, b->nthreads, b->nframes, pvx_transform, b);
+    for (i = 0; i < b->nframes; i++) {
+      k = (int32_t) (i % b->chans);
+      if (UNLIKELY(!csound->CheckEvents(csound)))
+        csound->LongJmp(csound, 1);
+      convert_frame(b->pvx[k], b->anal + i * (b->N + 2),
+                    b->phase + i * (b->N/2 + 1), b->frame, PVOC_AMP_FREQ);
+      if (UNLIKELY(!csound->PVOC_PutFrames(csound, b->pvfile, b->frame, 1))) {
+        csound->Message(csound,
+                        Str("pvxanal: error writing analysis frames: %s\n"),
+                        csound->PVOC_ErrorString(csound));
+        return 1;
+      }
+      b->blocks_written++;
+      if (b->displays) PVDisplay_Update(&b->disp, b->frame);
+      if (k == b->chans - 1) {
+        if ((b->blocks_written/b->chans) % 20 == 0) {
+          csound->Message(csound, "%"PRId64"\n", b->blocks_written/b->chans);
+        }
+        if (b->displays)
+          PVDisplay_Display(&b->disp, (int32_t) (b->blocks_written / b->chans));
+      }
+    }
+    b->nframes = 0;
+    return 0;
+}
+
 static int32_t pvxanal(CSOUND *csound, SOUNDIN *p, SNDFILE *fd, const char *fname,
                    int64_t srate, int64_t chans, int64_t fftsize, int64_t overlap,
-                   int64_t winsize, pv_wtype wintype, double beta, int32_t displays)
+                   int64_t winsize, pv_wtype wintype, double beta,
+                   int32_t displays, int32_t nthreads)
 {
-    int32_t         i, k, pvfile = -1, rc = 0;
+    int32_t         i, k, rc = 0;
     pv_stype    stype = STYPE_16;
     int64_t        buflen, buflen_samps;
     int64_t        sampsread;
-    int64_t        blocks_written = 0;     /* m/c framecount for user */
     PVX         *pvx[MAXPVXCHANS];
     MYFLT       *inbuf_c[MAXPVXCHANS];
-    float       *frame_c[MAXPVXCHANS];  /* RWD : MUST be 32bit  */
     MYFLT       *inbuf = NULL;
-    float       *frame;                 /* RWD : MUST be 32bit  */
-    MYFLT       *chanbuf;
     int64_t        total_sampsread = 0;
-    PVDISPLAY   disp;
+    PVXBATCH    b;
+    int32_t     done = 0;
+    RTCLOCK     clk;
 
     switch (p->format) {
       case AE_SHORT:  stype = STYPE_16; break;
@@ -434,8 +500,8 @@ static int32_t pvxanal(CSOUND *csound, SOUNDIN *p, SNDFILE *fd, const char *fnam
     for (i = 0; i < MAXPVXCHANS; i++) {
       pvx[i] = NULL;
       inbuf_c[i] = NULL;
-      frame_c[i] = NULL;
     }
+    b.pvfile = -1;
 
     /* TODO: save some memory and create analysis window once! */
 
@@ -452,16 +518,29 @@ static int32_t pvxanal(CSOUND *csound, SOUNDIN *p, SNDFILE *fd, const char *fnam
     buflen = (buflen/overlap) * overlap;
     buflen_samps = buflen * chans;
     inbuf = (MYFLT *) csound->Malloc(csound, buflen_samps * sizeof(MYFLT));
-    for (i=0;i < chans;i++) {
+    for (i=0;i < chans;i++)
       inbuf_c[i] = (MYFLT *) csound->Malloc(csound, buflen * sizeof(MYFLT));
-      frame_c[i] = (float*) csound->Malloc(csound,      /* RWD 32bit */
-                                           (fftsize + 2) * sizeof(float));
-    }
 
-    pvfile  = csound->PVOC_CreateFile(csound, fname, fftsize, overlap, chans,
+    /* a batch always holds whole multi-channel blocks */
+    b.pvx = pvx;
+    b.N = pvx[0]->N;
+    b.chans = chans;
+    b.nframes = 0;
+    b.maxframes = (int32_t) (PVX_BATCH * nthreads * chans);
+    b.nthreads = nthreads;
+    b.displays = displays;
+    b.blocks_written = 0;
+    b.anal = (MYFLT *) csound->Malloc(csound,
+                                      b.maxframes * (b.N + 2) * sizeof(MYFLT));
+    b.phase = (double *) csound->Malloc(csound, b.maxframes * (b.N/2 + 1)
+                                                * sizeof(double));
+    b.frame = (float*) csound->Malloc(csound,      /* RWD 32bit */
+                                      (fftsize + 2) * sizeof(float));
+
+    b.pvfile  = csound->PVOC_CreateFile(csound, fname, fftsize, overlap, chans,
                                               PVOC_AMP_FREQ, srate, stype,
                                               wintype, 0.0f, NULL, winsize);
-    if (UNLIKELY(pvfile < 0)) {
+    if (UNLIKELY(b.pvfile < 0)) {
       csound->Message(csound,
                       Str("pvxanal: unable to create analysis file: %s"),
                       csound->PVOC_ErrorString(csound));
@@ -469,81 +548,63 @@ static int32_t pvxanal(CSOUND *csound, SOUNDIN *p, SNDFILE *fd, const char *fnam
       goto error;
     }
     if (displays)
-    PVDisplay_Init(csound, &disp, (int32_t) fftsize,
+    PVDisplay_Init(csound, &b.disp, (int32_t) fftsize,
                    (int32_t) (((int64_t) p->getframes * chans / overlap)
                           / DISPFRAMES));
-
-    while ((sampsread = csound->getsndin(csound,
-                                         fd, inbuf, buflen_samps, p)) > 0) {
-      total_sampsread += sampsread;
-      /* zeropad to full buflen */
-      if (sampsread < buflen_samps) {
-        /* for (i = sampsread; i < buflen_samps; i++) */
+    if (nthreads > 1)
+      csound->Message(csound, Str("pvanal: using %d threads\n"), nthreads);
+    csound->InitTimerStruct(&clk);
+
+    while (done < 2) {
+      if (!done) {
+        sampsread = csound->getsndin(csound, fd, inbuf, buflen_samps, p);
+        if (sampsread <= 0) {
+          done = 1;
+          continue;
+        }
+        total_sampsread += sampsread;
+        /* zeropad to full buflen */
+        if (sampsread < buflen_samps) {
+          /* for (i = sampsread; i < buflen_samps; i++) */
+          /*   inbuf[i] = FL(0.0); */
+          memset(inbuf, 0, sizeof(MYFLT)*buflen_samps);
+          sampsread = buflen_samps;
+        }
+        if (total_sampsread >= p->getframes*chans)
+          done = 1;
+      }
+      else {
+        /* write out remaining frames */
+        sampsread = fftsize * chans;
+        /* for (i = 0;i< sampsread;i++) */
         /*   inbuf[i] = FL(0.0); */
-        memset(inbuf, 0, sizeof(MYFLT)*buflen_samps);
-        sampsread = buflen_samps;
+        memset(inbuf, 0, sizeof(MYFLT)*sampsread);
+        done = 2;
       }
       chan_split(csound, inbuf, inbuf_c, sampsread, chans);
 
       for (i = 0; i < sampsread/chans; i+= overlap) {
-        for (k = 0; k < chans; k++) {
-          frame = frame_c[k];
-          chanbuf = inbuf_c[k];
-          if (UNLIKELY(!csound->CheckEvents(csound)))
-            csound->LongJmp(csound, 1);
-          generate_frame(csound, pvx[k],chanbuf+i,frame,overlap,PVOC_AMP_FREQ);
-          if (UNLIKELY(!csound->PVOC_PutFrames(csound, pvfile, frame, 1))) {
-            csound->Message(csound,
-                            Str("pvxanal: error writing analysis frames: %s\n"),
-                            csound->PVOC_ErrorString(csound));
-            rc = 1;
-            goto error;
-          }
-          blocks_written++;
-          if (displays) PVDisplay_Update(&disp, frame);
-          if ((blocks_written/chans) % 20 == 0) {
-            csound->Message(csound, "%"PRId64"\n", blocks_written/chans);
-          }
-          if (displays)
-            PVDisplay_Display(&disp, (int32_t) (blocks_written / chans));
-        }
-      }
-      if (total_sampsread >= p->getframes*chans)
-        break;
-    }
-
-    /* write out remaining frames */
-    sampsread = fftsize * chans;
-    /* for (i = 0;i< sampsread;i++) */
-    /*   inbuf[i] = FL(0.0); */
-    memset(inbuf, 0, sizeof(MYFLT)*sampsread);
-    chan_split(csound,inbuf,inbuf_c,sampsread,chans);
-    for (i = 0; i < sampsread/chans; i+= overlap) {
-      for (k = 0; k < chans; k++) {
-        frame = frame_c[k];
-        chanbuf = inbuf_c[k];
-        if (!csound->CheckEvents(csound))
-          csound->LongJmp(csound, 1);
-        generate_frame(csound,pvx[k],chanbuf+i,frame,overlap,PVOC_AMP_FREQ);
-        if (UNLIKELY(!csound->PVOC_PutFrames(csound, pvfile, frame, 1))) {
-          csound->Message(csound,
-                          Str("pvxanal: error writing analysis frames: %s\n"),
-                          csound->PVOC_ErrorString(csound));
+        for (k = 0; k < chans; k++)
+          window_frame(pvx[k], inbuf_c[k] + i,
+                       b.anal + b.nframes++ * (b.N + 2), overlap);
+        if (b.nframes == b.maxframes && UNLIKELY(pvx_flush(csound, &b))) {
           rc = 1;
           goto error;
         }
-        blocks_written++;
-        if (displays) PVDisplay_Update(&disp, frame);
       }
-      if (displays) PVDisplay_Display(&disp, (int32_t) (blocks_written / chans));
+    }
+    if (b.nframes && UNLIKELY(pvx_flush(csound, &b))) {
+      rc = 1;
+      goto error;
     }
     csound->Message(csound, Str("\n%"PRId64" %d-chan blocks written to %s\n"),
-                    (int64_t) blocks_written / (int64_t) chans,
+                    (int64_t) b.blocks_written / (int64_t) chans,
                     (int32_t) chans, fname);
+    util_report_rate(csound, "pvanal", b.blocks_written, &clk);
 
  error:
-    if (pvfile >= 0)
-      csound->PVOC_CloseFile(csound, pvfile);
+    if (b.pvfile >= 0)
+      csound->PVOC_CloseFile(csound, b.pvfile);
     return rc;
 }
 
@@ -707,17 +768,16 @@ static int32_t init(CSOUND *csound,
 
 /* RWD outanal MUST be 32bit */
 
-static int64_t generate_frame(CSOUND *csound, PVX *pvx,
-                                           MYFLT *fbuf, float *outanal,
-                                           int64_t samps, int32_t frametype)
+/* Push the next samps input samples and window the analysis segment
+   into anal; this keeps the input state of pvx, so it must be called
+   for the frames of a channel in order. */
+
+static void window_frame(PVX *pvx, const MYFLT *fbuf, MYFLT *anal,
+                         int64_t samps)
 {
     int32_t     got, tocp, i, j, k;
     int64_t    N = pvx->N;
-    MYFLT   *fp, *oi, *i0, *i1, real, imag, *anal, angleDif;
-    double  rratio, phase;
-    float   *ofp;           /* RWD MUST be 32bit */
-
-    anal = pvx->anal;
+    const MYFLT *fp;
 
     got = samps;            /* always assume */
     if (got < pvx->Dd)
@@ -775,28 +835,59 @@ static int64_t generate_frame(CSOUND *csound, PVX *pvx,
         k -= N;
       *(anal + k) += *(pvx->analWindow + i) * *(pvx->input + j);
     }
-    csound->RealFFTnp2(csound, anal, pvx->N);
-    /* conversion: The real and imaginary values in anal are converted to
-       magnitude and angle-difference-per-second (assuming an
-       intermediate sampling rate of rIn) and are returned in
-       anal. */
+
+    pvx->nI += pvx->D;                          /* increment time */
+    pvx->Dd = MIN(pvx->D,                       /* CARL */
+                  MAX(0, pvx->D + pvx->nMax - pvx->nI - pvx->analWinLen));
+}
+
+/* FFT of a windowed frame; for PVOC_AMP_FREQ the magnitudes are left in
+   the even elements of anal and the phases in phase.  Uses no state of
+   its own, so frames can be transformed in any order or concurrently. */
+
+static void transform_frame(CSOUND *csound, int64_t N, MYFLT *anal,
+                            double *phase, int32_t frametype)
+{
+    int32_t     i;
+    MYFLT       *i0, *i1;
+
+    csound->RealFFTnp2(csound, anal, N);
+    if (frametype == PVOC_AMP_FREQ) {
+      for (i=0,i0=anal,i1=anal+1; i <= N/2; i++,i0+=2,i1+=2) {
+        MYFLT real = *i0, imag = *i1;
+        *i0 =(MYFLT) hypot((double)real, (double)imag);
+        /* RWD don't mess with v small numbers! */
+        phase[i] = (*i0 < FL(1.0E-10) ? 0.0 : atan2((double)imag,(double)real));
+      }
+    }
+}
+
+/* conversion: The real and imaginary values in anal are converted to
+   magnitude and angle-difference-per-second (assuming an
+   intermediate sampling rate of rIn) and are returned in
+   outanal.  Frames of a channel must be converted in order. */
+
+static int64_t convert_frame(PVX *pvx, MYFLT *anal, const double *phase,
+                             float *outanal, int32_t frametype)
+{
+    int32_t     i;
+    int64_t    N = pvx->N;
+    MYFLT   *fp, *oi, *i0, *i1, angleDif;
+    float   *ofp;           /* RWD MUST be 32bit */
+
     /* only support this format for now, in Csound */
     if (frametype == PVOC_AMP_FREQ) {
       for (i=0,i0=anal,i1=anal+1,oi=pvx->oldInPhase;
            i <= pvx->N2;
            i++,i0+=2,i1+=2, oi++) {
-        real = *i0;
-        imag = *i1;
-        *i0 =(MYFLT) hypot((double)real, (double)imag);
         /* phase unwrapping */
         /*if (*i0 == 0.)*/
         if (*i0 < FL(1.0E-10))        /* RWD don't mess with v small numbers! */
           angleDif = FL(0.0);
 
         else {
-          rratio = atan2((double)imag,(double)real);
-          angleDif  = (MYFLT)((phase = rratio) - *oi);
-          *oi = (MYFLT) phase;
+          angleDif  = (MYFLT)(phase[i] - *oi);
+          *oi = (MYFLT) phase[i];
         }
 
         if (angleDif > PI)
@@ -814,10 +905,6 @@ static int64_t generate_frame(CSOUND *csound, PVX *pvx,
     for (i=0;i < N+2;i++)
       *ofp++ = (float) *fp++;  /* RWD need 32bit cast incase MYFLT is double */
 
-    pvx->nI += pvx->D;                          /* increment time */
-    pvx->Dd = MIN(pvx->D,                       /* CARL */
-                  MAX(0, pvx->D + pvx->nMax - pvx->nI - pvx->analWinLen));
-
     return pvx->D;
 }
 
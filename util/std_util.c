@@ -55,6 +55,178 @@ strNcpy(char *dst, const char *src, size_t siz)
     return dst;        /* count does not include NUL */
 }
 
+/* Frame-parallel processing for the analysis utilities.  The frames
+   0 .. nframes-1 are split into contiguous ranges, one per thread; the
+   calling thread takes the first range and always runs frame 0 before any
+   worker is started, so lazily initialised state (FFT tables etc.) is set
+   up single-threaded.  fn() must only write data owned by its frame or by
+   its thread slot; results are then consumed in frame order by the caller,
+   which keeps the output independent of the number of threads.          */
+
+typedef struct {
+    CSOUND        *csound;
+    UTIL_FRAMEFN  fn;
+    void          *userData;
+    int32_t       thread;
+    int64_t       first, last;
+} UTIL_FRAMEJOB;
+
+static uintptr_t util_frame_thread(void *p)
+{
+    UTIL_FRAMEJOB *job = (UTIL_FRAMEJOB *) p;
+    int64_t       n;
+
+    for (n = job->first; n < job->last; n++)
+      job->fn(job->csound, job->userData, job->thread, n);
+    return 0;
+}
+
+int32_t util_parallel_frames(CSOUND *csound, int32_t nthreads,
+                             int64_t nframes, UTIL_FRAMEFN fn, void *userData)
+{
+    UTIL_FRAMEJOB jobs[UTIL_MAXTHREADS];
+    void          *threads[UTIL_MAXTHREADS];
+    int32_t       i;
+
+    if (nframes <= 0)
+      return 0;
+    if (nthreads > nframes)
+      nthreads = (int32_t) nframes;
+    if (nthreads < 1)
+      nthreads = 1;
+    for (i = 0; i < nthreads; i++) {
+      jobs[i].csound = csound;
+      jobs[i].fn = fn;
+      jobs[i].userData = userData;
+      jobs[i].thread = i;
+      jobs[i].first = (nframes * i) / nthreads;
+      jobs[i].last = (nframes * (i + 1)) / nthreads;
+      threads[i] = NULL;
+    }
+    fn(csound, userData, 0, jobs[0].first);
+    jobs[0].first++;
+    for (i = 1; i < nthreads; i++) {
+      threads[i] = csound->CreateThread(util_frame_thread, &jobs[i]);
+      if (UNLIKELY(threads[i] == NULL))       /* do it ourselves then */
+        util_frame_thread(&jobs[i]);
+    }
+    util_frame_thread(&jobs[0]);
+    for (i = 1; i < nthreads; i++)
+      if (threads[i] != NULL)
+        csound->JoinThread(threads[i]);
+    return nthreads;
+}
+
+/* Job-parallel processing, for work items of very different cost such as
+   whole files.  All the workers are started first and each one takes the
+   next job from a shared counter until there are none left, so a long
+   job never holds up the ones behind it.  fn() gets the job number as
+   its frame and must not depend on lazily initialised shared state.    */
+
+typedef struct {
+    CSOUND        *csound;
+    UTIL_FRAMEFN  fn;
+    void          *userData;
+    int64_t       njobs;
+    int64_t       next;
+#if !defined(MSVC) && !defined(HAVE_ATOMIC_BUILTIN)
+    void          *lock;
+#endif
+} UTIL_JOBQUEUE;
+
+typedef struct {
+    UTIL_JOBQUEUE *queue;
+    int32_t       thread;
+} UTIL_JOBWORKER;
+
+static int64_t util_next_job(UTIL_JOBQUEUE *q)
+{
+#if defined(MSVC)
+    return (int64_t) InterlockedExchangeAdd64((volatile LONG64*) &q->next, 1);
+#elif defined(HAVE_ATOMIC_BUILTIN)
+    return __atomic_fetch_add(&q->next, 1, __ATOMIC_SEQ_CST);
+#else
+    int64_t n;
+    q->csound->LockMutex(q->lock);
+    n = q->next++;
+    q->csound->UnlockMutex(q->lock);
+    return n;
+#endif
+}
+
+static uintptr_t util_job_thread(void *p)
+{
+    UTIL_JOBWORKER *w = (UTIL_JOBWORKER *) p;
+    UTIL_JOBQUEUE  *q = w->queue;
+    int64_t        n;
+
+    while ((n = util_next_job(q)) < q->njobs)
+      q->fn(q->csound, q->userData, w->thread, n);
+    return 0;
+}
+
+int32_t util_parallel_jobs(CSOUND *csound, int32_t nthreads,
+                           int64_t njobs, UTIL_FRAMEFN fn, void *userData)
+{
+    UTIL_JOBQUEUE  queue;
+    UTIL_JOBWORKER workers[UTIL_MAXTHREADS];
+    void           *threads[UTIL_MAXTHREADS];
+    int32_t        i;
+
+    if (njobs <= 0)
+      return 0;
+    if (nthreads > njobs)
+      nthreads = (int32_t) njobs;
+    if (nthreads < 1)
+      nthreads = 1;
+    queue.csound = csound;
+    queue.fn = fn;
+    queue.userData = userData;
+    queue.njobs = njobs;
+    queue.next = 0;
+#if !defined(MSVC) && !defined(HAVE_ATOMIC_BUILTIN)
+    queue.lock = csound->Create_Mutex(0);
+#endif
+    for (i = 0; i < nthreads; i++) {
+      workers[i].queue = &queue;
+      workers[i].thread = i;
+      threads[i] = NULL;
+    }
+    for (i = 1; i < nthreads; i++)      /* a thread that fails to start
+                                           leaves its jobs to the others */
+      threads[i] = csound->CreateThread(util_job_thread, &workers[i]);
+    util_job_thread(&workers[0]);
+    for (i = 1; i < nthreads; i++)
+      if (threads[i] != NULL)
+        csound->JoinThread(threads[i]);
+#if !defined(MSVC) && !defined(HAVE_ATOMIC_BUILTIN)
+    csound->DestroyMutex(queue.lock);
+#endif
+    return nthreads;
+}
+
+int32_t util_clamp_threads(CSOUND *csound, const char *util, int32_t nthreads)
+{
+    if (UNLIKELY(nthreads < 1 || nthreads > UTIL_MAXTHREADS)) {
+      int32_t n = (nthreads < 1 ? 1 : UTIL_MAXTHREADS);
+      csound->Warning(csound, Str("%s: %d threads out of range, using %d"),
+                      util, nthreads, n);
+      return n;
+    }
+    return nthreads;
+}
+
+void util_report_rate(CSOUND *csound, const char *util,
+                      int64_t frames, RTCLOCK *clk)
+{
+    double secs = csound->GetRealTime(clk);
+
+    csound->Message(csound,
+                    Str("%s: %"PRId64" frames analysed in %.3f seconds "
+                        "(%.1f frames/sec)\n"), util, frames, secs,
+                    (secs > 0.0 ? (double) frames / secs : 0.0));
+}
+
 /* module interface */
 
 PUBLIC int32_t csoundModuleCreate(CSOUND *csound)
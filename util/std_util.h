@@ -45,5 +45,23 @@ extern int32_t sndinfo_init_(CSOUND *);
 extern int32_t srconv_init_(CSOUND *);
 extern int32_t xtrct_init_(CSOUND *);
 
+/* frame- and job-parallel processing for the utilities (-j N) */
+
+#define UTIL_MAXTHREADS 64
+
+typedef void (*UTIL_FRAMEFN)(CSOUND *, void *userData,
+                             int32_t thread, int64_t frame);
+
+extern int32_t util_parallel_frames(CSOUND *csound, int32_t nthreads,
+                                    int64_t nframes, UTIL_FRAMEFN fn,
+                                    void *userData);
+extern int32_t util_parallel_jobs(CSOUND *csound, int32_t nthreads,
+                                  int64_t njobs, UTIL_FRAMEFN fn,
+                                  void *userData);
+extern int32_t util_clamp_threads(CSOUND *csound, const char *util,
+                                  int32_t nthreads);
+extern void util_report_rate(CSOUND *csound, const char *util,
+                             int64_t frames, RTCLOCK *clk);
+
 #endif  /* CSOUND_STD_UTIL_H */
 